@@ -0,0 +1,62 @@
+// Projections of dotted fields, and of the fields of a multikey index which have never held an
+// array, are covered by the index.
+
+// Include helpers for analyzing explain output.
+load("jstests/libs/analyze_plan.js");
+
+var coll = db.covered_index_dotted;
+coll.drop();
+
+for (var i = 0; i < 10; ++i) {
+    assert.writeOK(coll.insert({a: {b: i, c: -i}, d: i % 3}));
+}
+assert.commandWorked(coll.ensureIndex({"a.b": 1, "a.c": 1}));
+
+var explain = coll.find({"a.b": 5}, {_id: 0, "a.b": 1, "a.c": 1}).explain("executionStats");
+assert(isIndexOnly(explain.queryPlanner.winningPlan), tojson(explain));
+assert.eq(0, explain.executionStats.totalDocsExamined, tojson(explain));
+assert.eq([{a: {b: 5, c: -5}}],
+          coll.find({"a.b": 5}, {_id: 0, "a.b": 1, "a.c": 1}).toArray());
+assert.eq([{a: {c: -5}}], coll.find({"a.b": 5}, {_id: 0, "a.c": 1}).toArray());
+
+// A numeric path component may name an array element, so it isn't covered.
+explain = coll.find({"a.b": 5}, {_id: 0, "a.b": 1, "a.0": 1}).explain();
+assert(!isIndexOnly(explain.queryPlanner.winningPlan), tojson(explain));
+
+// Only 'e' holds arrays, so 'f' can still be read from the index.
+coll.drop();
+for (var i = 0; i < 10; ++i) {
+    assert.writeOK(coll.insert({e: [i, i + 1], f: i}));
+}
+assert.commandWorked(coll.ensureIndex({e: 1, f: 1}));
+
+explain = coll.find({e: 5}, {_id: 0, f: 1}).explain("executionStats");
+assert(isIndexOnly(explain.queryPlanner.winningPlan), tojson(explain));
+assert.eq(0, explain.executionStats.totalDocsExamined, tojson(explain));
+assert.eq([{f: 4}, {f: 5}], coll.find({e: 5}, {_id: 0, f: 1}).sort({f: 1}).toArray());
+
+explain = coll.find({e: 5}, {_id: 0, e: 1}).explain();
+assert(!isIndexOnly(explain.queryPlanner.winningPlan), tojson(explain));
+
+// Once 'f' holds an array too it must be fetched.
+assert.writeOK(coll.insert({e: 5, f: [1, 2]}));
+explain = coll.find({e: 5}, {_id: 0, f: 1}).explain();
+assert(!isIndexOnly(explain.queryPlanner.winningPlan), tojson(explain));
+assert.eq(3, coll.find({e: 5}, {_id: 0, f: 1}).itcount());
+
+// A single element array gives a single key, so it doesn't make the index multikey, but the value
+// in the key still isn't the value in the document.
+coll.drop();
+assert.commandWorked(coll.ensureIndex({e: 1, f: 1}));
+assert.writeOK(coll.insert({e: [1, 2], f: 1}));
+assert.writeOK(coll.insert({e: 1, f: [5]}));
+explain = coll.find({e: 1, f: 5}, {_id: 0, f: 1}).explain();
+assert(!isIndexOnly(explain.queryPlanner.winningPlan), tojson(explain));
+assert.eq([{f: [5]}], coll.find({e: 1, f: 5}, {_id: 0, f: 1}).toArray());
+
+coll.drop();
+assert.commandWorked(coll.ensureIndex({"a.b": 1}));
+assert.writeOK(coll.insert({a: [{b: 1}]}));
+explain = coll.find({"a.b": 1}, {_id: 0, "a.b": 1}).explain();
+assert(!isIndexOnly(explain.queryPlanner.winningPlan), tojson(explain));
+assert.eq([{a: [{b: 1}]}], coll.find({"a.b": 1}, {_id: 0, "a.b": 1}).toArray());
@@ -0,0 +1,46 @@
+// Queries which only compare fields to scalars are bound to the solution of an earlier query of
+// the same shape once it is in the plan cache.  Check that every binding gets its own values.
+
+var t = db.jstests_plan_cache_solution_template;
+t.drop();
+
+for (var i = 0; i < 100; ++i) {
+    t.save({a: i % 10, b: i % 7, c: "s" + (i % 5)});
+}
+
+// Two indices, so that the winning plan is cached.
+t.ensureIndex({a: 1});
+t.ensureIndex({b: 1});
+
+function expectedCount(a, b, c) {
+    var n = 0;
+    for (var i = 0; i < 100; ++i) {
+        if (i % 10 == a && i % 7 == b && (c === undefined || "s" + (i % 5) == c)) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+// Run every shape a few times, so that the later queries are planned from the cache.
+for (var round = 0; round < 3; ++round) {
+    for (var a = 0; a < 10; ++a) {
+        for (var b = 0; b < 7; ++b) {
+            assert.eq(expectedCount(a, b), t.find({a: a, b: b}).itcount(),
+                      tojson({a: a, b: b}));
+
+            var c = "s" + ((a + b) % 5);
+            var docs = t.find({a: a, b: b, c: c}, {_id: 0, a: 1, b: 1}).toArray();
+            assert.eq(expectedCount(a, b, c), docs.length, tojson({a: a, b: b, c: c}));
+            docs.forEach(function(doc) {
+                assert.eq({a: a, b: b}, doc);
+            });
+        }
+    }
+}
+
+// Values of other types, or which aren't scalars, are planned as usual.
+assert.eq(0, t.find({a: "0", b: 0}).itcount());
+assert.eq(0, t.find({a: null, b: 0}).itcount());
+assert.eq(expectedCount(0, 0), t.find({a: 0, b: 0}).itcount());
+assert.eq(expectedCount(3, 4), t.find({a: NumberLong(3), b: 4.0}).itcount());
@@ -0,0 +1,32 @@
+// Compound indices can answer predicates over their trailing fields, and distinct over a trailing
+// field, by seeking past each value of the leading field.
+
+// Include helpers for analyzing explain output.
+load("jstests/libs/analyze_plan.js");
+
+var coll = db.skip_scan;
+coll.drop();
+
+for (var i = 0; i < 1000; ++i) {
+    assert.writeOK(coll.insert({a: i % 4, b: i, c: i % 10}));
+}
+assert.commandWorked(coll.ensureIndex({a: 1, b: 1}));
+
+var explain = coll.find({b: {$gte: 500, $lt: 503}}).explain("executionStats");
+assert(isIxscan(explain.queryPlanner.winningPlan), tojson(explain));
+assert.eq(3, explain.executionStats.nReturned, tojson(explain));
+assert.eq(3, explain.executionStats.totalDocsExamined, tojson(explain));
+// A few keys for each of the 4 values of 'a', rather than the whole index.
+assert.lt(explain.executionStats.totalKeysExamined, 40, tojson(explain));
+
+assert.eq([500, 501, 502],
+          coll.find({b: {$gte: 500, $lt: 503}}, {_id: 0, b: 1}).sort({b: 1}).toArray()
+              .map(function(doc) { return doc.b; }));
+
+// There's no index prefixed by 'c', so distinct skips to each pair of 'a' and 'c' values.
+assert.commandWorked(coll.ensureIndex({a: 1, c: 1}));
+explain = coll.explain("executionStats").distinct("c");
+assert(planHasStage(explain.queryPlanner.winningPlan, "DISTINCT_SCAN"), tojson(explain));
+assert.lte(explain.executionStats.totalKeysExamined, 4 * 10 + 1, tojson(explain));
+assert.eq([0, 1, 2, 3, 4, 5, 6, 7, 8, 9],
+          coll.distinct("c").sort(function(x, y) { return x - y; }));
@@ -0,0 +1,66 @@
+// Test that with internalQueryExecBlockingSortAllowDiskUse set, an unindexed find() sort which
+// needs more than internalQueryExecMaxBlockingSortBytes spills to disk instead of failing, and
+// that explain reports the spills.
+//
+// Note that this test sets server parameters and restores their original values before exiting.
+// As a result, this test cannot run in the sharding passthrough (because mongos does not have
+// these parameters), and cannot run in the parallel suite.
+
+var coll = db.find_sort_spill;
+coll.drop();
+
+var result = db.adminCommand({getParameter: 1,
+                              internalQueryExecMaxBlockingSortBytes: 1,
+                              internalQueryExecBlockingSortAllowDiskUse: 1});
+assert.commandWorked(result);
+var oldSortLimit = result.internalQueryExecMaxBlockingSortBytes;
+var oldAllowDiskUse = result.internalQueryExecBlockingSortAllowDiskUse;
+assert.commandWorked(db.adminCommand({setParameter: 1,
+                                      internalQueryExecMaxBlockingSortBytes: 1024 * 1024}));
+
+try {
+    // Insert ~3MB of data.
+    var largeStr = '';
+    for (var i = 0; i < 32 * 1024; ++i) {
+        largeStr += 'x';
+    }
+    var bulk = coll.initializeUnorderedBulkOp();
+    for (var i = 0; i < 100; ++i) {
+        bulk.insert({a: largeStr, b: (i * 37) % 100});
+    }
+    assert.writeOK(bulk.execute());
+
+    // Without disk use the sort still fails.
+    assert.throws(function() { coll.find({}).sort({b: 1}).itcount(); });
+
+    assert.commandWorked(db.adminCommand({setParameter: 1,
+                                          internalQueryExecBlockingSortAllowDiskUse: true}));
+
+    var docs = coll.find({}, {a: 0}).sort({b: -1}).toArray();
+    assert.eq(100, docs.length);
+    for (var i = 0; i < docs.length; ++i) {
+        assert.eq(99 - i, docs[i].b);
+    }
+
+    // A limit larger than fits in memory spills too.
+    docs = coll.find({}, {a: 0}).sort({b: 1}).limit(60).toArray();
+    assert.eq(60, docs.length);
+    for (var i = 0; i < docs.length; ++i) {
+        assert.eq(i, docs[i].b);
+    }
+
+    var explain = coll.find({}).sort({b: 1}).explain("executionStats");
+    var sortStage = explain.executionStats.executionStages;
+    while (sortStage.stage != "SORT") {
+        sortStage = sortStage.inputStage;
+    }
+    assert.gt(sortStage.spills, 1, tojson(sortStage));
+    assert.gt(sortStage.spilledBytes, 3 * 1024 * 1024, tojson(sortStage));
+    assert.eq(100, explain.executionStats.nReturned);
+}
+finally {
+    assert.commandWorked(db.adminCommand({setParameter: 1,
+                                          internalQueryExecMaxBlockingSortBytes: oldSortLimit,
+                                          internalQueryExecBlockingSortAllowDiskUse:
+                                              oldAllowDiskUse}));
+}
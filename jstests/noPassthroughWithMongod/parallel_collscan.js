@@ -0,0 +1,58 @@
+// Test that with internalQueryExecParallelCollectionScanThreads set, collection scans with a
+// filter run as PARALLEL_COLLSCAN and give the same results to find, count and aggregate.
+//
+// Note that this test sets a server parameter and restores its original value before exiting.
+// As a result, this test cannot run in the sharding passthrough (because mongos does not have
+// this parameter), and cannot run in the parallel suite.
+
+var coll = db.parallel_collscan;
+coll.drop();
+
+var result = db.adminCommand({getParameter: 1,
+                              internalQueryExecParallelCollectionScanThreads: 1});
+assert.commandWorked(result);
+var oldThreads = result.internalQueryExecParallelCollectionScanThreads;
+
+var bulk = coll.initializeUnorderedBulkOp();
+for (var i = 0; i < 5000; ++i) {
+    bulk.insert({a: i, b: i % 10, c: {d: 'str' + (i % 3)}});
+}
+assert.writeOK(bulk.execute());
+
+var query = {b: {$in: [1, 4, 7]}, 'c.d': {$ne: 'str0'}};
+var pipeline = [{$match: query}, {$group: {_id: '$b', total: {$sum: '$a'}}}, {$sort: {_id: 1}}];
+
+function runQueries() {
+    return {find: coll.find(query).toArray(),
+            count: coll.find(query).count(),
+            agg: coll.aggregate(pipeline).toArray()};
+}
+
+try {
+    var expected = runQueries();
+    assert.gt(expected.count, 0);
+
+    assert.commandWorked(db.adminCommand({setParameter: 1,
+                                          internalQueryExecParallelCollectionScanThreads: 4}));
+
+    var explain = coll.find(query).explain("executionStats");
+    var scan = explain.executionStats.executionStages;
+    assert.eq("PARALLEL_COLLSCAN", scan.stage, tojson(explain));
+    assert.eq(4, scan.numThreads, tojson(scan));
+    assert.gt(scan.batches, 1, tojson(scan));
+    assert.eq(5000, scan.docsExamined, tojson(scan));
+
+    // $where has to run on the operation's own thread.
+    explain = coll.find({$where: 'this.b == 1'}).explain();
+    assert.eq("COLLSCAN", explain.queryPlanner.winningPlan.stage, tojson(explain));
+
+    var actual = runQueries();
+    assert.eq(expected.count, actual.count);
+    assert.eq(expected.find, actual.find);
+    assert.eq(expected.agg, actual.agg);
+}
+finally {
+    assert.commandWorked(db.adminCommand({setParameter: 1,
+                                          internalQueryExecParallelCollectionScanThreads:
+                                              oldThreads}));
+}
@@ -0,0 +1,72 @@
+// Before the trial period the multi plan runner counts the keys each candidate's index scans
+// would examine.  Check that explain reports the estimates next to the actual counts, and that
+// candidates estimated to be far more expensive than the cheapest one are not worked.
+//
+// Note that this test sets server parameters and restores their original values before exiting.
+// As a result, this test cannot run in the sharding passthrough (because mongos does not have
+// these parameters), and cannot run in the parallel suite.
+
+var coll = db.plan_ranking_estimates;
+coll.drop();
+
+var result = db.adminCommand({getParameter: 1, internalQueryPlanEvaluationEstimateMaxKeys: 1});
+assert.commandWorked(result);
+var oldEstimateMaxKeys = result.internalQueryPlanEvaluationEstimateMaxKeys;
+
+function getIxscan(stage, keyPattern) {
+    if (stage.stage == "IXSCAN" && friendlyEqual(stage.keyPattern, keyPattern)) {
+        return stage;
+    }
+    var children = stage.inputStages || (stage.inputStage ? [stage.inputStage] : []);
+    for (var i = 0; i < children.length; ++i) {
+        var ixscan = getIxscan(children[i], keyPattern);
+        if (ixscan) {
+            return ixscan;
+        }
+    }
+    return null;
+}
+
+try {
+    var bulk = coll.initializeUnorderedBulkOp();
+    for (var i = 0; i < 2000; ++i) {
+        bulk.insert({a: i % 100, b: i % 2});
+    }
+    assert.writeOK(bulk.execute());
+
+    coll.ensureIndex({a: 1});
+    coll.ensureIndex({b: 1});
+
+    // {a: 7} matches 20 keys, {b: 1} 1000, which is past the default 1000 key estimate limit.
+    var explain = coll.find({a: 7, b: 1}).explain("allPlansExecution");
+    var winner = getIxscan(explain.executionStats.executionStages, {a: 1});
+    assert(winner, tojson(explain));
+    assert.eq(20, winner.estimatedKeysExamined, tojson(winner));
+    assert.eq(20, winner.keysExamined, tojson(winner));
+    assert.eq(10, explain.executionStats.nReturned);
+
+    // The scan over 'b' was pruned.
+    var losers = explain.executionStats.allPlansExecution.filter(function(plan) {
+        return getIxscan(plan.executionStages, {b: 1}) != null &&
+               getIxscan(plan.executionStages, {a: 1}) == null;
+    });
+    assert.eq(1, losers.length, tojson(explain));
+    var loser = getIxscan(losers[0].executionStages, {b: 1});
+    assert.eq(1000, loser.estimatedKeysExamined, tojson(loser));
+    assert.eq(0, loser.keysExamined, tojson(loser));
+
+    // With the estimates turned off, nothing is pruned and there are no estimates to report.
+    assert.commandWorked(db.adminCommand({setParameter: 1,
+                                          internalQueryPlanEvaluationEstimateMaxKeys: 0}));
+    coll.getPlanCache().clear();
+    explain = coll.find({a: 7, b: 1}).explain("allPlansExecution");
+    winner = getIxscan(explain.executionStats.executionStages, {a: 1});
+    assert(winner, tojson(explain));
+    assert(!("estimatedKeysExamined" in winner), tojson(winner));
+    assert.eq(10, explain.executionStats.nReturned);
+}
+finally {
+    assert.commandWorked(db.adminCommand({setParameter: 1,
+                                          internalQueryPlanEvaluationEstimateMaxKeys:
+                                              oldEstimateMaxKeys}));
+}
@@ -0,0 +1,75 @@
+// Runs basic CRUD through a mongos serving clients from the asio network server and checks the
+// connection accounting reported in serverStatus.
+
+(function() {
+    'use strict';
+
+    var st = new ShardingTest({ shards : 2,
+                                mongos : 1,
+                                other : { mongosOptions : { asyncNetwork : "",
+                                                            asyncNetworkThreads : 4,
+                                                            asyncNetworkReactors : 2 }}});
+
+    var mongos = st.s0;
+    var coll = mongos.getCollection("test.async_network");
+
+    assert.commandWorked(mongos.adminCommand({ enableSharding : "test" }));
+    st.ensurePrimaryShard("test", "shard0001");
+    assert.commandWorked(mongos.adminCommand({ shardCollection : coll + "", key : { _id : 1 }}));
+    assert.commandWorked(mongos.adminCommand({ split : coll + "", middle : { _id : 0 }}));
+    assert.commandWorked(mongos.adminCommand({ moveChunk : coll + "",
+                                               find : { _id : 0 },
+                                               to : "shard0000" }));
+
+    for (var i = -50; i < 50; i++) {
+        assert.writeOK(coll.insert({ _id : i, x : i }));
+    }
+    assert.eq(100, coll.find().itcount());
+    assert.eq(50, coll.find({ _id : { $gte : 0 }}).itcount());
+
+    // A getMore goes through the same connection.
+    assert.eq(100, coll.find().batchSize(10).itcount());
+
+    assert.writeOK(coll.update({ _id : 1 }, { $set : { y : 1 }}));
+    assert.eq(1, coll.findOne({ _id : 1 }).y);
+    assert.writeOK(coll.remove({ _id : { $lt : 0 }}));
+    assert.eq(50, coll.count());
+
+    // Errors are reported back to the client without closing the connection.
+    assert.throws(function() { coll.find({ $bogus : 1 }).itcount(); });
+    assert.eq(50, coll.count());
+
+    var status = assert.commandWorked(mongos.adminCommand({ serverStatus : 1 }));
+    assert(status.asyncNetwork.enabled, tojson(status.asyncNetwork));
+    assert.gte(status.asyncNetwork.current, 1, tojson(status.asyncNetwork));
+    assert.gte(status.asyncNetwork.messagesIn, 100, tojson(status.asyncNetwork));
+    assert.gte(status.connections.current, 1, tojson(status.connections));
+
+    // A second client gets its own connection and sees the same data.
+    var other = new Mongo(mongos.host);
+    assert.eq(50, other.getCollection(coll + "").count());
+    status = assert.commandWorked(mongos.adminCommand({ serverStatus : 1 }));
+    assert.gte(status.asyncNetwork.current, 2, tojson(status.asyncNetwork));
+
+    // Connections are spread round robin over the reactors.
+    assert.eq(2, status.asyncNetwork.reactors.length, tojson(status.asyncNetwork));
+    status.asyncNetwork.reactors.forEach(function(reactor) {
+        assert.gte(reactor.connections, 1, tojson(status.asyncNetwork));
+    });
+
+    // Request counters are summed per reactor and per connection.
+    assert.gte(status.asyncNetwork.totals.inserts, 100, tojson(status.asyncNetwork.totals));
+    assert.gte(status.asyncNetwork.totals.commands, 1, tojson(status.asyncNetwork.totals));
+    assert.gte(status.asyncNetwork.totals.bytesIn, 1, tojson(status.asyncNetwork.totals));
+
+    var conns = assert.commandWorked(mongos.adminCommand({ currentConn : 1,
+                                                          sortBy : "inserts",
+                                                          limit : 1 })).connections;
+    assert.eq(1, conns.length, tojson(conns));
+    assert.gte(conns[0].inserts, 100, tojson(conns));
+    conns = assert.commandWorked(mongos.adminCommand({ currentConn : 1 })).connections;
+    assert.gte(conns.length, 2, tojson(conns));
+    assert.commandFailed(mongos.adminCommand({ currentConn : 1, sortBy : "bogus" }));
+
+    st.stop();
+})();
@@ -0,0 +1,41 @@
+// Runs a mongos with request pipelining enabled on the asio network server. Legacy writes are
+// sent without waiting for a reply, so they are read ahead and must still be applied in order.
+
+(function() {
+    'use strict';
+
+    var st = new ShardingTest({ shards : 1,
+                                mongos : 1,
+                                other : { mongosOptions : { asyncNetwork : "",
+                                                            asyncNetworkPipelineDepth : 8 }}});
+
+    var mongos = st.s0;
+    mongos.forceWriteMode("legacy");
+    var coll = mongos.getCollection("test.async_network_pipeline");
+
+    // Fire and forget inserts followed by updates that depend on them.
+    for (var i = 0; i < 500; i++) {
+        coll.insert({ _id : i, x : 0 });
+        coll.update({ _id : i }, { $inc : { x : 1 }});
+    }
+    assert.gleSuccess(mongos.getDB("test"));
+    assert.eq(500, coll.count());
+    assert.eq(500, coll.find({ x : 1 }).itcount());
+
+    // getLastError reports the error from the last write before it.
+    coll.insert({ _id : 0 });
+    assert.gleErrorCode(mongos.getDB("test"), 11000);
+    coll.insert({ _id : 1000 });
+    assert.gleSuccess(mongos.getDB("test"));
+
+    // Queries and getMores still get their replies in order.
+    assert.eq(501, coll.find().batchSize(7).itcount());
+
+    var status = assert.commandWorked(mongos.adminCommand({ serverStatus : 1 }));
+    assert(status.asyncNetwork.enabled, tojson(status.asyncNetwork));
+    assert.gte(status.asyncNetwork.messagesIn, 1000, tojson(status.asyncNetwork));
+    assert(status.asyncNetwork.hasOwnProperty("coalescedReplies"), tojson(status.asyncNetwork));
+    assert(status.asyncNetwork.hasOwnProperty("pipelinePauses"), tojson(status.asyncNetwork));
+
+    st.stop();
+})();
@@ -0,0 +1,55 @@
+// Loads two connections on the same asio reactor while another reactor is idle and checks that
+// the rebalancer moves one of them over, and that the moved connection keeps working.
+
+(function() {
+    'use strict';
+
+    var st = new ShardingTest({ shards : 1,
+                                mongos : 1,
+                                other : { mongosOptions : { asyncNetwork : "",
+                                                            asyncNetworkReactors : 2,
+                                                            asyncNetworkRebalanceIntervalSecs : 1 }}});
+
+    var mongos = st.s0;
+    assert.writeOK(mongos.getCollection("test.rebalance").insert({ _id : 1 }));
+
+    function reactorOf(conn) {
+        var me = assert.commandWorked(conn.adminCommand({ whatsmyuri : 1 })).you;
+        var conns = assert.commandWorked(mongos.adminCommand({ currentConn : 1 })).connections;
+        for (var i = 0; i < conns.length; i++) {
+            if (conns[i].client == me) {
+                return conns[i].reactor;
+            }
+        }
+        assert(false, "connection " + me + " not found in " + tojson(conns));
+    }
+
+    // New connections are spread round robin, so two of these share a reactor.
+    var conns = [];
+    for (var i = 0; i < 4; i++) {
+        conns.push(new Mongo(mongos.host));
+    }
+    var busy = conns.filter(function(conn) {
+        return reactorOf(conn) == reactorOf(conns[0]);
+    }).slice(0, 2);
+    assert.eq(2, busy.length);
+    var from = reactorOf(busy[0]);
+
+    assert.soon(function() {
+        var end = new Date().getTime() + 1000;
+        while (new Date().getTime() < end) {
+            busy.forEach(function(conn) {
+                assert.eq(1, conn.getCollection("test.rebalance").find().itcount());
+            });
+        }
+        var status = assert.commandWorked(mongos.adminCommand({ serverStatus : 1 }));
+        return status.asyncNetwork.connectionsMoved >= 1;
+    }, "no connection was moved", 60 * 1000, 0);
+
+    assert(reactorOf(busy[0]) != from || reactorOf(busy[1]) != from);
+    busy.forEach(function(conn) {
+        assert.eq(1, conn.getCollection("test.rebalance").find().itcount());
+    });
+
+    st.stop();
+})();
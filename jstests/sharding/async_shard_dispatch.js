@@ -0,0 +1,55 @@
+// Checks that commands mongos sends to every shard give the same answers when they are dispatched
+// through the asynchronous network interface (asyncShardDispatch) as through per shard connections.
+
+(function() {
+    'use strict';
+
+    var st = new ShardingTest({ shards : 2, mongos : 1 });
+
+    var mongos = st.s0;
+    var db = mongos.getDB("test");
+    var coll = db.async_shard_dispatch;
+
+    assert.commandWorked(mongos.adminCommand({ enableSharding : "test" }));
+    st.ensurePrimaryShard("test", "shard0001");
+    assert.commandWorked(mongos.adminCommand({ shardCollection : coll + "", key : { _id : 1 }}));
+    assert.commandWorked(mongos.adminCommand({ split : coll + "", middle : { _id : 0 }}));
+    assert.commandWorked(mongos.adminCommand({ moveChunk : coll + "",
+                                               find : { _id : 0 },
+                                               to : "shard0000" }));
+    for (var i = -50; i < 50; i++) {
+        assert.writeOK(coll.insert({ _id : i, x : i }));
+    }
+
+    var runCommands = function() {
+        var stats = assert.commandWorked(db.runCommand({ dbStats : 1 }));
+        assert.eq(2, Object.keySet(stats.raw).length, tojson(stats));
+        assert.eq(100, stats.objects, tojson(stats));
+
+        assert.commandWorked(coll.ensureIndex({ x : 1 }));
+        var validate = assert.commandWorked(coll.validate());
+        assert(validate.valid, tojson(validate));
+        assert.commandWorked(coll.dropIndex({ x : 1 }));
+
+        // Each shard's error is reported under its own name.
+        var res = db.runCommand({ dropIndexes : coll.getName(), index : "nonexistent_1" });
+        assert.commandFailed(res);
+        assert.eq(2, Object.keySet(res.raw).length, tojson(res));
+        return stats;
+    };
+
+    var legacyStats = runCommands();
+
+    assert.commandWorked(mongos.adminCommand({ setParameter : 1, asyncShardDispatch : true }));
+    var asyncStats = runCommands();
+    assert.eq(Object.keySet(legacyStats.raw).sort(), Object.keySet(asyncStats.raw).sort());
+    assert.eq(legacyStats.objects, asyncStats.objects);
+
+    // A shard which is down is reported as an error rather than hanging the command.
+    MongoRunner.stopMongod(st.shard0);
+    var res = db.runCommand({ dbStats : 1 });
+    assert.commandFailed(res);
+
+    assert.commandWorked(mongos.adminCommand({ setParameter : 1, asyncShardDispatch : false }));
+    st.stop();
+})();
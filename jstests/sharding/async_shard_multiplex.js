@@ -0,0 +1,49 @@
+// Runs many concurrent all-shard commands through a mongos which multiplexes its asynchronous
+// shard dispatch over one connection per shard host, and checks that the connection count stays
+// bounded while every command gets its own reply.
+
+(function() {
+    'use strict';
+
+    var st = new ShardingTest({ shards : 2,
+                                mongos : 1,
+                                other : { mongosOptions : {
+                                    setParameter : "asyncShardConnectionsPerHost=1" }}});
+
+    var mongos = st.s0;
+    var db = mongos.getDB("test");
+    assert.commandWorked(mongos.adminCommand({ setParameter : 1, asyncShardDispatch : true }));
+    assert.commandWorked(mongos.adminCommand({ enableSharding : "test" }));
+    st.ensurePrimaryShard("test", "shard0001");
+    for (var i = 0; i < 10; i++) {
+        assert.writeOK(db.multiplex.insert({ _id : i }));
+    }
+
+    var stats = assert.commandWorked(db.runCommand({ dbStats : 1 }));
+    assert.eq(10, stats.objects, tojson(stats));
+
+    // Each shell checks that it gets back its own database's stats, a reply matched to the wrong
+    // request would show up as the wrong object count.
+    var shells = [];
+    for (var n = 0; n < 4; n++) {
+        shells.push(startParallelShell(
+            'var db = db.getSiblingDB("multiplex' + n + '");' +
+            'for (var i = 0; i <= ' + n + '; i++) { assert.writeOK(db.c.insert({ i : i })); }' +
+            'for (var j = 0; j < 100; j++) {' +
+            '    var res = assert.commandWorked(db.runCommand({ dbStats : 1 }));' +
+            '    assert.eq(' + (n + 1) + ', res.objects, tojson(res));' +
+            '}', mongos.port));
+    }
+    shells.forEach(function(join) { join(); });
+
+    var status = assert.commandWorked(mongos.adminCommand({ serverStatus : 1 }));
+    var dispatch = status.asyncShardDispatch;
+    assert(dispatch.enabled, tojson(dispatch));
+    assert.eq(1, dispatch.connectionsPerHost, tojson(dispatch));
+    assert.gte(dispatch.commands, 400, tojson(dispatch));
+    assert.lte(dispatch.multiplexedConnections, 2, tojson(dispatch));
+    assert.lte(dispatch.connects, 2 + dispatch.retries, tojson(dispatch));
+    assert.eq(0, dispatch.inProgress, tojson(dispatch));
+
+    st.stop();
+})();
@@ -146,6 +146,9 @@ namespace {
 
     // ----
 
+    const size_t Collection::kMaxInsertBatchDocs;
+    const int Collection::kMaxInsertBatchBytes;
+
     Collection::Collection( OperationContext* txn,
                             StringData fullNS,
                             CollectionCatalogEntry* details,
@@ -335,6 +338,66 @@ namespace {
         return res;
     }
 
+    Status Collection::insertDocuments(OperationContext* txn,
+                                       const std::vector<BSONObj>& docs,
+                                       bool enforceQuota,
+                                       bool fromMigrate) {
+        dassert(txn->lockState()->isCollectionLockedForMode(ns().toString(), MODE_IX));
+
+        const bool needsId = _indexCatalog.findIdIndex(txn);
+
+        std::vector<RecordData> records;
+        records.reserve(docs.size());
+        for (size_t i = 0; i < docs.size(); i++) {
+            auto status = checkValidation(txn, docs[i]);
+            if (!status.isOK())
+                return status;
+
+            if (needsId && docs[i]["_id"].eoo()) {
+                return Status(ErrorCodes::InternalError,
+                              str::stream() << "Collection::insertDocuments got "
+                              "document without _id for ns:" << _ns.ns());
+            }
+
+            records.push_back(RecordData(docs[i].objdata(), docs[i].objsize()));
+        }
+
+        const SnapshotId sid = txn->recoveryUnit()->getSnapshotId();
+
+        std::vector<RecordId> locs;
+        locs.reserve(docs.size());
+        Status status = _recordStore->insertRecords(txn,
+                                                    records,
+                                                    _enforceQuota(enforceQuota),
+                                                    &locs);
+        if (!status.isOK())
+            return status;
+
+        _infoCache.notifyOfWriteOp();
+
+        for (size_t i = 0; i < docs.size(); i++) {
+            invariant(RecordId::min() < locs[i]);
+            invariant(locs[i] < RecordId::max());
+
+            status = _indexCatalog.indexRecord(txn, docs[i], locs[i]);
+            if (!status.isOK())
+                return status;
+        }
+
+        invariant(sid == txn->recoveryUnit()->getSnapshotId());
+
+        for (size_t i = 0; i < docs.size(); i++) {
+            getGlobalServiceContext()->getOpObserver()->onInsert(txn, ns(), docs[i], fromMigrate);
+        }
+
+        // See insertDocument() above.
+        if (_cappedNotifier && !_cappedNotifier.unique()) {
+            _cappedNotifier->notifyOfInsert();
+        }
+
+        return Status::OK();
+    }
+
     StatusWith<RecordId> Collection::insertDocument(OperationContext* txn,
                                                     const BSONObj& doc,
                                                     MultiIndexBlock* indexBlock,
@@ -216,6 +216,22 @@ namespace mongo {
                                             bool enforceQuota,
                                             bool fromMigrate = false);
 
+        /**
+         * Inserts all of 'docs' like insertDocument() above, but hands them to the RecordStore as
+         * one batch. On failure some of the documents may have been inserted already, so the
+         * caller must not commit its WriteUnitOfWork.
+         *
+         * Callers keep a batch to at most kMaxInsertBatchDocs documents and about
+         * kMaxInsertBatchBytes, so that one storage transaction doesn't grow too large.
+         */
+        Status insertDocuments( OperationContext* txn,
+                                const std::vector<BSONObj>& docs,
+                                bool enforceQuota,
+                                bool fromMigrate = false );
+
+        static const size_t kMaxInsertBatchDocs = 64;
+        static const int kMaxInsertBatchBytes = 256 * 1024;
+
         /**
          * Callers must ensure no document validation is performed for this collection when calling
          * this method.
@@ -100,6 +100,8 @@ namespace mongo {
         _isReady = _catalogIsReady( txn );
         _head = _catalogHead( txn );
         _isMultikey = _catalogIsMultikey( txn );
+        // The documents already in a built index may have held arrays in any field.
+        _multikeyFields.store( _isReady || _isMultikey ? ~0U : 0U );
 
         BSONElement filterElement = _descriptor->getInfoElement("partialFilterExpression");
         if ( filterElement.type() ) {
@@ -129,6 +131,10 @@ namespace mongo {
         return _isMultikey;
     }
 
+    uint32_t IndexCatalogEntry::getMultikeyFields() const {
+        return _multikeyFields.load();
+    }
+
     // ---
 
     void IndexCatalogEntry::setIsReady( bool newIsReady ) {
@@ -188,7 +194,28 @@ namespace mongo {
         const boost::scoped_ptr<RecoveryUnit> _newRecoveryUnit;
     };
 
-    void IndexCatalogEntry::setMultikey(OperationContext* txn) {
+    void IndexCatalogEntry::addMultikeyFields(uint32_t multikeyFields) {
+        // Readers plan covered projections from these bits, so they must be set before the
+        // document that has the arrays can be seen.
+        uint32_t oldFields = _multikeyFields.load();
+        while ((oldFields | multikeyFields) != oldFields) {
+            uint32_t seen = _multikeyFields.compareAndSwap(oldFields, oldFields | multikeyFields);
+            if (seen == oldFields) {
+                if (_infoCache) {
+                    LOG(1) << _ns << ": clearing plan cache - more fields of index "
+                           << _descriptor->keyPattern() << " hold arrays.";
+                    _infoCache->clearQueryCache();
+                }
+                break;
+            }
+            oldFields = seen;
+        }
+    }
+
+    void IndexCatalogEntry::setMultikey(OperationContext* txn, uint32_t multikeyFields) {
+        // The fields come first so that no reader sees the index multikey without them.
+        addMultikeyFields(multikeyFields);
+
         if (isMultikey()) {
             return;
         }
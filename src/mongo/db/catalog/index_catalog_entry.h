@@ -35,6 +35,7 @@
 #include "mongo/base/owned_pointer_vector.h"
 #include "mongo/bson/ordering.h"
 #include "mongo/db/record_id.h"
+#include "mongo/platform/atomic_word.h"
 
 namespace mongo {
 
@@ -85,7 +86,27 @@ namespace mongo {
 
         bool isMultikey() const;
 
-        void setMultikey( OperationContext* txn );
+        /**
+         * Which fields of the key pattern may hold an array: bit i stands for the i-th field, and
+         * the fields past the 32nd share the last bit.
+         *
+         * The catalog only records whether the index as a whole is multikey, so the fields are
+         * learned from every document with an array in an indexed path, even one which only
+         * produces a single key such as { a : [ 5 ] }.  Only an index built while it is loaded
+         * has seen all of its documents, so all bits are set for an index that was already built
+         * when it was loaded.
+         */
+        uint32_t getMultikeyFields() const;
+
+        /**
+         * Records that 'multikeyFields' may hold arrays without marking the index multikey.
+         */
+        void addMultikeyFields( uint32_t multikeyFields );
+
+        /**
+         * Marks the index multikey, with 'multikeyFields' holding arrays.
+         */
+        void setMultikey( OperationContext* txn, uint32_t multikeyFields );
 
         // if this ready is ready for queries
         bool isReady( OperationContext* txn ) const;
@@ -121,6 +142,7 @@ namespace mongo {
         bool _isReady; // cache of NamespaceDetails info
         RecordId _head; // cache of IndexDetails
         bool _isMultikey; // cache of NamespaceDetails info
+        AtomicUInt32 _multikeyFields; // only grows, see getMultikeyFields()
     };
 
     class IndexCatalogEntryContainer {
@@ -36,6 +36,7 @@
 
 #include <boost/make_shared.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "mongo/base/error_codes.h"
 #include "mongo/client/dbclientinterface.h"
@@ -49,7 +50,11 @@
 #include "mongo/db/query/internal_plans.h"
 #include "mongo/db/repl/replication_coordinator_global.h"
 #include "mongo/db/operation_context.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/functional.h"
 #include "mongo/stdx/mutex.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/log.h"
 #include "mongo/util/processinfo.h"
 #include "mongo/util/progress_meter.h"
@@ -60,6 +65,8 @@ namespace mongo {
     using std::string;
     using std::endl;
 
+    MONGO_EXPORT_SERVER_PARAMETER(indexBuildThreads, int, 0);
+
     /**
      * On rollback sets MultiIndexBlock::_needToCleanup to true.
      */
@@ -90,12 +97,185 @@ namespace mongo {
         MultiIndexBlock* const _indexer;
     };
 
+    /**
+     * Generates the keys of a foreground build on a pool of threads, for
+     * insertAllDocumentsInCollection().
+     *
+     * The collection can only be read by the thread which owns the OperationContext, so that
+     * thread copies the documents into batches and hands each batch to a worker.  Each bulk
+     * builder is split into one partition per thread and a worker takes a partition nobody else
+     * is using for each batch, so no two threads touch the same sorter.  The sorted runs of the
+     * partitions are merged by commitBulk().
+     */
+    class MultiIndexBlock::ParallelInserter {
+        MONGO_DISALLOW_COPYING(ParallelInserter);
+    public:
+        static const size_t kBatchSize = 512;
+        static const size_t kMaxBatchBytes = 16 * 1024 * 1024;
+
+        ParallelInserter(MultiIndexBlock* indexer, size_t numThreads)
+            : _indexer(indexer),
+              _numThreads(numThreads),
+              _batchBytes(0),
+              _inFlight(0),
+              _status(Status::OK()) {
+            for (size_t i = 0; i < _indexer->_indexes.size(); ++i) {
+                invariant(_indexer->_indexes[i].bulk);
+                _indexer->_indexes[i].bulk->partition(_numThreads);
+            }
+            for (size_t i = 0; i < _numThreads; ++i) {
+                _freePartitions.push_back(i);
+            }
+        }
+
+        ~ParallelInserter() {
+            waitForAllBatches();
+        }
+
+        /**
+         * Queues 'doc' to be indexed, waiting if the workers are too far behind.  Returns the
+         * error of any batch which has failed so far.
+         */
+        Status insert(const BSONObj& doc, const RecordId& loc) {
+            if (!_filling) {
+                _filling.reset(new Batch());
+            }
+            _filling->docs.push_back(doc.getOwned());
+            _filling->locs.push_back(loc);
+            _batchBytes += doc.objsize();
+
+            if (_filling->docs.size() >= kBatchSize || _batchBytes >= kMaxBatchBytes) {
+                dispatchBatch();
+            }
+
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            return _status;
+        }
+
+        /**
+         * Indexes the documents still queued and waits for the workers to finish.
+         */
+        Status done() {
+            dispatchBatch();
+            waitForAllBatches();
+            return _status;
+        }
+
+    private:
+        struct Batch {
+            std::vector<BSONObj> docs;
+            std::vector<RecordId> locs;
+        };
+        typedef boost::shared_ptr<Batch> BatchPtr;
+
+        void dispatchBatch() {
+            if (!_filling) {
+                return;
+            }
+
+            BatchPtr batch;
+            batch.swap(_filling);
+            _batchBytes = 0;
+
+            {
+                // Keep no more than two batches per thread in memory.
+                stdx::unique_lock<stdx::mutex> lk(_mutex);
+                while (_inFlight >= 2 * _numThreads) {
+                    _batchDone.wait(lk);
+                }
+                ++_inFlight;
+            }
+
+            if (!_workers) {
+                _workers.reset(new ThreadPool(_numThreads, "indexBuild"));
+            }
+            _workers->schedule(stdx::bind(&ParallelInserter::runBatch, this, batch));
+        }
+
+        void runBatch(BatchPtr batch) {
+            size_t partition;
+            {
+                // At most _numThreads batches run at once, so there's always a free partition.
+                stdx::lock_guard<stdx::mutex> lk(_mutex);
+                invariant(!_freePartitions.empty());
+                partition = _freePartitions.back();
+                _freePartitions.pop_back();
+            }
+
+            Status status = Status::OK();
+            try {
+                for (size_t i = 0; i < batch->docs.size() && status.isOK(); ++i) {
+                    status = insertIntoPartition(partition, batch->docs[i], batch->locs[i]);
+                }
+            }
+            catch (const DBException& e) {
+                status = e.toStatus();
+            }
+            catch (const std::exception& e) {
+                status = Status(ErrorCodes::InternalError, e.what());
+            }
+
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            if (!status.isOK() && _status.isOK()) {
+                _status = status;
+            }
+            _freePartitions.push_back(partition);
+            --_inFlight;
+            _batchDone.notify_all();
+        }
+
+        Status insertIntoPartition(size_t partition, const BSONObj& doc, const RecordId& loc) {
+            for (size_t i = 0; i < _indexer->_indexes.size(); ++i) {
+                const IndexToBuild& index = _indexer->_indexes[i];
+                if (index.filterExpression && !index.filterExpression->matchesBSON(doc)) {
+                    continue;
+                }
+
+                int64_t unused;
+                Status status = index.bulk->insertIntoPartition(partition, doc, loc, &unused);
+                if (!status.isOK()) {
+                    return status;
+                }
+            }
+            return Status::OK();
+        }
+
+        void waitForAllBatches() {
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+            while (_inFlight > 0) {
+                _batchDone.wait(lk);
+            }
+        }
+
+        MultiIndexBlock* const _indexer;
+        const size_t _numThreads;
+
+        // Only used by the build thread.
+        BatchPtr _filling;
+        size_t _batchBytes;
+
+        stdx::mutex _mutex;
+        stdx::condition_variable _batchDone;
+
+        // Guarded by _mutex.
+        size_t _inFlight;
+        std::vector<size_t> _freePartitions;
+        Status _status;
+
+        // Declared last so that it is destroyed, joining the workers, first.
+        boost::scoped_ptr<ThreadPool> _workers;
+    };
+
+    const size_t MultiIndexBlock::ParallelInserter::kBatchSize;
+    const size_t MultiIndexBlock::ParallelInserter::kMaxBatchBytes;
+
     MultiIndexBlock::MultiIndexBlock(OperationContext* txn, Collection* collection)
         : _collection(collection),
           _txn(txn),
           _buildInBackground(false),
           _allowInterruption(false),
           _ignoreUnique(false),
+          _numBuildThreads(0),
           _needToCleanup(true) {
     }
 
@@ -219,6 +399,8 @@ namespace mongo {
 
         if (_buildInBackground)
             _backgroundOperation.reset(new BackgroundOperation(ns));
+        else if (indexBuildThreads > 0)
+            _numBuildThreads = indexBuildThreads;
 
         wunit.commit();
         return Status::OK();
@@ -248,6 +430,12 @@ namespace mongo {
             exec->setYieldPolicy(PlanExecutor::WRITE_CONFLICT_RETRY_ONLY);
         }
 
+        scoped_ptr<ParallelInserter> parallel;
+        if (_numBuildThreads > 0) {
+            parallel.reset(new ParallelInserter(this, _numBuildThreads));
+            log() << "\t generating keys on " << _numBuildThreads << " threads";
+        }
+
         Snapshotted<BSONObj> objToIndex;
         RecordId loc;
         PlanExecutor::ExecState state;
@@ -270,6 +458,19 @@ namespace mongo {
                 // Done before insert so we can retry document if it WCEs.
                 progress->setTotalWhileRunning( _collection->numRecords(_txn) );
 
+                if (parallel) {
+                    // Only the bulk builders see the document, nothing to write here.
+                    Status ret = parallel->insert(objToIndex.value(), loc);
+                    if (!ret.isOK()) {
+                        return ret;
+                    }
+
+                    progress->hit();
+                    n++;
+                    retries = 0;
+                    continue;
+                }
+
                 WriteUnitOfWork wunit(_txn);
                 Status ret = insert(objToIndex.value(), loc);
                 if (ret.isOK()) {
@@ -316,6 +517,13 @@ namespace mongo {
 
         progress->finished();
 
+        if (parallel) {
+            Status ret = parallel->done();
+            if (!ret.isOK())
+                return ret;
+            parallel.reset();
+        }
+
         Status ret = doneInserting(dupsOut);
         if (!ret.isOK())
             return ret;
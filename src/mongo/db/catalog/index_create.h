@@ -47,6 +47,10 @@ namespace mongo {
     class Collection;
     class OperationContext;
 
+    // Number of threads generating keys for foreground index builds.  With 0 the build thread
+    // does it while scanning the collection.
+    extern int indexBuildThreads;
+
     /**
      * Builds one or more indexes.
      *
@@ -181,6 +185,7 @@ namespace mongo {
     private:
         class SetNeedToCleanupOnRollback;
         class CleanupIndexesVectorOnRollback;
+        class ParallelInserter;
 
         struct IndexToBuild {
 #if defined(_MSC_VER) && _MSC_VER < 1900 // MVSC++ <= 2013 can't generate default move operations
@@ -224,6 +229,10 @@ namespace mongo {
         bool _allowInterruption;
         bool _ignoreUnique;
 
+        // Number of threads generating keys in insertAllDocumentsInCollection(), 0 if it's done
+        // inline.  Only used for foreground builds.
+        size_t _numBuildThreads;
+
         bool _needToCleanup;
     };
 
@@ -89,6 +89,17 @@ namespace mongo {
         *currentClient.get() = service->makeClient(fullDesc, mp);
     }
 
+    ServiceContext::UniqueClient Client::releaseCurrent() {
+        invariant(currentClient.getMake()->get());
+        return std::move(*currentClient.get());
+    }
+
+    void Client::setCurrent(ServiceContext::UniqueClient client) {
+        invariant(client);
+        invariant(currentClient.getMake()->get() == nullptr);
+        *currentClient.get() = std::move(client);
+    }
+
     Client::Client(std::string desc,
                    ServiceContext* serviceContext,
                    AbstractMessagingPort *p)
@@ -76,6 +76,18 @@ namespace mongo {
          */
         static void initThreadIfNotAlready();
 
+        /**
+         * Detaches the Client bound to the calling thread and returns ownership of it.  Used by
+         * servers which multiplex many client connections over a small pool of threads, together
+         * with setCurrent() to re-attach the Client for the duration of each request.
+         */
+        static ServiceContext::UniqueClient releaseCurrent();
+
+        /**
+         * Binds "client" to the calling thread.  The thread must not already have a Client.
+         */
+        static void setCurrent(ServiceContext::UniqueClient client);
+
         std::string clientAddress(bool includePort = false) const;
         const std::string& desc() const { return _desc; }
 
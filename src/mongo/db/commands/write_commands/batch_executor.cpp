@@ -32,6 +32,7 @@
 
 #include "mongo/db/commands/write_commands/batch_executor.h"
 
+#include <algorithm>
 #include <boost/scoped_ptr.hpp>
 #include <memory>
 
@@ -804,6 +805,28 @@ namespace mongo {
         }
     }
 
+    /**
+     * Returns the end of the run of documents, starting at the current one, which can be inserted
+     * together. The run stops before the first document which failed to normalize, and it only
+     * ever holds plain inserts.
+     */
+    static size_t endOfInsertGroup(const WriteBatchExecutor::ExecInsertsState& state) {
+        const BatchedCommandRequest& request = *state.request;
+        if (request.isInsertIndexRequest())
+            return state.currIndex + 1;
+
+        size_t end = state.currIndex;
+        int bytes = 0;
+        while (end < request.sizeWriteOps() &&
+               end - state.currIndex < Collection::kMaxInsertBatchDocs &&
+               bytes < Collection::kMaxInsertBatchBytes &&
+               state.normalizedInserts[end].isOK()) {
+            bytes += request.getInsertRequest()->getDocumentsAt(end).objsize();
+            ++end;
+        }
+        return std::max(end, state.currIndex + 1);
+    }
+
     void WriteBatchExecutor::execInserts( const BatchedCommandRequest& request,
                                           std::vector<WriteErrorDetail*>* errors ) {
 
@@ -844,11 +867,14 @@ namespace mongo {
         ElapsedTracker elapsedTracker(internalQueryExecYieldIterations,
                                       internalQueryExecYieldPeriodMS);
 
-        for (state.currIndex = 0;
-             state.currIndex < state.request->sizeWriteOps();
-             ++state.currIndex) {
+        // Once a group fails, the rest of it is inserted one document at a time up to here,
+        // rather than trying again with a group starting at each following document.
+        size_t singleInsertsEnd = 0;
+
+        for (state.currIndex = 0; state.currIndex < state.request->sizeWriteOps();) {
 
-            if (state.currIndex + 1 == state.request->sizeWriteOps()) {
+            const size_t groupEnd = endOfInsertGroup(state);
+            if (groupEnd == state.request->sizeWriteOps()) {
                 setupSynchronousCommit(_txn);
             }
 
@@ -869,6 +895,14 @@ namespace mongo {
                 elapsedTracker.resetLastTime();
             }
 
+            if (state.currIndex >= singleInsertsEnd && groupEnd - state.currIndex > 1) {
+                if (execInsertGroup(&state, groupEnd)) {
+                    state.currIndex = groupEnd;
+                    continue;
+                }
+                singleInsertsEnd = groupEnd;
+            }
+
             WriteErrorDetail* error = NULL;
             execOneInsert(&state, &error);
             if (error) {
@@ -877,6 +911,7 @@ namespace mongo {
                 if (request.getOrdered())
                     return;
             }
+            ++state.currIndex;
         }
     }
 
@@ -1136,6 +1171,54 @@ namespace mongo {
         }
     }
 
+    bool WriteBatchExecutor::execInsertGroup(ExecInsertsState* state, size_t end) {
+        vector<BSONObj> docs;
+        docs.reserve(end - state->currIndex);
+        for (size_t i = state->currIndex; i < end; ++i) {
+            const BSONObj& normalized = state->normalizedInserts[i].getValue();
+            docs.push_back(normalized.isEmpty() ?
+                           state->request->getInsertRequest()->getDocumentsAt(i) :
+                           normalized);
+        }
+
+        try {
+            // Any error here shows up again, for the right document, when retrying them singly.
+            WriteOpResult lockResult;
+            if (!state->lockAndCheck(&lockResult))
+                return false;
+
+            WriteUnitOfWork wunit(_txn);
+            if (!state->getCollection()->insertDocuments(_txn, docs, true).isOK())
+                return false;
+            wunit.commit();
+        }
+        catch (const WriteConflictException&) {
+            state->unlock();
+            CurOp::get(_txn)->debug().writeConflicts++;
+            _txn->recoveryUnit()->abandonSnapshot();
+            return false;
+        }
+        catch (const DBException& ex) {
+            if (ErrorCodes::isInterruption(ex.toStatus().code()))
+                throw;
+            return false;
+        }
+
+        // Account for every document as if it had been inserted on its own.
+        for (size_t i = state->currIndex; i < end; ++i) {
+            BatchItemRef currInsertItem(state->request, i);
+            CurOp currentOp(_txn);
+            beginCurrentOp(_txn, currInsertItem);
+            incOpStats(currInsertItem);
+
+            WriteOpStats stats;
+            stats.n = 1;
+            incWriteStats(currInsertItem, stats, NULL, &currentOp);
+            finishCurrentOp(_txn, NULL);
+        }
+        return true;
+    }
+
     /**
      * Perform a single insert into a collection.  Requires the insert be preprocessed and the
      * collection already has been created.
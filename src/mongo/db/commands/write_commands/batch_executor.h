@@ -101,6 +101,14 @@ namespace mongo {
          */
         void execOneInsert( ExecInsertsState* state, WriteErrorDetail** error );
 
+        /**
+         * Inserts the documents of a batch from the current one up to, but not including, "end"
+         * in a single WriteUnitOfWork. Returns false, having inserted none of them, if that
+         * fails for any reason other than an interruption, in which case they should be retried
+         * one at a time with execOneInsert.
+         */
+        bool execInsertGroup( ExecInsertsState* state, size_t end );
+
         /**
          * Executes an update item (which may update many documents or upsert), and returns the
          * upserted _id on upsert or error on failure.
@@ -191,6 +191,33 @@ namespace mongo {
         p->reply(requestMsg, resp, requestMsg.header().getId());
     }
 
+    void replyToQuery(int queryResultFlags,
+                      AbstractMessagingPort* p, Message& requestMsg,
+                      BufBuilder& data,
+                      int nReturned, int startingFrom,
+                      long long cursorId) {
+        QueryResult::View qr = reinterpret_cast<char*>(mongoMalloc(sizeof(QueryResult::Value)));
+        qr.setResultFlags(queryResultFlags);
+        qr.msgdata().setOperation(opReply);
+        qr.setCursorId(cursorId);
+        qr.setStartingFrom(startingFrom);
+        qr.setNReturned(nReturned);
+
+        // appendData sets and then grows the message length as buffers are added
+        Message resp;
+        resp.appendData(qr.view2ptr(), sizeof(QueryResult::Value));
+        const int size = data.len();
+        if (size > 0) {
+            char* documents = data.buf();
+            data.decouple();
+            resp.appendData(documents, size);
+        }
+        else {
+            data.reset();
+        }
+        p->reply(requestMsg, resp, requestMsg.header().getId());
+    }
+
     void replyToQuery(int queryResultFlags,
                       AbstractMessagingPort* p, Message& requestMsg,
                       const BSONObj& responseObj) {
@@ -323,6 +323,17 @@ namespace mongo {
                       long long cursorId = 0
                       );
 
+    /**
+     * Like the above, but takes over the buffer of "data" instead of copying it into the reply.
+     * The reply is sent as two buffers, the reply header and the documents, so large batches
+     * are not memcpy'd again on their way to the socket. "data" is left empty.
+     */
+    void replyToQuery(int queryResultFlags,
+                      AbstractMessagingPort* p, Message& requestMsg,
+                      BufBuilder& data,
+                      int nReturned, int startingFrom = 0,
+                      long long cursorId = 0
+                      );
 
     /* object reply helper. */
     void replyToQuery(int queryResultFlags,
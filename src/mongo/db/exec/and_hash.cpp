@@ -28,24 +28,30 @@
 
 #include "mongo/db/exec/and_hash.h"
 
-#include "mongo/db/exec/and_common-inl.h"
 #include "mongo/db/exec/filter.h"
 #include "mongo/db/exec/scoped_timer.h"
 #include "mongo/db/exec/working_set_common.h"
 #include "mongo/db/exec/working_set.h"
+#include "mongo/db/storage_options.h"
 #include "mongo/util/mongoutils/str.h"
 
 namespace {
 
-    // Upper limit for buffered data.
-    // Stage execution will fail once size of all buffered data exceeds this threshold.
+    // Upper limit for the RecordIds we hold in memory.
+    // Past this threshold they are spilled to disk.
     const size_t kDefaultMaxMemUsageBytes = 32 * 1024 * 1024;
 
+    // Upper limit for the copies of documents invalidated while spilled.  Past this threshold
+    // the stage fails, since it can't drop them without returning bad results.
+    const size_t kMaxInvalidatedBytes = 32 * 1024 * 1024;
+
 } // namespace
 
 namespace mongo {
 
     using std::auto_ptr;
+    using std::make_pair;
+    using std::pair;
     using std::vector;
 
     const size_t AndHashStage::kLookAheadWorks = 10;
@@ -53,6 +59,72 @@ namespace mongo {
     // static
     const char* AndHashStage::kStageType = "AND_HASH";
 
+    AndHashStage::SpilledMember::SpilledMember() : seq(0), hasObj(false) { }
+
+    void AndHashStage::SpilledMember::serializeForSorter(BufBuilder& buf) const {
+        buf.appendNum(seq);
+        loc.serializeForSorter(buf);
+        buf.appendChar(hasObj);
+        if (hasObj) {
+            obj.serializeForSorter(buf);
+        }
+        buf.appendNum(static_cast<int>(keys.size()));
+        for (size_t i = 0; i < keys.size(); ++i) {
+            buf.appendNum(keys[i].first);
+            keys[i].second.serializeForSorter(buf);
+        }
+    }
+
+    // static
+    AndHashStage::SpilledMember AndHashStage::SpilledMember::deserializeForSorter(
+            BufReader& buf,
+            const SorterDeserializeSettings&) {
+        SpilledMember member;
+        member.seq = buf.read<long long>();
+        member.loc = RecordId::deserializeForSorter(buf, RecordId::SorterDeserializeSettings());
+        member.hasObj = buf.read<char>();
+        if (member.hasObj) {
+            member.obj = BSONObj::deserializeForSorter(buf, BSONObj::SorterDeserializeSettings());
+        }
+        const int numKeys = buf.read<int>();
+        for (int i = 0; i < numKeys; ++i) {
+            const int index = buf.read<int>();
+            member.keys.push_back(make_pair(index, BSONObj::deserializeForSorter(
+                    buf, BSONObj::SorterDeserializeSettings())));
+        }
+        return member;
+    }
+
+    int AndHashStage::SpilledMember::memUsageForSorter() const {
+        int usage = sizeof(SpilledMember) + keys.capacity() * sizeof(keys[0]);
+        if (hasObj) {
+            usage += obj.objsize();
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            usage += keys[i].second.objsize();
+        }
+        return usage;
+    }
+
+    AndHashStage::SpilledMember AndHashStage::SpilledMember::getOwned() const {
+        SpilledMember member(*this);
+        member.obj = obj.getOwned();
+        for (size_t i = 0; i < member.keys.size(); ++i) {
+            member.keys[i].second = member.keys[i].second.getOwned();
+        }
+        return member;
+    }
+
+    int AndHashStage::SpilledMemberComparator::operator()(
+            const pair<RecordId, SpilledMember>& lhs,
+            const pair<RecordId, SpilledMember>& rhs) const {
+        int result = lhs.first.compare(rhs.first);
+        if (0 != result) {
+            return result;
+        }
+        return lhs.second.seq < rhs.second.seq ? -1 : (lhs.second.seq > rhs.second.seq ? 1 : 0);
+    }
+
     AndHashStage::AndHashStage(WorkingSet* ws, 
                                const MatchExpression* filter,
                                const Collection* collection)
@@ -63,7 +135,11 @@ namespace mongo {
           _currentChild(0),
           _commonStats(kStageType),
           _memUsage(0),
-          _maxMemUsage(kDefaultMaxMemUsageBytes) {}
+          _maxMemUsage(kDefaultMaxMemUsageBytes),
+          _spilled(false),
+          _spilledSetSize(0),
+          _lastChildSeq(0),
+          _invalidatedBytes(0) {}
 
     AndHashStage::AndHashStage(WorkingSet* ws, 
                                const MatchExpression* filter,
@@ -76,7 +152,11 @@ namespace mongo {
           _currentChild(0),
           _commonStats(kStageType),
           _memUsage(0),
-          _maxMemUsage(maxMemUsage) {}
+          _maxMemUsage(maxMemUsage),
+          _spilled(false),
+          _spilledSetSize(0),
+          _lastChildSeq(0),
+          _invalidatedBytes(0) {}
 
     AndHashStage::~AndHashStage() {
         for (size_t i = 0; i < _children.size(); ++i) { delete _children[i]; }
@@ -95,10 +175,16 @@ namespace mongo {
         // Either we're busy hashing children, in which case we're not done yet.
         if (_hashingChildren) { return false; }
 
+        // Or we're returning the spilled results of the last child.
+        if (_spilledOutput) { return !_spilledOutput->more(); }
+
+        // Or we're spilling the last child.
+        if (_spilled) { return false; }
+
         // Or we're streaming in results from the last child.
 
         // If there's nothing to probe against, we're EOF.
-        if (_dataMap.empty()) { return true; }
+        if (_dataSet.empty()) { return true; }
 
         // Otherwise, we're done when the last child is done.
         invariant(_children.size() >= 2);
@@ -112,6 +198,15 @@ namespace mongo {
         // Adds the amount of time taken by work() to executionTimeMillis.
         ScopedTimer timer(&_commonStats.executionTimeMillis);
 
+        if (_invalidatedBytes > kMaxInvalidatedBytes) {
+            mongoutils::str::stream ss;
+            ss << "hashed AND stage used more than the maximum " << kMaxInvalidatedBytes
+               << " bytes of RAM for documents invalidated while spilled to disk";
+            Status status(ErrorCodes::OperationFailed, ss);
+            *out = WorkingSetCommon::allocateStatusMember(_ws, status);
+            return PlanStage::FAILURE;
+        }
+
         if (isEOF()) { return PlanStage::IS_EOF; }
 
         // Fast-path for one of our children being EOF immediately.  We work each child a few times.
@@ -139,7 +234,7 @@ namespace mongo {
 
                         // A child went right to EOF.  Bail out.
                         _hashingChildren = false;
-                        _dataMap.clear();
+                        _dataSet.clear();
                         return PlanStage::IS_EOF;
                     }
                     else if (PlanStage::ADVANCED == childStatus) {
@@ -162,7 +257,7 @@ namespace mongo {
                         }
 
                         _hashingChildren = false;
-                        _dataMap.clear();
+                        _dataSet.clear();
                         return PlanStage::FAILURE;
                     }
                     // We ignore NEED_TIME. TODO: what do we want to do if we get NEED_YIELD here?
@@ -179,16 +274,6 @@ namespace mongo {
 
         // We read the first child into our hash table.
         if (_hashingChildren) {
-            // Check memory usage of previously hashed results.
-            if (_memUsage > _maxMemUsage) {
-                mongoutils::str::stream ss;
-                ss << "hashed AND stage buffered data usage of " << _memUsage
-                   << " bytes exceeds internal limit of " << kDefaultMaxMemUsageBytes << " bytes";
-                Status status(ErrorCodes::Overflow, ss);
-                *out = WorkingSetCommon::allocateStatusMember( _ws, status);
-                return PlanStage::FAILURE;
-            }
-
             if (0 == _currentChild) {
                 return readFirstChild(out);
             }
@@ -204,60 +289,14 @@ namespace mongo {
         }
 
         // Returning results.  We read from the last child and return the results that are in our
-        // hash map.
-
-        // We should be EOF if we're not hashing results and the dataMap is empty.
-        verify(!_dataMap.empty());
-
-        // We probe _dataMap with the last child.
-        verify(_currentChild == _children.size() - 1);
-
-        // Get the next result for the (_children.size() - 1)-th child.
-        StageState childStatus = workChild(_children.size() - 1, out);
-        if (PlanStage::ADVANCED != childStatus) {
-            return childStatus;
-        }
-
-        // We know that we've ADVANCED.  See if the WSM is in our table.
-        WorkingSetMember* member = _ws->get(*out);
-
-        // Maybe the child had an invalidation.  We intersect RecordId(s) so we can't do anything
-        // with this WSM.
-        if (!member->hasLoc()) {
-            _ws->flagForReview(*out);
-            return PlanStage::NEED_TIME;
+        // hash table, unless it's on disk.
+        if (_spilledOutput) {
+            return returnSpilled(out);
         }
-
-        DataMap::iterator it = _dataMap.find(member->loc);
-        if (_dataMap.end() == it) {
-            // Child's output wasn't in every previous child.  Throw it out.
-            _ws->free(*out);
-            ++_commonStats.needTime;
-            return PlanStage::NEED_TIME;
-        }
-        else {
-            // Child's output was in every previous child.  Merge any key data in
-            // the child's output and free the child's just-outputted WSM.
-            WorkingSetID hashID = it->second;
-            _dataMap.erase(it);
-
-            WorkingSetMember* olderMember = _ws->get(hashID);
-            AndCommon::mergeFrom(olderMember, *member);
-            _ws->free(*out);
-
-            // We should check for matching at the end so the matcher can use information in the
-            // indices of all our children.
-            if (Filter::passes(olderMember, _filter)) {
-                *out = hashID;
-                ++_commonStats.advanced;
-                return PlanStage::ADVANCED;
-            }
-            else {
-                _ws->free(hashID);
-                ++_commonStats.needTime;
-                return PlanStage::NEED_TIME;
-            }
+        else if (_spilled) {
+            return spillLastChild(out);
         }
+        return probeLastChild(out);
     }
 
     PlanStage::StageState AndHashStage::workChild(size_t childNo, WorkingSetID* out) {
@@ -287,17 +326,28 @@ namespace mongo {
                 return PlanStage::NEED_TIME;
             }
 
-            if (!_dataMap.insert(std::make_pair(member->loc, id)).second) {
-                // Didn't insert because we already had this loc inside the map. This should only
-                // happen if we're seeing a newer copy of the same doc in a more recent snapshot.
-                // Throw out the newer copy of the doc.
-                _ws->free(id);
-                ++_commonStats.needTime;
-                return PlanStage::NEED_TIME;
-            }
+            // We only keep the RecordId.  If we already have it we're seeing a newer copy of the
+            // same doc in a more recent snapshot, which changes nothing.
+            const RecordId loc = member->loc;
+            _ws->free(id);
 
-            // Update memory stats.
-            _memUsage += member->getMemUsage();
+            try {
+                if (_spilled) {
+                    addToSpill(loc, SpilledMember());
+                    ++_spilledSetSize;
+                }
+                else {
+                    _dataSet.insert(loc);
+                    _memUsage = _dataSet.memUsage();
+                    if (_memUsage > _maxMemUsage) {
+                        spillDataSet();
+                    }
+                }
+            }
+            catch (const DBException& e) {
+                *out = WorkingSetCommon::allocateStatusMember(_ws, e.toStatus());
+                return PlanStage::FAILURE;
+            }
 
             ++_commonStats.needTime;
             return PlanStage::NEED_TIME;
@@ -306,14 +356,24 @@ namespace mongo {
             // Done reading child 0.
             _currentChild = 1;
 
+            if (_spilled) {
+                try {
+                    _spilledSet.reset(_spillSorter->done());
+                }
+                catch (const DBException& e) {
+                    *out = WorkingSetCommon::allocateStatusMember(_ws, e.toStatus());
+                    return PlanStage::FAILURE;
+                }
+                _spillSorter.reset();
+            }
             // If our first child was empty, don't scan any others, no possible results.
-            if (_dataMap.empty()) {
+            else if (_dataSet.empty()) {
                 _hashingChildren = false;
                 return PlanStage::IS_EOF;
             }
 
             ++_commonStats.needTime;
-            _specificStats.mapAfterChild.push_back(_dataMap.size());
+            _specificStats.mapAfterChild.push_back(_spilled ? _spilledSetSize : _dataSet.size());
 
             return PlanStage::NEED_TIME;
         }
@@ -359,22 +419,29 @@ namespace mongo {
                 return PlanStage::NEED_TIME;
             }
 
-            verify(member->hasLoc());
-            if (_dataMap.end() == _dataMap.find(member->loc)) {
-                // Ignore.  It's not in any previous child.
-            }
-            else {
-                // We have a hit.  Copy data into the WSM we already have.
-                _seenMap.insert(member->loc);
-                WorkingSetMember* olderMember = _ws->get(_dataMap[member->loc]);
-                size_t memUsageBefore = olderMember->getMemUsage();
-
-                AndCommon::mergeFrom(olderMember, *member);
+            const RecordId loc = member->loc;
+            _ws->free(id);
 
-                // Update memory stats.
-                _memUsage += olderMember->getMemUsage() - memUsageBefore;
+            try {
+                if (_spilled) {
+                    // We'll find out which are in every previous child once this one is done.
+                    addToSpill(loc, SpilledMember());
+                }
+                else if (_dataSet.contains(loc)) {
+                    // We have a hit.
+                    _nextSet.insert(loc);
+                    _memUsage = _dataSet.memUsage() + _nextSet.memUsage();
+                    if (_memUsage > _maxMemUsage) {
+                        spillDataSet();
+                    }
+                }
+                // Otherwise ignore it.  It's not in any previous child.
             }
-            _ws->free(id);
+            catch (const DBException& e) {
+                *out = WorkingSetCommon::allocateStatusMember(_ws, e.toStatus());
+                return PlanStage::FAILURE;
+            }
+
             ++_commonStats.needTime;
             return PlanStage::NEED_TIME;
         }
@@ -382,31 +449,29 @@ namespace mongo {
             // Finished with a child.
             ++_currentChild;
 
-            // Keep elements of _dataMap that are in _seenMap.
-            DataMap::iterator it = _dataMap.begin();
-            while (it != _dataMap.end()) {
-                if (_seenMap.end() == _seenMap.find(it->first)) {
-                    DataMap::iterator toErase = it;
-                    ++it;
-
-                    // Update memory stats.
-                    WorkingSetMember* member = _ws->get(toErase->second);
-                    _memUsage -= member->getMemUsage();
-
-                    _ws->free(toErase->second);
-                    _dataMap.erase(toErase);
+            // Keep the elements of _dataSet that are in _nextSet.
+            if (_spilled) {
+                try {
+                    intersectSpilled();
+                }
+                catch (const DBException& e) {
+                    *out = WorkingSetCommon::allocateStatusMember(_ws, e.toStatus());
+                    return PlanStage::FAILURE;
                 }
-                else { ++it; }
+            }
+            else {
+                _dataSet.swap(_nextSet);
+                _nextSet.clear();
+                _memUsage = _dataSet.memUsage();
             }
 
-            _specificStats.mapAfterChild.push_back(_dataMap.size());
-
-            _seenMap.clear();
+            _specificStats.mapAfterChild.push_back(_spilled ? _spilledSetSize : _dataSet.size());
 
-            // _dataMap is now the intersection of the first _currentChild nodes.
+            // _dataSet is now the intersection of the first _currentChild nodes.
 
-            // If we have nothing to AND with after finishing any child, stop.
-            if (_dataMap.empty()) {
+            // If we have nothing to AND with after finishing any child, stop.  The intersection
+            // only stays on disk if it didn't fit in memory.
+            if (!_spilled && _dataSet.empty()) {
                 _hashingChildren = false;
                 return PlanStage::IS_EOF;
             }
@@ -446,6 +511,362 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState AndHashStage::probeLastChild(WorkingSetID* out) {
+        // We should be EOF if we're not hashing results and the set is empty.
+        verify(!_dataSet.empty());
+
+        // We probe _dataSet with the last child.
+        verify(_currentChild == _children.size() - 1);
+
+        // Get the next result for the (_children.size() - 1)-th child.
+        StageState childStatus = workChild(_children.size() - 1, out);
+        if (PlanStage::ADVANCED != childStatus) {
+            return childStatus;
+        }
+
+        // We know that we've ADVANCED.  See if the WSM is in our table.
+        WorkingSetMember* member = _ws->get(*out);
+
+        // Maybe the child had an invalidation.  We intersect RecordId(s) so we can't do anything
+        // with this WSM.
+        if (!member->hasLoc()) {
+            _ws->flagForReview(*out);
+            return PlanStage::NEED_TIME;
+        }
+
+        // Erasing it means a newer copy from the last child won't be returned again.
+        if (!_dataSet.erase(member->loc)) {
+            // Child's output wasn't in every previous child.  Throw it out.
+            _ws->free(*out);
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+
+        // Child's output was in every previous child.  We should check for matching at the end
+        // so the matcher can use information in the index of the last child.
+        if (Filter::passes(member, _filter)) {
+            ++_commonStats.advanced;
+            return PlanStage::ADVANCED;
+        }
+        else {
+            _ws->free(*out);
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+    }
+
+    PlanStage::StageState AndHashStage::spillLastChild(WorkingSetID* out) {
+        verify(_currentChild == _children.size() - 1);
+
+        StageState childStatus = workChild(_children.size() - 1, out);
+        if (PlanStage::IS_EOF == childStatus) {
+            try {
+                buildSpilledOutput();
+            }
+            catch (const DBException& e) {
+                *out = WorkingSetCommon::allocateStatusMember(_ws, e.toStatus());
+                return PlanStage::FAILURE;
+            }
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+        else if (PlanStage::ADVANCED != childStatus) {
+            return childStatus;
+        }
+
+        WorkingSetMember* member = _ws->get(*out);
+
+        // Maybe the child had an invalidation.  We intersect RecordId(s) so we can't do anything
+        // with this WSM.
+        if (!member->hasLoc()) {
+            _ws->flagForReview(*out);
+            return PlanStage::NEED_TIME;
+        }
+
+        // Hold on to the result until we know whether it's in every previous child.  Text scores
+        // and geo distances aren't kept, as no child of an index intersection computes them.
+        SpilledMember spilled;
+        spilled.seq = ++_lastChildSeq;
+        spilled.loc = member->loc;
+        if (member->hasObj()) {
+            spilled.hasObj = true;
+            spilled.obj = member->obj.value().getOwned();
+        }
+        for (size_t i = 0; i < member->keyData.size(); ++i) {
+            const IndexKeyDatum& datum = member->keyData[i];
+            size_t index = 0;
+            while (index < _spilledIndexes.size()
+                   && (_spilledIndexes[index].index != datum.index
+                       || _spilledIndexes[index].indexKeyPattern.objdata()
+                              != datum.indexKeyPattern.objdata())) {
+                ++index;
+            }
+            if (index == _spilledIndexes.size()) {
+                _spilledIndexes.push_back(datum);
+            }
+            spilled.keys.push_back(make_pair(static_cast<int>(index), datum.keyData));
+        }
+        _ws->free(*out);
+
+        try {
+            addToSpill(spilled.loc, spilled);
+        }
+        catch (const DBException& e) {
+            *out = WorkingSetCommon::allocateStatusMember(_ws, e.toStatus());
+            return PlanStage::FAILURE;
+        }
+
+        ++_commonStats.needTime;
+        return PlanStage::NEED_TIME;
+    }
+
+    PlanStage::StageState AndHashStage::returnSpilled(WorkingSetID* out) {
+        SpilledMember spilled;
+        try {
+            spilled = _spilledOutput->next().second;
+        }
+        catch (const DBException& e) {
+            *out = WorkingSetCommon::allocateStatusMember(_ws, e.toStatus());
+            return PlanStage::FAILURE;
+        }
+
+        const bool flagged = flagIfInvalidated(spilled.loc);
+        if (!_spilledOutput->more()) {
+            // We're EOF, so nothing else will be flagged.
+            freeInvalidated();
+        }
+        if (flagged) {
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+
+        *out = _ws->allocate();
+        WorkingSetMember* member = _ws->get(*out);
+        member->loc = spilled.loc;
+        if (spilled.hasObj) {
+            // The document may have changed since it was spilled.
+            member->obj = Snapshotted<BSONObj>(SnapshotId(), spilled.obj.getOwned());
+            member->state = WorkingSetMember::LOC_AND_OWNED_OBJ;
+        }
+        else {
+            // The index entries may have changed since they were spilled.
+            member->state = WorkingSetMember::LOC_AND_IDX;
+            member->isSuspicious = true;
+        }
+        for (size_t i = 0; i < spilled.keys.size(); ++i) {
+            const IndexKeyDatum& index = _spilledIndexes[spilled.keys[i].first];
+            member->keyData.push_back(IndexKeyDatum(index.indexKeyPattern,
+                                                    spilled.keys[i].second.getOwned(),
+                                                    index.index));
+        }
+
+        if (Filter::passes(member, _filter)) {
+            ++_commonStats.advanced;
+            return PlanStage::ADVANCED;
+        }
+        else {
+            _ws->free(*out);
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+    }
+
+    AndHashStage::SpillSorter* AndHashStage::makeSpillSorter() const {
+        SortOptions opts;
+        opts.TempDir(storageGlobalParams.dbpath + "/_tmp");
+        opts.ExtSortAllowed();
+        opts.MaxMemoryUsageBytes(_maxMemUsage);
+        return SpillSorter::make(opts, SpilledMemberComparator());
+    }
+
+    void AndHashStage::addToSpill(const RecordId& loc, const SpilledMember& member) {
+        if (!_spillSorter) {
+            _spillSorter.reset(makeSpillSorter());
+        }
+        _spillSorter->add(loc, member);
+        _specificStats.spilledBytes += loc.memUsageForSorter() + member.memUsageForSorter();
+    }
+
+    void AndHashStage::spillDataSet() {
+        invariant(!_spilled);
+        invariant(_invalidated.empty());
+
+        boost::scoped_ptr<SpillSorter> sorter(makeSpillSorter());
+        for (RecordIdSet::const_iterator it = _dataSet.begin(); it != _dataSet.end(); ++it) {
+            sorter->add(*it, SpilledMember());
+            _specificStats.spilledBytes += sizeof(RecordId) + sizeof(SpilledMember);
+        }
+
+        if (0 == _currentChild) {
+            // The rest of the first child goes in the same sorter.
+            _spillSorter.swap(sorter);
+        }
+        else {
+            // The current child's hits so far start its own sorted input.
+            _spilledSet.reset(sorter->done());
+            for (RecordIdSet::const_iterator it = _nextSet.begin(); it != _nextSet.end(); ++it) {
+                addToSpill(*it, SpilledMember());
+            }
+        }
+
+        _spilledSetSize = _dataSet.size();
+        _dataSet.clear();
+        _nextSet.clear();
+        _memUsage = 0;
+        _spilled = true;
+        ++_specificStats.spills;
+    }
+
+    void AndHashStage::intersectSpilled() {
+        invariant(_spilled);
+
+        // The current child may not have returned anything.
+        boost::scoped_ptr<SpillIterator> child(_spillSorter ? _spillSorter->done() : NULL);
+        _spillSorter.reset();
+
+        // Build the intersection in memory for as long as it fits.
+        RecordIdSet inMemory;
+        boost::scoped_ptr<SpillSorter> onDisk;
+        size_t count = 0;
+
+        pair<RecordId, SpilledMember> a;
+        pair<RecordId, SpilledMember> b;
+        bool moreB = child && nextDistinct(child.get(), &b);
+        while (nextDistinct(_spilledSet.get(), &a)) {
+            // 'a' is in every previous child.  If it was invalidated in the meantime it's flagged
+            // as if we had held it in memory.
+            if (flagIfInvalidated(a.first)) {
+                continue;
+            }
+            while (moreB && b.first < a.first) {
+                moreB = nextDistinct(child.get(), &b);
+            }
+            if (!moreB) {
+                if (_invalidated.empty()) { break; }
+                continue;
+            }
+            if (b.first != a.first) {
+                continue;
+            }
+
+            ++count;
+            if (onDisk) {
+                onDisk->add(a.first, SpilledMember());
+                _specificStats.spilledBytes += sizeof(RecordId) + sizeof(SpilledMember);
+            }
+            else {
+                inMemory.insert(a.first);
+                if (inMemory.memUsage() > _maxMemUsage) {
+                    onDisk.reset(makeSpillSorter());
+                    for (RecordIdSet::const_iterator it = inMemory.begin();
+                         it != inMemory.end();
+                         ++it) {
+                        onDisk->add(*it, SpilledMember());
+                    }
+                    _specificStats.spilledBytes +=
+                        inMemory.size() * (sizeof(RecordId) + sizeof(SpilledMember));
+                    inMemory.clear();
+                }
+            }
+        }
+
+        // Anything else that was invalidated isn't in the intersection.
+        freeInvalidated();
+
+        _spilledSetSize = count;
+        if (onDisk) {
+            _spilledSet.reset(onDisk->done());
+            return;
+        }
+
+        // The intersection fits in memory again.
+        _spilledSet.reset();
+        _spilled = false;
+        _dataSet.swap(inMemory);
+        _memUsage = _dataSet.memUsage();
+    }
+
+    void AndHashStage::buildSpilledOutput() {
+        invariant(_spilled);
+
+        // The last child may not have returned anything.
+        boost::scoped_ptr<SpillIterator> results(_spillSorter ? _spillSorter->done() : NULL);
+        _spillSorter.reset();
+
+        // The output is sorted by position in the last child.  All the keys are null so that
+        // the comparator only looks at the position.
+        boost::scoped_ptr<SpillSorter> output(makeSpillSorter());
+
+        pair<RecordId, SpilledMember> a;
+        // For each RecordId this is the first result the last child returned for it.
+        pair<RecordId, SpilledMember> b;
+        bool moreB = results && nextDistinct(results.get(), &b);
+        while (nextDistinct(_spilledSet.get(), &a)) {
+            if (flagIfInvalidated(a.first)) {
+                continue;
+            }
+            while (moreB && b.first < a.first) {
+                moreB = nextDistinct(results.get(), &b);
+            }
+            if (!moreB) {
+                if (_invalidated.empty()) { break; }
+                continue;
+            }
+            if (b.first != a.first) {
+                continue;
+            }
+
+            output->add(RecordId(), b.second);
+            _specificStats.spilledBytes += sizeof(RecordId) + b.second.memUsageForSorter();
+        }
+
+        _spilledOutput.reset(output->done());
+        _spilledSet.reset();
+
+        // Anything else that was invalidated isn't in the intersection.
+        freeInvalidated();
+    }
+
+    bool AndHashStage::flagIfInvalidated(const RecordId& loc) {
+        InvalidatedMap::iterator it = _invalidated.find(loc);
+        if (_invalidated.end() == it) {
+            return false;
+        }
+
+        if (_hashingChildren) {
+            ++_specificStats.flaggedInProgress;
+        }
+        else {
+            ++_specificStats.flaggedButPassed;
+        }
+        _invalidatedBytes -= _ws->get(it->second)->getMemUsage();
+        _ws->flagForReview(it->second);
+        _invalidated.erase(it);
+        return true;
+    }
+
+    void AndHashStage::freeInvalidated() {
+        for (InvalidatedMap::const_iterator it = _invalidated.begin();
+             it != _invalidated.end();
+             ++it) {
+            _ws->free(it->second);
+        }
+        _invalidated.clear();
+        _invalidatedBytes = 0;
+    }
+
+    // static
+    bool AndHashStage::nextDistinct(SpillIterator* it, pair<RecordId, SpilledMember>* data) {
+        while (it->more()) {
+            pair<RecordId, SpilledMember> next = it->next();
+            if (next.first != data->first) {
+                *data = next;
+                return true;
+            }
+        }
+        return false;
+    }
+
     void AndHashStage::saveState() {
         ++_commonStats.yields;
 
@@ -489,12 +910,19 @@ namespace mongo {
         //
         // If it's a mutation the predicates implied by the AND-ing may no longer be true.
         //
-        // So, we flag and try to pick it up later.
-        DataMap::iterator it = _dataMap.find(dl);
-        if (_dataMap.end() != it) {
-            WorkingSetID id = it->second;
-            WorkingSetMember* member = _ws->get(id);
-            verify(member->loc == dl);
+        // So, we flag and try to pick it up later.  While spilled we can't tell whether we hold
+        // the RecordId, so we keep a copy and decide when the RecordIds are read back.
+        if (_spilled) {
+            if (_invalidated.end() != _invalidated.find(dl)) {
+                return;
+            }
+            if (_invalidatedBytes > kMaxInvalidatedBytes) {
+                // We fail on the next call to work(), so there's no need for more copies.
+                return;
+            }
+        }
+        else if (_dataSet.erase(dl)) {
+            _nextSet.erase(dl);
 
             if (_hashingChildren) {
                 ++_specificStats.flaggedInProgress;
@@ -502,18 +930,25 @@ namespace mongo {
             else {
                 ++_specificStats.flaggedButPassed;
             }
+        }
+        else {
+            return;
+        }
 
-            // Update memory stats.
-            _memUsage -= member->getMemUsage();
-
-            // The loc is about to be invalidated.  Fetch it and clear the loc.
-            WorkingSetCommon::fetchAndInvalidateLoc(txn, member, _collection);
+        // The loc is about to be invalidated.  Fetch it and clear the loc.
+        WorkingSetID id = _ws->allocate();
+        WorkingSetMember* member = _ws->get(id);
+        member->loc = dl;
+        member->state = WorkingSetMember::LOC_AND_IDX;
+        WorkingSetCommon::fetchAndInvalidateLoc(txn, member, _collection);
 
+        if (_spilled) {
+            _invalidated[dl] = id;
+            _invalidatedBytes += member->getMemUsage();
+        }
+        else {
             // Add the WSID to the to-be-reviewed list in the WS.
             _ws->flagForReview(id);
-
-            // And don't return it from this stage.
-            _dataMap.erase(it);
         }
     }
 
@@ -552,3 +987,8 @@ namespace mongo {
     }
 
 }  // namespace mongo
+
+#include "mongo/db/sorter/sorter.cpp"
+MONGO_CREATE_SORTER(mongo::RecordId,
+                    mongo::AndHashStage::SpilledMember,
+                    mongo::AndHashStage::SpilledMemberComparator);
@@ -29,13 +29,17 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <utility>
 #include <vector>
 
 #include "mongo/db/jsobj.h"
 #include "mongo/db/exec/plan_stage.h"
+#include "mongo/db/exec/record_id_set.h"
+#include "mongo/db/exec/working_set.h"
 #include "mongo/db/matcher/expression.h"
 #include "mongo/db/record_id.h"
-#include "mongo/platform/unordered_set.h"
+#include "mongo/db/sorter/sorter.h"
+#include "mongo/platform/unordered_map.h"
 
 namespace mongo {
 
@@ -43,6 +47,17 @@ namespace mongo {
      * Reads from N children, each of which must have a valid RecordId.  Uses a hash table to
      * intersect the outputs of the N children, and outputs the intersection.
      *
+     * Only the RecordIds of the first N-1 children are kept, in a RecordIdSet, and their working
+     * set members are freed as soon as they are read.  The last child is then streamed and its
+     * results that are in the set are returned in its order.  So a result carries the index keys
+     * or document of the last child only, not of the other children.
+     *
+     * If the set outgrows the memory limit the stage doesn't fail.  The RecordIds move to a
+     * Sorter which spills them to disk, each remaining child is intersected with them by merging
+     * sorted runs, and the set goes back to memory as soon as the intersection fits again.  If
+     * it is still on disk when the last child is read, the last child's results are spilled too,
+     * matched up by RecordId and returned in the last child's order once it is done.
+     *
      * Preconditions: Valid RecordId.  More than one child.
      *
      * Any RecordId that we keep a reference to that is invalidated before we are able to return it
@@ -96,10 +111,88 @@ namespace mongo {
     private:
         static const size_t kLookAheadWorks;
 
+        // A RecordId of one of the first N-1 children, or a result of the last child, held by a
+        // Sorter once the set no longer fits in memory.
+        struct SpilledMember {
+            SpilledMember();
+
+            struct SorterDeserializeSettings {};
+            void serializeForSorter(BufBuilder& buf) const;
+            static SpilledMember deserializeForSorter(BufReader& buf,
+                                                      const SorterDeserializeSettings&);
+            int memUsageForSorter() const;
+            SpilledMember getOwned() const;
+
+            // Where the last child returned this result.  Zero for the other children.
+            long long seq;
+
+            // Only set for results of the last child.
+            RecordId loc;
+            bool hasObj;
+            BSONObj obj;
+            // Index keys, by position in _spilledIndexes.
+            std::vector<std::pair<int, BSONObj> > keys;
+        };
+
+        // Orders by RecordId, then by the position in the last child's output.
+        struct SpilledMemberComparator {
+            int operator()(const std::pair<RecordId, SpilledMember>& lhs,
+                           const std::pair<RecordId, SpilledMember>& rhs) const;
+        };
+
+        typedef Sorter<RecordId, SpilledMember> SpillSorter;
+        typedef SortIteratorInterface<RecordId, SpilledMember> SpillIterator;
+
         StageState readFirstChild(WorkingSetID* out);
         StageState hashOtherChildren(WorkingSetID* out);
+        StageState probeLastChild(WorkingSetID* out);
+        StageState spillLastChild(WorkingSetID* out);
+        StageState returnSpilled(WorkingSetID* out);
         StageState workChild(size_t childNo, WorkingSetID* out);
 
+        SpillSorter* makeSpillSorter() const;
+
+        /**
+         * Adds to _spillSorter, which is created if need be.
+         */
+        void addToSpill(const RecordId& loc, const SpilledMember& member);
+
+        /**
+         * Moves _dataSet to disk.  If a middle child is being read, the RecordIds it has
+         * matched so far in _nextSet become the start of its own sorted input.
+         */
+        void spillDataSet();
+
+        /**
+         * Called once a middle child is done while spilled.  Intersects _spilledSet with the
+         * child's RecordIds in _spillSorter, keeping the result in _dataSet if it fits.
+         */
+        void intersectSpilled();
+
+        /**
+         * Called once the last child is done while spilled.  Matches its results in
+         * _spillSorter up with _spilledSet and sets up _spilledOutput.
+         */
+        void buildSpilledOutput();
+
+        /**
+         * If 'loc' was invalidated while spilled, flags the copy we fetched then for review and
+         * returns true.  Called for each RecordId of _spilledSet as it's read back, which is
+         * where an in-memory AND would have found it.
+         */
+        bool flagIfInvalidated(const RecordId& loc);
+
+        /**
+         * Frees the copies of invalidated documents that flagIfInvalidated() didn't use.
+         */
+        void freeInvalidated();
+
+        /**
+         * Advances 'it' to the next entry whose RecordId isn't data->first, which it stores in
+         * 'data'.  Returns false if there is none.
+         */
+        static bool nextDistinct(SpillIterator* it, std::pair<RecordId, SpilledMember>* data);
+
         // Not owned by us.
         const Collection* _collection;
 
@@ -117,15 +210,13 @@ namespace mongo {
         // we place that result here.
         std::vector<WorkingSetID> _lookAheadResults;
 
-        // _dataMap is filled out by the first child and probed by subsequent children.  This is the
-        // hash table that we create by intersecting _children and probe with the last child.
-        typedef unordered_map<RecordId, WorkingSetID, RecordId::Hasher> DataMap;
-        DataMap _dataMap;
+        // The RecordIds that are in every child read so far.  Filled out by the first child and
+        // probed by subsequent children.  Empty while spilled.
+        RecordIdSet _dataSet;
 
-        // Keeps track of what elements from _dataMap subsequent children have seen.
+        // The RecordIds of _dataSet which the child currently being read has also returned.
         // Only used while _hashingChildren.
-        typedef unordered_set<RecordId, RecordId::Hasher> SeenMap;
-        SeenMap _seenMap;
+        RecordIdSet _nextSet;
 
         // True if we're still intersecting _children[0..._children.size()-1].
         bool _hashingChildren;
@@ -137,14 +228,49 @@ namespace mongo {
         CommonStats _commonStats;
         AndHashStats _specificStats;
 
-        // The usage in bytes of all buffered data that we're holding.
-        // Memory usage is calculated from keys held in _dataMap only.
+        // The usage in bytes of _dataSet and _nextSet.
         // For simplicity, results in _lookAheadResults do not count towards the limit.
         size_t _memUsage;
 
-        // Upper limit for buffered data memory usage.
+        // Upper limit for _memUsage before we spill, and for the memory used by each Sorter.
         // Defaults to 32 MB (See kMaxBytes in and_hash.cpp).
         size_t _maxMemUsage;
+
+        //
+        // State used once the intersection has spilled to disk.
+        //
+
+        // True while the intersection is kept by the Sorters below rather than _dataSet.
+        bool _spilled;
+
+        // The sorted RecordIds that are in every child read so far.
+        boost::scoped_ptr<SpillIterator> _spilledSet;
+
+        // How many RecordIds _spilledSet holds, or will once the first child is done.
+        size_t _spilledSetSize;
+
+        // The RecordIds, or for the last child the results, of the child being read.
+        boost::scoped_ptr<SpillSorter> _spillSorter;
+
+        // The matched results of the last child, in its order.
+        boost::scoped_ptr<SpillIterator> _spilledOutput;
+
+        // Number of results read from the last child so far, to put them back in order.
+        long long _lastChildSeq;
+
+        // The indices whose keys the spilled results carry.  Their key patterns point into the
+        // index descriptors, which outlive the query.
+        std::vector<IndexKeyDatum> _spilledIndexes;
+
+        // Owned copies of the documents invalidated while spilled.  We can't tell whether they
+        // are still in the intersection until the spilled RecordIds are read back.
+        typedef unordered_map<RecordId, WorkingSetID, RecordId::Hasher> InvalidatedMap;
+        InvalidatedMap _invalidated;
+
+        // The memory used by the copies in _invalidated.  Every invalidation while spilled makes
+        // a copy, whether or not we hold the RecordId, so this is capped and the stage fails
+        // once it's exceeded (See kMaxInvalidatedBytes in and_hash.cpp).
+        size_t _invalidatedBytes;
     };
 
 }  // namespace mongo
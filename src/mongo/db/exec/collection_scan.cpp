@@ -35,6 +35,7 @@
 #include "mongo/db/exec/filter.h"
 #include "mongo/db/exec/scoped_timer.h"
 #include "mongo/db/exec/working_set.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/storage/record_fetcher.h"
@@ -65,6 +66,10 @@ namespace mongo {
         // Explain reports the direction of the collection scan.
         _specificStats.direction = params.direction;
 
+        if (_filter && internalQueryExecCompileFilters) {
+            _compiledFilter.reset(new CompiledMatchExpression(_filter));
+        }
+
         // We pre-allocate a WSM and use it to pass up fetch requests. This should never be used
         // for anything other than passing up NEED_YIELD. We use the loc and owned obj state, but
         // the loc isn't really pointing at any obj. The obj field of the WSM should never be used.
@@ -78,6 +83,22 @@ namespace mongo {
         // Adds the amount of time taken by work() to executionTimeMillis.
         ScopedTimer timer(&_commonStats.executionTimeMillis);
 
+        return doWork(out);
+    }
+
+    PlanStage::StageState CollectionScan::workBatch(size_t maxWorks,
+                                                    std::vector<WorkingSetID>* out,
+                                                    WorkingSetID* stateOut) {
+        // One timer for the whole batch.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        return runBatch(maxWorks, out, stateOut, [this](WorkingSetID* id) {
+            ++_commonStats.works;
+            return doWork(id);
+        });
+    }
+
+    PlanStage::StageState CollectionScan::doWork(WorkingSetID* out) {
         if (_isDead) { return PlanStage::DEAD; }
 
         // Do some init if we haven't already.
@@ -182,7 +203,9 @@ namespace mongo {
                                                           WorkingSetID* out) {
         ++_specificStats.docsTested;
 
-        if (Filter::passes(member, _filter)) {
+        const bool passes = _compiledFilter ? Filter::passes(member, *_compiledFilter)
+                                            : Filter::passes(member, _filter);
+        if (passes) {
             *out = memberID;
             ++_commonStats.advanced;
             return PlanStage::ADVANCED;
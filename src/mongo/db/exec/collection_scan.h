@@ -33,6 +33,7 @@
 #include "mongo/db/exec/collection_scan_common.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_compiled.h"
 #include "mongo/db/record_id.h"
 
 namespace mongo {
@@ -55,6 +56,9 @@ namespace mongo {
                        const MatchExpression* filter);
 
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks,
+                                     std::vector<WorkingSetID>* out,
+                                     WorkingSetID* stateOut);
         virtual bool isEOF();
 
         virtual void invalidate(OperationContext* txn, const RecordId& dl, InvalidationType type);
@@ -74,6 +78,11 @@ namespace mongo {
         static const char* kStageType;
 
     private:
+        /**
+         * One unit of work, without the timing and works accounting done by work().
+         */
+        StageState doWork(WorkingSetID* out);
+
         /**
          * If the member (with id memberID) passes our filter, set *out to memberID and return that
          * ADVANCED.  Otherwise, free memberID and return NEED_TIME.
@@ -91,6 +100,10 @@ namespace mongo {
         // The filter is not owned by us.
         const MatchExpression* _filter;
 
+        // The filter compiled for matching whole documents, NULL if there is no filter or
+        // internalQueryExecCompileFilters is off.
+        boost::scoped_ptr<CompiledMatchExpression> _compiledFilter;
+
         boost::scoped_ptr<RecordIterator> _iter;
 
         CollectionScanParams _params;
@@ -35,6 +35,7 @@
 #include "mongo/db/exec/filter.h"
 #include "mongo/db/exec/scoped_timer.h"
 #include "mongo/db/exec/working_set_common.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/storage/record_fetcher.h"
 #include "mongo/util/fail_point_service.h"
 #include "mongo/util/mongoutils/str.h"
@@ -58,7 +59,13 @@ namespace mongo {
           _child(child),
           _filter(filter),
           _idRetrying(WorkingSet::INVALID_ID),
-          _commonStats(kStageType) { }
+          _pendingChildState(PlanStage::NEED_TIME),
+          _pendingChildStateId(WorkingSet::INVALID_ID),
+          _commonStats(kStageType) {
+        if (_filter && internalQueryExecCompileFilters) {
+            _compiledFilter.reset(new CompiledMatchExpression(_filter));
+        }
+    }
 
     FetchStage::~FetchStage() { }
 
@@ -69,6 +76,11 @@ namespace mongo {
             return false;
         }
 
+        if (!_pendingResults.empty() || PlanStage::NEED_TIME != _pendingChildState) {
+            // We still have to pass on the rest of a child batch.
+            return false;
+        }
+
         return _child->isEOF();
     }
 
@@ -78,19 +90,64 @@ namespace mongo {
         // Adds the amount of time taken by work() to executionTimeMillis.
         ScopedTimer timer(&_commonStats.executionTimeMillis);
 
+        return doWork(out);
+    }
+
+    PlanStage::StageState FetchStage::workBatch(size_t maxWorks,
+                                                std::vector<WorkingSetID>* out,
+                                                WorkingSetID* stateOut) {
+        // One timer for the whole batch.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        if (isEOF()) { return PlanStage::IS_EOF; }
+
+        // Take a whole batch from the child in one call, unless we are still working through
+        // the last one.
+        if (WorkingSet::INVALID_ID == _idRetrying
+            && _pendingResults.empty()
+            && PlanStage::NEED_TIME == _pendingChildState) {
+            std::vector<WorkingSetID> childResults;
+            _pendingChildState = _child->workBatch(maxWorks, &childResults, &_pendingChildStateId);
+            _pendingResults.assign(childResults.begin(), childResults.end());
+        }
+
+        // Each unit of work below consumes one of these.
+        const size_t units = (WorkingSet::INVALID_ID != _idRetrying)
+                           + _pendingResults.size()
+                           + (PlanStage::NEED_TIME != _pendingChildState);
+
+        return runBatch(units, out, stateOut, [this](WorkingSetID* id) {
+            ++_commonStats.works;
+            return doWork(id);
+        });
+    }
+
+    PlanStage::StageState FetchStage::doWork(WorkingSetID* out) {
         if (isEOF()) { return PlanStage::IS_EOF; }
 
-        // Either retry the last WSM we worked on or get a new one from our child.
+        // Either retry the last WSM we worked on, pass on what's left of a child batch or get a
+        // new one from our child.
         WorkingSetID id;
         StageState status;
-        if (_idRetrying == WorkingSet::INVALID_ID) {
-            status = _child->work(&id);
-        }
-        else {
+        if (_idRetrying != WorkingSet::INVALID_ID) {
             status = ADVANCED;
             id = _idRetrying;
             _idRetrying = WorkingSet::INVALID_ID;
         }
+        else if (!_pendingResults.empty()) {
+            status = ADVANCED;
+            id = _pendingResults.front();
+            _pendingResults.pop_front();
+        }
+        else if (PlanStage::NEED_TIME != _pendingChildState) {
+            status = _pendingChildState;
+            id = _pendingChildStateId;
+            _pendingChildState = PlanStage::NEED_TIME;
+            _pendingChildStateId = WorkingSet::INVALID_ID;
+        }
+        else {
+            status = _child->work(&id);
+        }
 
         if (PlanStage::ADVANCED == status) {
             WorkingSetMember* member = _ws->get(id);
@@ -188,6 +245,16 @@ namespace mongo {
                 WorkingSetCommon::fetchAndInvalidateLoc(txn, member, _collection);
             }
         }
+
+        // The same goes for results of a child batch which we haven't got to yet.
+        for (std::deque<WorkingSetID>::const_iterator it = _pendingResults.begin();
+             it != _pendingResults.end();
+             ++it) {
+            WorkingSetMember* member = _ws->get(*it);
+            if (member->hasLoc() && (member->loc == dl)) {
+                WorkingSetCommon::fetchAndInvalidateLoc(txn, member, _collection);
+            }
+        }
     }
 
     PlanStage::StageState FetchStage::returnIfMatches(WorkingSetMember* member,
@@ -209,7 +276,9 @@ namespace mongo {
         // predicate.
         ++_specificStats.docsExamined;
 
-        if (Filter::passes(member, _filter)) {
+        const bool passes = _compiledFilter ? Filter::passes(member, *_compiledFilter)
+                                            : Filter::passes(member, _filter);
+        if (passes) {
             *out = memberID;
 
             ++_commonStats.advanced;
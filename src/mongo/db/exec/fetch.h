@@ -29,10 +29,12 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <deque>
 
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_compiled.h"
 #include "mongo/db/record_id.h"
 
 namespace mongo {
@@ -57,6 +59,9 @@ namespace mongo {
 
         virtual bool isEOF();
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks,
+                                     std::vector<WorkingSetID>* out,
+                                     WorkingSetID* stateOut);
 
         virtual void saveState();
         virtual void restoreState(OperationContext* opCtx);
@@ -75,6 +80,11 @@ namespace mongo {
         static const char* kStageType;
 
     private:
+        /**
+         * One unit of work, without the timing and works accounting done by work().  Takes its
+         * input from _idRetrying or the rest of a child batch before asking the child for more.
+         */
+        StageState doWork(WorkingSetID* out);
 
         /**
          * If the member (with id memberID) passes our filter, set *out to memberID and return that
@@ -96,9 +106,22 @@ namespace mongo {
         // The filter is not owned by us.
         const MatchExpression* _filter;
 
+        // The filter compiled for matching whole documents, NULL if there is no filter or
+        // internalQueryExecCompileFilters is off.
+        boost::scoped_ptr<CompiledMatchExpression> _compiledFilter;
+
         // If not Null, we use this rather than asking our child what to do next.
         WorkingSetID _idRetrying;
 
+        // Results of a child batch that we haven't fetched yet, because fetching one of them
+        // needed a yield.
+        std::deque<WorkingSetID> _pendingResults;
+
+        // The state which ended that child batch, and its WSID, to be passed on once
+        // _pendingResults is empty.  NEED_TIME if there is none.
+        StageState _pendingChildState;
+        WorkingSetID _pendingChildStateId;
+
         // Stats
         CommonStats _commonStats;
         FetchStats _specificStats;
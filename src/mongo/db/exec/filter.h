@@ -30,6 +30,7 @@
 
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_compiled.h"
 #include "mongo/db/matcher/matchable.h"
 
 namespace mongo {
@@ -158,6 +159,14 @@ namespace mongo {
             return filter->matches(&doc, NULL);
         }
 
+        /**
+         * As above, but uses the compiled form of the filter if 'wsm' has a full document.
+         */
+        static bool passes(WorkingSetMember* wsm, const CompiledMatchExpression& filter) {
+            if (!wsm->hasObj()) { return passes(wsm, filter.getExpression()); }
+            return filter.matchesBSON(wsm->obj.value());
+        }
+
         static bool passes(const BSONObj& keyData,
                            const BSONObj& keyPattern,
                            const MatchExpression* filter) {
@@ -32,6 +32,8 @@
 
 #include "mongo/db/exec/index_scan.h"
 
+#include <algorithm>
+
 #include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/exec/filter.h"
 #include "mongo/db/exec/scoped_timer.h"
@@ -92,13 +94,21 @@ namespace mongo {
 
         // Perform the possibly heavy-duty initialization of the underlying index cursor.
         _indexCursor = _iam->newCursor(_txn, _forward);
+        return seekToStart(_indexCursor.get(), &_checker, &_seekPoint, &_endKey, &_endKeyInclusive);
+    }
 
+    boost::optional<IndexKeyEntry> IndexScan::seekToStart(
+                SortedDataInterface::Cursor* cursor,
+                boost::scoped_ptr<IndexBoundsChecker>* checker,
+                IndexSeekPoint* seekPoint,
+                BSONObj* endKey,
+                bool* endKeyInclusive) const {
         if (_params.bounds.isSimpleRange) {
             // Start at one key, end at another.
-            _endKey = _params.bounds.endKey;
-            _endKeyInclusive = _params.bounds.endKeyInclusive;
-            _indexCursor->setEndPosition(_endKey, _endKeyInclusive);
-            return _indexCursor->seek(_params.bounds.startKey, /*inclusive*/true);
+            *endKey = _params.bounds.endKey;
+            *endKeyInclusive = _params.bounds.endKeyInclusive;
+            cursor->setEndPosition(*endKey, *endKeyInclusive);
+            return cursor->seek(_params.bounds.startKey, /*inclusive*/true);
         }
         else {
             // For single intervals, we can use an optimized scan which checks against the position
@@ -109,23 +119,60 @@ namespace mongo {
             if (IndexBoundsBuilder::isSingleInterval(_params.bounds,
                                                      &startKey,
                                                      &startKeyInclusive,
-                                                     &_endKey,
-                                                     &_endKeyInclusive)) {
+                                                     endKey,
+                                                     endKeyInclusive)) {
 
-                _indexCursor->setEndPosition(_endKey, _endKeyInclusive);
-                return _indexCursor->seek(startKey, startKeyInclusive);
+                cursor->setEndPosition(*endKey, *endKeyInclusive);
+                return cursor->seek(startKey, startKeyInclusive);
             }
             else {
-                _checker.reset(new IndexBoundsChecker(&_params.bounds,
+                checker->reset(new IndexBoundsChecker(&_params.bounds,
                                                       _keyPattern,
                                                       _params.direction));
 
-                if (!_checker->getStartSeekPoint(&_seekPoint))
+                if (!(*checker)->getStartSeekPoint(seekPoint))
                     return boost::none;
 
-                return _indexCursor->seek(_seekPoint);
+                return cursor->seek(*seekPoint);
+            }
+        }
+    }
+
+    size_t IndexScan::estimateKeysExamined(size_t maxKeys) {
+        invariant(INITIALIZING == _scanState);
+
+        if (_params.maxScan) {
+            maxKeys = std::min(maxKeys, _params.maxScan);
+        }
+
+        std::unique_ptr<SortedDataInterface::Cursor> cursor = _iam->newCursor(_txn, _forward);
+        boost::scoped_ptr<IndexBoundsChecker> checker;
+        IndexSeekPoint seekPoint;
+        BSONObj endKey;
+        bool endKeyInclusive;
+        boost::optional<IndexKeyEntry> kv = seekToStart(cursor.get(), &checker, &seekPoint,
+                                                        &endKey, &endKeyInclusive);
+
+        // Count keys the way doWork() does: every key the cursor hands back, including the ones
+        // the checker skips past.
+        size_t keys = 0;
+        while (kv && keys < maxKeys) {
+            ++keys;
+
+            if (!checker) {
+                kv = cursor->next();
+                continue;
+            }
+
+            switch (checker->checkKey(kv->key, &seekPoint)) {
+            case IndexBoundsChecker::VALID: kv = cursor->next(); break;
+            case IndexBoundsChecker::DONE: kv = boost::none; break;
+            case IndexBoundsChecker::MUST_ADVANCE: kv = cursor->seek(seekPoint); break;
             }
         }
+
+        _specificStats.estimatedKeysExamined = keys;
+        return keys;
     }
 
     PlanStage::StageState IndexScan::work(WorkingSetID* out) {
@@ -134,6 +181,22 @@ namespace mongo {
         // Adds the amount of time taken by work() to executionTimeMillis.
         ScopedTimer timer(&_commonStats.executionTimeMillis);
 
+        return doWork(out);
+    }
+
+    PlanStage::StageState IndexScan::workBatch(size_t maxWorks,
+                                               std::vector<WorkingSetID>* out,
+                                               WorkingSetID* stateOut) {
+        // One timer for the whole batch.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        return runBatch(maxWorks, out, stateOut, [this](WorkingSetID* id) {
+            ++_commonStats.works;
+            return doWork(id);
+        });
+    }
+
+    PlanStage::StageState IndexScan::doWork(WorkingSetID* out) {
         // Get the next kv pair from the index, if any.
         boost::optional<IndexKeyEntry> kv;
         try {
@@ -176,6 +239,7 @@ namespace mongo {
 
             case IndexBoundsChecker::MUST_ADVANCE:
                 _scanState = NEED_SEEK;
+                ++_specificStats.seeks;
                 _commonStats.needTime++;
                 return PlanStage::NEED_TIME;
             }
@@ -103,6 +103,9 @@ namespace mongo {
         virtual ~IndexScan() { }
 
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks,
+                                     std::vector<WorkingSetID>* out,
+                                     WorkingSetID* stateOut);
         virtual bool isEOF();
         virtual void saveState();
         virtual void restoreState(OperationContext* opCtx);
@@ -118,14 +121,40 @@ namespace mongo {
 
         virtual const SpecificStats* getSpecificStats() const;
 
+        /**
+         * Walks the bounds with a cursor of its own and returns the number of keys the scan
+         * would examine, stopping at 'maxKeys'.  The count is exact if it is less than
+         * 'maxKeys'.  It is kept as estimatedKeysExamined in the stats.
+         *
+         * Must be called before the first call to work().  May throw WriteConflictException.
+         */
+        size_t estimateKeysExamined(size_t maxKeys);
+
         static const char* kStageType;
 
     private:
+        /**
+         * One unit of work, without the timing and works accounting done by work().
+         */
+        StageState doWork(WorkingSetID* out);
+
         /**
          * Initialize the underlying index Cursor, returning first result if any.
          */
         boost::optional<IndexKeyEntry> initIndexScan();
 
+        /**
+         * Positions 'cursor' at the first key in the bounds and returns it, if any.  If the
+         * cursor can't be told where the bounds end, sets 'checker' to an IndexBoundsChecker
+         * positioned at 'seekPoint'.  Otherwise sets the end position of the cursor, and the end
+         * key, which is only used by debug checks.
+         */
+        boost::optional<IndexKeyEntry> seekToStart(SortedDataInterface::Cursor* cursor,
+                                                   boost::scoped_ptr<IndexBoundsChecker>* checker,
+                                                   IndexSeekPoint* seekPoint,
+                                                   BSONObj* endKey,
+                                                   bool* endKeyInclusive) const;
+
         // transactional context for read locks. Not owned by us
         OperationContext* _txn;
 
@@ -91,6 +91,48 @@ namespace mongo {
         return status;
     }
 
+    PlanStage::StageState LimitStage::workBatch(size_t maxWorks,
+                                                vector<WorkingSetID>* out,
+                                                WorkingSetID* stateOut) {
+        // One timer for the whole batch.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        if (0 == _numToReturn) {
+            ++_commonStats.works;
+            return PlanStage::IS_EOF;
+        }
+
+        // A unit of work produces at most one result, so the child can't read past the limit
+        // if we ask it for no more units than we have results left to return.
+        const size_t childWorks = std::min(maxWorks, static_cast<size_t>(_numToReturn));
+        const size_t numBefore = out->size();
+        StageState status = _child->workBatch(childWorks, out, stateOut);
+        const size_t numResults = out->size() - numBefore;
+
+        _numToReturn -= static_cast<int>(numResults);
+        _commonStats.works += numResults;
+        _commonStats.advanced += numResults;
+
+        if (PlanStage::NEED_TIME == status) {
+            return status;
+        }
+
+        ++_commonStats.works;
+        if (PlanStage::FAILURE == status) {
+            if (WorkingSet::INVALID_ID == *stateOut) {
+                mongoutils::str::stream ss;
+                ss << "limit stage failed to read in results from child";
+                Status status(ErrorCodes::InternalError, ss);
+                *stateOut = WorkingSetCommon::allocateStatusMember( _ws, status);
+            }
+        }
+        else if (PlanStage::NEED_YIELD == status) {
+            ++_commonStats.needYield;
+        }
+
+        return status;
+    }
+
     void LimitStage::saveState() {
         ++_commonStats.yields;
         _child->saveState();
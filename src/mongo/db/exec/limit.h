@@ -50,6 +50,9 @@ namespace mongo {
 
         virtual bool isEOF();
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks,
+                                     std::vector<WorkingSetID>* out,
+                                     WorkingSetID* stateOut);
 
         virtual void saveState();
         virtual void restoreState(OperationContext* opCtx);
@@ -40,11 +40,13 @@
 #include "mongo/db/catalog/database.h"
 #include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/client.h"
+#include "mongo/db/exec/index_scan.h"
 #include "mongo/db/exec/scoped_timer.h"
 #include "mongo/db/exec/working_set_common.h"
 #include "mongo/db/query/explain.h"
 #include "mongo/db/query/plan_cache.h"
 #include "mongo/db/query/plan_ranker.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/storage/record_fetcher.h"
 #include "mongo/util/mongoutils/str.h"
 #include "mongo/util/log.h"
@@ -71,6 +73,7 @@ namespace mongo {
           _backupPlanIdx(kNoSuchPlan),
           _failure(false),
           _failureCount(0),
+          _prunedCount(0),
           _statusMemberId(WorkingSet::INVALID_ID),
           _commonStats(kStageType) {
         invariant(_collection);
@@ -186,6 +189,108 @@ namespace mongo {
         return Status::OK();
     }
 
+    namespace {
+
+        /**
+         * Adds the number of index keys and documents 'stage' is estimated to examine to '*cost'.
+         * Index scans are counted up to 'maxKeys' keys, and '*exact' is set to false if one
+         * has more.  Returns false if 'stage' has a leaf whose cost can't be estimated.
+         */
+        bool estimateCost(OperationContext* txn,
+                          const Collection* collection,
+                          PlanStage* stage,
+                          size_t maxKeys,
+                          long long* cost,
+                          bool* exact) {
+            const std::vector<PlanStage*> children = stage->getChildren();
+            if (!children.empty()) {
+                for (size_t i = 0; i < children.size(); ++i) {
+                    if (!estimateCost(txn, collection, children[i], maxKeys, cost, exact)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            switch (stage->stageType()) {
+            case STAGE_IXSCAN: {
+                size_t keys = static_cast<IndexScan*>(stage)->estimateKeysExamined(maxKeys);
+                if (keys >= maxKeys) {
+                    *exact = false;
+                }
+                *cost += keys;
+                return true;
+            }
+            case STAGE_COLLSCAN:
+            case STAGE_PARALLEL_COLLSCAN:
+                *cost += collection->numRecords(txn);
+                return true;
+            case STAGE_EOF:
+                return true;
+            default:
+                // Text, geo and the like.
+                return false;
+            }
+        }
+
+    }  // namespace
+
+    void MultiPlanStage::pruneByEstimatedCost() {
+        // Forced intersection plans must get their trial, since they are boosted in ranking.
+        if (internalQueryPlanEvaluationEstimateMaxKeys <= 0
+            || internalQueryForceIntersectionPlans
+            || _candidates.size() < 2) {
+            return;
+        }
+        const size_t maxKeys = internalQueryPlanEvaluationEstimateMaxKeys;
+
+        // A cost of -1 means the candidate couldn't be estimated.  Costs which aren't exact are
+        // lower bounds, which is enough to prune a candidate but not to compare it against.
+        std::vector<long long> costs(_candidates.size(), -1);
+        int cheapestIdx = kNoSuchPlan;
+        try {
+            for (size_t ix = 0; ix < _candidates.size(); ++ix) {
+                long long cost = 0;
+                bool exact = true;
+                if (!estimateCost(_txn, _collection, _candidates[ix].root, maxKeys,
+                                  &cost, &exact)) {
+                    continue;
+                }
+
+                costs[ix] = cost;
+                if (exact && (kNoSuchPlan == cheapestIdx || cost < costs[cheapestIdx])) {
+                    cheapestIdx = ix;
+                }
+            }
+        }
+        catch (const WriteConflictException& wce) {
+            // The estimates only save work, so leave the decision to the trial period.
+            return;
+        }
+
+        if (kNoSuchPlan == cheapestIdx) {
+            return;
+        }
+
+        // If the cheapest plan has a blocking stage it may fail, in which case we need a plan
+        // without one to fall back on.  Only prune plans which could not be that backup.
+        const bool cheapestIsBlocking = _candidates[cheapestIdx].solution->hasBlockingStage;
+        const double maxCost = internalQueryPlanEvaluationPruneRatio * (costs[cheapestIdx] + 1);
+
+        for (size_t ix = 0; ix < _candidates.size(); ++ix) {
+            CandidatePlan& candidate = _candidates[ix];
+            if (costs[ix] < 0 || costs[ix] <= maxCost) { continue; }
+            if (cheapestIsBlocking && !candidate.solution->hasBlockingStage) { continue; }
+
+            LOG(2) << "Pruning plan " << Explain::getPlanSummary(candidate.root)
+                   << " with estimated cost " << costs[ix] << " (cheapest plan "
+                   << Explain::getPlanSummary(_candidates[cheapestIdx].root)
+                   << " has estimated cost " << costs[cheapestIdx] << ")";
+            candidate.pruned = true;
+            ++_prunedCount;
+        }
+    }
+
     // static
     size_t MultiPlanStage::getTrialPeriodWorks(OperationContext* txn,
                                                const Collection* collection) {
@@ -227,6 +332,8 @@ namespace mongo {
         // make sense.
         ScopedTimer timer(&_commonStats.executionTimeMillis);
 
+        pruneByEstimatedCost();
+
         size_t numWorks = getTrialPeriodWorks(_txn, _collection);
         size_t numResults = getTrialPeriodNumToReturn(*_query);
 
@@ -329,7 +436,7 @@ namespace mongo {
 
         for (size_t ix = 0; ix < _candidates.size(); ++ix) {
             CandidatePlan& candidate = _candidates[ix];
-            if (candidate.failed) { continue; }
+            if (candidate.failed || candidate.pruned) { continue; }
 
             // Might need to yield between calls to work due to the timer elapsing.
             if (!(tryYield(yieldPolicy)).isOK()) {
@@ -389,6 +496,14 @@ namespace mongo {
                     _failure = true;
                     return false;
                 }
+
+                if (_failureCount + _prunedCount == _candidates.size()) {
+                    // Every plan we kept failed, so the ones we pruned get a trial after all.
+                    for (size_t i = 0; i < _candidates.size(); ++i) {
+                        _candidates[i].pruned = false;
+                    }
+                    _prunedCount = 0;
+                }
             }
         }
 
@@ -149,6 +149,15 @@ namespace mongo {
         static const char* kStageType;
 
     private:
+        /**
+         * Estimates how many index keys and documents each candidate will examine, and marks the
+         * candidates which are estimated to cost more than internalQueryPlanEvaluationPruneRatio
+         * times the cheapest one as pruned, so that the trial period doesn't work them.
+         *
+         * A candidate whose cost can't be estimated is never pruned.
+         */
+        void pruneByEstimatedCost();
+
         //
         // Have all our candidate plans do something.
         // If all our candidate plans fail, *objOut will contain
@@ -215,6 +224,9 @@ namespace mongo {
         // If everything fails during the plan competition, we can't pick one.
         size_t _failureCount;
 
+        // How many candidates pruneByEstimatedCost() left out of the plan competition.
+        size_t _prunedCount;
+
         // if pickBestPlan fails, this is set to the wsid of the statusMember
         // returned by ::work()
         WorkingSetID _statusMemberId;
@@ -0,0 +1,443 @@
+/**
+ *    Copyright (C) 2013-2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kQuery
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/db/exec/parallel_collection_scan.h"
+
+#include "mongo/db/catalog/collection.h"
+#include "mongo/db/concurrency/write_conflict_exception.h"
+#include "mongo/db/exec/scoped_timer.h"
+#include "mongo/db/exec/working_set.h"
+#include "mongo/db/exec/working_set_common.h"
+#include "mongo/db/operation_context.h"
+#include "mongo/db/query/query_knobs.h"
+#include "mongo/db/storage/record_fetcher.h"
+#include "mongo/stdx/functional.h"
+#include "mongo/util/concurrency/thread_pool.h"
+#include "mongo/util/log.h"
+#include "mongo/util/processinfo.h"
+
+namespace mongo {
+
+    using std::auto_ptr;
+    using std::vector;
+
+    namespace {
+
+        /**
+         * The workers are shared by every parallel scan in the process, so however many queries
+         * run at once they never use more threads than there are cores.
+         */
+        ThreadPool* getWorkerPool() {
+            static ThreadPool* const pool =
+                new ThreadPool(std::max(1u, ProcessInfo().getNumCores()), "parallelCollScan");
+            return pool;
+        }
+
+    }  // namespace
+
+    // static
+    const char* ParallelCollectionScan::kStageType = "PARALLEL_COLLSCAN";
+    const size_t ParallelCollectionScan::kBatchSize;
+
+    ParallelCollectionScan::ParallelCollectionScan(OperationContext* txn,
+                                                   const CollectionScanParams& params,
+                                                   WorkingSet* workingSet,
+                                                   const MatchExpression* filter,
+                                                   size_t numThreads)
+        : _txn(txn),
+          _workingSet(workingSet),
+          _filter(filter),
+          _params(params),
+          _isDead(false),
+          _doneReading(false),
+          _numThreads(numThreads),
+          _wsidForFetch(_workingSet->allocate()),
+          _commonStats(kStageType) {
+        invariant(!_params.tailable);
+        invariant(_numThreads > 0);
+        invariant(canParallelize(_filter));
+
+        _specificStats.direction = params.direction;
+        _specificStats.numThreads = _numThreads;
+
+        if (_filter && internalQueryExecCompileFilters) {
+            _compiledFilter.reset(new CompiledMatchExpression(_filter));
+        }
+
+        // We pre-allocate a WSM and use it to pass up fetch requests, as CollectionScan does.
+        WorkingSetMember* member = _workingSet->get(_wsidForFetch);
+        member->state = WorkingSetMember::LOC_AND_OWNED_OBJ;
+    }
+
+    ParallelCollectionScan::~ParallelCollectionScan() {
+        waitForAllBatches();
+    }
+
+    // static
+    bool ParallelCollectionScan::canParallelize(const MatchExpression* filter) {
+        if (NULL == filter) {
+            return true;
+        }
+
+        if (MatchExpression::WHERE == filter->matchType()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < filter->numChildren(); ++i) {
+            if (!canParallelize(filter->getChild(i))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    PlanStage::StageState ParallelCollectionScan::work(WorkingSetID* out) {
+        ++_commonStats.works;
+
+        // Adds the amount of time taken by work() to executionTimeMillis.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        if (_isDead) { return PlanStage::DEAD; }
+
+        while (!_batches.empty()) {
+            Batch* front = _batches.front().get();
+            {
+                stdx::unique_lock<stdx::mutex> lk(_mutex);
+                if (!front->done) {
+                    // Read more while the workers catch up, unless they're far enough behind.
+                    if (!_doneReading && _batches.size() < 2 * _numThreads) {
+                        break;
+                    }
+                    while (!front->done) {
+                        _batchDone.wait(lk);
+                    }
+                }
+            }
+
+            if (!front->status.isOK()) {
+                _isDead = true;
+                *out = WorkingSetCommon::allocateStatusMember(_workingSet, front->status);
+                return PlanStage::FAILURE;
+            }
+
+            while (front->nextResult < front->objs.size()) {
+                const size_t i = front->nextResult++;
+                if (!front->passed[i]) {
+                    continue;
+                }
+
+                WorkingSetID id = _workingSet->allocate();
+                WorkingSetMember* member = _workingSet->get(id);
+                member->obj = front->objs[i];
+                if (front->locs[i].isNull()) {
+                    // Invalidated since we read it, the object was made owned by invalidate().
+                    member->state = WorkingSetMember::OWNED_OBJ;
+                }
+                else {
+                    member->loc = front->locs[i];
+                    member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+                }
+
+                *out = id;
+                ++_commonStats.advanced;
+                return PlanStage::ADVANCED;
+            }
+
+            _batches.pop_front();
+        }
+
+        if (_doneReading) {
+            return PlanStage::IS_EOF;
+        }
+
+        return readBatch(out);
+    }
+
+    PlanStage::StageState ParallelCollectionScan::readBatch(WorkingSetID* out) {
+        // Do some init if we haven't already.
+        if (NULL == _iter) {
+            if (_params.collection == NULL) {
+                _isDead = true;
+                return PlanStage::DEAD;
+            }
+
+            try {
+                _iter.reset(_params.collection->getIterator(_txn,
+                                                            _params.start,
+                                                            _params.direction));
+            }
+            catch (const WriteConflictException& wce) {
+                // Leave us in a state to try again next time.
+                _iter.reset();
+                *out = WorkingSet::INVALID_ID;
+                return PlanStage::NEED_YIELD;
+            }
+
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+
+        if (!_filling) {
+            _filling.reset(new Batch());
+        }
+
+        while (_filling->locs.size() < kBatchSize) {
+            if ((0 != _params.maxScan) && (_specificStats.docsTested >= _params.maxScan)) {
+                _doneReading = true;
+                break;
+            }
+
+            const RecordId curr = _iter->curr();
+            if (curr.isNull()) {
+                _doneReading = true;
+                break;
+            }
+
+            // See if the record we're about to access is in memory. If not, hand off what we
+            // have read so far and pass a fetch request up.
+            {
+                std::auto_ptr<RecordFetcher> fetcher(
+                    _params.collection->documentNeedsFetch(_txn, curr));
+                if (NULL != fetcher.get()) {
+                    dispatchBatch();
+                    WorkingSetMember* member = _workingSet->get(_wsidForFetch);
+                    member->loc = curr;
+                    // Pass the RecordFetcher off to the WSM.
+                    member->setFetcher(fetcher.release());
+                    *out = _wsidForFetch;
+                    _commonStats.needYield++;
+                    return PlanStage::NEED_YIELD;
+                }
+            }
+
+            const Snapshotted<BSONObj> obj(_txn->recoveryUnit()->getSnapshotId(),
+                                           _iter->dataFor(curr).releaseToBson());
+
+            try {
+                invariant(_iter->getNext() == curr);
+            }
+            catch (const WriteConflictException& wce) {
+                // If getNext thows, it leaves us on the original document.
+                invariant(_iter->curr() == curr);
+                dispatchBatch();
+                *out = WorkingSet::INVALID_ID;
+                return PlanStage::NEED_YIELD;
+            }
+
+            _filling->locs.push_back(curr);
+            _filling->objs.push_back(obj);
+            ++_specificStats.docsTested;
+        }
+
+        dispatchBatch();
+
+        ++_commonStats.needTime;
+        return PlanStage::NEED_TIME;
+    }
+
+    void ParallelCollectionScan::dispatchBatch() {
+        if (!_filling || _filling->locs.empty()) {
+            return;
+        }
+
+        BatchPtr batch;
+        batch.swap(_filling);
+        ++_specificStats.batches;
+
+        if (1 == _specificStats.batches && _doneReading) {
+            // The whole scan fit in one batch, not worth handing to a worker.
+            filterBatch(batch.get());
+            batch->done = true;
+            ++_specificStats.batchesFilteredInline;
+        }
+        else {
+            getWorkerPool()->schedule(stdx::bind(&ParallelCollectionScan::runBatch, this, batch));
+        }
+
+        _batches.push_back(batch);
+    }
+
+    void ParallelCollectionScan::runBatch(BatchPtr batch) {
+        filterBatch(batch.get());
+
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        batch->done = true;
+        _batchDone.notify_all();
+    }
+
+    void ParallelCollectionScan::filterBatch(Batch* batch) const {
+        const size_t numRecords = batch->objs.size();
+        batch->passed.resize(numRecords, 0);
+
+        try {
+            for (size_t i = 0; i < numRecords; ++i) {
+                batch->passed[i] = passesFilter(batch->objs[i].value());
+            }
+        }
+        catch (const DBException& e) {
+            batch->status = e.toStatus();
+        }
+        catch (const std::exception& e) {
+            batch->status = Status(ErrorCodes::InternalError, e.what());
+        }
+    }
+
+    bool ParallelCollectionScan::passesFilter(const BSONObj& obj) const {
+        if (_compiledFilter) {
+            return _compiledFilter->matchesBSON(obj);
+        }
+        return (NULL == _filter) || _filter->matchesBSON(obj, NULL);
+    }
+
+    void ParallelCollectionScan::waitForAllBatches() {
+        stdx::unique_lock<stdx::mutex> lk(_mutex);
+        for (size_t i = 0; i < _batches.size(); ++i) {
+            while (!_batches[i]->done) {
+                _batchDone.wait(lk);
+            }
+        }
+    }
+
+    bool ParallelCollectionScan::isEOF() {
+        if (_isDead) { return true; }
+        return _doneReading && _batches.empty();
+    }
+
+    void ParallelCollectionScan::invalidate(OperationContext* txn,
+                                            const RecordId& dl,
+                                            InvalidationType type) {
+        ++_commonStats.invalidates;
+
+        // Deletions can harm the underlying RecordIterator so we must pass them down.
+        if (INVALIDATION_DELETION == type && NULL != _iter) {
+            _iter->invalidate(dl);
+        }
+
+        // Nothing may read a batch while we change it.
+        waitForAllBatches();
+
+        for (size_t i = 0; i < _batches.size(); ++i) {
+            Batch* batch = _batches[i].get();
+            for (size_t j = batch->nextResult; j < batch->locs.size(); ++j) {
+                if (dl != batch->locs[j]) {
+                    continue;
+                }
+
+                // Like WorkingSetCommon::fetchAndInvalidateLoc(), keep an owned copy of the
+                // document as it is now and forget the loc, so that an update or delete above us
+                // won't act on a record which may no longer match.  The copy we filtered may be
+                // older than the record, so filter it again.
+                if (INVALIDATION_MUTATION == type) {
+                    batch->objs[j] = _params.collection->docFor(txn, dl);
+                    try {
+                        batch->passed[j] = passesFilter(batch->objs[j].value());
+                    }
+                    catch (const DBException& e) {
+                        if (batch->status.isOK()) {
+                            batch->status = e.toStatus();
+                        }
+                    }
+                }
+
+                BSONObj& obj = batch->objs[j].value();
+                if (!obj.isOwned()) {
+                    obj = obj.getOwned();
+                }
+                batch->locs[j] = RecordId();
+            }
+        }
+    }
+
+    void ParallelCollectionScan::saveState() {
+        // The workers may not look at a document once the operation gives up its locks, and any
+        // document we haven't returned has to survive the yield.
+        waitForAllBatches();
+        for (size_t i = 0; i < _batches.size(); ++i) {
+            Batch* batch = _batches[i].get();
+            for (size_t j = batch->nextResult; j < batch->objs.size(); ++j) {
+                BSONObj& obj = batch->objs[j].value();
+                if (!obj.isOwned()) {
+                    obj = obj.getOwned();
+                }
+            }
+        }
+
+        _txn = NULL;
+        ++_commonStats.yields;
+        if (NULL != _iter) {
+            _iter->saveState();
+        }
+    }
+
+    void ParallelCollectionScan::restoreState(OperationContext* opCtx) {
+        invariant(_txn == NULL);
+        _txn = opCtx;
+        ++_commonStats.unyields;
+        if (NULL != _iter) {
+            if (!_iter->restoreState(opCtx)) {
+                warning() << "Collection dropped or state deleted during yield of "
+                          << "ParallelCollectionScan: " << opCtx->getNS();
+                _isDead = true;
+            }
+        }
+    }
+
+    vector<PlanStage*> ParallelCollectionScan::getChildren() const {
+        vector<PlanStage*> empty;
+        return empty;
+    }
+
+    PlanStageStats* ParallelCollectionScan::getStats() {
+        _commonStats.isEOF = isEOF();
+
+        // Add a BSON representation of the filter to the stats tree, if there is one.
+        if (NULL != _filter) {
+            BSONObjBuilder bob;
+            _filter->toBSON(&bob);
+            _commonStats.filter = bob.obj();
+        }
+
+        auto_ptr<PlanStageStats> ret(new PlanStageStats(_commonStats, STAGE_PARALLEL_COLLSCAN));
+        ret->specific.reset(new ParallelCollectionScanStats(_specificStats));
+        return ret.release();
+    }
+
+    const CommonStats* ParallelCollectionScan::getCommonStats() const {
+        return &_commonStats;
+    }
+
+    const SpecificStats* ParallelCollectionScan::getSpecificStats() const {
+        return &_specificStats;
+    }
+
+}  // namespace mongo
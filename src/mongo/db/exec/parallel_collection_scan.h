@@ -0,0 +1,206 @@
+/**
+ *    Copyright (C) 2013-2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <deque>
+#include <vector>
+
+#include "mongo/db/exec/collection_scan_common.h"
+#include "mongo/db/exec/plan_stage.h"
+#include "mongo/db/matcher/expression.h"
+#include "mongo/db/matcher/expression_compiled.h"
+#include "mongo/db/record_id.h"
+#include "mongo/db/storage/snapshot.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+
+namespace mongo {
+
+    class RecordIterator;
+    class WorkingSet;
+    class OperationContext;
+
+    /**
+     * A collection scan which runs its filter on a pool of worker threads.
+     *
+     * The records are read on the operation's own thread, since a RecordIterator and the
+     * RecoveryUnit under it may only be used by the thread which owns the OperationContext, and
+     * are cut into batches.  Each batch is filtered by a worker while the next ones are read,
+     * and the documents which pass are returned in the order they were read, so the results are
+     * exactly those of a CollectionScan with the same params and filter.
+     *
+     * The workers come from a pool shared by all parallel scans, 'numThreads' only caps how
+     * many of this scan's batches are in flight.
+     *
+     * No batch is being filtered while the stage is yielded: saveState() waits for the workers
+     * and takes owned copies of any documents not yet returned.  A document updated during the
+     * yield is copied and filtered again by invalidate(), and returned without its loc.
+     *
+     * Only filters which are safe to evaluate concurrently are allowed, see canParallelize().
+     * Tailable scans are not supported.
+     */
+    class ParallelCollectionScan : public PlanStage {
+    public:
+        ParallelCollectionScan(OperationContext* txn,
+                               const CollectionScanParams& params,
+                               WorkingSet* workingSet,
+                               const MatchExpression* filter,
+                               size_t numThreads);
+
+        virtual ~ParallelCollectionScan();
+
+        /**
+         * Returns true if 'filter' may be matched by several threads at once, which rules out
+         * $where since it runs in a JS scope that belongs to the operation.
+         */
+        static bool canParallelize(const MatchExpression* filter);
+
+        virtual StageState work(WorkingSetID* out);
+        virtual bool isEOF();
+
+        virtual void invalidate(OperationContext* txn, const RecordId& dl, InvalidationType type);
+        virtual void saveState();
+        virtual void restoreState(OperationContext* opCtx);
+
+        virtual std::vector<PlanStage*> getChildren() const;
+
+        virtual StageType stageType() const { return STAGE_PARALLEL_COLLSCAN; }
+
+        virtual PlanStageStats* getStats();
+
+        virtual const CommonStats* getCommonStats() const;
+
+        virtual const SpecificStats* getSpecificStats() const;
+
+        static const char* kStageType;
+
+        // How many records are read into a batch before it is handed to a worker.
+        static const size_t kBatchSize = 512;
+
+    private:
+        /**
+         * Records read together and filtered by one worker.  Only 'done' is shared with the
+         * worker after the batch is scheduled, the rest belongs to whichever thread has it.
+         */
+        struct Batch {
+            Batch() : status(Status::OK()), done(false), nextResult(0) { }
+
+            // A null loc means the record was deleted or changed after it was read.
+            std::vector<RecordId> locs;
+            std::vector<Snapshotted<BSONObj> > objs;
+
+            // Set by the filter, one per record.
+            std::vector<char> passed;
+            Status status;
+
+            // Guarded by _mutex.
+            bool done;
+
+            // Position of the next record to consider returning.
+            size_t nextResult;
+        };
+        typedef boost::shared_ptr<Batch> BatchPtr;
+
+        /**
+         * Reads up to kBatchSize records into _filling.  Returns NEED_TIME unless the iterator
+         * asked us to yield.
+         */
+        StageState readBatch(WorkingSetID* out);
+
+        /**
+         * Hands _filling to a worker, or filters it right here if it's the only batch.
+         */
+        void dispatchBatch();
+
+        /**
+         * Filters 'batch' on a worker thread and marks it done.
+         */
+        void runBatch(BatchPtr batch);
+
+        /**
+         * Sets 'passed' for each record in 'batch'.
+         */
+        void filterBatch(Batch* batch) const;
+
+        /**
+         * Matches 'obj' against the filter.  Safe to call from any thread.
+         */
+        bool passesFilter(const BSONObj& obj) const;
+
+        /**
+         * Waits until every scheduled batch is done.
+         */
+        void waitForAllBatches();
+
+        // transactional context for read locks. Not owned by us
+        OperationContext* _txn;
+
+        // WorkingSet is not owned by us.
+        WorkingSet* _workingSet;
+
+        // The filter is not owned by us.
+        const MatchExpression* _filter;
+
+        // Shared by the workers, each only calls the const matchesBSON().
+        boost::scoped_ptr<CompiledMatchExpression> _compiledFilter;
+
+        boost::scoped_ptr<RecordIterator> _iter;
+
+        CollectionScanParams _params;
+
+        bool _isDead;
+
+        // Set once the iterator is exhausted or maxScan is reached.
+        bool _doneReading;
+
+        // The batch being read.
+        BatchPtr _filling;
+
+        // Batches handed to workers or already filtered, oldest first.  The front one is where
+        // results come from.
+        std::deque<BatchPtr> _batches;
+
+        const size_t _numThreads;
+
+        // We allocate a working set member with this id on construction of the stage. It gets
+        // used for all fetch requests, changing the RecordId as appropriate.
+        const WorkingSetID _wsidForFetch;
+
+        // Guards Batch::done.
+        stdx::mutex _mutex;
+        stdx::condition_variable _batchDone;
+
+        // Stats
+        CommonStats _commonStats;
+        ParallelCollectionScanStats _specificStats;
+    };
+
+}  // namespace mongo
@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "mongo/db/exec/plan_stats.h"
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/invalidation_type.h"
@@ -184,6 +186,28 @@ namespace mongo {
          */
         virtual StageState work(WorkingSetID* out) = 0;
 
+        /**
+         * Perform up to 'maxWorks' units of work, as if by calling work() that many times, and
+         * append every result produced to 'out'.  The caller must free the results, just as for
+         * ADVANCED.
+         *
+         * Returns NEED_TIME once all 'maxWorks' units are done.  A unit of work which returns
+         * anything other than ADVANCED or NEED_TIME ends the batch early: that state is returned
+         * and *stateOut is set as work() would have set its out parameter.  The results in 'out'
+         * were produced before that state and should be consumed first.
+         *
+         * The default calls work() in a loop.  Stages on the path of simple scans implement this
+         * directly, timing the whole batch at once and asking their child for a batch in a single
+         * call.  Such a stage only counts works for the child results and final state it sees.
+         */
+        virtual StageState workBatch(size_t maxWorks,
+                                     std::vector<WorkingSetID>* out,
+                                     WorkingSetID* stateOut) {
+            return runBatch(maxWorks, out, stateOut, [this](WorkingSetID* id) {
+                return work(id);
+            });
+        }
+
         /**
          * Returns true if no more work can be done on the query / out of results.
          */
@@ -283,6 +307,31 @@ namespace mongo {
          */
         virtual const SpecificStats* getSpecificStats() const = 0;
 
+    protected:
+        /**
+         * Calls 'workOne' up to 'maxWorks' times, collecting results and stopping early with the
+         * semantics of workBatch().  'workOne' is a callable taking a WorkingSetID* and returning
+         * a StageState, like work().
+         */
+        template <typename WorkOne>
+        static StageState runBatch(size_t maxWorks,
+                                   std::vector<WorkingSetID>* out,
+                                   WorkingSetID* stateOut,
+                                   const WorkOne& workOne) {
+            for (size_t i = 0; i < maxWorks; ++i) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                const StageState state = workOne(&id);
+                if (ADVANCED == state) {
+                    out->push_back(id);
+                }
+                else if (NEED_TIME != state) {
+                    *stateOut = id;
+                    return state;
+                }
+            }
+            return NEED_TIME;
+        }
+
     };
 
 }  // namespace mongo
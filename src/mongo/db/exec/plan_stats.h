@@ -147,7 +147,9 @@ namespace mongo {
         AndHashStats() : flaggedButPassed(0),
                          flaggedInProgress(0),
                          memUsage(0),
-                         memLimit(0) { }
+                         memLimit(0),
+                         spills(0),
+                         spilledBytes(0) { }
 
         virtual ~AndHashStats() { }
 
@@ -176,6 +178,12 @@ namespace mongo {
 
         // What's our memory limit?
         size_t memLimit;
+
+        // How many times did the intersection outgrow the memory limit and move to disk?
+        size_t spills;
+
+        // How many bytes of RecordIds and results went to the sorters after that?
+        size_t spilledBytes;
     };
 
     struct AndSortedStats : public SpecificStats {
@@ -219,6 +227,25 @@ namespace mongo {
         int direction;
     };
 
+    struct ParallelCollectionScanStats : public CollectionScanStats {
+        ParallelCollectionScanStats() : numThreads(0), batches(0), batchesFilteredInline(0) { }
+
+        virtual SpecificStats* clone() const {
+            ParallelCollectionScanStats* specific = new ParallelCollectionScanStats(*this);
+            return specific;
+        }
+
+        // How many batches may be with the shared workers at once, counted in threads?
+        size_t numThreads;
+
+        // How many batches of records were read?
+        size_t batches;
+
+        // How many of those were filtered on the operation's own thread, because the scan
+        // fit in a single batch?
+        size_t batchesFilteredInline;
+    };
+
     struct CountStats : public SpecificStats {
         CountStats() : nCounted(0), nSkipped(0), trivialCount(false) { }
 
@@ -359,7 +386,9 @@ namespace mongo {
                            dupsTested(0),
                            dupsDropped(0),
                            seenInvalidated(0),
-                           keysExamined(0) { }
+                           keysExamined(0),
+                           seeks(0),
+                           estimatedKeysExamined(-1) { }
 
         virtual ~IndexScanStats() { }
 
@@ -401,6 +430,15 @@ namespace mongo {
         // Number of entries retrieved from the index during the scan.
         size_t keysExamined;
 
+        // Number of times the bounds sent the cursor forward past keys it didn't need to look at.
+        // A scan which skips over the values of a leading field does this about twice per value.
+        size_t seeks;
+
+        // Number of entries the multi plan runner expected the scan to examine before ranking
+        // it, or -1 if it didn't estimate.  Estimates stop at
+        // internalQueryPlanEvaluationEstimateMaxKeys.
+        long long estimatedKeysExamined;
+
     };
 
     struct LimitStats : public SpecificStats {
@@ -462,7 +500,7 @@ namespace mongo {
     };
 
     struct SortStats : public SpecificStats {
-        SortStats() : forcedFetches(0), memUsage(0), memLimit(0) { }
+        SortStats() : forcedFetches(0), memUsage(0), memLimit(0), spills(0), spilledBytes(0) { }
 
         virtual ~SortStats() { }
 
@@ -480,6 +518,12 @@ namespace mongo {
         // What's our memory limit?
         size_t memLimit;
 
+        // How many sorted runs did we write to disk after running out of memory?
+        size_t spills;
+
+        // How many bytes of documents and sort keys went into those runs, before compression?
+        size_t spilledBytes;
+
         // The number of results to return from the sort.
         size_t limit;
 
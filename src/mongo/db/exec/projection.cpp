@@ -76,6 +76,17 @@ namespace mongo {
             // Figure out what fields are in the projection.
             getSimpleInclusionFields(_projObj, &_includedFields);
 
+            // The simple inclusion of whole documents only looks at top level fields, so dotted
+            // fields take the general path for documents.
+            for (FieldSet::const_iterator it = _includedFields.begin();
+                 it != _includedFields.end();
+                 ++it) {
+                if (std::string::npos != it->find('.')) {
+                    _exec.reset(new ProjectionExec(params.projObj, NULL, *params.whereCallback));
+                    break;
+                }
+            }
+
             // If we're pulling data out of one index we can pre-compute the indices of the fields
             // in the key that we pull data from and avoid looking up the field name each time.
             if (ProjectionStageParams::COVERED_ONE_INDEX == params.projImpl) {
@@ -169,6 +180,11 @@ namespace mongo {
             // If we got here because of SIMPLE_DOC the planner shouldn't have messed up.
             invariant(member->hasObj());
 
+            if (_exec) {
+                // Dotted fields.
+                return _exec->transform(member);
+            }
+
             // Apply the SIMPLE_DOC projection.
             transformSimpleInclusion(member->obj.value(), _includedFields, bob);
         }
@@ -179,16 +195,25 @@ namespace mongo {
             size_t keyIndex = 0;
 
             // Look at every key element...
+            ProjectionExec::DottedFieldValues values;
             BSONObjIterator keyIterator(member->keyData[0].keyData);
             while (keyIterator.more()) {
                 BSONElement elt = keyIterator.next();
                 // If we're supposed to include it...
                 if (_includeKey[keyIndex]) {
                     // Do so.
-                    bob.appendAs(elt, _keyFieldNames[keyIndex]);
+                    if (_exec) {
+                        // Dotted fields have to be nested, so gather them first.
+                        values.push_back(std::make_pair(_keyFieldNames[keyIndex], elt));
+                    }
+                    else {
+                        bob.appendAs(elt, _keyFieldNames[keyIndex]);
+                    }
                 }
                 ++keyIndex;
             }
+
+            ProjectionExec::appendDottedFields(values, &bob);
         }
 
         member->state = WorkingSetMember::OWNED_OBJ;
@@ -250,6 +275,56 @@ namespace mongo {
         return status;
     }
 
+    PlanStage::StageState ProjectionStage::workBatch(size_t maxWorks,
+                                                     vector<WorkingSetID>* out,
+                                                     WorkingSetID* stateOut) {
+        // One timer for the whole batch.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        const size_t numBefore = out->size();
+        StageState status = _child->workBatch(maxWorks, out, stateOut);
+
+        for (size_t i = numBefore; i < out->size(); ++i) {
+            ++_commonStats.works;
+
+            // Punt to our specific projection impl.
+            Status projStatus = transform(_ws->get((*out)[i]));
+            if (!projStatus.isOK()) {
+                warning() << "Couldn't execute projection, status = "
+                          << projStatus.toString() << endl;
+
+                // The results before this one stand, the rest of the batch is dropped.
+                for (size_t j = i; j < out->size(); ++j) {
+                    _ws->free((*out)[j]);
+                }
+                out->resize(i);
+                *stateOut = WorkingSetCommon::allocateStatusMember(_ws, projStatus);
+                return PlanStage::FAILURE;
+            }
+
+            ++_commonStats.advanced;
+        }
+
+        if (PlanStage::NEED_TIME == status) {
+            return status;
+        }
+
+        ++_commonStats.works;
+        if (PlanStage::FAILURE == status) {
+            if (WorkingSet::INVALID_ID == *stateOut) {
+                mongoutils::str::stream ss;
+                ss << "projection stage failed to read in results from child";
+                Status status(ErrorCodes::InternalError, ss);
+                *stateOut = WorkingSetCommon::allocateStatusMember( _ws, status);
+            }
+        }
+        else if (PlanStage::NEED_YIELD == status) {
+            ++_commonStats.needYield;
+        }
+
+        return status;
+    }
+
     void ProjectionStage::saveState() {
         ++_commonStats.yields;
         _child->saveState();
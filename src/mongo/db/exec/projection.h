@@ -84,6 +84,9 @@ namespace mongo {
 
         virtual bool isEOF();
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks,
+                                     std::vector<WorkingSetID>* out,
+                                     WorkingSetID* stateOut);
 
         virtual void saveState();
         virtual void restoreState(OperationContext* opCtx);
@@ -124,6 +127,8 @@ namespace mongo {
     private:
         Status transform(WorkingSetMember* member);
 
+        // Used by NO_FAST_PATH, and by the fast paths for documents if the projection has dotted
+        // fields.
         boost::scoped_ptr<ProjectionExec> _exec;
 
         // _ws is not owned by us.
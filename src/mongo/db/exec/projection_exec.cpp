@@ -47,7 +47,6 @@ namespace mongo {
           _limit(-1),
           _arrayOpType(ARRAY_OP_NORMAL),
           _hasNonSimple(false),
-          _hasDottedField(false),
           _queryExpression(NULL),
           _hasReturnKey(false) { }
 
@@ -63,7 +62,6 @@ namespace mongo {
           _limit(-1),
           _arrayOpType(ARRAY_OP_NORMAL),
           _hasNonSimple(false),
-          _hasDottedField(false),
           _queryExpression(queryExpression),
           _hasReturnKey(false) {
 
@@ -160,11 +158,6 @@ namespace mongo {
             else {
                 add(e.fieldName(), e.trueValue());
 
-                // Projections of dotted fields aren't covered.
-                if (mongoutils::str::contains(e.fieldName(), '.')) {
-                    _hasDottedField = true;
-                }
-
                 // Validate input.
                 if (include_exclude == -1) {
                     // If we haven't specified an include/exclude, initialize include_exclude.
@@ -180,6 +173,39 @@ namespace mongo {
         }
     }
 
+    // static
+    void ProjectionExec::appendDottedFields(const DottedFieldValues& fields,
+                                            BSONObjBuilder* bob) {
+        std::vector<bool> appended(fields.size(), false);
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (appended[i]) {
+                continue;
+            }
+
+            const StringData path = fields[i].first;
+            const size_t dot = path.find('.');
+            if (string::npos == dot) {
+                bob->appendAs(fields[i].second, path);
+                continue;
+            }
+
+            // Gather the rest of the paths of every field under the same first component.
+            const StringData prefix = path.substr(0, dot + 1);
+            DottedFieldValues subFields;
+            for (size_t j = i; j < fields.size(); ++j) {
+                if (!appended[j] && fields[j].first.startsWith(prefix)) {
+                    subFields.push_back(std::make_pair(fields[j].first.substr(prefix.size()),
+                                                       fields[j].second));
+                    appended[j] = true;
+                }
+            }
+
+            BSONObjBuilder subBob(bob->subobjStart(path.substr(0, dot)));
+            appendDottedFields(subFields, &subBob);
+            subBob.doneFast();
+        }
+    }
+
     ProjectionExec::~ProjectionExec() {
         for (FieldMap::const_iterator it = _fields.begin(); it != _fields.end(); ++it) {
             delete it->second;
@@ -273,11 +299,12 @@ namespace mongo {
         else {
             verify(!requiresDocument());
             // Go field by field.
+            DottedFieldValues values;
             if (_includeID) {
                 BSONElement elt;
                 // Sometimes the _id field doesn't exist...
                 if (member->getFieldDotted("_id", &elt) && !elt.eoo()) {
-                    bob.appendAs(elt, "_id");
+                    values.push_back(std::make_pair(StringData("_id"), elt));
                 }
             }
 
@@ -291,9 +318,11 @@ namespace mongo {
                 BSONElement keyElt;
                 // We can project a field that doesn't exist.  We just ignore it.
                 if (member->getFieldDotted(specElt.fieldName(), &keyElt) && !keyElt.eoo()) {
-                    bob.appendAs(keyElt, specElt.fieldName());
+                    values.push_back(std::make_pair(specElt.fieldNameStringData(), keyElt));
                 }
             }
+
+            appendDottedFields(values, &bob);
         }
 
         for (MetaMap::const_iterator it = _meta.begin(); it != _meta.end(); ++it) {
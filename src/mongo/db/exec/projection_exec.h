@@ -86,6 +86,16 @@ namespace mongo {
          */
         Status transform(const BSONObj& in, BSONObj* out) const;
 
+        typedef std::vector<std::pair<StringData, BSONElement> > DottedFieldValues;
+
+        /**
+         * Appends the values in 'fields' to 'bob' under their paths, which may be dotted, so
+         * that {'a.b': 1, 'a.c': 2, d: 3} becomes {a: {b: 1, c: 2}, d: 3}.  Fields are appended
+         * in the order in which their first path component first appears.  No path may be a
+         * prefix of another.
+         */
+        static void appendDottedFields(const DottedFieldValues& fields, BSONObjBuilder* bob);
+
     private:
         //
         // Initialization
@@ -131,7 +141,7 @@ namespace mongo {
          * Is the full document required to compute this projection?
          */
         bool requiresDocument() const {
-            return _include || _hasNonSimple || _hasDottedField;
+            return _include || _hasNonSimple || ARRAY_OP_POSITIONAL == _arrayOpType;
         }
 
         /**
@@ -184,9 +194,6 @@ namespace mongo {
         // Is there an slice, elemMatch or meta operator?
         bool _hasNonSimple;
 
-        // Is there a projection over a dotted field or a $ positional operator?
-        bool _hasDottedField;
-
         // The full query expression.  Used when we need MatchDetails.
         const MatchExpression* _queryExpression;
 
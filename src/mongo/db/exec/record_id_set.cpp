@@ -0,0 +1,179 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/db/exec/record_id_set.h"
+
+#include <algorithm>
+
+#include "mongo/util/assert_util.h"
+
+namespace {
+
+    const int64_t kEmpty = mongo::RecordId().repr();
+    const int64_t kErased = mongo::RecordId::min().repr();
+
+    const size_t kMinCapacity = 16;
+
+    /**
+     * RecordIds are often handed out in sequence, so mix all the bits into the low ones that
+     * pick the slot.  This is the finalizer of MurmurHash3.
+     */
+    inline uint64_t hashRepr(int64_t repr) {
+        uint64_t h = static_cast<uint64_t>(repr);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+} // namespace
+
+namespace mongo {
+
+    RecordIdSet::RecordIdSet() : _size(0), _used(0) { }
+
+    bool RecordIdSet::insert(const RecordId& id) {
+        const int64_t repr = id.repr();
+        invariant(repr != kEmpty && repr != kErased);
+
+        // Keep the table at most 3/4 full, counting erased slots.
+        if (4 * (_used + 1) > 3 * _slots.size()) {
+            size_t capacity = std::max(kMinCapacity, _slots.size());
+            while (2 * (_size + 1) > capacity) {
+                capacity *= 2;
+            }
+            rehash(capacity);
+        }
+
+        size_t firstErased;
+        const size_t pos = find(repr, &firstErased);
+        if (_slots[pos] == repr) {
+            return false;
+        }
+
+        if (firstErased != _slots.size()) {
+            _slots[firstErased] = repr;
+        }
+        else {
+            _slots[pos] = repr;
+            ++_used;
+        }
+        ++_size;
+        return true;
+    }
+
+    bool RecordIdSet::contains(const RecordId& id) const {
+        if (_slots.empty()) {
+            return false;
+        }
+        return _slots[find(id.repr(), NULL)] == id.repr();
+    }
+
+    bool RecordIdSet::erase(const RecordId& id) {
+        if (_slots.empty()) {
+            return false;
+        }
+        const size_t pos = find(id.repr(), NULL);
+        if (_slots[pos] != id.repr()) {
+            return false;
+        }
+        _slots[pos] = kErased;
+        --_size;
+        return true;
+    }
+
+    void RecordIdSet::clear() {
+        std::vector<int64_t>().swap(_slots);
+        _size = 0;
+        _used = 0;
+    }
+
+    void RecordIdSet::swap(RecordIdSet& other) {
+        _slots.swap(other._slots);
+        std::swap(_size, other._size);
+        std::swap(_used, other._used);
+    }
+
+    size_t RecordIdSet::find(int64_t repr, size_t* firstErased) const {
+        const size_t mask = _slots.size() - 1;
+        if (firstErased) {
+            *firstErased = _slots.size();
+        }
+
+        // The table always has an empty slot, so this finishes.
+        for (size_t pos = hashRepr(repr) & mask; ; pos = (pos + 1) & mask) {
+            const int64_t slot = _slots[pos];
+            if (slot == repr || slot == kEmpty) {
+                return pos;
+            }
+            if (slot == kErased && firstErased && *firstErased == _slots.size()) {
+                *firstErased = pos;
+            }
+        }
+    }
+
+    void RecordIdSet::rehash(size_t capacity) {
+        std::vector<int64_t> old(capacity, kEmpty);
+        old.swap(_slots);
+
+        const size_t mask = capacity - 1;
+        for (size_t i = 0; i < old.size(); ++i) {
+            if (old[i] == kEmpty || old[i] == kErased) {
+                continue;
+            }
+            size_t pos = hashRepr(old[i]) & mask;
+            while (_slots[pos] != kEmpty) {
+                pos = (pos + 1) & mask;
+            }
+            _slots[pos] = old[i];
+        }
+        _used = _size;
+    }
+
+    RecordIdSet::const_iterator::const_iterator(const std::vector<int64_t>* slots, size_t pos)
+        : _slots(slots),
+          _pos(pos) {
+        skipFree();
+    }
+
+    RecordIdSet::const_iterator& RecordIdSet::const_iterator::operator++() {
+        ++_pos;
+        skipFree();
+        return *this;
+    }
+
+    void RecordIdSet::const_iterator::skipFree() {
+        while (_pos < _slots->size() && ((*_slots)[_pos] == kEmpty ||
+                                         (*_slots)[_pos] == kErased)) {
+            ++_pos;
+        }
+    }
+
+}  // namespace mongo
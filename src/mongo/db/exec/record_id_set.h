@@ -0,0 +1,127 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/record_id.h"
+
+namespace mongo {
+
+    /**
+     * A set of RecordIds stored in one flat open-addressing table, for stages which have to
+     * remember a lot of RecordIds and nothing else.  Each id costs a single slot of 8 bytes and
+     * the table is kept at most 3/4 full, where unordered_set<RecordId> would spend a separately
+     * allocated node per id.
+     *
+     * The null RecordId and RecordId::min() are used to mark empty and erased slots, so they
+     * can't be stored.  Erasing doesn't shrink the table.
+     */
+    class RecordIdSet {
+        MONGO_DISALLOW_COPYING(RecordIdSet);
+    public:
+        RecordIdSet();
+
+        /**
+         * Returns false if 'id' was already in the set.
+         */
+        bool insert(const RecordId& id);
+
+        bool contains(const RecordId& id) const;
+
+        /**
+         * Returns false if 'id' wasn't in the set.
+         */
+        bool erase(const RecordId& id);
+
+        /**
+         * Removes every id and frees the table.
+         */
+        void clear();
+
+        void swap(RecordIdSet& other);
+
+        size_t size() const { return _size; }
+        bool empty() const { return 0 == _size; }
+
+        /**
+         * The number of bytes used by the table.
+         */
+        size_t memUsage() const { return _slots.size() * sizeof(int64_t); }
+
+        /**
+         * Visits the ids in the set in no particular order.  The set must not be modified while
+         * iterating.
+         */
+        class const_iterator {
+        public:
+            const_iterator& operator++();
+            RecordId operator*() const { return RecordId((*_slots)[_pos]); }
+            bool operator==(const const_iterator& other) const { return _pos == other._pos; }
+            bool operator!=(const const_iterator& other) const { return _pos != other._pos; }
+
+        private:
+            friend class RecordIdSet;
+            const_iterator(const std::vector<int64_t>* slots, size_t pos);
+
+            // Moves forward to the first occupied slot at or after _pos.
+            void skipFree();
+
+            const std::vector<int64_t>* _slots;
+            size_t _pos;
+        };
+
+        const_iterator begin() const { return const_iterator(&_slots, 0); }
+        const_iterator end() const { return const_iterator(&_slots, _slots.size()); }
+
+    private:
+        /**
+         * Returns the slot holding 'repr', or the first free slot it would go in.  If 'repr' is
+         * missing and 'firstErased' is not NULL, it is set to the first erased slot on the way,
+         * or to the table size if there was none.
+         */
+        size_t find(int64_t repr, size_t* firstErased) const;
+
+        /**
+         * Rehashes into a table with 'capacity' slots, which must be a power of two.
+         */
+        void rehash(size_t capacity);
+
+        // Reprs of the ids, or kEmpty or kErased.  The size is zero or a power of two.
+        std::vector<int64_t> _slots;
+
+        // Number of ids in the set.
+        size_t _size;
+
+        // Number of slots that are not kEmpty, which is what bounds the probe sequences.
+        size_t _used;
+    };
+
+}  // namespace mongo
@@ -0,0 +1,137 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+/**
+ * This file contains tests for mongo/db/exec/record_id_set.cpp
+ */
+
+#include <set>
+
+#include "mongo/db/exec/record_id_set.h"
+#include "mongo/unittest/unittest.h"
+
+using namespace mongo;
+
+namespace {
+
+    TEST(RecordIdSetTest, Empty) {
+        RecordIdSet set;
+        ASSERT(set.empty());
+        ASSERT_EQUALS(0U, set.size());
+        ASSERT_EQUALS(0U, set.memUsage());
+        ASSERT(!set.contains(RecordId(1)));
+        ASSERT(!set.erase(RecordId(1)));
+        ASSERT(set.begin() == set.end());
+    }
+
+    TEST(RecordIdSetTest, InsertContainsErase) {
+        RecordIdSet set;
+        ASSERT(set.insert(RecordId(5)));
+        ASSERT(!set.insert(RecordId(5)));
+        ASSERT(set.insert(RecordId(0, 8)));
+        ASSERT_EQUALS(2U, set.size());
+
+        ASSERT(set.contains(RecordId(5)));
+        ASSERT(set.contains(RecordId(0, 8)));
+        ASSERT(!set.contains(RecordId(6)));
+
+        ASSERT(set.erase(RecordId(5)));
+        ASSERT(!set.erase(RecordId(5)));
+        ASSERT(!set.contains(RecordId(5)));
+        ASSERT(set.contains(RecordId(0, 8)));
+        ASSERT_EQUALS(1U, set.size());
+
+        // An erased id can come back.
+        ASSERT(set.insert(RecordId(5)));
+        ASSERT(set.contains(RecordId(5)));
+        ASSERT_EQUALS(2U, set.size());
+    }
+
+    TEST(RecordIdSetTest, GrowAndIterate) {
+        RecordIdSet set;
+        for (int64_t i = 1; i <= 10000; ++i) {
+            ASSERT(set.insert(RecordId(i)));
+        }
+        ASSERT_EQUALS(10000U, set.size());
+        // One 8 byte slot per id, at most half full after growing.
+        ASSERT_LESS_THAN_OR_EQUALS(set.memUsage(), 4 * 10000 * sizeof(int64_t));
+
+        for (int64_t i = 2; i <= 10000; i += 2) {
+            ASSERT(set.erase(RecordId(i)));
+        }
+
+        std::set<int64_t> seen;
+        for (RecordIdSet::const_iterator it = set.begin(); it != set.end(); ++it) {
+            ASSERT(seen.insert((*it).repr()).second);
+        }
+        ASSERT_EQUALS(5000U, seen.size());
+        ASSERT_EQUALS(1, *seen.begin());
+        ASSERT_EQUALS(9999, *seen.rbegin());
+        for (std::set<int64_t>::const_iterator it = seen.begin(); it != seen.end(); ++it) {
+            ASSERT(*it % 2 == 1);
+        }
+    }
+
+    // Erased slots are reclaimed rather than filling up the table.
+    TEST(RecordIdSetTest, ChurnDoesNotGrow) {
+        RecordIdSet set;
+        for (int64_t i = 1; i <= 100; ++i) {
+            set.insert(RecordId(i));
+        }
+        const size_t memUsage = set.memUsage();
+        for (int64_t i = 101; i <= 100000; ++i) {
+            ASSERT(set.erase(RecordId(i - 100)));
+            ASSERT(set.insert(RecordId(i)));
+        }
+        ASSERT_EQUALS(100U, set.size());
+        ASSERT_EQUALS(memUsage, set.memUsage());
+        ASSERT(set.contains(RecordId(100000)));
+        ASSERT(!set.contains(RecordId(99900)));
+    }
+
+    TEST(RecordIdSetTest, ClearAndSwap) {
+        RecordIdSet a;
+        RecordIdSet b;
+        a.insert(RecordId(1));
+        a.insert(RecordId(2));
+        b.insert(RecordId(3));
+
+        a.swap(b);
+        ASSERT_EQUALS(1U, a.size());
+        ASSERT(a.contains(RecordId(3)));
+        ASSERT_EQUALS(2U, b.size());
+        ASSERT(b.contains(RecordId(1)));
+
+        b.clear();
+        ASSERT(b.empty());
+        ASSERT_EQUALS(0U, b.memUsage());
+        ASSERT(!b.contains(RecordId(1)));
+        ASSERT(b.insert(RecordId(1)));
+    }
+
+}  // namespace
@@ -94,6 +94,48 @@ namespace mongo {
         return status;
     }
 
+    PlanStage::StageState SkipStage::workBatch(size_t maxWorks,
+                                               vector<WorkingSetID>* out,
+                                               WorkingSetID* stateOut) {
+        // One timer for the whole batch.
+        ScopedTimer timer(&_commonStats.executionTimeMillis);
+
+        const size_t numBefore = out->size();
+        StageState status = _child->workBatch(maxWorks, out, stateOut);
+
+        // Drop the results we're still skipping from the front of the child's batch.
+        const size_t numResults = out->size() - numBefore;
+        const size_t numSkipped = std::min(numResults, static_cast<size_t>(_toSkip));
+        for (size_t i = 0; i < numSkipped; ++i) {
+            _ws->free((*out)[numBefore + i]);
+        }
+        out->erase(out->begin() + numBefore, out->begin() + numBefore + numSkipped);
+
+        _toSkip -= static_cast<int>(numSkipped);
+        _commonStats.works += numResults;
+        _commonStats.needTime += numSkipped;
+        _commonStats.advanced += numResults - numSkipped;
+
+        if (PlanStage::NEED_TIME == status) {
+            return status;
+        }
+
+        ++_commonStats.works;
+        if (PlanStage::FAILURE == status) {
+            if (WorkingSet::INVALID_ID == *stateOut) {
+                mongoutils::str::stream ss;
+                ss << "skip stage failed to read in results from child";
+                Status status(ErrorCodes::InternalError, ss);
+                *stateOut = WorkingSetCommon::allocateStatusMember( _ws, status);
+            }
+        }
+        else if (PlanStage::NEED_YIELD == status) {
+            ++_commonStats.needYield;
+        }
+
+        return status;
+    }
+
     void SkipStage::saveState() {
         ++_commonStats.yields;
         _child->saveState();
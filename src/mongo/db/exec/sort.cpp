@@ -41,6 +41,7 @@
 #include "mongo/db/query/lite_parsed_query.h"
 #include "mongo/db/query/query_knobs.h"
 #include "mongo/db/query/query_planner.h"
+#include "mongo/db/storage_options.h"
 #include "mongo/util/log.h"
 
 namespace mongo {
@@ -285,6 +286,59 @@ namespace mongo {
         return lhs.loc < rhs.loc;
     }
 
+    SortStage::SpilledDataItem::SpilledDataItem()
+        : hasTextScore(false),
+          textScore(0),
+          hasGeoDistance(false),
+          geoDistance(0) { }
+
+    void SortStage::SpilledDataItem::serializeForSorter(BufBuilder& buf) const {
+        obj.serializeForSorter(buf);
+        loc.serializeForSorter(buf);
+        buf.appendChar(hasTextScore);
+        buf.appendNum(textScore);
+        buf.appendChar(hasGeoDistance);
+        buf.appendNum(geoDistance);
+    }
+
+    // static
+    SortStage::SpilledDataItem SortStage::SpilledDataItem::deserializeForSorter(
+            BufReader& buf,
+            const SorterDeserializeSettings&) {
+        SpilledDataItem item;
+        item.obj = BSONObj::deserializeForSorter(buf, BSONObj::SorterDeserializeSettings());
+        item.loc = RecordId::deserializeForSorter(buf, RecordId::SorterDeserializeSettings());
+        item.hasTextScore = buf.read<char>();
+        item.textScore = buf.read<double>();
+        item.hasGeoDistance = buf.read<char>();
+        item.geoDistance = buf.read<double>();
+        return item;
+    }
+
+    int SortStage::SpilledDataItem::memUsageForSorter() const {
+        return sizeof(SpilledDataItem) + obj.objsize();
+    }
+
+    SortStage::SpilledDataItem SortStage::SpilledDataItem::getOwned() const {
+        SpilledDataItem item(*this);
+        item.obj = obj.getOwned();
+        return item;
+    }
+
+    SortStage::SpilledDataComparator::SpilledDataComparator(BSONObj p)
+      : pattern(p) {
+    }
+
+    int SortStage::SpilledDataComparator::operator()(
+            const std::pair<BSONObj, SpilledDataItem>& lhs,
+            const std::pair<BSONObj, SpilledDataItem>& rhs) const {
+        int result = lhs.first.woCompare(rhs.first, pattern, false);
+        if (0 != result) {
+            return result;
+        }
+        return lhs.second.loc.compare(rhs.second.loc);
+    }
+
     SortStage::SortStage(const SortStageParams& params,
                          WorkingSet* ws,
                          PlanStage* child)
@@ -305,7 +359,10 @@ namespace mongo {
     bool SortStage::isEOF() {
         // We're done when our child has no more results, we've sorted the child's results, and
         // we've returned all sorted results.
-        return _child->isEOF() && _sorted && (_data.end() == _resultIterator);
+        if (!_child->isEOF() || !_sorted) {
+            return false;
+        }
+        return _spilledOutput ? !_spilledOutput->more() : _data.end() == _resultIterator;
     }
 
     PlanStage::StageState SortStage::work(WorkingSetID* out) {
@@ -328,6 +385,18 @@ namespace mongo {
         }
 
         const size_t maxBytes = static_cast<size_t>(internalQueryExecMaxBlockingSortBytes);
+        if (_memUsage > maxBytes && !_sorted && internalQueryExecBlockingSortAllowDiskUse) {
+            try {
+                spill();
+            }
+            catch (const DBException& e) {
+                *out = WorkingSetCommon::allocateStatusMember(_ws, e.toStatus());
+                return PlanStage::FAILURE;
+            }
+            ++_commonStats.needTime;
+            return PlanStage::NEED_TIME;
+        }
+
         if (_memUsage > maxBytes) {
             mongoutils::str::stream ss;
             ss << "Sort operation used more than the maximum " << maxBytes
@@ -379,8 +448,25 @@ namespace mongo {
             else if (PlanStage::IS_EOF == code) {
                 // TODO: We don't need the lock for this.  We could ask for a yield and do this work
                 // unlocked.  Also, this is performing a lot of work for one call to work(...)
-                sortBuffer();
-                _resultIterator = _data.begin();
+                if (!_spilledRuns.empty()) {
+                    // Whatever is still buffered becomes the last run, then we merge them all.
+                    try {
+                        spill();
+                        SpilledDataComparator cmp(_sortKeyGen->getSortComparator());
+                        _spilledOutput.reset(SpilledIterator::merge(_spilledRuns,
+                                                                    SortOptions().Limit(_limit),
+                                                                    cmp));
+                    }
+                    catch (const DBException& e) {
+                        *out = WorkingSetCommon::allocateStatusMember(_ws, e.toStatus());
+                        return PlanStage::FAILURE;
+                    }
+                    _spilledRuns.clear();
+                }
+                else {
+                    sortBuffer();
+                    _resultIterator = _data.begin();
+                }
                 _sorted = true;
                 ++_commonStats.needTime;
                 return PlanStage::NEED_TIME;
@@ -410,6 +496,25 @@ namespace mongo {
         }
 
         // Returning results.
+        if (_spilledOutput) {
+            const std::pair<BSONObj, SpilledDataItem> next = _spilledOutput->next();
+            const SpilledDataItem& item = next.second;
+
+            *out = _ws->allocate();
+            WorkingSetMember* member = _ws->get(*out);
+            member->obj = Snapshotted<BSONObj>(SnapshotId(), item.obj.getOwned());
+            member->state = WorkingSetMember::OWNED_OBJ;
+            if (item.hasTextScore) {
+                member->addComputed(new TextScoreComputedData(item.textScore));
+            }
+            if (item.hasGeoDistance) {
+                member->addComputed(new GeoDistanceComputedData(item.geoDistance));
+            }
+
+            ++_commonStats.advanced;
+            return PlanStage::ADVANCED;
+        }
+
         verify(_resultIterator != _data.end());
         verify(_sorted);
         *out = _resultIterator->wsid;
@@ -593,4 +698,56 @@ namespace mongo {
         }
     }
 
+    void SortStage::spill() {
+        // The buffer is in sorted order after this, and only _data holds it.
+        sortBuffer();
+
+        SortOptions opts;
+        opts.TempDir(storageGlobalParams.dbpath + "/_tmp");
+        SortedFileWriter<BSONObj, SpilledDataItem> writer(opts);
+
+        for (vector<SortableDataItem>::const_iterator it = _data.begin(); it != _data.end(); ++it) {
+            WorkingSetMember* member = _ws->get(it->wsid);
+
+            SpilledDataItem item;
+            item.obj = member->obj.value();
+            item.loc = it->loc;
+            if (member->hasComputed(WSM_COMPUTED_TEXT_SCORE)) {
+                const TextScoreComputedData* score = static_cast<const TextScoreComputedData*>(
+                        member->getComputed(WSM_COMPUTED_TEXT_SCORE));
+                item.hasTextScore = true;
+                item.textScore = score->getScore();
+            }
+            if (member->hasComputed(WSM_COMPUTED_GEO_DISTANCE)) {
+                const GeoDistanceComputedData* dist = static_cast<const GeoDistanceComputedData*>(
+                        member->getComputed(WSM_COMPUTED_GEO_DISTANCE));
+                item.hasGeoDistance = true;
+                item.geoDistance = dist->getDist();
+            }
+
+            writer.addAlreadySorted(it->sortKey, item);
+            _specificStats.spilledBytes += it->sortKey.objsize() + item.obj.objsize();
+
+            // The run has its own copy now, so the result can't be invalidated any more.
+            if (member->hasLoc()) {
+                _wsidByDiskLoc.erase(member->loc);
+            }
+            _ws->free(it->wsid);
+        }
+
+        _spilledRuns.push_back(boost::shared_ptr<SpilledIterator>(writer.done()));
+        ++_specificStats.spills;
+
+        _data.clear();
+        _memUsage = 0;
+        if (_limit > 1) {
+            _dataSet.reset(new SortableDataItemSet(*_sortKeyComparator));
+        }
+    }
+
 }  // namespace mongo
+
+#include "mongo/db/sorter/sorter.cpp"
+MONGO_CREATE_SORTER(mongo::BSONObj,
+                    mongo::SortStage::SpilledDataItem,
+                    mongo::SortStage::SpilledDataComparator);
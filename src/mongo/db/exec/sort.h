@@ -29,6 +29,7 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <vector>
 #include <set>
 
@@ -37,6 +38,7 @@
 #include "mongo/db/jsobj.h"
 #include "mongo/db/query/index_bounds.h"
 #include "mongo/db/record_id.h"
+#include "mongo/db/sorter/sorter.h"
 #include "mongo/platform/unordered_map.h"
 
 
@@ -137,6 +139,11 @@ namespace mongo {
     /**
      * Sorts the input received from the child according to the sort pattern provided.
      *
+     * If internalQueryExecBlockingSortAllowDiskUse is set, buffered results which outgrow
+     * internalQueryExecMaxBlockingSortBytes are written to disk as a sorted run and the runs are
+     * merged once the child is exhausted.  Results read back from disk are owned objects without
+     * a RecordId, as if they had been invalidated.
+     *
      * Preconditions: For each field in 'pattern', all inputs in the child must handle a
      * getFieldDotted for that field.
      */
@@ -240,6 +247,44 @@ namespace mongo {
          */
         void sortBuffer();
 
+        /**
+         * Writes the buffered data to disk as a sorted run and frees it from the working set.
+         */
+        void spill();
+
+        // A buffered result in a sorted run on disk.  Holds an owned copy of the document and
+        // whatever computed data a projection after the sort may ask for.
+        struct SpilledDataItem {
+            SpilledDataItem();
+
+            struct SorterDeserializeSettings {};
+            void serializeForSorter(BufBuilder& buf) const;
+            static SpilledDataItem deserializeForSorter(BufReader& buf,
+                                                        const SorterDeserializeSettings&);
+            int memUsageForSorter() const;
+            SpilledDataItem getOwned() const;
+
+            BSONObj obj;
+            // Only used to break ties between equal sort keys, as for SortableDataItem.
+            RecordId loc;
+            bool hasTextScore;
+            double textScore;
+            bool hasGeoDistance;
+            double geoDistance;
+        };
+
+        // Orders (sort key, item) pairs the same way as WorkingSetComparator.
+        struct SpilledDataComparator {
+            explicit SpilledDataComparator(BSONObj p);
+
+            int operator()(const std::pair<BSONObj, SpilledDataItem>& lhs,
+                           const std::pair<BSONObj, SpilledDataItem>& rhs) const;
+
+            BSONObj pattern;
+        };
+
+        typedef SortIteratorInterface<BSONObj, SpilledDataItem> SpilledIterator;
+
         // Comparator for data buffer
         // Initialization follows sort key generator
         boost::scoped_ptr<WorkingSetComparator> _sortKeyComparator;
@@ -258,6 +303,12 @@ namespace mongo {
         // Iterates through _data post-sort returning it.
         std::vector<SortableDataItem>::iterator _resultIterator;
 
+        // Sorted runs written by spill() which haven't been merged yet.
+        std::vector<boost::shared_ptr<SpilledIterator> > _spilledRuns;
+
+        // Once we have spilled, the results come from merging the runs rather than from _data.
+        boost::scoped_ptr<SpilledIterator> _spilledOutput;
+
         // We buffer a lot of data and we want to look it up by RecordId quickly upon invalidation.
         typedef unordered_map<RecordId, WorkingSetID, RecordId::Hasher> DataMap;
         DataMap _wsidByDiskLoc;
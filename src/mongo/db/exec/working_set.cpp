@@ -203,6 +203,17 @@ namespace mongo {
         return state == LOC_AND_UNOWNED_OBJ;
     }
 
+    void WorkingSetMember::makeObjOwned() {
+        if (hasObj() && !obj.value().isOwned()) {
+            obj.setValue(obj.value().getOwned());
+        }
+        for (size_t i = 0; i < keyData.size(); ++i) {
+            if (!keyData[i].keyData.isOwned()) {
+                keyData[i].keyData = keyData[i].keyData.getOwned();
+            }
+        }
+    }
+
     bool WorkingSetMember::hasComputed(const WorkingSetComputedDataType type) const {
         return _computed[type].get();
     }
@@ -304,6 +304,12 @@ namespace mongo {
         bool hasOwnedObj() const;
         bool hasUnownedObj() const;
 
+        /**
+         * Takes owned copies of the obj and of any index key data, so that nothing in the member
+         * points into storage engine memory.  Leaves the state as it is.
+         */
+        void makeObjOwned();
+
         //
         // Computed data
         //
@@ -149,6 +149,23 @@ namespace {
         ASSERT_FALSE(member->getFieldDotted("y", &elt));
     }
 
+    TEST_F(WorkingSetFixture, makeObjOwned) {
+        BSONObj obj = BSON("x" << 5);
+        member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+        member->obj = Snapshotted<BSONObj>(SnapshotId(), BSONObj(obj.objdata()));
+        BSONObj key = BSON("" << 5);
+        member->keyData.push_back(IndexKeyDatum(BSON("x" << 1), BSONObj(key.objdata()), NULL));
+        ASSERT_FALSE(member->obj.value().isOwned());
+        ASSERT_FALSE(member->keyData[0].keyData.isOwned());
+
+        member->makeObjOwned();
+        ASSERT_EQUALS(WorkingSetMember::LOC_AND_UNOWNED_OBJ, member->state);
+        ASSERT_TRUE(member->obj.value().isOwned());
+        ASSERT_EQUALS(obj, member->obj.value());
+        ASSERT_TRUE(member->keyData[0].keyData.isOwned());
+        ASSERT_EQUALS(key, member->keyData[0].keyData);
+    }
+
     //
     // WorkingSet::iterator tests
     //
@@ -32,8 +32,11 @@
 
 #include "mongo/db/index/btree_access_method.h"
 
+#include <algorithm>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+
 #include "mongo/base/error_codes.h"
 #include "mongo/base/status.h"
 #include "mongo/db/client.h"
@@ -85,6 +88,44 @@ namespace mongo {
         const int _version;
     };
 
+    /**
+     * Orders keys encoded as KeyStrings with memcmp, then by RecordId.  For version 1 indexes
+     * this is the same order as BtreeExternalSortComparison.
+     */
+    class KeyStringExternalSortComparison {
+    public:
+        typedef std::pair<KeyString::Value, RecordId> Data;
+
+        int operator() (const Data& l, const Data& r) const {
+            int x = l.first.compare(r.first);
+            if (x) { return x; }
+            return l.second.compare(r.second);
+        }
+    };
+
+    namespace {
+
+        /**
+         * True if 'path' runs into an array anywhere in 'obj', including at its end.
+         */
+        bool pathHasArray(const BSONObj& obj, StringData path) {
+            BSONObj current = obj;
+            while (true) {
+                size_t dot = path.find('.');
+                BSONElement elt = current.getField(path.substr(0, dot));
+                if (Array == elt.type()) {
+                    return true;
+                }
+                if (std::string::npos == dot || Object != elt.type()) {
+                    return false;
+                }
+                current = elt.embeddedObject();
+                path = path.substr(dot + 1);
+            }
+        }
+
+    }  // namespace
+
     IndexAccessMethod::IndexAccessMethod(IndexCatalogEntry* btreeState,
                                          SortedDataInterface* btree)
         : _btreeState(btreeState),
@@ -93,6 +134,19 @@ namespace mongo {
         verify(0 == _descriptor->version() || 1 == _descriptor->version());
     }
 
+    uint32_t IndexAccessMethod::getMultikeyFields(const BSONObj& obj) const {
+        uint32_t fields = 0;
+        size_t fieldIdx = 0;
+        BSONObjIterator it(_descriptor->keyPattern());
+        while (it.more()) {
+            if (pathHasArray(obj, it.next().fieldNameStringData())) {
+                fields |= 1U << std::min(fieldIdx, size_t(31));
+            }
+            ++fieldIdx;
+        }
+        return fields;
+    }
+
     bool IndexAccessMethod::ignoreKeyTooLong(OperationContext *txn) {
         // Ignore this error if we're on a secondary or if the user requested it
         return !txn->isPrimaryFor(_btreeState->ns()) || !failIndexKeyTooLong;
@@ -144,8 +198,13 @@ namespace mongo {
             return status;
         }
 
+        // A single key may still come from an array, such as { a : [ 5 ] }.
+        const uint32_t multikeyFields = getMultikeyFields(obj);
         if (*numInserted > 1) {
-            _btreeState->setMultikey( txn );
+            _btreeState->setMultikey( txn, multikeyFields );
+        }
+        else if (multikeyFields) {
+            _btreeState->addMultikeyFields( multikeyFields );
         }
 
         return ret;
@@ -281,6 +340,7 @@ namespace mongo {
             getKeys(to, &ticket->newKeys);
         ticket->loc = record;
         ticket->dupsAllowed = options.dupsAllowed;
+        ticket->multikeyFields = ticket->newKeys.empty() ? 0 : getMultikeyFields(to);
 
         setDifference(ticket->oldKeys, ticket->newKeys, &ticket->removed);
         setDifference(ticket->newKeys, ticket->oldKeys, &ticket->added);
@@ -298,7 +358,10 @@ namespace mongo {
         }
 
         if (ticket.oldKeys.size() + ticket.added.size() - ticket.removed.size() > 1) {
-            _btreeState->setMultikey( txn );
+            _btreeState->setMultikey( txn, ticket.multikeyFields );
+        }
+        else if (ticket.multikeyFields) {
+            _btreeState->addMultikeyFields( ticket.multikeyFields );
         }
 
         for (size_t i = 0; i < ticket.removed.size(); ++i) {
@@ -330,17 +393,52 @@ namespace mongo {
 
     std::unique_ptr<IndexAccessMethod::BulkBuilder> IndexAccessMethod::initiateBulk() {
 
-        return std::unique_ptr<BulkBuilder>(new BulkBuilder(this, _descriptor));
+        return std::unique_ptr<BulkBuilder>(new BulkBuilder(this));
+    }
+
+    namespace {
+
+        const size_t kBulkBuilderMaxMemoryUsageBytes = 100*1024*1024;
+
+        SortOptions bulkBuilderSortOptions(size_t maxMemoryUsageBytes) {
+            return SortOptions().TempDir(storageGlobalParams.dbpath + "/_tmp")
+                                .ExtSortAllowed()
+                                .MaxMemoryUsageBytes(maxMemoryUsageBytes);
+        }
+
+    }  // namespace
+
+    IndexAccessMethod::BulkBuilder::BulkBuilder(const IndexAccessMethod* index)
+            : _real(index),
+              _ordering(Ordering::make(index->_descriptor->keyPattern())),
+              _useKeyStrings(index->_descriptor->version() >= 1) {
+        partition(1);
     }
 
-    IndexAccessMethod::BulkBuilder::BulkBuilder(const IndexAccessMethod* index,
-                                                const IndexDescriptor* descriptor)
-            : _sorter(Sorter::make(SortOptions().TempDir(storageGlobalParams.dbpath + "/_tmp")
-                                                .ExtSortAllowed()
-                                                .MaxMemoryUsageBytes(100*1024*1024),
-                                   BtreeExternalSortComparison(descriptor->keyPattern(),
-                                                               descriptor->version())))
-            , _real(index) {
+    void IndexAccessMethod::BulkBuilder::partition(size_t numPartitions) {
+        invariant(numPartitions > 0);
+        for (size_t i = 0; i < _partitions.size(); ++i) {
+            invariant(0 == _partitions[i]->keysInserted);
+        }
+
+        const IndexDescriptor* descriptor = _real->_descriptor;
+        const SortOptions opts = bulkBuilderSortOptions(kBulkBuilderMaxMemoryUsageBytes
+                                                        / numPartitions);
+
+        _partitions.clear();
+        for (size_t i = 0; i < numPartitions; ++i) {
+            std::unique_ptr<Partition> partition(new Partition());
+            if (_useKeyStrings) {
+                partition->keyStringSorter.reset(
+                    KeyStringSorter::make(opts, KeyStringExternalSortComparison()));
+            }
+            else {
+                partition->sorter.reset(
+                    Sorter::make(opts, BtreeExternalSortComparison(descriptor->keyPattern(),
+                                                                   descriptor->version())));
+            }
+            _partitions.push_back(std::move(partition));
+        }
     }
 
     Status IndexAccessMethod::BulkBuilder::insert(OperationContext* txn,
@@ -348,14 +446,36 @@ namespace mongo {
                                                   const RecordId& loc,
                                                   const InsertDeleteOptions& options,
                                                   int64_t* numInserted) {
+        return insertIntoPartition(0, obj, loc, numInserted);
+    }
+
+    Status IndexAccessMethod::BulkBuilder::insertIntoPartition(size_t partition,
+                                                               const BSONObj& obj,
+                                                               const RecordId& loc,
+                                                               int64_t* numInserted) {
+        Partition* const p = _partitions[partition].get();
+
         BSONObjSet keys;
         _real->getKeys(obj, &keys);
 
-        _isMultiKey = _isMultiKey || (keys.size() > 1);
+        if (keys.size() > 1) {
+            p->isMultiKey = true;
+        }
+        if (!keys.empty()) {
+            // A single key may still come from an array, such as { a : [ 5 ] }.
+            p->multikeyFields |= _real->getMultikeyFields(obj);
+        }
 
+        KeyString keyString;
         for (BSONObjSet::iterator it = keys.begin(); it != keys.end(); ++it) {
-            _sorter->add(*it, loc);
-            _keysInserted++;
+            if (_useKeyStrings) {
+                keyString.resetToKey(*it, _ordering);
+                p->keyStringSorter->add(KeyString::Value(keyString), loc);
+            }
+            else {
+                p->sorter->add(*it, loc);
+            }
+            p->keysInserted++;
         }
 
         if (NULL != numInserted) {
@@ -365,38 +485,72 @@ namespace mongo {
         return Status::OK();
     }
 
+    IndexAccessMethod::BulkBuilder::Sorter::Iterator* IndexAccessMethod::BulkBuilder::done() {
+        invariant(!_useKeyStrings);
+        if (1 == _partitions.size()) {
+            return _partitions[0]->sorter->done();
+        }
 
-    Status IndexAccessMethod::commitBulk(OperationContext* txn,
-                                         std::unique_ptr<BulkBuilder> bulk,
-                                         bool mayInterrupt,
-                                         bool dupsAllowed,
-                                         set<RecordId>* dupsToDrop) {
+        // Each partition's run is sorted on its own, merge them into one.
+        std::vector<boost::shared_ptr<Sorter::Iterator> > runs;
+        for (size_t i = 0; i < _partitions.size(); ++i) {
+            runs.push_back(boost::shared_ptr<Sorter::Iterator>(_partitions[i]->sorter->done()));
+        }
 
-        Timer timer;
+        const IndexDescriptor* descriptor = _real->_descriptor;
+        return Sorter::Iterator::merge(runs,
+                                       bulkBuilderSortOptions(kBulkBuilderMaxMemoryUsageBytes),
+                                       BtreeExternalSortComparison(descriptor->keyPattern(),
+                                                                   descriptor->version()));
+    }
 
-        std::unique_ptr<BulkBuilder::Sorter::Iterator> i(bulk->_sorter->done());
+    IndexAccessMethod::BulkBuilder::KeyStringSorter::Iterator*
+    IndexAccessMethod::BulkBuilder::doneKeyStrings() {
+        invariant(_useKeyStrings);
+        if (1 == _partitions.size()) {
+            return _partitions[0]->keyStringSorter->done();
+        }
 
-        stdx::unique_lock<Client> lk(*txn->getClient());
-        ProgressMeterHolder pm(*txn->setMessage_inlock("Index Bulk Build: (2/3) btree bottom up",
-                                                       "Index: (2/3) BTree Bottom Up Progress",
-                                                       bulk->_keysInserted,
-                                                       10));
-        lk.unlock();
+        std::vector<boost::shared_ptr<KeyStringSorter::Iterator> > runs;
+        for (size_t i = 0; i < _partitions.size(); ++i) {
+            runs.push_back(boost::shared_ptr<KeyStringSorter::Iterator>(
+                _partitions[i]->keyStringSorter->done()));
+        }
 
-        std::unique_ptr<SortedDataBuilderInterface> builder;
+        return KeyStringSorter::Iterator::merge(
+            runs,
+            bulkBuilderSortOptions(kBulkBuilderMaxMemoryUsageBytes),
+            KeyStringExternalSortComparison());
+    }
 
-        MONGO_WRITE_CONFLICT_RETRY_LOOP_BEGIN {
-            WriteUnitOfWork wunit(txn);
+    namespace {
 
-            if (bulk->_isMultiKey) {
-                _btreeState->setMultikey( txn );
-            }
+        Status addKeyToBuilder(SortedDataBuilderInterface* builder,
+                               const BSONObj& key,
+                               Ordering ordering,
+                               const RecordId& loc) {
+            return builder->addKey(key, loc);
+        }
 
-            builder.reset(_newInterface->getBulkBuilder(txn, dupsAllowed));
-            wunit.commit();
-        } MONGO_WRITE_CONFLICT_RETRY_LOOP_END(txn, "setting index multikey flag", "");
+        Status addKeyToBuilder(SortedDataBuilderInterface* builder,
+                               const KeyString::Value& key,
+                               Ordering ordering,
+                               const RecordId& loc) {
+            return builder->addKeyString(key, ordering, loc);
+        }
 
-        while (i->more()) {
+    }  // namespace
+
+    template <typename Key>
+    Status IndexAccessMethod::addSortedKeys(OperationContext* txn,
+                                            SortIteratorInterface<Key, RecordId>* it,
+                                            SortedDataBuilderInterface* builder,
+                                            Ordering ordering,
+                                            bool mayInterrupt,
+                                            bool dupsAllowed,
+                                            set<RecordId>* dupsToDrop,
+                                            ProgressMeterHolder* pm) {
+        while (it->more()) {
             if (mayInterrupt) {
                 txn->checkForInterrupt();
             }
@@ -409,8 +563,8 @@ namespace mongo {
             txn->recoveryUnit()->setRollbackWritesDisabled();
 
             // Get the next datum and add it to the builder.
-            BulkBuilder::Sorter::Data d = i->next();
-            Status status = builder->addKey(d.first, d.second);
+            std::pair<Key, RecordId> d = it->next();
+            Status status = addKeyToBuilder(builder, d.first, ordering, d.second);
 
             if (!status.isOK()) {
                 // Overlong key that's OK to skip?
@@ -433,8 +587,69 @@ namespace mongo {
 
             // If we're here either it's a dup and we're cool with it or the addKey went just
             // fine.
-            pm.hit();
+            pm->hit();
+            wunit.commit();
+        }
+
+        return Status::OK();
+    }
+
+    Status IndexAccessMethod::commitBulk(OperationContext* txn,
+                                         std::unique_ptr<BulkBuilder> bulk,
+                                         bool mayInterrupt,
+                                         bool dupsAllowed,
+                                         set<RecordId>* dupsToDrop) {
+
+        Timer timer;
+
+        int64_t keysInserted = 0;
+        bool isMultiKey = false;
+        uint32_t multikeyFields = 0;
+        for (size_t p = 0; p < bulk->_partitions.size(); ++p) {
+            keysInserted += bulk->_partitions[p]->keysInserted;
+            isMultiKey = isMultiKey || bulk->_partitions[p]->isMultiKey;
+            multikeyFields |= bulk->_partitions[p]->multikeyFields;
+        }
+
+        std::unique_ptr<BulkBuilder::Sorter::Iterator> i;
+        std::unique_ptr<BulkBuilder::KeyStringSorter::Iterator> keyStrings;
+        if (bulk->_useKeyStrings) {
+            keyStrings.reset(bulk->doneKeyStrings());
+        }
+        else {
+            i.reset(bulk->done());
+        }
+
+        stdx::unique_lock<Client> lk(*txn->getClient());
+        ProgressMeterHolder pm(*txn->setMessage_inlock("Index Bulk Build: (2/3) btree bottom up",
+                                                       "Index: (2/3) BTree Bottom Up Progress",
+                                                       keysInserted,
+                                                       10));
+        lk.unlock();
+
+        std::unique_ptr<SortedDataBuilderInterface> builder;
+
+        MONGO_WRITE_CONFLICT_RETRY_LOOP_BEGIN {
+            WriteUnitOfWork wunit(txn);
+
+            if (isMultiKey) {
+                _btreeState->setMultikey( txn, multikeyFields );
+            }
+            else if (multikeyFields) {
+                _btreeState->addMultikeyFields( multikeyFields );
+            }
+
+            builder.reset(_newInterface->getBulkBuilder(txn, dupsAllowed));
             wunit.commit();
+        } MONGO_WRITE_CONFLICT_RETRY_LOOP_END(txn, "setting index multikey flag", "");
+
+        Status status = keyStrings
+            ? addSortedKeys(txn, keyStrings.get(), builder.get(), bulk->_ordering,
+                            mayInterrupt, dupsAllowed, dupsToDrop, &pm)
+            : addSortedKeys(txn, i.get(), builder.get(), bulk->_ordering,
+                            mayInterrupt, dupsAllowed, dupsToDrop, &pm);
+        if (!status.isOK()) {
+            return status;
         }
 
         pm.finished();
@@ -455,3 +670,6 @@ namespace mongo {
 
 #include "mongo/db/sorter/sorter.cpp"
 MONGO_CREATE_SORTER(mongo::BSONObj, mongo::RecordId, mongo::BtreeExternalSortComparison);
+MONGO_CREATE_SORTER(mongo::KeyString::Value,
+                    mongo::RecordId,
+                    mongo::KeyStringExternalSortComparison);
@@ -29,6 +29,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "mongo/base/disallow_copying.h"
 #include "mongo/db/index/index_descriptor.h"
@@ -36,12 +37,14 @@
 #include "mongo/db/operation_context.h"
 #include "mongo/db/record_id.h"
 #include "mongo/db/sorter/sorter.h"
+#include "mongo/db/storage/key_string.h"
 #include "mongo/db/storage/sorted_data_interface.h"
 
 namespace mongo {
 
     class BSONObjBuilder;
     class MatchExpression;
+    class ProgressMeterHolder;
     class UpdateTicket;
     struct InsertDeleteOptions;
 
@@ -193,17 +196,57 @@ namespace mongo {
                           const InsertDeleteOptions& options,
                           int64_t* numInserted);
 
+            /**
+             * Splits the builder into 'numPartitions' independent sorted runs which share the
+             * memory budget of the single one, and are merged by commitBulk().  Must be called
+             * before anything is inserted.
+             */
+            void partition(size_t numPartitions);
+
+            size_t numPartitions() const { return _partitions.size(); }
+
+            /**
+             * Like insert(), but the keys go into the run of 'partition'.  Different partitions
+             * may be inserted into concurrently from different threads, as long as each one is
+             * only used by one thread at a time.
+             */
+            Status insertIntoPartition(size_t partition,
+                                       const BSONObj& obj,
+                                       const RecordId& loc,
+                                       int64_t* numInserted);
+
         private:
             friend class IndexAccessMethod;
 
             using Sorter = mongo::Sorter<BSONObj, RecordId>;
 
-            BulkBuilder(const IndexAccessMethod* index, const IndexDescriptor* descriptor);
+            // Sorts keys encoded as KeyStrings by their bytes.
+            using KeyStringSorter = mongo::Sorter<KeyString::Value, RecordId>;
+
+            struct Partition {
+                // Only one of them is used, depending on _useKeyStrings.
+                std::unique_ptr<Sorter> sorter;
+                std::unique_ptr<KeyStringSorter> keyStringSorter;
+                int64_t keysInserted = 0;
+                bool isMultiKey = false;
+                uint32_t multikeyFields = 0;
+            };
+
+            explicit BulkBuilder(const IndexAccessMethod* index);
+
+            /**
+             * Return the sorted keys of all partitions.  Nothing can be inserted afterwards.
+             */
+            Sorter::Iterator* done();
+            KeyStringSorter::Iterator* doneKeyStrings();
 
-            std::unique_ptr<Sorter> _sorter;
+            std::vector<std::unique_ptr<Partition>> _partitions;
             const IndexAccessMethod* _real;
-            int64_t _keysInserted = 0;
-            bool _isMultiKey = false;
+            const Ordering _ordering;
+
+            // Keys are encoded once as KeyStrings and sorted with memcmp, rather than compared
+            // as BSON over and over.  Version 0 indexes don't sort in KeyString order.
+            const bool _useKeyStrings;
         };
 
         /**
@@ -243,11 +286,30 @@ namespace mongo {
         const IndexDescriptor* _descriptor;
 
     private:
+        /**
+         * Returns which fields of the key pattern hold an array in 'obj', in the form of
+         * IndexCatalogEntry::getMultikeyFields().
+         */
+        uint32_t getMultikeyFields(const BSONObj& obj) const;
+
         void removeOneKey(OperationContext* txn,
                           const BSONObj& key,
                           const RecordId& loc,
                           bool dupsAllowed);
 
+        /**
+         * Adds the keys sorted by a BulkBuilder to 'builder', for commitBulk().
+         */
+        template <typename Key>
+        Status addSortedKeys(OperationContext* txn,
+                             SortIteratorInterface<Key, RecordId>* it,
+                             SortedDataBuilderInterface* builder,
+                             Ordering ordering,
+                             bool mayInterrupt,
+                             bool dupsAllowed,
+                             std::set<RecordId>* dupsToDrop,
+                             ProgressMeterHolder* pm);
+
         const std::unique_ptr<SortedDataInterface> _newInterface;
     };
 
@@ -271,6 +333,9 @@ namespace mongo {
 
         RecordId loc;
         bool dupsAllowed;
+
+        // The fields which hold arrays in the new document, if it has any keys.
+        uint32_t multikeyFields;
     };
 
     /**
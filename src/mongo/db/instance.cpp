@@ -1048,24 +1048,90 @@ namespace {
         }
     }
 
+    /**
+     * Returns the end of the run of documents, starting at 'begin', which insertBatch() may
+     * insert in one WriteUnitOfWork, within the same limits as the write commands use.
+     */
+    static size_t endOfInsertBatch(const vector<BSONObj>& objs, size_t begin) {
+        size_t end = begin;
+        int bytes = 0;
+        while (end < objs.size() &&
+               end - begin < Collection::kMaxInsertBatchDocs &&
+               bytes < Collection::kMaxInsertBatchBytes) {
+            bytes += objs[end].objsize();
+            ++end;
+        }
+        return end;
+    }
+
+    /**
+     * Inserts objs[begin, end) in one WriteUnitOfWork.  Returns false, having inserted nothing,
+     * on any error, including a write conflict, so that the caller inserts the documents one at
+     * a time and reports errors for the right one.
+     */
+    bool insertBatch(OperationContext* txn,
+                     OldClientContext& ctx,
+                     const char *ns,
+                     const vector<BSONObj>& objs,
+                     size_t begin,
+                     size_t end) {
+
+        vector<BSONObj> docs;
+        docs.reserve(end - begin);
+        for (size_t i = begin; i < end; i++) {
+            StatusWith<BSONObj> fixed = fixDocumentForInsert( objs[i] );
+            if ( !fixed.isOK() )
+                return false;
+            docs.push_back( fixed.getValue().isEmpty() ? objs[i] : fixed.getValue() );
+        }
+
+        try {
+            WriteUnitOfWork wunit(txn);
+            Collection* collection = ctx.db()->getCollection( ns );
+            if ( !collection )
+                return false;
+
+            if ( !collection->insertDocuments( txn, docs, true ).isOK() )
+                return false;
+            wunit.commit();
+            return true;
+        }
+        catch( const WriteConflictException& e ) {
+            CurOp::get(txn)->debug().writeConflicts++;
+            txn->recoveryUnit()->abandonSnapshot();
+            return false;
+        }
+        catch (const UserException&) {
+            return false;
+        }
+    }
+
     NOINLINE_DECL void insertMulti(OperationContext* txn,
                                    OldClientContext& ctx,
                                    bool keepGoing,
                                    const char *ns,
                                    vector<BSONObj>& objs,
                                    CurOp& op) {
-        size_t i;
-        for (i=0; i<objs.size(); i++){
-            try {
-                checkAndInsert(txn, ctx, ns, objs[i]);
+        size_t i = 0;
+        while (i < objs.size()) {
+            const size_t end = endOfInsertBatch(objs, i);
+            if (end - i > 1 && insertBatch(txn, ctx, ns, objs, i, end)) {
+                i = end;
+                continue;
             }
-            catch (const UserException& ex) {
-                if (!keepGoing || i == objs.size()-1){
-                    globalOpCounters.incInsertInWriteLock(i);
-                    throw;
+
+            for (; i < end; i++) {
+                try {
+                    checkAndInsert(txn, ctx, ns, objs[i]);
+                }
+                catch (const UserException& ex) {
+                    if (!keepGoing || i == objs.size()-1){
+                        globalOpCounters.incInsertInWriteLock(i);
+                        throw;
+                    }
+                    LastError::get(txn->getClient()).setLastError(ex.getCode(), ex.getInfo().msg);
+                    // otherwise ignore and keep going
                 }
-                LastError::get(txn->getClient()).setLastError(ex.getCode(), ex.getInfo().msg);
-                // otherwise ignore and keep going
             }
         }
 
@@ -0,0 +1,212 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/db/matcher/expression_compiled.h"
+
+#include "mongo/db/field_ref.h"
+
+namespace mongo {
+
+    using std::string;
+    using std::vector;
+
+    namespace {
+
+        /**
+         * The leaf types whose matches() is LeafMatchExpression::matches, which for a path that
+         * doesn't reach an array is the same as matchesSingleElement() on the element at the path.
+         */
+        bool isCompilableLeaf(const MatchExpression* expr) {
+            switch (expr->matchType()) {
+            case MatchExpression::EQ:
+            case MatchExpression::LTE:
+            case MatchExpression::LT:
+            case MatchExpression::GT:
+            case MatchExpression::GTE:
+            case MatchExpression::REGEX:
+            case MatchExpression::MOD:
+            case MatchExpression::EXISTS:
+            case MatchExpression::MATCH_IN:
+                return !expr->path().empty();
+            default:
+                return false;
+            }
+        }
+
+    }  // namespace
+
+    CompiledMatchExpression::CompiledMatchExpression(const MatchExpression* expr)
+        : _expr(expr),
+          _interpretAll(false) {
+
+        if (!_expr) {
+            return;
+        }
+
+        if (MatchExpression::AND == _expr->matchType()) {
+            for (size_t i = 0; i < _expr->numChildren(); ++i) {
+                const MatchExpression* child = _expr->getChild(i);
+                if (!compileLeaf(child)) {
+                    _interpreted.push_back(child);
+                }
+            }
+        }
+        else if (!compileLeaf(_expr)) {
+            _interpretAll = true;
+        }
+    }
+
+    bool CompiledMatchExpression::compileLeaf(const MatchExpression* expr) {
+        CompiledLeaf leaf;
+        leaf.negated = false;
+        if (MatchExpression::NOT == expr->matchType()) {
+            // NotMatchExpression::matches is just the negation of its child's.
+            leaf.negated = true;
+            expr = expr->getChild(0);
+        }
+
+        if (!isCompilableLeaf(expr)) {
+            return false;
+        }
+
+        FieldRef path;
+        path.parse(expr->path());
+
+        leaf.expr = expr;
+        for (size_t i = 1; i < path.numParts(); ++i) {
+            leaf.restOfPath.push_back(path.getPart(i).toString());
+        }
+        _leaves.push_back(leaf);
+
+        const StringData name = path.getPart(0);
+        for (size_t i = 0; i < _fields.size(); ++i) {
+            if (name == _fields[i].name) {
+                _fields[i].leaves.push_back(_leaves.size() - 1);
+                return true;
+            }
+        }
+
+        TopLevelField field;
+        field.name = name.toString();
+        field.leaves.push_back(_leaves.size() - 1);
+        _fields.push_back(field);
+        return true;
+    }
+
+    bool CompiledMatchExpression::matchesLeaf(const CompiledLeaf& leaf,
+                                              const BSONElement& topLevel,
+                                              const BSONObj& doc) const {
+        // Follow the rest of the path the way getFieldDottedOrArray() does.
+        BSONElement e = topLevel;
+        for (size_t i = 0; i < leaf.restOfPath.size(); ++i) {
+            if (Object == e.type()) {
+                e = e.Obj().getField(leaf.restOfPath[i]);
+            }
+            else if (Array == e.type()) {
+                break;
+            }
+            else {
+                // Either missing or a scalar with more path left, the path doesn't exist.
+                e = BSONElement();
+                break;
+            }
+        }
+
+        bool matches;
+        if (Array == e.type()) {
+            // The interpreter knows how to traverse arrays.
+            matches = leaf.expr->matchesBSON(doc, NULL);
+        }
+        else {
+            matches = leaf.expr->matchesSingleElement(e);
+        }
+
+        return matches != leaf.negated;
+    }
+
+    bool CompiledMatchExpression::matchesBSON(const BSONObj& doc) const {
+        if (!_expr) {
+            return true;
+        }
+
+        if (_interpretAll) {
+            return _expr->matchesBSON(doc, NULL);
+        }
+
+        if (!_fields.empty()) {
+            // Only the first field with a given name counts, like BSONObj::getField.
+            const size_t numFields = _fields.size();
+            vector<bool> seen(numFields, false);
+            size_t numSeen = 0;
+
+            BSONObjIterator it(doc);
+            while (it.more() && numSeen < numFields) {
+                const BSONElement topLevel = it.next();
+                const StringData name = topLevel.fieldNameStringData();
+
+                for (size_t i = 0; i < numFields; ++i) {
+                    const TopLevelField& field = _fields[i];
+                    if (seen[i] || name != field.name) {
+                        continue;
+                    }
+
+                    seen[i] = true;
+                    ++numSeen;
+                    for (size_t j = 0; j < field.leaves.size(); ++j) {
+                        if (!matchesLeaf(_leaves[field.leaves[j]], topLevel, doc)) {
+                            return false;
+                        }
+                    }
+                    break;
+                }
+            }
+
+            for (size_t i = 0; i < numFields && numSeen < numFields; ++i) {
+                if (seen[i]) {
+                    continue;
+                }
+
+                const TopLevelField& field = _fields[i];
+                for (size_t j = 0; j < field.leaves.size(); ++j) {
+                    if (!matchesLeaf(_leaves[field.leaves[j]], BSONElement(), doc)) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < _interpreted.size(); ++i) {
+            if (!_interpreted[i]->matchesBSON(doc, NULL)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+}  // namespace mongo
@@ -0,0 +1,118 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/matcher/expression.h"
+
+namespace mongo {
+
+    /**
+     * A MatchExpression prepared for matching many whole documents.
+     *
+     * MatchExpression::matchesBSON walks the tree once per document and walks the path of each
+     * leaf from the top of the document.  If the expression is an AND of leaves, or a single
+     * leaf, this instead groups the leaves by the first part of their path and finds all of
+     * those fields in a single pass over the top level of the document.  Each leaf is checked as
+     * soon as its field turns up, so a document which fails a leaf is rejected without looking
+     * further.
+     *
+     * Only EQ, LT, LTE, GT, GTE, REGEX, MOD, EXISTS and MATCH_IN leaves, and NOTs of them such as
+     * $ne and $nin, are handled this way, and only while their path doesn't run into an array,
+     * since array traversal is left to the interpreter.  Any other child of the AND ($where,
+     * geo, text, $elemMatch, $or and so on) is checked with matchesBSON once the compiled leaves
+     * have passed.  Anything else falls back to matchesBSON entirely.
+     *
+     * The expression is not owned and must outlive this.
+     */
+    class CompiledMatchExpression {
+        MONGO_DISALLOW_COPYING(CompiledMatchExpression);
+    public:
+        /**
+         * 'expr' may be NULL, which matches everything.
+         */
+        explicit CompiledMatchExpression(const MatchExpression* expr);
+
+        /**
+         * Same result as getExpression()->matchesBSON(doc, NULL).
+         */
+        bool matchesBSON(const BSONObj& doc) const;
+
+        const MatchExpression* getExpression() const { return _expr; }
+
+        /**
+         * True if any leaf is matched by the compiled single pass.
+         */
+        bool isCompiled() const { return !_leaves.empty(); }
+
+    private:
+        struct CompiledLeaf {
+            // The child of a NOT if 'negated', otherwise the compiled expression itself.
+            const MatchExpression* expr;
+            bool negated;
+            // The parts of the path after the first one.
+            std::vector<std::string> restOfPath;
+        };
+
+        // The leaves whose path starts with one top level field name.
+        struct TopLevelField {
+            std::string name;
+            std::vector<size_t> leaves;
+        };
+
+        /**
+         * Tries to add 'expr' to _leaves, returning false if it must be interpreted.
+         */
+        bool compileLeaf(const MatchExpression* expr);
+
+        /**
+         * Checks 'leaf' given the document's first field with the leaf's top level name, which
+         * is EOO if there is none.
+         */
+        bool matchesLeaf(const CompiledLeaf& leaf,
+                         const BSONElement& topLevel,
+                         const BSONObj& doc) const;
+
+        const MatchExpression* const _expr;
+
+        std::vector<CompiledLeaf> _leaves;
+        std::vector<TopLevelField> _fields;
+
+        // Children of the AND that are checked with matchesBSON.
+        std::vector<const MatchExpression*> _interpreted;
+
+        // If true nothing compiled and we just call _expr->matchesBSON.
+        bool _interpretAll;
+    };
+
+}  // namespace mongo
@@ -0,0 +1,150 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/unittest/unittest.h"
+
+#include "mongo/db/matcher/expression_compiled.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/db/json.h"
+#include "mongo/db/matcher/expression_parser.h"
+
+namespace mongo {
+
+    using boost::scoped_ptr;
+
+    namespace {
+
+        /**
+         * Documents chosen to cover scalars, arrays at and before the end of a path, missing
+         * fields, scalars in the middle of a path and repeated field names.
+         */
+        const char* const kDocs[] = {
+            "{}",
+            "{a: 1}",
+            "{a: 5, b: 'x'}",
+            "{a: [1, 5], b: 'y'}",
+            "{a: [[5]]}",
+            "{a: null}",
+            "{a: {b: 2}}",
+            "{a: {b: [1, 2]}}",
+            "{a: [{b: 2}, {b: 3}]}",
+            "{a: {b: {c: 7}}, d: 1}",
+            "{a: 1, a: 5}",
+            "{a: 5, a: 1}",
+            "{b: 'x', a: 5, c: {d: 4}}",
+            "{a: 'abc', c: 4}",
+            "{a: {b: null}, c: [4, 5]}",
+            "{c: {d: 4}, a: 2, b: 'xyz'}",
+        };
+
+        /**
+         * Parses 'query' and checks that the compiled expression agrees with matchesBSON on
+         * every document in kDocs.  Returns whether it compiled any leaves.
+         */
+        bool assertSameAsInterpreter(const char* query) {
+            StatusWithMatchExpression result = MatchExpressionParser::parse(fromjson(query));
+            ASSERT_OK(result.getStatus());
+            scoped_ptr<MatchExpression> expr(result.getValue());
+
+            CompiledMatchExpression compiled(expr.get());
+            for (size_t i = 0; i < sizeof(kDocs) / sizeof(kDocs[0]); ++i) {
+                BSONObj doc = fromjson(kDocs[i]);
+                if (expr->matchesBSON(doc, NULL) != compiled.matchesBSON(doc)) {
+                    FAIL(str::stream() << "query " << query << " differs on " << kDocs[i]);
+                }
+            }
+            return compiled.isCompiled();
+        }
+
+    }  // namespace
+
+    TEST(CompiledMatchExpressionTest, NullMatchesEverything) {
+        CompiledMatchExpression compiled(NULL);
+        ASSERT(compiled.matchesBSON(BSONObj()));
+        ASSERT(compiled.matchesBSON(BSON("a" << 1)));
+    }
+
+    TEST(CompiledMatchExpressionTest, EmptyAnd) {
+        ASSERT(!assertSameAsInterpreter("{}"));
+    }
+
+    TEST(CompiledMatchExpressionTest, Comparisons) {
+        ASSERT(assertSameAsInterpreter("{a: 5}"));
+        ASSERT(assertSameAsInterpreter("{a: null}"));
+        ASSERT(assertSameAsInterpreter("{a: {$gt: 1}}"));
+        ASSERT(assertSameAsInterpreter("{a: {$gte: 1, $lt: 5}}"));
+        ASSERT(assertSameAsInterpreter("{a: {$lte: 5}, b: 'x'}"));
+        ASSERT(assertSameAsInterpreter("{a: [1, 5]}"));
+        ASSERT(assertSameAsInterpreter("{a: {b: 2}}"));
+    }
+
+    TEST(CompiledMatchExpressionTest, OtherLeaves) {
+        ASSERT(assertSameAsInterpreter("{a: {$exists: true}}"));
+        ASSERT(assertSameAsInterpreter("{a: {$exists: false}, b: {$exists: true}}"));
+        ASSERT(assertSameAsInterpreter("{a: {$in: [1, null, 'abc']}}"));
+        ASSERT(assertSameAsInterpreter("{a: {$mod: [2, 1]}}"));
+        ASSERT(assertSameAsInterpreter("{a: /b/, b: /^x/}"));
+    }
+
+    TEST(CompiledMatchExpressionTest, DottedPaths) {
+        ASSERT(assertSameAsInterpreter("{'a.b': 2}"));
+        ASSERT(assertSameAsInterpreter("{'a.b': null}"));
+        ASSERT(assertSameAsInterpreter("{'a.b': {$exists: false}}"));
+        ASSERT(assertSameAsInterpreter("{'a.b.c': 7, d: 1}"));
+        ASSERT(assertSameAsInterpreter("{'a.b': {$gt: 1}, a: {$exists: true}}"));
+        ASSERT(assertSameAsInterpreter("{'a.0': 1}"));
+        ASSERT(assertSameAsInterpreter("{'c.d': 4, b: {$in: ['x', 'xyz']}}"));
+    }
+
+    TEST(CompiledMatchExpressionTest, Negations) {
+        ASSERT(assertSameAsInterpreter("{a: {$ne: 5}}"));
+        ASSERT(assertSameAsInterpreter("{a: {$ne: null}, b: 'x'}"));
+        ASSERT(assertSameAsInterpreter("{a: {$nin: [5]}, 'a.b': {$ne: 1}}"));
+        ASSERT(assertSameAsInterpreter("{a: {$not: /c/}}"));
+        ASSERT(assertSameAsInterpreter("{'a.b': {$exists: false}, c: {$nin: [4, 5]}}"));
+    }
+
+    TEST(CompiledMatchExpressionTest, InterpretedChildren) {
+        ASSERT(assertSameAsInterpreter("{a: {$elemMatch: {b: 2}}, c: {$exists: false}}"));
+        ASSERT(assertSameAsInterpreter("{a: {$elemMatch: {b: 2}}, 'c.d': 4}"));
+        ASSERT(assertSameAsInterpreter("{$or: [{a: 1}, {b: 'x'}], a: {$exists: true}}"));
+        ASSERT(assertSameAsInterpreter("{a: {$not: {$size: 2}}, c: 4}"));
+        ASSERT(assertSameAsInterpreter("{a: {$size: 2}, b: 'y'}"));
+        ASSERT(assertSameAsInterpreter("{a: {$type: 2}, c: 4}"));
+    }
+
+    TEST(CompiledMatchExpressionTest, NotCompiled) {
+        ASSERT(!assertSameAsInterpreter("{$or: [{a: 1}, {'a.b': 2}]}"));
+        ASSERT(!assertSameAsInterpreter("{a: {$elemMatch: {$gte: 5}}}"));
+        ASSERT(!assertSameAsInterpreter("{$nor: [{a: 5}]}"));
+    }
+
+}  // namespace mongo
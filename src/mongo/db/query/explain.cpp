@@ -151,7 +151,7 @@ namespace {
             const FetchStats* spec = static_cast<const FetchStats*>(specific);
             return spec->docsExamined;
         }
-        else if (STAGE_COLLSCAN == type) {
+        else if (STAGE_COLLSCAN == type || STAGE_PARALLEL_COLLSCAN == type) {
             const CollectionScanStats* spec = static_cast<const CollectionScanStats*>(specific);
             return spec->docsTested;
         }
@@ -245,6 +245,8 @@ namespace mongo {
             if (verbosity >= ExplainCommon::EXEC_STATS) {
                 bob->appendNumber("memUsage", spec->memUsage);
                 bob->appendNumber("memLimit", spec->memLimit);
+                bob->appendNumber("spills", spec->spills);
+                bob->appendNumber("spilledBytes", spec->spilledBytes);
 
                 bob->appendNumber("flaggedButPassed", spec->flaggedButPassed);
                 bob->appendNumber("flaggedInProgress", spec->flaggedInProgress);
@@ -272,6 +274,17 @@ namespace mongo {
                 bob->appendNumber("docsExamined", spec->docsTested);
             }
         }
+        else if (STAGE_PARALLEL_COLLSCAN == stats.stageType) {
+            ParallelCollectionScanStats* spec =
+                static_cast<ParallelCollectionScanStats*>(stats.specific.get());
+            bob->append("direction", spec->direction > 0 ? "forward" : "backward");
+            bob->appendNumber("numThreads", spec->numThreads);
+            if (verbosity >= ExplainCommon::EXEC_STATS) {
+                bob->appendNumber("docsExamined", spec->docsTested);
+                bob->appendNumber("batches", spec->batches);
+                bob->appendNumber("batchesFilteredInline", spec->batchesFilteredInline);
+            }
+        }
         else if (STAGE_COUNT == stats.stageType) {
             CountStats* spec = static_cast<CountStats*>(stats.specific.get());
 
@@ -355,8 +368,13 @@ namespace mongo {
                 bob->append("indexBounds", spec->indexBounds);
             }
 
+            if (spec->estimatedKeysExamined >= 0) {
+                bob->appendNumber("estimatedKeysExamined", spec->estimatedKeysExamined);
+            }
+
             if (verbosity >= ExplainCommon::EXEC_STATS) {
                 bob->appendNumber("keysExamined", spec->keysExamined);
+                bob->appendNumber("seeks", spec->seeks);
                 bob->appendNumber("dupsTested", spec->dupsTested);
                 bob->appendNumber("dupsDropped", spec->dupsDropped);
                 bob->appendNumber("seenInvalidated", spec->seenInvalidated);
@@ -397,6 +415,8 @@ namespace mongo {
             if (verbosity >= ExplainCommon::EXEC_STATS) {
                 bob->appendNumber("memUsage", spec->memUsage);
                 bob->appendNumber("memLimit", spec->memLimit);
+                bob->appendNumber("spills", spec->spills);
+                bob->appendNumber("spilledBytes", spec->spilledBytes);
             }
 
             if (spec->limit > 0) {
@@ -66,6 +66,7 @@
 #include "mongo/db/query/query_planner.h"
 #include "mongo/db/query/query_planner_common.h"
 #include "mongo/db/query/query_settings.h"
+#include "mongo/db/query/query_solution_template.h"
 #include "mongo/db/query/stage_builder.h"
 #include "mongo/db/repl/replication_coordinator_global.h"
 #include "mongo/db/server_options.h"
@@ -155,6 +156,7 @@ namespace mongo {
                                                         desc->indexName(),
                                                         ice->getFilterExpression(),
                                                         desc->infoObj()));
+            plannerParams->indices.back().multikeyFields = ice->getMultikeyFields();
         }
 
         // If query supports index filters, filter params.indices by indices in query settings.
@@ -204,6 +206,10 @@ namespace mongo {
             plannerParams->options |= QueryPlannerParams::INDEX_INTERSECTION;
         }
 
+        if (internalQueryPlannerEnableSkipScan) {
+            plannerParams->options |= QueryPlannerParams::SKIP_SCAN;
+        }
+
         plannerParams->options |= QueryPlannerParams::SPLIT_LIMITED_SORT;
 
         // Doc-level locking storage engines cannot answer predicates implicitly via exact index
@@ -318,11 +324,36 @@ namespace mongo {
             CachedSolution* rawCS;
             if (PlanCache::shouldCacheQuery(*canonicalQuery) &&
                 collection->infoCache()->getPlanCache()->get(*canonicalQuery, &rawCS).isOK()) {
-                // We have a CachedSolution.  Have the planner turn it into a QuerySolution.
+                // We have a CachedSolution.  If a query of this shape has already been planned
+                // from the cache, just put our values into that solution.  Otherwise have the
+                // planner turn the CachedSolution into a QuerySolution.
                 boost::scoped_ptr<CachedSolution> cs(rawCS);
-                QuerySolution *qs;
-                Status status = QueryPlanner::planFromCache(*canonicalQuery, plannerParams, *cs,
-                                                            &qs);
+                QuerySolution *qs = NULL;
+                Status status = Status::OK();
+                if (internalQueryCacheSolutionTemplates && cs->solutionTemplate) {
+                    qs = cs->solutionTemplate->bind(*canonicalQuery, plannerParams);
+                }
+
+                if (NULL != qs) {
+                    LOG(2) << "Using cached solution template: "
+                           << canonicalQuery->toStringShort();
+                }
+                else {
+                    status = QueryPlanner::planFromCache(*canonicalQuery, plannerParams, *cs,
+                                                         &qs);
+
+                    if (status.isOK()
+                        && internalQueryCacheSolutionTemplates
+                        && !cs->solutionTemplate) {
+                        QuerySolutionTemplate* solutionTemplate =
+                            QuerySolutionTemplate::make(*canonicalQuery, plannerParams, *qs);
+                        if (NULL != solutionTemplate) {
+                            collection->infoCache()->getPlanCache()->setSolutionTemplate(
+                                *cs, boost::shared_ptr<const QuerySolutionTemplate>(
+                                    solutionTemplate));
+                        }
+                    }
+                }
 
                 if (status.isOK()) {
                     verify(StageBuilder::build(opCtx, collection, *qs, ws, rootOut));
@@ -1385,6 +1416,31 @@ namespace {
             }
         }
 
+        // Without a query, a distinct scan of an index with the field further in can skip over
+        // each value of the fields before it.  It examines about one key per distinct prefix,
+        // which is never more than the collection scan would if the index isn't multikey.
+        if (plannerParams.indices.empty() && query.isEmpty() && internalQueryPlannerEnableSkipScan) {
+            IndexCatalog::IndexIterator skipIt =
+                collection->getIndexCatalog()->getIndexIterator(txn, false);
+            while (skipIt.more()) {
+                const IndexDescriptor* desc = skipIt.next();
+                if (!IndexNames::findPluginName(desc->keyPattern()).empty()
+                    || desc->isMultikey(txn)
+                    || !desc->getInfoElement("partialFilterExpression").eoo()
+                    || !desc->keyPattern().hasField(field)) {
+                    continue;
+                }
+                plannerParams.indices.push_back(IndexEntry(desc->keyPattern(),
+                                                           desc->getAccessMethodName(),
+                                                           desc->isMultikey(txn),
+                                                           desc->isSparse(),
+                                                           desc->unique(),
+                                                           desc->indexName(),
+                                                           NULL,
+                                                           desc->infoObj()));
+            }
+        }
+
         const WhereCallbackReal whereCallback(txn, collection->ns().db());
 
         // If there are no suitable indices for the distinct hack bail out now into regular planning
@@ -1402,7 +1458,8 @@ namespace {
         }
 
         //
-        // If we're here, we have an index prefixed by the field we're distinct-ing over.
+        // If we're here, we have an index prefixed by the field we're distinct-ing over, or an
+        // empty query and an index we can skip scan to the field.
         //
 
         // Applying a projection allows the planner to try to give us covered plans that we can turn
@@ -1435,6 +1492,10 @@ namespace {
             dn->direction = 1;
             IndexBoundsBuilder::allValuesBounds(dn->indexKeyPattern, &dn->bounds);
             dn->fieldNo = 0;
+            BSONObjIterator it(dn->indexKeyPattern);
+            while (it.more() && field != it.next().fieldName()) {
+                dn->fieldNo++;
+            }
 
             QueryPlannerParams params;
 
@@ -55,6 +55,7 @@ namespace mongo {
                    const BSONObj& io)
             : keyPattern(kp),
               multikey(mk),
+              multikeyFields(~0U),
               sparse(sp),
               unique(unq),
               name(n),
@@ -76,6 +77,7 @@ namespace mongo {
                    const BSONObj& io)
             : keyPattern(kp),
               multikey(mk),
+              multikeyFields(~0U),
               sparse(sp),
               unique(unq),
               name(n),
@@ -91,6 +93,7 @@ namespace mongo {
         IndexEntry(const BSONObj& kp)
             : keyPattern(kp),
               multikey(false),
+              multikeyFields(~0U),
               sparse(false),
               unique(false),
               name("test_foo"),
@@ -104,6 +107,10 @@ namespace mongo {
 
         bool multikey;
 
+        // Which fields of the key pattern may hold arrays, as returned by
+        // IndexCatalogEntry::getMultikeyFields().  All of them unless we know better.
+        uint32_t multikeyFields;
+
         bool sparse;
 
         bool unique;
@@ -154,6 +154,19 @@ namespace mongo {
             return Status::OK();
         }
 
+        /**
+         * Like get(), but leaves the order of the entries alone, so unlike get() it may be
+         * called by several threads at once as long as none of them modifies the kv-store.
+         */
+        Status peek(const K& key, V** entryOut) const {
+            KVMapConstIt i = _kvMap.find(key);
+            if (i == _kvMap.end()) {
+                return Status(ErrorCodes::NoSuchKey, "no such key in LRU key-value store");
+            }
+            *entryOut = i->second->second;
+            return Status::OK();
+        }
+
         /**
          * Remove the kv-store entry keyed by 'key'.
          */
@@ -194,6 +207,11 @@ namespace mongo {
          */
         size_t size() const { return _currentSize; }
 
+        /**
+         * Returns the number of entries the kv-store holds before it starts evicting.
+         */
+        size_t maxSize() const { return _maxSize; }
+
         /**
          * TODO: The kv-store should implement its own iterator. Calling through to the underlying
          * iterator exposes the internals, and forces the caller to make a horrible type
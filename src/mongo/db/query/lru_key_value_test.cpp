@@ -163,6 +163,26 @@ namespace {
         }
     }
 
+    /**
+     * Test that peek() finds an entry without promoting it.
+     */
+    TEST(LRUKeyValueTest, PeekTest) {
+        LRUKeyValue<int, int> cache(2);
+        cache.add(1, new int(1));
+        cache.add(2, new int(2));
+        ASSERT_EQUALS(cache.maxSize(), 2U);
+
+        int* cachedValue = NULL;
+        ASSERT_OK(cache.peek(1, &cachedValue));
+        ASSERT_EQUALS(*cachedValue, 1);
+        ASSERT_NOT_OK(cache.peek(3, &cachedValue));
+
+        // 1 is still the least recently used entry.
+        std::auto_ptr<int> evicted = cache.add(3, new int(3));
+        ASSERT(NULL != evicted.get());
+        ASSERT_EQUALS(*evicted, 1);
+    }
+
     /**
      * Test that calling add() with a key that already exists
      * in the kv-store deletes the existing entry.
@@ -28,6 +28,8 @@
 
 #include "mongo/db/query/parsed_projection.h"
 
+#include "mongo/db/field_ref.h"
+#include "mongo/db/matcher/path_internal.h"
 #include "mongo/db/query/lite_parsed_query.h"
 
 namespace mongo {
@@ -58,7 +60,6 @@ namespace mongo {
         // If any of these are 'true' the projection isn't covered.
         bool include = true;
         bool hasNonSimple = false;
-        bool hasDottedField = false;
 
         bool includeID = true;
 
@@ -180,11 +181,6 @@ namespace mongo {
                 includeID = false;
             }
             else {
-                // Projections of dotted fields aren't covered.
-                if (mongoutils::str::contains(e.fieldName(), '.')) {
-                    hasDottedField = true;
-                }
-
                 // Validate input.
                 if (include_exclude == -1) {
                     // If we haven't specified an include/exclude, initialize include_exclude.
@@ -249,10 +245,10 @@ namespace mongo {
         pp->_source = spec;
         pp->_returnKey = hasIndexKeyProjection;
 
-        // Dotted fields aren't covered, non-simple require match details, and as for include, "if
-        // we default to including then we can't use an index because we don't know what we're
-        // missing."
-        pp->_requiresDocument = include || hasNonSimple || hasDottedField;
+        // Positional projections and non-simple ones require match details, and as for include,
+        // "if we default to including then we can't use an index because we don't know what
+        // we're missing."
+        pp->_requiresDocument = include || hasNonSimple || ARRAY_OP_POSITIONAL == arrayOpType;
 
         // Add geoNear projections.
         pp->_wantGeoNearPoint = wantGeoNearPoint;
@@ -265,8 +261,8 @@ namespace mongo {
                 pp->_requiredFields.push_back("_id");
             }
 
-            // The only way we could be here is if spec is only simple non-dotted-field projections.
-            // Therefore we can iterate over spec to get the fields required.
+            // The only way we could be here is if spec is only simple inclusions of fields, which
+            // may be dotted.  Therefore we can iterate over spec to get the fields required.
             BSONObjIterator srcIt(spec);
             while (srcIt.more()) {
                 BSONElement elt = srcIt.next();
@@ -278,6 +274,11 @@ namespace mongo {
                     pp->_requiredFields.push_back(elt.fieldName());
                 }
             }
+
+            if (!_canCoverFields(pp->_requiredFields)) {
+                pp->_requiresDocument = true;
+                pp->_requiredFields.clear();
+            }
         }
 
         // returnKey clobbers everything.
@@ -289,6 +290,36 @@ namespace mongo {
         return Status::OK();
     }
 
+    // static
+    bool ParsedProjection::_canCoverFields(const std::vector<std::string>& fields) {
+        for (size_t i = 0; i < fields.size(); ++i) {
+            // A path like 'a.0' picks an element out of an array when it's indexed, but the
+            // projection keeps the field named '0' of an embedded object.
+            FieldRef path(fields[i]);
+            for (size_t part = 1; part < path.numParts(); ++part) {
+                if (isAllDigits(path.getPart(part))) {
+                    return false;
+                }
+            }
+
+            // A covered projection builds its output from the values of the fields alone, so
+            // that doesn't work if one field is a prefix of another, as in {a: 1, 'a.b': 1}.
+            for (size_t j = 0; j < fields.size(); ++j) {
+                if (i == j) {
+                    continue;
+                }
+
+                StringData longer(fields[i]);
+                StringData shorter(fields[j]);
+                if (longer.startsWith(shorter)
+                    && (longer.size() == shorter.size() || '.' == longer[shorter.size()])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
     // static
     bool ParsedProjection::_isPositionalOperator(const char* fieldName) {
         return mongoutils::str::contains(fieldName, ".$") &&
@@ -68,7 +68,7 @@ namespace mongo {
 
         /**
          * If requiresDocument() == false, what fields are required to compute
-         * the projection?
+         * the projection?  The fields may be dotted, but none is a prefix of another.
          */
         const std::vector<std::string>& getRequiredFields() const {
             return _requiredFields;
@@ -112,6 +112,12 @@ namespace mongo {
          */
         static bool _isPositionalOperator(const char* fieldName);
 
+        /**
+         * Returns true if a simple inclusion of 'fields' can be computed from their values
+         * alone, e.g. from index keys.
+         */
+        static bool _canCoverFields(const std::vector<std::string>& fields);
+
         /**
          * Returns true if the MatchExpression 'query' queries against
          * the field named by 'matchfield'. This deeply traverses logical
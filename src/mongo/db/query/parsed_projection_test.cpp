@@ -137,6 +137,30 @@ namespace {
         ASSERT_EQUALS(fields[0], "a");
     }
 
+    TEST(ParsedProjectionTest, MakeDottedFieldCovered) {
+        auto_ptr<ParsedProjection> parsedProj(createParsedProjection("{}",
+                                                                     "{_id: 0, 'a.b': 1, c: 1}"));
+        ASSERT(!parsedProj->requiresDocument());
+        const vector<string>& fields = parsedProj->getRequiredFields();
+        ASSERT_EQUALS(fields.size(), 2U);
+        ASSERT_EQUALS(fields[0], "a.b");
+        ASSERT_EQUALS(fields[1], "c");
+    }
+
+    TEST(ParsedProjectionTest, MakeOverlappingDottedFieldsNotCovered) {
+        auto_ptr<ParsedProjection> parsedProj(createParsedProjection("{}",
+                                                                     "{_id: 0, a: 1, 'a.b': 1}"));
+        ASSERT(parsedProj->requiresDocument());
+        ASSERT(parsedProj->getRequiredFields().empty());
+    }
+
+    // 'a.0' could be an array element rather than a field
+    TEST(ParsedProjectionTest, MakeNumericPathComponentNotCovered) {
+        auto_ptr<ParsedProjection> parsedProj(createParsedProjection("{}", "{_id: 0, 'a.0': 1}"));
+        ASSERT(parsedProj->requiresDocument());
+        ASSERT(parsedProj->getRequiredFields().empty());
+    }
+
     //
     // Positional operator validation
     //
@@ -35,6 +35,7 @@
 #include <algorithm>
 #include <math.h>
 #include <memory>
+#include "boost/functional/hash.hpp"
 #include "boost/thread/locks.hpp"
 #include "mongo/base/owned_pointer_vector.h"
 #include "mongo/client/dbclientinterface.h"   // For QueryOption_foobar
@@ -43,6 +44,7 @@
 #include "mongo/db/query/plan_ranker.h"
 #include "mongo/db/query/query_solution.h"
 #include "mongo/db/query/query_knobs.h"
+#include "mongo/stdx/thread.h"
 #include "mongo/util/assert_util.h"
 #include "mongo/util/log.h"
 #include "mongo/util/mongoutils/str.h"
@@ -240,27 +242,20 @@ namespace {
     //
 
     CachedSolution::CachedSolution(const PlanCacheKey& key, const PlanCacheEntry& entry)
-        : plannerData(entry.plannerData.size()),
+        : plannerData(entry.plannerData),
           key(key),
           query(entry.query.getOwned()),
           sort(entry.sort.getOwned()),
           projection(entry.projection.getOwned()),
-          decisionWorks(entry.decision->stats[0]->common.works) {
-        // CachedSolution should not having any references into
-        // cache entry. All relevant data should be cloned/copied.
-        for (size_t i = 0; i < entry.plannerData.size(); ++i) {
-            verify(entry.plannerData[i]);
-            plannerData[i] = entry.plannerData[i]->clone();
-        }
+          decisionWorks(entry.decision->stats[0]->common.works),
+          solutionTemplate(entry.solutionTemplate),
+          _plannerDataOwner(entry.ownedPlannerData) {
+        // CachedSolution must not have any references into the cache entry other than the
+        // planner data, which outlives the entry if need be.  The BSON above is owned by the
+        // entry, so getOwned() just takes a reference.
     }
 
-    CachedSolution::~CachedSolution() {
-        for (std::vector<SolutionCacheData*>::const_iterator i = plannerData.begin();
-             i != plannerData.end(); ++i) {
-            SolutionCacheData* scd = *i;
-            delete scd;
-        }
-    }
+    CachedSolution::~CachedSolution() { }
 
     //
     // PlanCacheEntry
@@ -268,8 +263,7 @@ namespace {
 
     PlanCacheEntry::PlanCacheEntry(const std::vector<QuerySolution*>& solutions,
                                    PlanRankingDecision* why)
-        : plannerData(solutions.size()),
-          decision(why) {
+        : decision(why) {
         invariant(why);
 
         // The caller of this constructor is responsible for ensuring
@@ -277,19 +271,19 @@ namespace {
         // data to cache you shouldn't be trying to construct a PlanCacheEntry.
 
         // Copy the solution's cache data into the plan cache entry.
+        OwnedPointerVector<SolutionCacheData>* owned = new OwnedPointerVector<SolutionCacheData>();
+        ownedPlannerData.reset(owned);
         for (size_t i = 0; i < solutions.size(); ++i) {
             invariant(solutions[i]->cacheData.get());
-            plannerData[i] = solutions[i]->cacheData->clone();
+            owned->mutableVector().push_back(solutions[i]->cacheData->clone());
         }
+        plannerData = owned->vector();
     }
 
     PlanCacheEntry::~PlanCacheEntry() {
         for (size_t i = 0; i < feedback.size(); ++i) {
             delete feedback[i];
         }
-        for (size_t i = 0; i < plannerData.size(); ++i) {
-            delete plannerData[i];
-        }
     }
 
     PlanCacheEntry* PlanCacheEntry::clone() const {
@@ -415,6 +409,49 @@ namespace {
     // PlanCache
     //
 
+    /**
+     * Locks the stripe of _lockStripes picked by the calling thread.  Enough to read _cache
+     * and to set PlanCacheEntry::recentlyUsed, but not to modify anything else.
+     */
+    class PlanCache::ReadLock {
+        MONGO_DISALLOW_COPYING(ReadLock);
+    public:
+        explicit ReadLock(const PlanCache* cache)
+            : _mutex(cache->_lockStripes[boost::hash<stdx::thread::id>()(stdx::this_thread::get_id())
+                                         % kNumLockStripes].mutex) {
+            _mutex.lock();
+        }
+
+        ~ReadLock() {
+            _mutex.unlock();
+        }
+
+    private:
+        boost::mutex& _mutex;
+    };
+
+    /**
+     * Locks every stripe, always in the same order.
+     */
+    class PlanCache::WriteLock {
+        MONGO_DISALLOW_COPYING(WriteLock);
+    public:
+        explicit WriteLock(const PlanCache* cache) : _cache(cache) {
+            for (size_t i = 0; i < kNumLockStripes; ++i) {
+                _cache->_lockStripes[i].mutex.lock();
+            }
+        }
+
+        ~WriteLock() {
+            for (size_t i = kNumLockStripes; i > 0; --i) {
+                _cache->_lockStripes[i - 1].mutex.unlock();
+            }
+        }
+
+    private:
+        const PlanCache* const _cache;
+    };
+
     PlanCache::PlanCache() : _cache(internalQueryCacheSize) { }
 
     PlanCache::PlanCache(const std::string& ns) : _cache(internalQueryCacheSize), _ns(ns) { }
@@ -573,8 +610,30 @@ namespace {
         entry->sort = pq.getSort().getOwned();
         entry->projection = pq.getProj().getOwned();
 
-        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
-        std::auto_ptr<PlanCacheEntry> evictedEntry = _cache.add(computeKey(query), entry);
+        const PlanCacheKey key = computeKey(query);
+
+        WriteLock cacheLock(this);
+
+        // Hits don't promote entries, so before evicting the least recently used entry give
+        // any entry at the back which has been hit since it was added or last spared a second
+        // chance at the front.
+        if (!_cache.hasKey(key) && _cache.size() >= _cache.maxSize()) {
+            for (size_t i = 0; i < _cache.size(); ++i) {
+                typedef LRUKeyValue<PlanCacheKey, PlanCacheEntry>::KVListConstIt ConstIterator;
+                ConstIterator leastRecentlyUsed = _cache.end();
+                --leastRecentlyUsed;
+                if (!leastRecentlyUsed->second->recentlyUsed.swap(0)) {
+                    break;
+                }
+
+                // get() promotes, copy the key since it removes the list element holding it.
+                const PlanCacheKey promotedKey = leastRecentlyUsed->first;
+                PlanCacheEntry* promoted;
+                invariantOK(_cache.get(promotedKey, &promoted));
+            }
+        }
+
+        std::auto_ptr<PlanCacheEntry> evictedEntry = _cache.add(key, entry);
 
         if (NULL != evictedEntry.get()) {
             LOG(1) << _ns << ": plan cache maximum size exceeded - "
@@ -589,14 +648,20 @@ namespace {
         PlanCacheKey key = computeKey(query);
         verify(crOut);
 
-        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        ReadLock cacheLock(this);
         PlanCacheEntry* entry;
-        Status cacheStatus = _cache.get(key, &entry);
+        Status cacheStatus = _cache.peek(key, &entry);
         if (!cacheStatus.isOK()) {
             return cacheStatus;
         }
         invariant(entry);
 
+        // Only write the flag if it isn't set, so that hits on a popular entry don't keep
+        // invalidating its cache line.
+        if (!entry->recentlyUsed.load()) {
+            entry->recentlyUsed.store(1);
+        }
+
         *crOut = new CachedSolution(key, *entry);
 
         return Status::OK();
@@ -609,15 +674,31 @@ namespace {
         std::auto_ptr<PlanCacheEntryFeedback> autoFeedback(feedback);
         PlanCacheKey ck = computeKey(cq);
 
-        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        // We store up to a constant number of feedback entries.  Once an entry has all of its
+        // feedback, which is the usual case for a popular entry, there's no need to lock out the
+        // readers.
+        {
+            ReadLock cacheLock(this);
+            PlanCacheEntry* entry;
+            Status cacheStatus = _cache.peek(ck, &entry);
+            if (!cacheStatus.isOK()) {
+                return cacheStatus;
+            }
+            invariant(entry);
+
+            if (entry->feedback.size() >= size_t(internalQueryCacheFeedbacksStored)) {
+                return Status::OK();
+            }
+        }
+
+        WriteLock cacheLock(this);
         PlanCacheEntry* entry;
-        Status cacheStatus = _cache.get(ck, &entry);
+        Status cacheStatus = _cache.peek(ck, &entry);
         if (!cacheStatus.isOK()) {
             return cacheStatus;
         }
         invariant(entry);
 
-        // We store up to a constant number of feedback entries.
         if (entry->feedback.size() < size_t(internalQueryCacheFeedbacksStored)) {
             entry->feedback.push_back(autoFeedback.release());
         }
@@ -625,13 +706,32 @@ namespace {
         return Status::OK();
     }
 
+    void PlanCache::setSolutionTemplate(
+            const CachedSolution& cachedSoln,
+            const boost::shared_ptr<const QuerySolutionTemplate>& solutionTemplate) {
+        WriteLock cacheLock(this);
+        PlanCacheEntry* entry;
+        if (!_cache.peek(cachedSoln.key, &entry).isOK()) {
+            return;
+        }
+        invariant(entry);
+
+        // The planner data is shared, so the entry is the one 'cachedSoln' came from if they
+        // point to the same.
+        if (entry->plannerData != cachedSoln.plannerData || entry->solutionTemplate) {
+            return;
+        }
+
+        entry->solutionTemplate = solutionTemplate;
+    }
+
     Status PlanCache::remove(const CanonicalQuery& canonicalQuery) {
-        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        WriteLock cacheLock(this);
         return _cache.remove(computeKey(canonicalQuery));
     }
 
     void PlanCache::clear() {
-        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        WriteLock cacheLock(this);
         _cache.clear();
         _writeOperations.store(0);
     }
@@ -648,9 +748,9 @@ namespace {
         PlanCacheKey key = computeKey(query);
         verify(entryOut);
 
-        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        ReadLock cacheLock(this);
         PlanCacheEntry* entry;
-        Status cacheStatus = _cache.get(key, &entry);
+        Status cacheStatus = _cache.peek(key, &entry);
         if (!cacheStatus.isOK()) {
             return cacheStatus;
         }
@@ -662,7 +762,7 @@ namespace {
     }
 
     std::vector<PlanCacheEntry*> PlanCache::getAllEntries() const {
-        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        ReadLock cacheLock(this);
         std::vector<PlanCacheEntry*> entries;
         typedef std::list< std::pair<PlanCacheKey, PlanCacheEntry*> >::const_iterator ConstIterator;
         for (ConstIterator i = _cache.begin(); i != _cache.end(); i++) {
@@ -674,12 +774,12 @@ namespace {
     }
 
     bool PlanCache::contains(const CanonicalQuery& cq) const {
-        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        ReadLock cacheLock(this);
         return _cache.hasKey(computeKey(cq));
     }
 
     size_t PlanCache::size() const {
-        boost::lock_guard<boost::mutex> cacheLock(_cacheMutex);
+        ReadLock cacheLock(this);
         return _cache.size();
     }
 
@@ -31,8 +31,10 @@
 #include <set>
 #include <boost/optional/optional.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 
+#include "mongo/base/owned_pointer_vector.h"
 #include "mongo/db/exec/plan_stats.h"
 #include "mongo/db/query/canonical_query.h"
 #include "mongo/db/query/index_tag.h"
@@ -49,6 +51,7 @@ namespace mongo {
     struct PlanRankingDecision;
     struct QuerySolution;
     struct QuerySolutionNode;
+    class QuerySolutionTemplate;
 
     /**
      * When the CachedPlanStage runs a cached query, it can provide feedback to the cache.  This
@@ -181,7 +184,8 @@ namespace mongo {
         CachedSolution(const PlanCacheKey& key, const PlanCacheEntry& entry);
         ~CachedSolution();
 
-        // Owned here.
+        // Shared with the cache entry and never modified, so that a cache hit copies no
+        // solutions.  Kept alive by '_plannerDataOwner' even if the entry is evicted.
         std::vector<SolutionCacheData*> plannerData;
 
         // Key used to provide feedback on the entry.
@@ -200,6 +204,12 @@ namespace mongo {
         // The number of work cycles taken to decide on a winning plan when the plan was first
         // cached.
         size_t decisionWorks;
+
+        // The entry's solution template, if it has one yet.
+        boost::shared_ptr<const QuerySolutionTemplate> solutionTemplate;
+
+    private:
+        boost::shared_ptr<const OwnedPointerVector<SolutionCacheData> > _plannerDataOwner;
     };
 
     /**
@@ -233,9 +243,15 @@ namespace mongo {
         //
 
         // Data provided to the planner to allow it to recreate the solutions this entry
-        // represents. Each SolutionCacheData is fully owned here, so in order to return
-        // it from the cache a deep copy is made and returned inside CachedSolution.
+        // represents. It is never modified after construction, and is shared by reference count
+        // with the CachedSolutions returned from the cache rather than copied into them.
         std::vector<SolutionCacheData*> plannerData;
+        boost::shared_ptr<const OwnedPointerVector<SolutionCacheData> > ownedPlannerData;
+
+        // The first solution planned from this entry with the query's values taken out, so that
+        // later queries of the same shape can skip planning.  Set at most once, by
+        // PlanCache::setSolutionTemplate(), and shared with the CachedSolutions handed out after.
+        boost::shared_ptr<const QuerySolutionTemplate> solutionTemplate;
 
         // TODO: Do we really want to just hold a copy of the CanonicalQuery?  For now we just
         // extract the data we need.
@@ -257,6 +273,10 @@ namespace mongo {
         // Annotations from cached runs.  The CachedPlanStage provides these stats about its
         // runs when they complete.
         std::vector<PlanCacheEntryFeedback*> feedback;
+
+        // Set by every cache hit and cleared when PlanCache::add() spares the entry from
+        // eviction because of it.
+        mutable AtomicUInt32 recentlyUsed;
     };
 
     /**
@@ -264,6 +284,11 @@ namespace mongo {
      * mapping, the cache contains information on why that mapping was made and statistics on the
      * cache entry's actual performance on subsequent runs.
      *
+     * Lookups are optimized for many threads hitting the cache at once, often for the same
+     * entry.  They don't reorder the LRU list and only lock one of several mutexes, picked by
+     * thread, while anything which modifies the cache locks all of them.  In place of promotion,
+     * a hit marks the entry as recently used, and add() moves such entries to the front of the
+     * list before evicting (the "second chance" approximation of LRU).
      */
     class PlanCache {
     private:
@@ -326,6 +351,15 @@ namespace mongo {
          */
         Status feedback(const CanonicalQuery& cq, PlanCacheEntryFeedback* feedback);
 
+        /**
+         * Gives the entry from which get() returned 'cachedSoln' the template
+         * 'solutionTemplate'.  Does nothing if the entry has been replaced since, or
+         * already has a template.
+         */
+        void setSolutionTemplate(
+            const CachedSolution& cachedSoln,
+            const boost::shared_ptr<const QuerySolutionTemplate>& solutionTemplate);
+
         /**
          * Remove the entry corresponding to 'ck' from the cache.  Returns Status::OK() if the plan
          * was present and removed and an error status otherwise.
@@ -398,10 +432,19 @@ namespace mongo {
         void encodeKeyForSort(const BSONObj& sortObj, StringBuilder* keyBuilder) const;
         void encodeKeyForProj(const BSONObj& projObj, StringBuilder* keyBuilder) const;
 
+        class ReadLock;
+        class WriteLock;
+
         LRUKeyValue<PlanCacheKey, PlanCacheEntry> _cache;
 
-        // Protects _cache.
-        mutable boost::mutex _cacheMutex;
+        // Protects _cache.  A reader locks the stripe for its thread, a writer locks them all.
+        // Each mutex is padded so that readers on different stripes don't share a cache line.
+        static const size_t kNumLockStripes = 16;
+        struct LockStripe {
+            boost::mutex mutex;
+            char padding[64];
+        };
+        mutable LockStripe _lockStripes[kNumLockStripes];
 
         // Counter for write notifications since initialization or last clear() invocation.  Starts
         // at 0.
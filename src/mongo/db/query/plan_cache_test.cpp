@@ -424,6 +424,69 @@ namespace {
         ASSERT_EQUALS(planCache.size(), 1U);
     }
 
+    // A CachedSolution shares its planner data with the cache entry, so it must stay valid
+    // after the entry is gone.
+    TEST(PlanCacheTest, CachedSolutionOutlivesEntry) {
+        PlanCache planCache;
+        auto_ptr<CanonicalQuery> cq(canonicalize("{a: 1}"));
+        QuerySolution qs;
+        qs.cacheData.reset(new SolutionCacheData());
+        qs.cacheData->tree.reset(new PlanCacheIndexTree());
+        qs.cacheData->solnType = SolutionCacheData::COLLSCAN_SOLN;
+        std::vector<QuerySolution*> solns;
+        solns.push_back(&qs);
+        ASSERT_OK(planCache.add(*cq, solns, createDecision(1U)));
+
+        CachedSolution* rawCachedSoln;
+        ASSERT_OK(planCache.get(*cq, &rawCachedSoln));
+        boost::scoped_ptr<CachedSolution> cachedSoln(rawCachedSoln);
+
+        planCache.clear();
+        ASSERT_EQUALS(planCache.size(), 0U);
+
+        ASSERT_EQUALS(cachedSoln->plannerData.size(), 1U);
+        ASSERT_EQUALS(cachedSoln->plannerData[0]->solnType, SolutionCacheData::COLLSCAN_SOLN);
+        ASSERT_EQUALS(cachedSoln->query, fromjson("{a: 1}"));
+    }
+
+    // Hits don't reorder the cache, but an entry which has been hit gets a second chance before
+    // it is evicted.
+    TEST(PlanCacheTest, EvictionSparesRecentlyUsedEntry) {
+        const int oldCacheSize = internalQueryCacheSize;
+        internalQueryCacheSize = 2;
+        PlanCache planCache;
+        internalQueryCacheSize = oldCacheSize;
+
+        auto_ptr<CanonicalQuery> cqA(canonicalize("{a: 1}"));
+        auto_ptr<CanonicalQuery> cqB(canonicalize("{b: 1}"));
+        auto_ptr<CanonicalQuery> cqC(canonicalize("{c: 1}"));
+        QuerySolution qs;
+        qs.cacheData.reset(new SolutionCacheData());
+        qs.cacheData->tree.reset(new PlanCacheIndexTree());
+        std::vector<QuerySolution*> solns;
+        solns.push_back(&qs);
+
+        ASSERT_OK(planCache.add(*cqA, solns, createDecision(1U)));
+        ASSERT_OK(planCache.add(*cqB, solns, createDecision(1U)));
+
+        // 'a' is the least recently added, but has been used since.
+        CachedSolution* rawCachedSoln;
+        ASSERT_OK(planCache.get(*cqA, &rawCachedSoln));
+        delete rawCachedSoln;
+
+        ASSERT_OK(planCache.add(*cqC, solns, createDecision(1U)));
+        ASSERT_EQUALS(planCache.size(), 2U);
+        ASSERT_TRUE(planCache.contains(*cqA));
+        ASSERT_FALSE(planCache.contains(*cqB));
+        ASSERT_TRUE(planCache.contains(*cqC));
+
+        // 'a' used up its second chance, so it goes next.
+        ASSERT_OK(planCache.add(*cqB, solns, createDecision(1U)));
+        ASSERT_FALSE(planCache.contains(*cqA));
+        ASSERT_TRUE(planCache.contains(*cqB));
+        ASSERT_TRUE(planCache.contains(*cqC));
+    }
+
     /**
      * Each test in the CachePlanSelectionTest suite goes through
      * the following flow:
@@ -72,6 +72,7 @@ namespace mongo {
         : _root(params.root),
           _indices(params.indices),
           _ixisect(params.intersect),
+          _skipScan(params.skipScan),
           _orLimit(params.maxSolutionsPerOr),
           _intersectLimit(params.maxIntersectPerAnd) { }
 
@@ -113,6 +114,15 @@ namespace mongo {
                     ss << ", ";
             }
             ss << "]\n";
+            if (!pred->skipScan.empty()) {
+                ss << "\tskip scan indices: [";
+                for (size_t i = 0; i < pred->skipScan.size(); ++i) {
+                    ss << pred->skipScan[i] << " pos " << pred->skipScanPositions[i];
+                    if (i < pred->skipScan.size() - 1)
+                        ss << ", ";
+                }
+                ss << "]\n";
+            }
             ss << "\tpred: " << pred->expr->toString();
             ss << "\tindexToAssign: " << pred->indexToAssign;
             return ss;
@@ -222,8 +232,25 @@ namespace mongo {
             // In order to definitely use an index it must be prefixed with our field.
             // We don't consider notFirst indices here because we must be AND-related to a node
             // that uses the first spot in that index, and we currently do not know that
-            // unless we're in an AND node.
-            if (0 == rt->first.size()) { return false; }
+            // unless we're in an AND node.  The exception is an index we can skip scan.
+            vector<IndexID> skipScan;
+            vector<size_t> skipScanPositions;
+            for (size_t i = 0; i < rt->notFirst.size(); ++i) {
+                if (!canSkipScan(rt->notFirst[i])) { continue; }
+
+                const IndexEntry& thisIndex = (*_indices)[rt->notFirst[i]];
+                size_t pos = 0;
+                BSONObjIterator kpIt(thisIndex.keyPattern);
+                while (kpIt.more() && rt->path != kpIt.next().fieldName()) {
+                    ++pos;
+                }
+                invariant(pos > 0 && pos < static_cast<size_t>(thisIndex.keyPattern.nFields()));
+
+                skipScan.push_back(rt->notFirst[i]);
+                skipScanPositions.push_back(pos);
+            }
+
+            if (0 == rt->first.size() && 0 == skipScan.size()) { return false; }
 
             // We know we can use an index, so grab a memo spot.
             size_t myMemoID;
@@ -233,6 +260,8 @@ namespace mongo {
             assign->pred.reset(new PredicateAssignment());
             assign->pred->expr = node;
             assign->pred->first.swap(rt->first);
+            assign->pred->skipScan.swap(skipScan);
+            assign->pred->skipScanPositions.swap(skipScanPositions);
             return true;
         }
         else if (Indexability::isBoundsGeneratingNot(node)) {
@@ -387,8 +416,18 @@ namespace mongo {
                 }
             }
 
+            // An index that none of our children prefix can still be used if we can skip scan it.
+            bool anySkipScan = false;
+            for (IndexToPredMap::const_iterator it = idxToNotFirst.begin();
+                 it != idxToNotFirst.end() && !anySkipScan;
+                 ++it) {
+                anySkipScan = idxToFirst.end() == idxToFirst.find(it->first)
+                              && canSkipScan(it->first);
+            }
+
             // If none of our children can use indices, bail out.
             if (idxToFirst.empty()
+                && !anySkipScan
                 && (subnodes.size() == 0)
                 && (mandatorySubnodes.size() == 0)) {
                 return false;
@@ -652,6 +691,31 @@ namespace mongo {
             state.assignments.push_back(indexAssign);
             andAssignment->choices.push_back(state);
         }
+
+        if (!_skipScan) {
+            return;
+        }
+
+        // For each index which none of the predicates prefix, but which we can skip scan, assign
+        // every predicate over its other fields.  Which of these plans beat the ones above
+        // depends on how many distinct values the leading fields have, which only running them
+        // tells us.
+        for (IndexToPredMap::const_iterator it = idxToNotFirst.begin();
+             it != idxToNotFirst.end();
+             ++it) {
+            if (idxToFirst.end() != idxToFirst.find(it->first) || !canSkipScan(it->first)) {
+                continue;
+            }
+
+            OneIndexAssignment indexAssign;
+            indexAssign.index = it->first;
+            compound(it->second, (*_indices)[it->first], &indexAssign);
+            invariant(!indexAssign.preds.empty());
+
+            AndEnumerableState state;
+            state.assignments.push_back(indexAssign);
+            andAssignment->choices.push_back(state);
+        }
     }
 
     void PlanEnumerator::enumerateAndIntersect(const IndexToPredMap& idxToFirst,
@@ -1103,6 +1167,18 @@ namespace mongo {
         return false;
     }
 
+    bool PlanEnumerator::canSkipScan(IndexID idx) const {
+        if (!_skipScan) {
+            return false;
+        }
+
+        const IndexEntry& thisIndex = (*_indices)[idx];
+        return INDEX_BTREE == thisIndex.type
+            && !thisIndex.multikey
+            && !thisIndex.sparse
+            && NULL == thisIndex.filterExpr;
+    }
+
     void PlanEnumerator::compound(const vector<MatchExpression*>& tryCompound,
                                   const IndexEntry& thisIndex,
                                   OneIndexAssignment* assign) {
@@ -1153,8 +1229,14 @@ namespace mongo {
         if (NULL != assign->pred) {
             PredicateAssignment* pa = assign->pred.get();
             verify(NULL == pa->expr->getTag());
-            verify(pa->indexToAssign < pa->first.size());
-            pa->expr->setTag(new IndexTag(pa->first[pa->indexToAssign]));
+            verify(pa->indexToAssign < pa->first.size() + pa->skipScan.size());
+            if (pa->indexToAssign < pa->first.size()) {
+                pa->expr->setTag(new IndexTag(pa->first[pa->indexToAssign]));
+            }
+            else {
+                const size_t i = pa->indexToAssign - pa->first.size();
+                pa->expr->setTag(new IndexTag(pa->skipScan[i], pa->skipScanPositions[i]));
+            }
         }
         else if (NULL != assign->orAssignment) {
             OrAssignment* oa = assign->orAssignment.get();
@@ -1198,7 +1280,7 @@ namespace mongo {
         if (NULL != assign->pred) {
             PredicateAssignment* pa = assign->pred.get();
             pa->indexToAssign++;
-            if (pa->indexToAssign >= pa->first.size()) {
+            if (pa->indexToAssign >= pa->first.size() + pa->skipScan.size()) {
                 pa->indexToAssign = 0;
                 return true;
             }
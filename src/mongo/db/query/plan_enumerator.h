@@ -43,6 +43,7 @@ namespace mongo {
     struct PlanEnumeratorParams {
 
         PlanEnumeratorParams() : intersect(false),
+                                 skipScan(false),
                                  maxSolutionsPerOr(internalQueryEnumerationMaxOrSolutions),
                                  maxIntersectPerAnd(internalQueryEnumerationMaxIntersectPerAnd) { }
 
@@ -50,6 +51,10 @@ namespace mongo {
         // an indexed solution?
         bool intersect;
 
+        // Do we provide solutions that use a compound index without a predicate over its leading
+        // field?
+        bool skipScan;
+
         // Not owned here.
         MatchExpression* root;
 
@@ -178,12 +183,19 @@ namespace mongo {
             PredicateAssignment() : indexToAssign(0) { }
 
             std::vector<IndexID> first;
+
+            // Compound indices the predicate can use by skipping over their leading fields, and
+            // the position of the predicate's field in each.  Parallel arrays.
+            std::vector<IndexID> skipScan;
+            std::vector<size_t> skipScanPositions;
+
             // Not owned here.
             MatchExpression* expr;
 
             // Enumeration state.  An indexed predicate's possible states are the indices that the
-            // predicate can directly use (the 'first' indices).  As such this value ranges from 0
-            // to first.size()-1 inclusive.
+            // predicate can directly use (the 'first' indices), followed by the 'skipScan'
+            // indices.  As such this value ranges from 0 to first.size()+skipScan.size()-1
+            // inclusive.
             size_t indexToAssign;
         };
 
@@ -399,6 +411,13 @@ namespace mongo {
                                      const std::set<IndexID>& mandatoryIndices,
                                      AndAssignment* andAssignment);
 
+        /**
+         * Returns true if we may scan the index 'idx' without any predicate over its leading
+         * field, relying on the scan to seek past each value of the fields it isn't given bounds
+         * for.  Only done for plain btree indices which are neither multikey, sparse, nor partial.
+         */
+        bool canSkipScan(IndexID idx) const;
+
         /**
          * Try to assign predicates in 'tryCompound' to 'thisIndex' as compound assignments.
          * Output the assignments in 'assign'.
@@ -438,6 +457,9 @@ namespace mongo {
         // Do we output >1 index per AND (index intersection)?
         bool _ixisect;
 
+        // Do we output assignments which skip over the leading field of an index?
+        bool _skipScan;
+
         // How many enumerations are we willing to produce from each OR?
         size_t _orLimit;
 
@@ -43,6 +43,7 @@
 #include "mongo/db/exec/working_set_common.h"
 #include "mongo/db/service_context.h"
 #include "mongo/db/query/plan_yield_policy.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/storage/record_fetcher.h"
 
 #include "mongo/util/stacktrace.h"
@@ -156,7 +157,9 @@ namespace mongo {
           _qs(qs),
           _root(rt),
           _ns(ns),
-          _yieldPolicy(new PlanYieldPolicy(this, YIELD_MANUAL)) {
+          _yieldPolicy(new PlanYieldPolicy(this, YIELD_MANUAL)),
+          _batchState(PlanStage::NEED_TIME),
+          _batchStateId(WorkingSet::INVALID_ID) {
         // We may still need to initialize _ns from either _collection or _cq.
         if (!_ns.empty()) {
             // We already have an _ns set, so there's nothing more to do.
@@ -253,6 +256,16 @@ namespace mongo {
             _root->saveState();
         }
 
+        // Results buffered from a batch outlive the snapshot they were read in, and on MMAP v1
+        // index keys point into bucket memory which may change once we give up our locks.
+        for (std::deque<WorkingSetID>::const_iterator it = _batchResults.begin();
+             it != _batchResults.end();
+             ++it) {
+            if (WorkingSet::INVALID_ID != *it) {
+                _workingSet->get(*it)->makeObjOwned();
+            }
+        }
+
         // Doc-locking storage engines drop their transactional context after saving state.
         // The query stages inside this stage tree might buffer record ids (e.g. text, geoNear,
         // mergeSort, sort) which are no longer protected by the storage engine's transactional
@@ -296,7 +309,22 @@ namespace mongo {
     }
 
     void PlanExecutor::invalidate(OperationContext* txn, const RecordId& dl, InvalidationType type) {
-        if (!killed()) { _root->invalidate(txn, dl, type); }
+        if (killed()) { return; }
+
+        _root->invalidate(txn, dl, type);
+
+        // Results we've buffered from a batch are ours to protect, just as a stage would.
+        for (std::deque<WorkingSetID>::const_iterator it = _batchResults.begin();
+             it != _batchResults.end();
+             ++it) {
+            if (WorkingSet::INVALID_ID == *it) {
+                continue;
+            }
+            WorkingSetMember* member = _workingSet->get(*it);
+            if (member->hasLoc() && member->loc == dl) {
+                WorkingSetCommon::fetchAndInvalidateLoc(txn, member, _collection);
+            }
+        }
     }
 
     PlanExecutor::ExecState PlanExecutor::getNext(BSONObj* objOut, RecordId* dlOut) {
@@ -343,8 +371,9 @@ namespace mongo {
             //   1) The yield policy's timer elapsed, or
             //   2) some stage requested a yield due to a document fetch, or
             //   3) we need to yield and retry due to a WriteConflictException.
-            // In all cases, the actual yielding happens here.
-            if (_yieldPolicy->shouldYield()) {
+            // In all cases, the actual yielding happens here.  We don't yield while handing out
+            // the results of a batch.
+            if (_batchResults.empty() && _yieldPolicy->shouldYield()) {
                 _yieldPolicy->yield(fetcher.get());
 
                 if (killed()) {
@@ -365,7 +394,7 @@ namespace mongo {
             fetcher.reset();
 
             WorkingSetID id = WorkingSet::INVALID_ID;
-            PlanStage::StageState code = _root->work(&id);
+            PlanStage::StageState code = workRoot(&id);
 
             if (code != PlanStage::NEED_YIELD)
                 writeConflictsInARow = 0;
@@ -467,7 +496,35 @@ namespace mongo {
     }
 
     bool PlanExecutor::isEOF() {
-        return killed() || (_stash.empty() && _root->isEOF());
+        return killed() || (_stash.empty()
+                            && _batchResults.empty()
+                            && PlanStage::NEED_TIME == _batchState
+                            && _root->isEOF());
+    }
+
+    PlanStage::StageState PlanExecutor::workRoot(WorkingSetID* out) {
+        if (_batchResults.empty() && PlanStage::NEED_TIME == _batchState) {
+            const int batchSize = internalQueryExecWorkBatchSize;
+            if (batchSize <= 1) {
+                return _root->work(out);
+            }
+
+            std::vector<WorkingSetID> results;
+            _batchState = _root->workBatch(batchSize, &results, &_batchStateId);
+            _batchResults.assign(results.begin(), results.end());
+        }
+
+        if (!_batchResults.empty()) {
+            *out = _batchResults.front();
+            _batchResults.pop_front();
+            return PlanStage::ADVANCED;
+        }
+
+        const PlanStage::StageState state = _batchState;
+        *out = _batchStateId;
+        _batchState = PlanStage::NEED_TIME;
+        _batchStateId = WorkingSet::INVALID_ID;
+        return state;
     }
 
     void PlanExecutor::registerExec() {
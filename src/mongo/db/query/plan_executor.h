@@ -30,9 +30,11 @@
 
 #include <boost/optional.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <deque>
 #include <queue>
 
 #include "mongo/base/status.h"
+#include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/invalidation_type.h"
 #include "mongo/db/query/query_solution.h"
 #include "mongo/db/storage/snapshot.h"
@@ -410,6 +412,13 @@ namespace mongo {
 
         bool killed() { return static_cast<bool>(_killReason); };
 
+        /**
+         * Gets the next result or state from the root stage.  With internalQueryExecWorkBatchSize
+         * set this hands out what the last call to workBatch() produced, and only works the root
+         * again once that is used up.
+         */
+        PlanStage::StageState workRoot(WorkingSetID* out);
+
         // The OperationContext that we're executing within.  We need this in order to release
         // locks.
         OperationContext* _opCtx;
@@ -442,6 +451,13 @@ namespace mongo {
         // to consume yet. We empty the queue before retrieving further results from the plan
         // stages.
         std::queue<BSONObj> _stash;
+
+        // Results of the last call to workBatch() on the root stage not yet returned by getNext(),
+        // followed by the state which ended that batch, or NEED_TIME if there was none.  We only
+        // yield once these are used up, but the caller may save state with results still here.
+        std::deque<WorkingSetID> _batchResults;
+        PlanStage::StageState _batchState;
+        WorkingSetID _batchStateId;
     };
 
 }  // namespace mongo
@@ -101,7 +101,9 @@ namespace mongo {
                    << Explain::getPlanSummary(candidates[i].root)
                    << " planHitEOF=" << statTrees[i]->common.isEOF;
 
-            double score = scoreTree(statTrees[i]);
+            // A pruned plan never did any work, so it has nothing to score and gets the "no
+            // plan selected" score of 0.
+            double score = candidates[i].pruned ? 0 : scoreTree(statTrees[i]);
             LOG(5) << "score = " << score << endl;
             if (statTrees[i]->common.isEOF) {
                 LOG(5) << "Adding +" << eofBonus << " EOF bonus to score." << endl;
@@ -69,7 +69,7 @@ namespace mongo {
      */
     struct CandidatePlan {
         CandidatePlan(QuerySolution* s, PlanStage* r, WorkingSet* w)
-            : solution(s), root(r), ws(w), failed(false) { }
+            : solution(s), root(r), ws(w), failed(false), pruned(false) { }
 
         QuerySolution* solution;
         PlanStage* root;
@@ -79,6 +79,10 @@ namespace mongo {
         std::list<WorkingSetID> results;
 
         bool failed;
+
+        // Set if the plan was left out of the trial period because its estimated cost was too
+        // high.  Pruned plans are ranked below all others.
+        bool pruned;
     };
 
     /**
@@ -159,6 +159,7 @@ namespace mongo {
             IndexScanNode* isn = new IndexScanNode();
             isn->indexKeyPattern = index.keyPattern;
             isn->indexIsMultiKey = index.multikey;
+            isn->indexMultikeyFields = index.multikeyFields;
             isn->bounds.fields.resize(index.keyPattern.nFields());
             isn->maxScan = query.getParsed().getMaxScan();
             isn->addKeyMetadata = query.getParsed().returnKey();
@@ -1172,6 +1173,7 @@ namespace mongo {
         IndexScanNode* isn = new IndexScanNode();
         isn->indexKeyPattern = index.keyPattern;
         isn->indexIsMultiKey = index.multikey;
+        isn->indexMultikeyFields = index.multikeyFields;
         isn->maxScan = query.getParsed().getMaxScan();
         isn->addKeyMetadata = query.getParsed().returnKey();
 
@@ -1320,6 +1322,7 @@ namespace mongo {
         IndexScanNode* isn = new IndexScanNode();
         isn->indexKeyPattern = index.keyPattern;
         isn->indexIsMultiKey = index.multikey;
+        isn->indexMultikeyFields = index.multikeyFields;
         isn->direction = 1;
         isn->maxScan = query.getParsed().getMaxScan();
         isn->addKeyMetadata = query.getParsed().returnKey();
@@ -209,6 +209,7 @@ namespace mongo {
                 child->maxScan = isn->maxScan;
                 child->addKeyMetadata = isn->addKeyMetadata;
                 child->indexIsMultiKey = isn->indexIsMultiKey;
+                child->indexMultikeyFields = isn->indexMultikeyFields;
 
                 // Copy the filter, if there is one.
                 if (isn->filter.get()) {
@@ -655,8 +656,9 @@ namespace mongo {
             }
             else if (!query.getProj()->wantIndexKey()) {
                 // The only way we're here is if it's a simple projection.  That is, we can pick out
-                // the fields we want to include and they're not dotted.  So we want to execute the
-                // projection in the fast-path simple fashion.  Just don't know which fast path yet.
+                // the fields we want to include, some of which may be dotted.  So we want to
+                // execute the projection in the fast-path simple fashion.  Just don't know which
+                // fast path yet.
                 LOG(5) << "PROJECTION: requires fields\n";
                 const vector<string>& fields = query.getProj()->getRequiredFields();
                 bool covered = true;
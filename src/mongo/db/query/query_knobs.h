@@ -45,6 +45,14 @@ namespace mongo {
     // Stop working plans once a plan returns this many results.
     extern int internalQueryPlanEvaluationMaxResults;
 
+    // Before the trial period, count the keys each candidate's index scans would examine, giving
+    // up on a scan after this many keys.  0 turns the estimates, and the pruning, off.
+    extern int internalQueryPlanEvaluationEstimateMaxKeys;
+
+    // Candidates estimated to examine more than this many times as many keys or documents as the
+    // cheapest candidate are left out of the trial period.
+    extern double internalQueryPlanEvaluationPruneRatio;
+
     // Do we give a big ranking bonus to intersection plans?
     extern bool internalQueryForceIntersectionPlans;
 
@@ -54,6 +62,9 @@ namespace mongo {
     // Do we use hash-based intersection for rooted $and queries?
     extern bool internalQueryPlannerEnableHashIntersection;
 
+    // Do we consider compound indices whose leading fields the query doesn't constrain?
+    extern bool internalQueryPlannerEnableSkipScan;
+
     //
     // plan cache
     //
@@ -72,6 +83,10 @@ namespace mongo {
     // How many write ops should we allow in a collection before tossing all cache entries?
     extern int internalQueryCacheWriteOpsBetweenFlush;
 
+    // Do we keep a QuerySolutionTemplate in cache entries for queries which only compare fields
+    // to scalars, and bind later queries of the same shape to it instead of planning from cache?
+    extern bool internalQueryCacheSolutionTemplates;
+
     //
     // Planning and enumeration.
     //
@@ -98,6 +113,23 @@ namespace mongo {
 
     extern int internalQueryExecMaxBlockingSortBytes;
 
+    // Should a blocking sort which needs more than internalQueryExecMaxBlockingSortBytes write
+    // sorted runs to disk and merge them instead of failing?
+    extern bool internalQueryExecBlockingSortAllowDiskUse;
+
+    // How many units of work a PlanExecutor asks of its root stage at once.  0 or 1 runs the
+    // plan a call to work() at a time.
+    extern int internalQueryExecWorkBatchSize;
+
+    // Should collection scans and fetches match their filter with a CompiledMatchExpression?
+    // Off by default.
+    extern bool internalQueryExecCompileFilters;
+
+    // How many threads an unsorted collection scan with a filter may use to apply the filter.
+    // The threads come from one pool per process, with a thread per core.  0 runs the scan on
+    // the operation's thread as a plain CollectionScan.
+    extern int internalQueryExecParallelCollectionScanThreads;
+
     // Yield after this many "should yield?" checks.
     extern int internalQueryExecYieldIterations;
 
@@ -98,6 +98,9 @@ namespace mongo {
         if (options & QueryPlannerParams::INDEX_INTERSECTION) {
             ss << "INDEX_INTERSECTION ";
         }
+        if (options & QueryPlannerParams::SKIP_SCAN) {
+            ss << "SKIP_SCAN ";
+        }
         if (options & QueryPlannerParams::KEEP_MUTATIONS) {
             ss << "KEEP_MUTATIONS";
         }
@@ -233,6 +236,50 @@ namespace mongo {
         return QueryPlannerAnalysis::analyzeDataAccess(query, params, solnRoot);
     }
 
+    /**
+     * Returns true if 'node' has an index scan which constrains some field of a compound index
+     * but not the leading one.  The planner only makes those when skip scanning.
+     */
+    static bool hasSkipScan(const QuerySolutionNode* node) {
+        if (STAGE_IXSCAN == node->getType()) {
+            const IndexBounds& bounds = static_cast<const IndexScanNode*>(node)->bounds;
+            if (bounds.isSimpleRange || bounds.fields.size() < 2) {
+                return false;
+            }
+
+            const OrderedIntervalList& leading = bounds.fields[0];
+            if (1 != leading.intervals.size()) {
+                return false;
+            }
+            const Interval& ival = leading.intervals[0];
+            const bool leadingUnbounded =
+                (MinKey == ival.start.type() && MaxKey == ival.end.type())
+                || (MaxKey == ival.start.type() && MinKey == ival.end.type());
+            if (!leadingUnbounded) {
+                return false;
+            }
+
+            for (size_t i = 1; i < bounds.fields.size(); ++i) {
+                const OrderedIntervalList& oil = bounds.fields[i];
+                if (1 != oil.intervals.size()
+                    || (MinKey != oil.intervals[0].start.type()
+                        && MaxKey != oil.intervals[0].start.type())
+                    || (MinKey != oil.intervals[0].end.type()
+                        && MaxKey != oil.intervals[0].end.type())) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        for (size_t i = 0; i < node->children.size(); ++i) {
+            if (hasSkipScan(node->children[i])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     bool providesSort(const CanonicalQuery& query, const BSONObj& kp) {
         return query.getParsed().getSort().isPrefixOf(kp);
     }
@@ -736,6 +783,7 @@ namespace mongo {
             // The enumerator spits out trees tagged with IndexTag(s).
             PlanEnumeratorParams enumParams;
             enumParams.intersect = params.options & QueryPlannerParams::INDEX_INTERSECTION;
+            enumParams.skipScan = params.options & QueryPlannerParams::SKIP_SCAN;
             enumParams.root = query.root();
             enumParams.indices = &relevantIndices;
 
@@ -910,6 +958,16 @@ namespace mongo {
         // No indexed plans?  We must provide a collscan if possible or else we can't run the query.
         bool collscanNeeded = (0 == out->size() && canTableScan);
 
+        // If every indexed plan skip scans, it's only a win when the leading fields have few
+        // distinct values.  Let the collscan compete with them.
+        if (canTableScan && (params.options & QueryPlannerParams::SKIP_SCAN)) {
+            bool allSkipScans = !out->empty();
+            for (size_t i = 0; i < out->size() && allSkipScans; ++i) {
+                allSkipScans = hasSkipScan((*out)[i]->root.get());
+            }
+            collscanNeeded = collscanNeeded || allSkipScans;
+        }
+
         if (possibleToCollscan && (collscanRequested || collscanNeeded)) {
             QuerySolution* collscan = buildCollscanSoln(query, false, params);
             if (NULL != collscan) {
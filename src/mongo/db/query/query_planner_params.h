@@ -86,6 +86,11 @@ namespace mongo {
             // Set this to prevent the planner from generating plans which answer a predicate
             // implicitly via exact index bounds for index intersection solutions.
             CANNOT_TRIM_IXISECT = 1 << 8,
+
+            // Set this if you want the planner to use compound indices which only have predicates
+            // over their trailing fields.  The index scan seeks past each value of the leading
+            // fields, which is cheap when they have few distinct values.
+            SKIP_SCAN = 1 << 9,
         };
 
         // See Options enum above.
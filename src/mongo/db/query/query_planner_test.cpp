@@ -1029,14 +1029,43 @@ namespace {
     }
 
     TEST_F(QueryPlannerTest, DottedFieldCovering) {
+        // 'a.b' has never held an array.
         addIndex(BSON("a.b" << 1));
+        params.indices.back().multikeyFields = 0U;
         runQuerySortProj(fromjson("{'a.b': 5}"), BSONObj(), fromjson("{_id: 0, 'a.b': 1}"));
 
         ASSERT_EQUALS(getNumSolutions(), 2U);
         assertSolutionExists("{proj: {spec: {_id: 0, 'a.b': 1}, node: "
                                 "{cscan: {dir: 1, filter: {'a.b': 5}}}}}");
-        // SERVER-2104
-        //assertSolutionExists("{proj: {spec: {_id: 0, 'a.b': 1}, node: {'a.b': 1}}}");
+        assertSolutionExists("{proj: {spec: {_id: 0, 'a.b': 1}, node: {ixscan: "
+                                "{filter: null, pattern: {'a.b': 1}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, DottedFieldMayHoldArrayNotCovered) {
+        // A single element array such as {a: [{b: 5}]} doesn't make the index multikey.
+        addIndex(BSON("a.b" << 1));
+        params.indices.back().multikeyFields = 1U;
+        runQuerySortProj(fromjson("{'a.b': 5}"), BSONObj(), fromjson("{_id: 0, 'a.b': 1}"));
+
+        ASSERT_EQUALS(getNumSolutions(), 2U);
+        assertSolutionExists("{proj: {spec: {_id: 0, 'a.b': 1}, node: {fetch: {filter: null, "
+                                "node: {ixscan: {filter: null, pattern: {'a.b': 1}}}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, MultikeyCoveringNonArrayField) {
+        // Only 'a' has held an array.
+        addIndex(BSON("a" << 1 << "b" << 1), true);
+        params.indices.back().multikeyFields = 1U;
+
+        runQuerySortProj(fromjson("{a: 5}"), BSONObj(), fromjson("{_id: 0, b: 1}"));
+        ASSERT_EQUALS(getNumSolutions(), 2U);
+        assertSolutionExists("{proj: {spec: {_id: 0, b: 1}, node: {ixscan: "
+                                "{filter: null, pattern: {a: 1, b: 1}}}}}");
+
+        runQuerySortProj(fromjson("{a: 5}"), BSONObj(), fromjson("{_id: 0, a: 1}"));
+        ASSERT_EQUALS(getNumSolutions(), 2U);
+        assertSolutionExists("{proj: {spec: {_id: 0, a: 1}, node: {fetch: {filter: null, node: "
+                                "{ixscan: {filter: null, pattern: {a: 1, b: 1}}}}}}}");
     }
 
     TEST_F(QueryPlannerTest, IdCovering) {
@@ -2404,6 +2433,82 @@ namespace {
                                  "b:[['bar',{},true,false]]}}}}}");
     }
 
+    //
+    // Skip scans of compound indices without a predicate over the leading field
+    //
+
+    TEST_F(QueryPlannerTest, SkipScanRequiresOption) {
+        addIndex(BSON("a" << 1 << "b" << 1));
+        runQuery(fromjson("{b: 5}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{cscan: {dir: 1, filter: {b: 5}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanTrailingField) {
+        params.options = QueryPlannerParams::SKIP_SCAN;
+        addIndex(BSON("a" << 1 << "b" << 1));
+        runQuery(fromjson("{b: 5}"));
+
+        // The collscan competes with a plan that only skip scans.
+        assertNumSolutions(2U);
+        assertSolutionExists("{cscan: {dir: 1, filter: {b: 5}}}");
+        assertSolutionExists("{fetch: {filter: null, node: {ixscan: {filter: null, pattern: "
+                                "{a: 1, b: 1}, bounds: {a: [['MinKey','MaxKey',true,true]], "
+                                "b: [[5,5,true,true]]}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanCompoundsTrailingFields) {
+        params.options = QueryPlannerParams::SKIP_SCAN | QueryPlannerParams::NO_TABLE_SCAN;
+        addIndex(BSON("a" << 1 << "b" << 1 << "c" << 1));
+        runQuery(fromjson("{b: 5, c: {$gt: 1}}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{fetch: {filter: null, node: {ixscan: {filter: null, pattern: "
+                                "{a: 1, b: 1, c: 1}, bounds: {a: [['MinKey','MaxKey',true,true]], "
+                                "b: [[5,5,true,true]], c: [[1,Infinity,false,true]]}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanAlongsidePrefixedIndex) {
+        params.options = QueryPlannerParams::SKIP_SCAN;
+        addIndex(BSON("a" << 1 << "b" << 1));
+        addIndex(BSON("c" << 1));
+        runQuery(fromjson("{b: 5, c: 6}"));
+
+        // Not every plan skip scans, so there's no collscan.
+        assertNumSolutions(2U);
+        assertSolutionExists("{fetch: {filter: {b: 5}, node: {ixscan: {filter: null, pattern: "
+                                "{c: 1}, bounds: {c: [[6,6,true,true]]}}}}}");
+        assertSolutionExists("{fetch: {filter: {c: 6}, node: {ixscan: {filter: null, pattern: "
+                                "{a: 1, b: 1}, bounds: {a: [['MinKey','MaxKey',true,true]], "
+                                "b: [[5,5,true,true]]}}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanUnderOr) {
+        params.options = QueryPlannerParams::SKIP_SCAN | QueryPlannerParams::NO_TABLE_SCAN;
+        addIndex(BSON("a" << 1 << "b" << 1));
+        addIndex(BSON("c" << 1));
+        runQuery(fromjson("{$or: [{b: 5}, {c: 6}]}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{fetch: {filter: null, node: {or: {nodes: ["
+                                "{ixscan: {filter: null, pattern: {a: 1, b: 1}, "
+                                "bounds: {a: [['MinKey','MaxKey',true,true]], "
+                                "b: [[5,5,true,true]]}}}, "
+                                "{ixscan: {filter: null, pattern: {c: 1}, "
+                                "bounds: {c: [[6,6,true,true]]}}}]}}}}");
+    }
+
+    TEST_F(QueryPlannerTest, SkipScanNotMultikey) {
+        params.options = QueryPlannerParams::SKIP_SCAN;
+        // true means multikey
+        addIndex(BSON("a" << 1 << "b" << 1), true);
+        runQuery(fromjson("{b: 5}"));
+
+        assertNumSolutions(1U);
+        assertSolutionExists("{cscan: {dir: 1, filter: {b: 5}}}");
+    }
+
     TEST_F(QueryPlannerTest, IndexBoundsAndWithNestedOr) {
         addIndex(BSON("a" << 1));
         runQuery(fromjson("{$and: [{a: 1, $or: [{a: 2}, {a: 3}]}]}"));
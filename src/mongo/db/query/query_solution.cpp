@@ -28,6 +28,8 @@
 
 #include "mongo/db/query/query_solution.h"
 
+#include <algorithm>
+
 #include "mongo/db/index_names.h"
 #include "mongo/db/matcher/expression_geo.h"
 #include "mongo/db/query/planner_analysis.h"
@@ -156,25 +158,14 @@ namespace mongo {
     }
 
     bool AndHashNode::fetched() const {
-        // Any WSM output from this stage came from all children stages.  If any child provides
-        // fetched data, we merge that fetched data into the WSM we output.
-        for (size_t i = 0; i < children.size(); ++i) {
-            if (children[i]->fetched()) {
-                return true;
-            }
-        }
-        return false;
+        // The stage only keeps the RecordIds of the other children, so the WSMs it outputs are
+        // the ones of its last child.
+        return children.back()->fetched();
     }
 
     bool AndHashNode::hasField(const string& field) const {
-        // Any WSM output from this stage came from all children stages.  Therefore we have all
-        // fields covered in our children.
-        for (size_t i = 0; i < children.size(); ++i) {
-            if (children[i]->hasField(field)) {
-                return true;
-            }
-        }
-        return false;
+        // Only the last child's index keys make it into our output.
+        return children.back()->hasField(field);
     }
 
     QuerySolutionNode* AndHashNode::clone() const {
@@ -397,7 +388,11 @@ namespace mongo {
     //
 
     IndexScanNode::IndexScanNode()
-        : indexIsMultiKey(false), direction(1), maxScan(0), addKeyMetadata(false) { }
+        : indexIsMultiKey(false),
+          indexMultikeyFields(~0U),
+          direction(1),
+          maxScan(0),
+          addKeyMetadata(false) { }
 
     void IndexScanNode::appendToString(mongoutils::str::stream* ss, int indent) const {
         addIndent(ss, indent);
@@ -416,19 +411,25 @@ namespace mongo {
     }
 
     bool IndexScanNode::hasField(const string& field) const {
-        // There is no covering in a multikey index because you don't know whether or not the field
-        // in the key was extracted from an array in the original document.
-        if (indexIsMultiKey) { return false; }
-
         // Custom index access methods may return non-exact key data - this function is currently
         // used for covering exact key data only.
         if (IndexNames::BTREE != IndexNames::findPluginName(indexKeyPattern)) { return false; }
 
+        size_t fieldIdx = 0;
         BSONObjIterator it(indexKeyPattern);
         while (it.more()) {
             if (field == it.next().fieldName()) {
-                return true;
+                // There is no covering a field which may hold arrays, because you don't know
+                // whether or not the value in the key was extracted from an array in the original
+                // document.  A single element array such as { a : [ 5 ] } doesn't make the index
+                // multikey, so only the top level fields of an index which isn't multikey are
+                // covered regardless, as they always were.
+                if (!indexIsMultiKey && std::string::npos == field.find('.')) {
+                    return true;
+                }
+                return !(indexMultikeyFields & (1U << std::min(fieldIdx, size_t(31))));
             }
+            ++fieldIdx;
         }
         return false;
     }
@@ -570,6 +571,7 @@ namespace mongo {
         copy->_sorts = this->_sorts;
         copy->indexKeyPattern = this->indexKeyPattern;
         copy->indexIsMultiKey = this->indexIsMultiKey;
+        copy->indexMultikeyFields = this->indexMultikeyFields;
         copy->direction = this->direction;
         copy->maxScan = this->maxScan;
         copy->addKeyMetadata = this->addKeyMetadata;
@@ -614,6 +616,8 @@ namespace mongo {
         // This MatchExpression* is owned by the canonical query, not by the
         // ProjectionNode. Just copying the pointer is fine.
         copy->projection = this->projection;
+        copy->projType = this->projType;
+        copy->coveredKeyObj = this->coveredKeyObj;
 
         return copy;
     }
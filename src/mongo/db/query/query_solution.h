@@ -406,6 +406,9 @@ namespace mongo {
         BSONObj indexKeyPattern;
         bool indexIsMultiKey;
 
+        // Which fields of the key pattern may hold arrays.  See IndexEntry::multikeyFields.
+        uint32_t indexMultikeyFields;
+
         int direction;
 
         // maxScan option to .find() limits how many docs we look at.
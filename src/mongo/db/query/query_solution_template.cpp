@@ -0,0 +1,370 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/db/query/query_solution_template.h"
+
+#include "mongo/db/index_names.h"
+#include "mongo/db/matcher/expression_leaf.h"
+#include "mongo/db/query/index_bounds_builder.h"
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+
+    using std::auto_ptr;
+    using std::vector;
+
+    namespace {
+
+        /**
+         * A $eq predicate of the query.  Both members point into the query's filter.
+         */
+        struct Parameter {
+            StringData path;
+            BSONElement value;
+        };
+        typedef vector<Parameter> Parameters;
+
+        /**
+         * True if an $eq to 'value' is answered by a single point interval on a btree index, with
+         * exact bounds.  Null, arrays and objects are not because of the way they are indexed.
+         */
+        bool isBindableValue(const BSONElement& value) {
+            switch (value.type()) {
+            case NumberDouble:
+            case NumberInt:
+            case NumberLong:
+            case String:
+            case jstOID:
+            case Bool:
+            case Date:
+            case bsonTimestamp:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        /**
+         * Fills out 'parametersOut' with the predicates of 'query' and returns true if they are
+         * all $eq on distinct paths to bindable values, false otherwise.
+         */
+        bool getParameters(const CanonicalQuery& query, Parameters* parametersOut) {
+            const MatchExpression* root = query.root();
+            const bool isAnd = MatchExpression::AND == root->matchType();
+            const size_t numLeaves = isAnd ? root->numChildren() : 1;
+
+            for (size_t i = 0; i < numLeaves; ++i) {
+                const MatchExpression* leaf = isAnd ? root->getChild(i) : root;
+                if (MatchExpression::EQ != leaf->matchType()) {
+                    return false;
+                }
+
+                Parameter parameter;
+                parameter.path = leaf->path();
+                parameter.value = static_cast<const ComparisonMatchExpression*>(leaf)->getData();
+                if (!isBindableValue(parameter.value)) {
+                    return false;
+                }
+
+                for (size_t j = 0; j < parametersOut->size(); ++j) {
+                    if ((*parametersOut)[j].path == parameter.path) {
+                        return false;
+                    }
+                }
+                parametersOut->push_back(parameter);
+            }
+
+            return true;
+        }
+
+        const Parameter* findParameter(StringData path, const Parameters& parameters) {
+            for (size_t i = 0; i < parameters.size(); ++i) {
+                if (parameters[i].path == path) {
+                    return &parameters[i];
+                }
+            }
+            return NULL;
+        }
+
+        bool isAllValues(const Interval& interval) {
+            return (MinKey == interval.start.type() && MaxKey == interval.end.type())
+                || (MaxKey == interval.start.type() && MinKey == interval.end.type());
+        }
+
+        /**
+         * True if every leaf of 'filter' is an $eq on the path of one of 'parameters'.
+         */
+        bool isBindableFilter(const MatchExpression* filter, const Parameters& parameters) {
+            if (MatchExpression::AND == filter->matchType()) {
+                for (size_t i = 0; i < filter->numChildren(); ++i) {
+                    if (!isBindableFilter(filter->getChild(i), parameters)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            return MatchExpression::EQ == filter->matchType()
+                && NULL != findParameter(filter->path(), parameters);
+        }
+
+        /**
+         * True if the only values in the tree rooted at 'node' are in filters accepted by
+         * isBindableFilter(), and in the index bounds as a point interval on the path of one of
+         * 'parameters' with its value.
+         */
+        bool isBindableNode(const QuerySolutionNode* node, const Parameters& parameters) {
+            if (NULL != node->filter && !isBindableFilter(node->filter.get(), parameters)) {
+                return false;
+            }
+
+            switch (node->getType()) {
+            case STAGE_AND_HASH:
+            case STAGE_AND_SORTED:
+            case STAGE_COLLSCAN:
+            case STAGE_FETCH:
+            case STAGE_KEEP_MUTATIONS:
+            case STAGE_LIMIT:
+            case STAGE_OR:
+            case STAGE_PROJECTION:
+            case STAGE_SHARDING_FILTER:
+            case STAGE_SKIP:
+            case STAGE_SORT:
+                break;
+            case STAGE_IXSCAN: {
+                const IndexScanNode* isn = static_cast<const IndexScanNode*>(node);
+                if (IndexNames::BTREE != IndexNames::findPluginName(isn->indexKeyPattern)
+                    || isn->bounds.isSimpleRange) {
+                    return false;
+                }
+
+                for (size_t i = 0; i < isn->bounds.fields.size(); ++i) {
+                    const OrderedIntervalList& oil = isn->bounds.fields[i];
+                    const Parameter* parameter = findParameter(oil.name, parameters);
+                    if (NULL == parameter) {
+                        continue;
+                    }
+
+                    if (1 != oil.intervals.size()) {
+                        return false;
+                    }
+
+                    const Interval& interval = oil.intervals[0];
+                    if (!isAllValues(interval)
+                        && !(interval.isPoint()
+                             && 0 == interval.start.woCompare(parameter->value, false))) {
+                        return false;
+                    }
+                }
+                break;
+            }
+            default:
+                return false;
+            }
+
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                if (!isBindableNode(node->children[i], parameters)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool bindFilter(const Parameters& parameters, MatchExpression* filter) {
+            if (MatchExpression::AND == filter->matchType()) {
+                for (size_t i = 0; i < filter->numChildren(); ++i) {
+                    if (!bindFilter(parameters, filter->getChild(i))) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            const Parameter* parameter = findParameter(filter->path(), parameters);
+            if (MatchExpression::EQ != filter->matchType() || NULL == parameter) {
+                return false;
+            }
+            return static_cast<ComparisonMatchExpression*>(filter)->init(parameter->path,
+                                                                         parameter->value).isOK();
+        }
+
+        /**
+         * Puts the values in 'parameters' into the filters and index bounds of the tree rooted
+         * at 'node', and points it at 'query'.  Returns false if a filter leaf has no parameter.
+         */
+        bool bindNode(const CanonicalQuery& query,
+                      const Parameters& parameters,
+                      QuerySolutionNode* node) {
+            if (NULL != node->filter && !bindFilter(parameters, node->filter.get())) {
+                return false;
+            }
+
+            switch (node->getType()) {
+            case STAGE_IXSCAN: {
+                IndexScanNode* isn = static_cast<IndexScanNode*>(node);
+                for (size_t i = 0; i < isn->bounds.fields.size(); ++i) {
+                    OrderedIntervalList& oil = isn->bounds.fields[i];
+                    const Parameter* parameter = findParameter(oil.name, parameters);
+                    if (NULL != parameter && oil.intervals[0].isPoint()) {
+                        oil.intervals[0] = IndexBoundsBuilder::makePointInterval(
+                            IndexBoundsBuilder::objFromElement(parameter->value));
+                    }
+                }
+                break;
+            }
+            case STAGE_PROJECTION: {
+                ProjectionNode* pn = static_cast<ProjectionNode*>(node);
+                pn->fullExpression = query.root();
+                pn->projection = query.getParsed().getProj();
+                break;
+            }
+            case STAGE_SORT: {
+                SortNode* sn = static_cast<SortNode*>(node);
+                sn->pattern = query.getParsed().getSort();
+                sn->query = query.getParsed().getFilter();
+                break;
+            }
+            default:
+                break;
+            }
+
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                if (!bindNode(query, parameters, node->children[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    }  // namespace
+
+    QuerySolutionTemplate::QuerySolutionTemplate(const CanonicalQuery& query,
+                                                 const QueryPlannerParams& params)
+        : _hasBlockingStage(false),
+          _indexFilterApplied(params.indexFiltersApplied),
+          _plannerOptions(params.options),
+          _shardKey(params.shardKey.getOwned()),
+          _skip(query.getParsed().getSkip()),
+          _limit(query.getParsed().getLimit()),
+          _batchSize(query.getParsed().getBatchSize()),
+          _wantMore(query.getParsed().wantMore()),
+          _fromFindCommand(query.getParsed().fromFindCommand()),
+          _maxScan(query.getParsed().getMaxScan()),
+          _returnKey(query.getParsed().returnKey()) {
+        for (size_t i = 0; i < params.indices.size(); ++i) {
+            _indexIsMultiKey.push_back(params.indices[i].multikey);
+            _indexMultikeyFields.push_back(params.indices[i].multikeyFields);
+        }
+    }
+
+    // static
+    QuerySolutionTemplate* QuerySolutionTemplate::make(const CanonicalQuery& query,
+                                                       const QueryPlannerParams& params,
+                                                       const QuerySolution& soln) {
+        // A count turns the solution into a COUNT_SCAN once it is planned.
+        if (NULL == soln.root || (params.options & QueryPlannerParams::PRIVATE_IS_COUNT)) {
+            return NULL;
+        }
+
+        // Whether a partial index can be used depends on the values.
+        for (size_t i = 0; i < params.indices.size(); ++i) {
+            if (NULL != params.indices[i].filterExpr) {
+                return NULL;
+            }
+        }
+
+        Parameters parameters;
+        if (!getParameters(query, &parameters) || !isBindableNode(soln.root.get(), parameters)) {
+            return NULL;
+        }
+
+        // The filters of the clone point into the query's filter, which is owned and kept alive
+        // by _filterData.  ProjectionNode::fullExpression points into the query itself, but
+        // bind() always replaces it.
+        auto_ptr<QuerySolutionTemplate> solutionTemplate(new QuerySolutionTemplate(query, params));
+        solutionTemplate->_root.reset(soln.root->clone());
+        solutionTemplate->_filterData = soln.filterData;
+        solutionTemplate->_hasBlockingStage = soln.hasBlockingStage;
+        invariant(solutionTemplate->_filterData.isOwned());
+        return solutionTemplate.release();
+    }
+
+    QuerySolution* QuerySolutionTemplate::bind(const CanonicalQuery& query,
+                                               const QueryPlannerParams& params) const {
+        if (!matchesOptions(query, params)) {
+            return NULL;
+        }
+
+        Parameters parameters;
+        if (!getParameters(query, &parameters)) {
+            return NULL;
+        }
+
+        auto_ptr<QuerySolutionNode> root(_root->clone());
+        if (!bindNode(query, parameters, root.get())) {
+            return NULL;
+        }
+
+        auto_ptr<QuerySolution> soln(new QuerySolution());
+        soln->root.reset(root.release());
+        soln->filterData = query.getQueryObj();
+        soln->hasBlockingStage = _hasBlockingStage;
+        soln->indexFilterApplied = _indexFilterApplied;
+        return soln.release();
+    }
+
+    bool QuerySolutionTemplate::matchesOptions(const CanonicalQuery& query,
+                                               const QueryPlannerParams& params) const {
+        const LiteParsedQuery& lpq = query.getParsed();
+        if (params.options != _plannerOptions
+            || params.indexFiltersApplied != _indexFilterApplied
+            || params.indices.size() != _indexIsMultiKey.size()
+            || params.shardKey != _shardKey
+            || lpq.getSkip() != _skip
+            || lpq.getLimit() != _limit
+            || lpq.getBatchSize() != _batchSize
+            || lpq.wantMore() != _wantMore
+            || lpq.fromFindCommand() != _fromFindCommand
+            || lpq.getMaxScan() != _maxScan
+            || lpq.returnKey() != _returnKey) {
+            return false;
+        }
+
+        for (size_t i = 0; i < params.indices.size(); ++i) {
+            if (params.indices[i].multikey != _indexIsMultiKey[i]
+                || params.indices[i].multikeyFields != _indexMultikeyFields[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+}  // namespace mongo
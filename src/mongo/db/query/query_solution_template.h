@@ -0,0 +1,106 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/query/canonical_query.h"
+#include "mongo/db/query/query_planner_params.h"
+#include "mongo/db/query/query_solution.h"
+
+namespace mongo {
+
+    /**
+     * A QuerySolution built from the plan cache with the values of the query taken out, so that
+     * it can be reused for any other query of the same shape.
+     *
+     * planFromCache() tags a copy of the query with the cached indices, builds the access plan
+     * and index bounds, and then adds sort, projection, skip and limit, for every query it is
+     * handed.  When all the query does is compare fields to scalars, such as {a: 5, b: "x"},
+     * the resulting solution only depends on the values in two ways: through the $eq leaves in
+     * its filters and through the point intervals in its index bounds.  bind() clones the
+     * template and puts the new query's values in those places, which is much cheaper than
+     * planning.
+     *
+     * A template is only made when every filter leaf and every point interval in the solution
+     * is accounted for by one of the query's $eq predicates, and it can only be bound to a
+     * query whose planner parameters and non-filter options (skip, limit, ...) are the same.
+     * Anything else is left to planFromCache().
+     */
+    class QuerySolutionTemplate {
+        MONGO_DISALLOW_COPYING(QuerySolutionTemplate);
+    public:
+        /**
+         * Returns a template of 'soln', which must have been planned for 'query' with 'params',
+         * or NULL if the solution can't be turned into one.  Does not take ownership.
+         */
+        static QuerySolutionTemplate* make(const CanonicalQuery& query,
+                                           const QueryPlannerParams& params,
+                                           const QuerySolution& soln);
+
+        /**
+         * Returns a new solution for 'query', which must have the same plan cache key as the
+         * query the template was made from, or NULL if the template doesn't apply to it.  The
+         * solution points into 'query', which must outlive it.
+         */
+        QuerySolution* bind(const CanonicalQuery& query, const QueryPlannerParams& params) const;
+
+    private:
+        QuerySolutionTemplate(const CanonicalQuery& query, const QueryPlannerParams& params);
+
+        /**
+         * True if 'query' and 'params' would be planned the same way as the template's query.
+         */
+        bool matchesOptions(const CanonicalQuery& query, const QueryPlannerParams& params) const;
+
+        // The solution, bound to the values of _filterData.
+        boost::scoped_ptr<QuerySolutionNode> _root;
+        BSONObj _filterData;
+        bool _hasBlockingStage;
+        bool _indexFilterApplied;
+
+        // What the solution depends on besides the values.
+        size_t _plannerOptions;
+        std::vector<bool> _indexIsMultiKey;
+        std::vector<uint32_t> _indexMultikeyFields;
+        BSONObj _shardKey;
+        int _skip;
+        boost::optional<int> _limit;
+        boost::optional<int> _batchSize;
+        bool _wantMore;
+        bool _fromFindCommand;
+        int _maxScan;
+        bool _returnKey;
+    };
+
+}  // namespace mongo
@@ -0,0 +1,195 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+/**
+ * This file contains tests for mongo/db/query/query_solution_template.h
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/db/query/query_solution_template.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/db/json.h"
+#include "mongo/db/query/query_planner_test_fixture.h"
+#include "mongo/db/query/query_planner_test_lib.h"
+
+namespace {
+
+    using boost::scoped_ptr;
+    using namespace mongo;
+
+    class QuerySolutionTemplateTest : public QueryPlannerTest {
+    protected:
+        void setUp() {
+            QueryPlannerTest::setUp();
+            // Only the indexed solution is wanted.
+            params.options = QueryPlannerParams::DEFAULT;
+        }
+
+        /**
+         * Makes a template of the only solution of the last query run.
+         */
+        QuerySolutionTemplate* makeTemplate() const {
+            assertNumSolutions(1U);
+            return QuerySolutionTemplate::make(*cq, params, *solns.vector()[0]);
+        }
+
+        /**
+         * Binds 'query', with the same sort and projection as the last query run, to
+         * 'solutionTemplate'.  The query is kept in 'boundQuery'.
+         */
+        QuerySolution* bind(const QuerySolutionTemplate& solutionTemplate, const char* query) {
+            CanonicalQuery* rawCq;
+            ASSERT_OK(CanonicalQuery::canonicalize(ns,
+                                                   fromjson(query),
+                                                   cq->getParsed().getSort(),
+                                                   cq->getParsed().getProj(),
+                                                   0,
+                                                   0,
+                                                   &rawCq));
+            boundQuery.reset(rawCq);
+            return solutionTemplate.bind(*boundQuery, params);
+        }
+
+        void assertBoundTo(const QuerySolution* soln, const std::string& solnJson) const {
+            ASSERT(NULL != soln);
+            if (!QueryPlannerTestLib::solutionMatches(solnJson, soln->root.get())) {
+                FAIL(str::stream() << "Bound solution " << soln->root->toString()
+                                   << " does not match " << solnJson);
+            }
+        }
+
+        scoped_ptr<CanonicalQuery> boundQuery;
+    };
+
+    TEST_F(QuerySolutionTemplateTest, BindsBoundsAndFilter) {
+        addIndex(BSON("a" << 1));
+        runQuery(fromjson("{a: 1, b: 2}"));
+        scoped_ptr<QuerySolutionTemplate> solutionTemplate(makeTemplate());
+        ASSERT(NULL != solutionTemplate.get());
+
+        scoped_ptr<QuerySolution> soln(bind(*solutionTemplate, "{a: 5, b: 'x'}"));
+        assertBoundTo(soln.get(), "{fetch: {filter: {b: 'x'}, node: {ixscan: {pattern: {a: 1}, "
+                                  "bounds: {a: [[5, 5, true, true]]}}}}}");
+        ASSERT_EQUALS(soln->filterData, boundQuery->getQueryObj());
+    }
+
+    TEST_F(QuerySolutionTemplateTest, BindsCompoundBoundsByField) {
+        addIndex(BSON("a" << 1 << "b" << 1));
+        runQuery(fromjson("{a: 1, b: 1}"));
+        scoped_ptr<QuerySolutionTemplate> solutionTemplate(makeTemplate());
+        ASSERT(NULL != solutionTemplate.get());
+
+        scoped_ptr<QuerySolution> soln(bind(*solutionTemplate, "{b: 3, a: 2}"));
+        assertBoundTo(soln.get(), "{fetch: {filter: null, node: {ixscan: {pattern: {a: 1, b: 1}, "
+                                  "bounds: {a: [[2, 2, true, true]], b: [[3, 3, true, true]]}}}}}");
+    }
+
+    TEST_F(QuerySolutionTemplateTest, OutlivesQuery) {
+        addIndex(BSON("a" << 1));
+        runQuery(fromjson("{a: 1, b: 2}"));
+        scoped_ptr<QuerySolutionTemplate> solutionTemplate(makeTemplate());
+        ASSERT(NULL != solutionTemplate.get());
+        solns.clear();
+        cq.reset(NULL);
+        queryObj = BSONObj();
+
+        CanonicalQuery* rawCq;
+        ASSERT_OK(CanonicalQuery::canonicalize(ns, fromjson("{a: 3, b: 4}"), &rawCq));
+        scoped_ptr<CanonicalQuery> query(rawCq);
+        scoped_ptr<QuerySolution> soln(solutionTemplate->bind(*query, params));
+        assertBoundTo(soln.get(), "{fetch: {filter: {b: 4}, node: {ixscan: {pattern: {a: 1}, "
+                                  "bounds: {a: [[3, 3, true, true]]}}}}}");
+    }
+
+    TEST_F(QuerySolutionTemplateTest, KeepsCoveredProjection) {
+        addIndex(BSON("a" << 1 << "b" << 1));
+        runQuerySortProj(fromjson("{a: 1}"), BSONObj(), fromjson("{_id: 0, b: 1}"));
+        scoped_ptr<QuerySolutionTemplate> solutionTemplate(makeTemplate());
+        ASSERT(NULL != solutionTemplate.get());
+
+        scoped_ptr<QuerySolution> soln(bind(*solutionTemplate, "{a: 7}"));
+        assertBoundTo(soln.get(), "{proj: {spec: {_id: 0, b: 1}, node: {ixscan: "
+                                  "{pattern: {a: 1, b: 1}, bounds: {a: [[7, 7, true, true]], "
+                                  "b: [['MinKey', 'MaxKey', true, true]]}}}}}");
+
+        ASSERT_EQUALS(STAGE_PROJECTION, soln->root->getType());
+        const ProjectionNode* pn = static_cast<const ProjectionNode*>(soln->root.get());
+        ASSERT_EQUALS(ProjectionNode::COVERED_ONE_INDEX, pn->projType);
+        ASSERT_EQUALS(boundQuery->root(), pn->fullExpression);
+    }
+
+    TEST_F(QuerySolutionTemplateTest, NotMadeForRangePredicates) {
+        addIndex(BSON("a" << 1));
+        runQuery(fromjson("{a: {$gt: 1}}"));
+        ASSERT(NULL == makeTemplate());
+    }
+
+    TEST_F(QuerySolutionTemplateTest, NotMadeForNull) {
+        addIndex(BSON("a" << 1));
+        runQuery(fromjson("{a: null}"));
+        ASSERT(NULL == makeTemplate());
+    }
+
+    TEST_F(QuerySolutionTemplateTest, NotMadeForHashedIndex) {
+        addIndex(BSON("a" << "hashed"));
+        runQuery(fromjson("{a: 1}"));
+        ASSERT(NULL == makeTemplate());
+    }
+
+    TEST_F(QuerySolutionTemplateTest, NotBoundToUnbindableValues) {
+        addIndex(BSON("a" << 1));
+        runQuery(fromjson("{a: 1}"));
+        scoped_ptr<QuerySolutionTemplate> solutionTemplate(makeTemplate());
+        ASSERT(NULL != solutionTemplate.get());
+
+        ASSERT(NULL == bind(*solutionTemplate, "{a: null}"));
+        ASSERT(NULL == bind(*solutionTemplate, "{a: [1, 2]}"));
+        ASSERT(NULL == bind(*solutionTemplate, "{a: {b: 1}}"));
+    }
+
+    TEST_F(QuerySolutionTemplateTest, NotBoundWithDifferentOptions) {
+        addIndex(BSON("a" << 1));
+        runQuery(fromjson("{a: 1}"));
+        scoped_ptr<QuerySolutionTemplate> solutionTemplate(makeTemplate());
+        ASSERT(NULL != solutionTemplate.get());
+
+        CanonicalQuery* rawCq;
+        ASSERT_OK(CanonicalQuery::canonicalize(ns, fromjson("{a: 2}"), 10, 0, &rawCq));
+        scoped_ptr<CanonicalQuery> skipQuery(rawCq);
+        ASSERT(NULL == solutionTemplate->bind(*skipQuery, params));
+
+        params.indices[0].multikey = true;
+        scoped_ptr<QuerySolution> soln(bind(*solutionTemplate, "{a: 2}"));
+        ASSERT(NULL == soln.get());
+    }
+
+}  // namespace
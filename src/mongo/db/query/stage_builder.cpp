@@ -43,12 +43,14 @@
 #include "mongo/db/exec/limit.h"
 #include "mongo/db/exec/merge_sort.h"
 #include "mongo/db/exec/or.h"
+#include "mongo/db/exec/parallel_collection_scan.h"
 #include "mongo/db/exec/projection.h"
 #include "mongo/db/exec/shard_filter.h"
 #include "mongo/db/exec/sort.h"
 #include "mongo/db/exec/skip.h"
 #include "mongo/db/exec/text.h"
 #include "mongo/db/index/fts_access_method.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/catalog/database.h"
 #include "mongo/util/log.h"
@@ -70,6 +72,12 @@ namespace mongo {
             params.direction = (csn->direction == 1) ? CollectionScanParams::FORWARD
                                                      : CollectionScanParams::BACKWARD;
             params.maxScan = csn->maxScan;
+
+            const int numThreads = internalQueryExecParallelCollectionScanThreads;
+            if (numThreads > 0 && !params.tailable && NULL != csn->filter.get()
+                && ParallelCollectionScan::canParallelize(csn->filter.get())) {
+                return new ParallelCollectionScan(txn, params, ws, csn->filter.get(), numThreads);
+            }
             return new CollectionScan(txn, params, ws, csn->filter.get());
         }
         else if (STAGE_IXSCAN == root->getType()) {
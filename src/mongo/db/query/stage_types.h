@@ -81,6 +81,10 @@ namespace mongo {
         STAGE_MULTI_PLAN,
         STAGE_OPLOG_START,
         STAGE_OR,
+
+        // A collection scan which filters batches of documents on several threads.
+        STAGE_PARALLEL_COLLSCAN,
+
         STAGE_PROJECTION,
 
         // Stage for running aggregation pipelines.
@@ -47,21 +47,26 @@ namespace mongo {
 
     using boost::shared_ptr;
 
+    // Undoes the insert of the records from 'first' to 'last', inclusive.
     class InMemoryRecordStore::InsertChange : public RecoveryUnit::Change {
     public:
-        InsertChange(Data* data, RecordId loc) :_data(data), _loc(loc) {}
+        InsertChange(Data* data, RecordId loc) :_data(data), _first(loc), _last(loc) {}
+        InsertChange(Data* data, RecordId first, RecordId last)
+            :_data(data), _first(first), _last(last) {}
         virtual void commit() {}
         virtual void rollback() {
-            Records::iterator it = _data->records.find(_loc);
-            if (it != _data->records.end()) {
+            Records::iterator it = _data->records.lower_bound(_first);
+            const Records::iterator end = _data->records.upper_bound(_last);
+            while (it != end) {
                 _data->dataSize -= it->second.size;
-                _data->records.erase(it);
+                _data->records.erase(it++);
             }
         }
 
     private:
         Data* const _data;
-        const RecordId _loc;
+        const RecordId _first;
+        const RecordId _last;
     };
 
     // Works for both removes and updates
@@ -292,6 +297,32 @@ namespace mongo {
         return StatusWith<RecordId>(loc);
     }
 
+    Status InMemoryRecordStore::insertRecords(OperationContext* txn,
+                                              const std::vector<RecordData>& records,
+                                              bool enforceQuota,
+                                              std::vector<RecordId>* locsOut) {
+        if (_isCapped || _data->isOplog || records.empty()) {
+            return RecordStore::insertRecords(txn, records, enforceQuota, locsOut);
+        }
+
+        // The ids are consecutive and above all existing ones, so one change covers the batch
+        // and every record goes in at the end of the map.
+        const RecordId first = allocateLoc();
+        for (size_t i = 0; i < records.size(); i++) {
+            const RecordId loc = (i == 0) ? first : allocateLoc();
+
+            InMemoryRecord rec(records[i].size());
+            memcpy(rec.data.get(), records[i].data(), records[i].size());
+
+            _data->dataSize += records[i].size();
+            _data->records.insert(_data->records.end(), std::make_pair(loc, rec));
+            locsOut->push_back(loc);
+        }
+        txn->recoveryUnit()->registerChange(new InsertChange(_data, first, locsOut->back()));
+
+        return Status::OK();
+    }
+
     StatusWith<RecordId> InMemoryRecordStore::updateRecord(OperationContext* txn,
                                                           const RecordId& loc,
                                                           const char* data,
@@ -1081,6 +1081,72 @@ namespace mongo {
         return toHex(getBuffer(), getSize());
     }
 
+    KeyString::Value::Value(const KeyString& ks)
+        : _keySize(0),
+          _typeBitsSize(0) {
+        const TypeBits& typeBits = ks.getTypeBits();
+        if (typeBits.isAllZeros()) {
+            *this = Value(ks.getBuffer(), ks.getSize(), NULL, 0);
+        }
+        else {
+            *this = Value(ks.getBuffer(), ks.getSize(),
+                          reinterpret_cast<const char*>(typeBits.getBuffer()),
+                          typeBits.getSize());
+        }
+    }
+
+    KeyString::Value::Value(const char* key,
+                            uint32_t keySize,
+                            const char* typeBits,
+                            uint32_t typeBitsSize)
+        : _buffer(SharedBuffer::allocate(keySize + typeBitsSize)),
+          _keySize(keySize),
+          _typeBitsSize(typeBitsSize) {
+        memcpy(_buffer.get(), key, keySize);
+        if (typeBitsSize) {
+            memcpy(_buffer.get() + keySize, typeBits, typeBitsSize);
+        }
+    }
+
+    KeyString::TypeBits KeyString::Value::getTypeBits() const {
+        BufReader reader(getTypeBitsBuffer(), _typeBitsSize);
+        return TypeBits::fromBuffer(&reader);
+    }
+
+    int KeyString::Value::compare(const Value& other) const {
+        const size_t a = getSize();
+        const size_t b = other.getSize();
+
+        const int cmp = memcmp(getBuffer(), other.getBuffer(), std::min(a, b));
+        if (cmp) {
+            return cmp < 0 ? -1 : 1;
+        }
+
+        if (a == b)
+            return 0;
+
+        return a < b ? -1 : 1;
+    }
+
+    BSONObj KeyString::Value::toBson(Ordering ord) const {
+        return KeyString::toBson(getBuffer(), getSize(), ord, getTypeBits());
+    }
+
+    void KeyString::Value::serializeForSorter(BufBuilder& buf) const {
+        buf.appendNum(_keySize);
+        buf.appendNum(_typeBitsSize);
+        buf.appendBuf(_buffer.get(), _keySize + _typeBitsSize);
+    }
+
+    // static
+    KeyString::Value KeyString::Value::deserializeForSorter(BufReader& buf,
+                                                            const SorterDeserializeSettings&) {
+        const uint32_t keySize = buf.read<uint32_t>();
+        const uint32_t typeBitsSize = buf.read<uint32_t>();
+        const char* data = static_cast<const char*>(buf.skip(keySize + typeBitsSize));
+        return Value(data, keySize, data + keySize, typeBitsSize);
+    }
+
     int KeyString::compare(const KeyString& other) const {
         int a = getSize();
         int b = other.getSize();
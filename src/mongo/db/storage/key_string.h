@@ -28,12 +28,16 @@
  *    it in the license file.
  */
 
+#pragma once
+
 #include "mongo/bson/bsonobj.h"
 #include "mongo/bson/bsonobjbuilder.h"
 #include "mongo/bson/bsonmisc.h"
 #include "mongo/bson/timestamp.h"
 #include "mongo/bson/ordering.h"
 #include "mongo/db/record_id.h"
+#include "mongo/util/bufreader.h"
+#include "mongo/util/shared_buffer.h"
 
 namespace mongo {
 
@@ -181,6 +185,8 @@ namespace mongo {
             uint8_t _buf[1/*size*/ + kMaxBytesNeeded];
         };
 
+        class Value;
+
         enum Discriminator {
             kInclusive, // Anything to be stored in an index must use this.
             kExclusiveBefore,
@@ -292,6 +298,54 @@ namespace mongo {
         StackBufBuilder _buffer;
     };
 
+    /**
+     * An immutable copy of the bytes and TypeBits of a KeyString, for holding on to many keys.
+     * KeyString keeps its buffer on the stack, this only takes a shared heap buffer of the size
+     * of the key so copies are cheap.  Can be sorted by the external Sorter.
+     */
+    class KeyString::Value {
+    public:
+        Value() : _keySize(0), _typeBitsSize(0) {}
+
+        explicit Value(const KeyString& ks);
+
+        const char* getBuffer() const { return _buffer.get(); }
+        size_t getSize() const { return _keySize; }
+
+        /**
+         * The encoded TypeBits, in the format of TypeBits::getBuffer().  Empty if they are all
+         * zeros.
+         */
+        const char* getTypeBitsBuffer() const { return _buffer.get() + _keySize; }
+        size_t getTypeBitsSize() const { return _typeBitsSize; }
+
+        TypeBits getTypeBits() const;
+
+        /**
+         * Compares the key bytes, the same way as KeyString::compare().
+         */
+        int compare(const Value& other) const;
+
+        BSONObj toBson(Ordering ord) const;
+
+        // For the external Sorter.
+        struct SorterDeserializeSettings {}; // unused
+        void serializeForSorter(BufBuilder& buf) const;
+        static Value deserializeForSorter(BufReader& buf, const SorterDeserializeSettings&);
+        int memUsageForSorter() const {
+            return sizeof(Value) + _keySize + _typeBitsSize;
+        }
+        Value getOwned() const { return *this; }
+
+    private:
+        Value(const char* key, uint32_t keySize, const char* typeBits, uint32_t typeBitsSize);
+
+        // The key bytes followed by the TypeBits bytes.
+        SharedBuffer _buffer;
+        uint32_t _keySize;
+        uint32_t _typeBitsSize;
+    };
+
     inline bool operator<(const KeyString& lhs, const KeyString& rhs) {
         return lhs.compare(rhs) < 0;
     }
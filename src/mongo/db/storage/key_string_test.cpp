@@ -844,3 +844,58 @@ TEST(KeyStringTest, RecordIds) {
     }
 }
 
+TEST(KeyStringTest, ValueRoundtrip) {
+    const BSONObj objs[] = {
+        BSON("" << 5),
+        BSON("" << 5.5 << "" << "abc"),
+        BSON("" << 5LL << "" << BSON("a" << 1.0)),
+        BSON("" << BSON_ARRAY(1 << 2.0 << "x")),
+    };
+    for (size_t i = 0; i < sizeof(objs) / sizeof(objs[0]); ++i) {
+        for (Ordering ord : {ALL_ASCENDING, ONE_DESCENDING}) {
+            const KeyString ks(objs[i], ord);
+            const KeyString::Value value(ks);
+            ASSERT_EQUALS(ks.getSize(), value.getSize());
+            ASSERT_EQUALS(0, memcmp(ks.getBuffer(), value.getBuffer(), ks.getSize()));
+            ASSERT_EQUALS(ks.getTypeBits().isAllZeros(), value.getTypeBitsSize() == 0);
+            ASSERT(value.toBson(ord).binaryEqual(objs[i]));
+
+            // Through the format the Sorter spills with.
+            BufBuilder buf;
+            value.serializeForSorter(buf);
+            BufReader reader(buf.buf(), buf.len());
+            const KeyString::Value read = KeyString::Value::deserializeForSorter(
+                reader, KeyString::Value::SorterDeserializeSettings());
+            ASSERT(reader.atEof());
+            ASSERT_EQUALS(0, read.compare(value));
+            ASSERT(read.toBson(ord).binaryEqual(objs[i]));
+        }
+    }
+}
+
+TEST(KeyStringTest, ValueCompare) {
+    const BSONObj objs[] = {
+        BSON("" << MINKEY),
+        BSON("" << -1),
+        BSON("" << 1),
+        BSON("" << 1.5),
+        BSON("" << "a"),
+        BSON("" << "ab"),
+        BSON("" << MAXKEY),
+    };
+    const size_t numObjs = sizeof(objs) / sizeof(objs[0]);
+    for (size_t i = 0; i < numObjs; ++i) {
+        for (size_t j = 0; j < numObjs; ++j) {
+            const KeyString::Value a((KeyString(objs[i], ALL_ASCENDING)));
+            const KeyString::Value b((KeyString(objs[j], ALL_ASCENDING)));
+            const int expected = i < j ? -1 : (i == j ? 0 : 1);
+            ASSERT_EQUALS(expected, a.compare(b));
+        }
+    }
+
+    // Equal numbers of different types only differ in their TypeBits.
+    const KeyString::Value intValue((KeyString(BSON("" << 1), ALL_ASCENDING)));
+    const KeyString::Value doubleValue((KeyString(BSON("" << 1.0), ALL_ASCENDING)));
+    ASSERT_EQUALS(0, intValue.compare(doubleValue));
+    ASSERT(doubleValue.toBson(ALL_ASCENDING).binaryEqual(BSON("" << 1.0)));
+}
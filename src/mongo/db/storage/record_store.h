@@ -188,6 +188,30 @@ namespace mongo {
                                                   const DocWriter* doc,
                                                   bool enforceQuota ) = 0;
 
+        /**
+         * Inserts all of 'records', appending their RecordIds to 'locsOut' in the same order.
+         * Stops at the first record which can't be inserted and returns why, leaving the ones
+         * inserted before it in place, so the caller has to roll back its WriteUnitOfWork.
+         *
+         * The default implementation inserts the records one at a time. Record stores which can
+         * do better for a batch, e.g. by reusing one cursor, should override it.
+         */
+        virtual Status insertRecords( OperationContext* txn,
+                                      const std::vector<RecordData>& records,
+                                      bool enforceQuota,
+                                      std::vector<RecordId>* locsOut ) {
+            for ( size_t i = 0; i < records.size(); i++ ) {
+                StatusWith<RecordId> loc = insertRecord( txn,
+                                                         records[i].data(),
+                                                         records[i].size(),
+                                                         enforceQuota );
+                if ( !loc.isOK() )
+                    return loc.getStatus();
+                locsOut->push_back( loc.getValue() );
+            }
+            return Status::OK();
+        }
+
         /**
          * @param notifier - Only used by record stores which do not support doc-locking.
          *                   In the case of a document move, this is called after the document
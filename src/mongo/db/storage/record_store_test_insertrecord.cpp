@@ -183,4 +183,45 @@ namespace mongo {
         }
     }
 
+    // Insert several records in one call and verify each can be read back
+    // from the RecordId it was given.
+    TEST( RecordStoreTestHarness, InsertRecords ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<RecordStore> rs( harnessHelper->newNonCappedRecordStore() );
+
+        const int nToInsert = 10;
+        std::vector<string> datas;
+        for ( int i = 0; i < nToInsert; i++ ) {
+            stringstream ss;
+            ss << "record " << i;
+            datas.push_back( ss.str() );
+        }
+
+        std::vector<RecordId> locs;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                std::vector<RecordData> records;
+                for ( int i = 0; i < nToInsert; i++ ) {
+                    records.push_back( RecordData( datas[i].c_str(), datas[i].size() + 1 ) );
+                }
+
+                WriteUnitOfWork uow( opCtx.get() );
+                ASSERT_OK( rs->insertRecords( opCtx.get(), records, false, &locs ) );
+                uow.commit();
+            }
+        }
+
+        ASSERT_EQUALS( static_cast<size_t>( nToInsert ), locs.size() );
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            ASSERT_EQUALS( nToInsert, rs->numRecords( opCtx.get() ) );
+            for ( int i = 0; i < nToInsert; i++ ) {
+                RecordData record = rs->dataFor( opCtx.get(), locs[i] );
+                ASSERT_EQUALS( datas[i].size() + 1, static_cast<size_t>( record.size() ) );
+                ASSERT_EQUALS( datas[i], record.data() );
+            }
+        }
+    }
+
 } // namespace mongo
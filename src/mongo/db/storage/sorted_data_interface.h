@@ -34,6 +34,7 @@
 #include "mongo/db/operation_context.h"
 #include "mongo/db/record_id.h"
 #include "mongo/db/storage/index_entry_comparison.h"
+#include "mongo/db/storage/key_string.h"
 
 #pragma once
 
@@ -359,6 +360,19 @@ namespace mongo {
          */
         virtual Status addKey(const BSONObj& key, const RecordId& loc) = 0;
 
+        /**
+         * Like addKey(), for a key which has already been encoded as a KeyString with 'ordering',
+         * the Ordering of the index's key pattern.
+         *
+         * The default implementation decodes the key and calls addKey().  Storage engines which
+         * keep their keys as KeyStrings can use the bytes as they are.
+         */
+        virtual Status addKeyString(const KeyString::Value& key,
+                                    Ordering ordering,
+                                    const RecordId& loc) {
+            return addKey(key.toBson(ordering), loc);
+        }
+
         /**
          * Do any necessary work to finish building the tree.
          *
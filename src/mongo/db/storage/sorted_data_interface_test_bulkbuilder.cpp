@@ -198,4 +198,63 @@ namespace mongo {
         }
     }
 
+    // Add keys which are already encoded as KeyStrings using a bulk builder.
+    TEST( SortedDataInterface, BuilderAddKeyString ) {
+        const std::unique_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        const std::unique_ptr<SortedDataInterface> sorted( harnessHelper->newSortedDataInterface( false ) );
+        const Ordering ordering = Ordering::make( BSONObj() );
+
+        {
+            const std::unique_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            const std::unique_ptr<SortedDataBuilderInterface> builder(
+                    sorted->getBulkBuilder( opCtx.get(), true ) );
+
+            const BSONObj doubleKey = BSON( "" << 2.5 );
+            ASSERT_OK( builder->addKeyString( KeyString::Value( KeyString( key1, ordering ) ),
+                                              ordering, loc1 ) );
+            ASSERT_OK( builder->addKeyString( KeyString::Value( KeyString( doubleKey, ordering ) ),
+                                              ordering, loc2 ) );
+            ASSERT_OK( builder->addKey( key3, loc3 ) );
+            builder->commit( false );
+        }
+
+        {
+            const std::unique_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            ASSERT_EQUALS( 3, sorted->numEntries( opCtx.get() ) );
+
+            // The keys come back with their original types.
+            const std::unique_ptr<SortedDataInterface::Cursor> cursor( sorted->newCursor(opCtx.get()) );
+            ASSERT_EQ( cursor->seek( key1, true ), IndexKeyEntry( key1, loc1 ) );
+            const auto entry = cursor->next();
+            ASSERT( entry );
+            ASSERT( entry->key.binaryEqual( BSON( "" << 2.5 ) ) );
+            ASSERT_EQ( entry->loc, loc2 );
+            ASSERT_EQ( cursor->next(), IndexKeyEntry( key3, loc3 ) );
+        }
+    }
+
+    // Add the same encoded key twice using a bulk builder for a unique index.
+    TEST( SortedDataInterface, BuilderAddSameKeyString ) {
+        const std::unique_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        const std::unique_ptr<SortedDataInterface> sorted( harnessHelper->newSortedDataInterface( true ) );
+        const Ordering ordering = Ordering::make( BSONObj() );
+
+        {
+            const std::unique_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            const std::unique_ptr<SortedDataBuilderInterface> builder(
+                    sorted->getBulkBuilder( opCtx.get(), false ) );
+
+            const KeyString::Value key( KeyString( key1, ordering ) );
+            ASSERT_OK( builder->addKeyString( key, ordering, loc1 ) );
+            ASSERT_EQUALS( ErrorCodes::DuplicateKey,
+                           builder->addKeyString( key, ordering, loc2 ) );
+            builder->commit( false );
+        }
+
+        {
+            const std::unique_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            ASSERT_EQUALS( 1, sorted->numEntries( opCtx.get() ) );
+        }
+    }
+
 } // namespace mongo
@@ -108,6 +108,19 @@ namespace {
         return Status::OK();
     }
 
+    /**
+     * checkKeySize() for a key which is already a KeyString.  The BSON of a key is never more
+     * than 16 times the size of its KeyString, the worst case is an array of small numbers which
+     * the KeyString stores in a byte each, without the field names.  So only long keys need to
+     * be decoded.
+     */
+    Status checkKeySize(const KeyString::Value& key, Ordering ordering) {
+        if (key.getSize() * 16 < static_cast<size_t>(TempKeyMaxSize)) {
+            return Status::OK();
+        }
+        return checkKeySize(key.toBson(ordering));
+    }
+
 } // namespace
 
     Status WiredTigerIndex::dupKeyError(const BSONObj& key) {
@@ -475,19 +488,32 @@ namespace {
 
             KeyString data( key, _idx->_ordering, loc );
 
-            // Can't use WiredTigerCursor since we aren't using the cache.
-            WiredTigerItem item(data.getBuffer(), data.getSize());
-            _cursor->set_key(_cursor, item.Get() );
-
             WiredTigerItem valueItem = 
                 data.getTypeBits().isAllZeros() ? emptyItem
                                                 : WiredTigerItem(data.getTypeBits().getBuffer(),
                                                                  data.getTypeBits().getSize());
 
-            _cursor->set_value(_cursor, valueItem.Get());
+            doInsert(data, valueItem);
+            return Status::OK();
+        }
 
-            invariantWTOK(_cursor->insert(_cursor));
+        Status addKeyString(const KeyString::Value& key, Ordering ordering, const RecordId& loc) {
+            {
+                const Status s = checkKeySize(key, ordering);
+                if (!s.isOK())
+                    return s;
+            }
+
+            // Only the RecordId has to be added, the TypeBits are already encoded.
+            _keyString.resetFromBuffer(key.getBuffer(), key.getSize());
+            _keyString.appendRecordId(loc);
+
+            WiredTigerItem valueItem =
+                key.getTypeBitsSize() == 0 ? emptyItem
+                                           : WiredTigerItem(key.getTypeBitsBuffer(),
+                                                            key.getTypeBitsSize());
 
+            doInsert(_keyString, valueItem);
             return Status::OK();
         }
 
@@ -499,7 +525,17 @@ namespace {
         }
 
     private:
+        void doInsert(const KeyString& key, WiredTigerItem& valueItem) {
+            // Can't use WiredTigerCursor since we aren't using the cache.
+            WiredTigerItem item(key.getBuffer(), key.getSize());
+            _cursor->set_key(_cursor, item.Get() );
+            _cursor->set_value(_cursor, valueItem.Get());
+
+            invariantWTOK(_cursor->insert(_cursor));
+        }
+
         WiredTigerIndex* _idx;
+        KeyString _keyString;
     };
 
     /**
@@ -523,9 +559,35 @@ namespace {
                     return s;
             }
 
-            const int cmp = newKey.woCompare(_key, _ordering);
+            return addCheckedKey(KeyString::Value(KeyString(newKey, _ordering)), loc);
+        }
+
+        Status addKeyString(const KeyString::Value& newKey,
+                            Ordering ordering,
+                            const RecordId& loc) {
+            {
+                const Status s = checkKeySize(newKey, ordering);
+                if (!s.isOK())
+                    return s;
+            }
+
+            return addCheckedKey(newKey, loc);
+        }
+
+        void commit(bool mayInterrupt) {
+            WriteUnitOfWork uow( _txn );
+            if (!_records.empty()) {
+                // This handles inserting the last unique key.
+                doInsert();
+            }
+            uow.commit();
+        }
+
+    private:
+        Status addCheckedKey(const KeyString::Value& newKey, const RecordId& loc) {
+            const int cmp = newKey.compare(_key);
             if (cmp != 0) {
-                if (!_key.isEmpty()) { // _key.isEmpty() is only true on the first call to addKey().
+                if (_key.getSize() != 0) { // _key is only empty on the first call to addKey().
                     invariant(cmp > 0); // newKey must be > the last key
                     // We are done with dups of the last key so we can insert it now.
                     doInsert();
@@ -535,7 +597,7 @@ namespace {
             else {
                 // Dup found!
                 if (!_dupsAllowed) {
-                    return _idx->dupKeyError(newKey);
+                    return _idx->dupKeyError(newKey.toBson(_ordering));
                 }
 
                 // If we get here, we are in the weird mode where dups are allowed on a unique
@@ -543,23 +605,12 @@ namespace {
                 // _key which is correct since any dups seen later are likely to be newer.
             }
 
-            _key = newKey.getOwned();
-            _keyString.resetToKey(_key, _idx->ordering());
-            _records.push_back(std::make_pair(loc, _keyString.getTypeBits()));
+            _key = newKey;
+            _records.push_back(std::make_pair(loc, _key.getTypeBits()));
 
             return Status::OK();
         }
 
-        void commit(bool mayInterrupt) {
-            WriteUnitOfWork uow( _txn );
-            if (!_records.empty()) {
-                // This handles inserting the last unique key.
-                doInsert();
-            }
-            uow.commit();
-        }
-
-    private:
         void doInsert() {
             invariant(!_records.empty());
 
@@ -573,7 +624,7 @@ namespace {
                 }
             }
             
-            WiredTigerItem keyItem( _keyString.getBuffer(), _keyString.getSize() );
+            WiredTigerItem keyItem( _key.getBuffer(), _key.getSize() );
             WiredTigerItem valueItem(value.getBuffer(), value.getSize());
 
             _cursor->set_key(_cursor, keyItem.Get());
@@ -586,8 +637,7 @@ namespace {
 
         WiredTigerIndex* _idx;
         const bool _dupsAllowed;
-        BSONObj _key;
-        KeyString _keyString;
+        KeyString::Value _key;
         std::vector<std::pair<RecordId, KeyString::TypeBits> > _records;
     };
 
@@ -0,0 +1,168 @@
+// wiredtiger_journal_flusher.cpp
+
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/db/storage/wiredtiger/wiredtiger_journal_flusher.h"
+
+#include <algorithm>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_util.h"
+#include "mongo/stdx/functional.h"
+#include "mongo/util/concurrency/thread_name.h"
+#include "mongo/util/log.h"
+#include "mongo/util/time_support.h"
+#include "mongo/util/timer.h"
+
+namespace mongo {
+
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(wiredTigerJournalCommitWindowMicros, int, 0);
+
+    WiredTigerJournalFlusher::WiredTigerJournalFlusher(WT_CONNECTION* conn,
+                                                       const std::string& uri,
+                                                       int windowMicros)
+        : _windowMicros(windowMicros),
+          _session(conn),
+          _cursor(NULL),
+          _lastTicket(0),
+          _flushedTicket(0),
+          _shuttingDown(false),
+          _numFlushes(0),
+          _maxGroupSize(0),
+          _numWaits(0),
+          _totalWaitMicros(0) {
+
+        WT_SESSION* session = _session.getSession();
+        int ret = session->open_cursor(session, uri.c_str(), NULL, "overwrite=true", &_cursor);
+        if (ret == ENOENT) {
+            invariantWTOK(session->create(session, uri.c_str(), "key_format=S,value_format=q"));
+            ret = session->open_cursor(session, uri.c_str(), NULL, "overwrite=true", &_cursor);
+        }
+        invariantWTOK(ret);
+
+        _thread = stdx::thread(stdx::bind(&WiredTigerJournalFlusher::_run, this));
+    }
+
+    WiredTigerJournalFlusher::~WiredTigerJournalFlusher() {
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _shuttingDown = true;
+            _flushRequested.notify_one();
+        }
+        _thread.join();
+    }
+
+    void WiredTigerJournalFlusher::waitUntilDurable() {
+        Timer timer;
+
+        stdx::unique_lock<stdx::mutex> lk(_mutex);
+        if (_shuttingDown) {
+            // The thread may be gone already. Closing the connection syncs the log anyway.
+            return;
+        }
+
+        const unsigned long long ticket = ++_lastTicket;
+        _flushRequested.notify_one();
+
+        while (_flushedTicket < ticket) {
+            _flushDone.wait(lk);
+        }
+
+        _numWaits++;
+        _totalWaitMicros += timer.micros();
+    }
+
+    void WiredTigerJournalFlusher::appendStats(BSONObjBuilder& b) const {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        BSONObjBuilder bb(b.subobjStart("journalGroupCommit"));
+        bb.append("windowMicros", _windowMicros);
+        bb.append("flushes", _numFlushes);
+        bb.append("waits", _numWaits);
+        bb.append("maxGroupSize", _maxGroupSize);
+        bb.append("totalWaitMicros", _totalWaitMicros);
+        bb.done();
+    }
+
+    void WiredTigerJournalFlusher::_run() {
+        setThreadName("WTJournalFlusher");
+        LOG(1) << "starting WiredTiger journal flusher, window " << _windowMicros << "us";
+
+        while (true) {
+            {
+                stdx::unique_lock<stdx::mutex> lk(_mutex);
+                while (_flushedTicket == _lastTicket && !_shuttingDown) {
+                    _flushRequested.wait(lk);
+                }
+                if (_flushedTicket == _lastTicket) {
+                    // Shutting down, and nobody is left waiting.
+                    return;
+                }
+            }
+
+            // Give the operations committing right behind the first one a chance to join.
+            if (_windowMicros > 0) {
+                sleepmicros(_windowMicros);
+            }
+
+            unsigned long long target;
+            {
+                stdx::lock_guard<stdx::mutex> lk(_mutex);
+                target = _lastTicket;
+            }
+
+            _flush();
+
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _numFlushes++;
+            _maxGroupSize = std::max(_maxGroupSize,
+                                     static_cast<long long>(target - _flushedTicket));
+            _flushedTicket = target;
+            _flushDone.notify_all();
+        }
+    }
+
+    void WiredTigerJournalFlusher::_flush() {
+        WT_SESSION* session = _session.getSession();
+        invariantWTOK(session->begin_transaction(session, "sync=true"));
+
+        // Only this thread writes the table, so this can't conflict.
+        _cursor->set_key(_cursor, "lastFlush");
+        _cursor->set_value(_cursor, static_cast<int64_t>(_numFlushes));
+        invariantWTOK(_cursor->insert(_cursor));
+
+        invariantWTOK(session->commit_transaction(session, NULL));
+    }
+
+}  // namespace mongo
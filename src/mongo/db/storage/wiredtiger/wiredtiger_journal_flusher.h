@@ -0,0 +1,124 @@
+// wiredtiger_journal_flusher.h
+
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <wiredtiger.h>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_session_cache.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /**
+     * Microseconds the journal flusher waits after the first operation asks for a flush, so that
+     * others can join the same one. Zero, the default, disables group commit and every operation
+     * which waits for the journal syncs it on its own.
+     */
+    extern int wiredTigerJournalCommitWindowMicros;
+
+    /**
+     * Group commit for operations which wait for the journal. Instead of committing with
+     * sync=true, each of them commits without syncing and then calls waitUntilDurable(). A
+     * background thread syncs the journal once for all the operations waiting at that point.
+     *
+     * WiredTiger has no call which just flushes the log, so the flusher commits an update to a
+     * table of its own with sync=true. The log is written in order, so syncing up to that update
+     * also syncs everything committed before it.
+     */
+    class WiredTigerJournalFlusher {
+        MONGO_DISALLOW_COPYING(WiredTigerJournalFlusher);
+    public:
+        WiredTigerJournalFlusher(WT_CONNECTION* conn,
+                                 const std::string& uri,
+                                 int windowMicros);
+
+        /**
+         * Stops the thread after it has served the operations still waiting.
+         */
+        ~WiredTigerJournalFlusher();
+
+        /**
+         * Blocks until everything the calling thread has committed is in the journal on disk.
+         */
+        void waitUntilDurable();
+
+        /**
+         * Appends the number of flushes, how many operations they served, and how long the
+         * operations waited.
+         */
+        void appendStats(BSONObjBuilder& b) const;
+
+    private:
+        void _run();
+
+        /**
+         * Commits a sync=true transaction, which syncs the log up to and including it.
+         */
+        void _flush();
+
+        const int _windowMicros;
+
+        const WiredTigerSession _session;
+        WT_CURSOR* _cursor; // owned by _session
+
+        // Protects everything below.
+        mutable stdx::mutex _mutex;
+
+        // Signalled when an operation asks for a flush, or on shutdown.
+        stdx::condition_variable _flushRequested;
+
+        // Signalled when a flush finishes.
+        stdx::condition_variable _flushDone;
+
+        // Every call to waitUntilDurable() takes the next ticket. Flushes begun after a ticket
+        // was taken cover it, so a flush takes the last ticket handed out before it starts, and
+        // afterwards wakes the waiters with tickets up to that one.
+        unsigned long long _lastTicket;
+        unsigned long long _flushedTicket;
+
+        bool _shuttingDown;
+
+        long long _numFlushes;
+        long long _maxGroupSize;
+        long long _numWaits;
+        long long _totalWaitMicros;
+
+        stdx::thread _thread;
+    };
+
+}  // namespace mongo
@@ -0,0 +1,108 @@
+// wiredtiger_journal_flusher_test.cpp
+
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <vector>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_journal_flusher.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_util.h"
+#include "mongo/stdx/thread.h"
+#include "mongo/unittest/temp_dir.h"
+#include "mongo/unittest/unittest.h"
+
+namespace mongo {
+namespace {
+
+    class WiredTigerJournalFlusherTest : public mongo::unittest::Test {
+    public:
+        WiredTigerJournalFlusherTest() : _dbpath("wt_test"), _conn(NULL) {
+            int ret = wiredtiger_open(_dbpath.path().c_str(),
+                                      NULL,
+                                      "create,log=(enabled=true)",
+                                      &_conn);
+            ASSERT_OK(wtRCToStatus(ret));
+        }
+
+        ~WiredTigerJournalFlusherTest() {
+            _conn->close(_conn, NULL);
+        }
+
+    protected:
+        static BSONObj stats(const WiredTigerJournalFlusher& flusher) {
+            BSONObjBuilder bob;
+            flusher.appendStats(bob);
+            return bob.obj()["journalGroupCommit"].Obj().getOwned();
+        }
+
+        unittest::TempDir _dbpath;
+        WT_CONNECTION* _conn;
+    };
+
+    TEST_F(WiredTigerJournalFlusherTest, SingleWaiter) {
+        WiredTigerJournalFlusher flusher(_conn, "table:journalFlush", 0);
+        flusher.waitUntilDurable();
+        flusher.waitUntilDurable();
+
+        BSONObj s = stats(flusher);
+        ASSERT_EQUALS(2, s["waits"].numberLong());
+        ASSERT_EQUALS(2, s["flushes"].numberLong());
+        ASSERT_EQUALS(1, s["maxGroupSize"].numberLong());
+    }
+
+    TEST_F(WiredTigerJournalFlusherTest, ConcurrentWaitersShareFlushes) {
+        const int kThreads = 16;
+        const int kWaitsPerThread = 20;
+
+        // A long window, so that the waiters pile up behind each flush.
+        WiredTigerJournalFlusher flusher(_conn, "table:journalFlush", 10 * 1000);
+
+        std::vector<stdx::thread*> threads;
+        for (int i = 0; i < kThreads; i++) {
+            threads.push_back(new stdx::thread([&flusher]() {
+                for (int j = 0; j < kWaitsPerThread; j++) {
+                    flusher.waitUntilDurable();
+                }
+            }));
+        }
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i]->join();
+            delete threads[i];
+        }
+
+        BSONObj s = stats(flusher);
+        ASSERT_EQUALS(kThreads * kWaitsPerThread, s["waits"].numberLong());
+        ASSERT_LESS_THAN(s["flushes"].numberLong(), kThreads * kWaitsPerThread);
+        ASSERT_GREATER_THAN(s["maxGroupSize"].numberLong(), 1);
+    }
+
+}  // namespace
+}  // namespace mongo
@@ -40,6 +40,7 @@
 #include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_global_options.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_index.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_journal_flusher.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_record_store.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_recovery_unit.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_session_cache.h"
@@ -135,6 +136,12 @@ namespace mongo {
             _sizeStorer.reset(new WiredTigerSizeStorer(_conn, _sizeStorerUri));
             _sizeStorer->fillCache();
         }
+
+        if (_durable && wiredTigerJournalCommitWindowMicros > 0) {
+            _journalFlusher.reset(new WiredTigerJournalFlusher(_conn,
+                                                               "table:journalFlush",
+                                                               wiredTigerJournalCommitWindowMicros));
+        }
     }
 
 
@@ -151,6 +158,7 @@ namespace mongo {
         syncSizeInfo(true);
         if (_conn) {
             // these must be the last things we do before _conn->close();
+            _journalFlusher.reset( NULL );
             _sizeStorer.reset( NULL );
             _sessionCache->shuttingDown();
 
@@ -440,7 +448,7 @@ namespace mongo {
                 continue;
 
             StringData ident = key.substr(idx+1);
-            if ( ident == "sizeStorer" )
+            if ( ident == "sizeStorer" || ident == "journalFlush" )
                 continue;
 
             all.push_back( ident.toString() );
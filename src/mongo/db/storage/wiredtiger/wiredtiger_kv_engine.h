@@ -46,6 +46,7 @@
 
 namespace mongo {
 
+    class WiredTigerJournalFlusher;
     class WiredTigerSessionCache;
     class WiredTigerSizeStorer;
 
@@ -120,6 +121,11 @@ namespace mongo {
 
         void syncSizeInfo(bool sync) const;
 
+        /**
+         * Returns NULL unless journal group commit is enabled.
+         */
+        WiredTigerJournalFlusher* getJournalFlusher() const { return _journalFlusher.get(); }
+
         /**
          * Initializes a background job to remove excess documents in the oplog collections.
          * This applies to the capped collections in the local.oplog.* namespaces (specifically
@@ -153,6 +159,8 @@ namespace mongo {
         boost::scoped_ptr<WiredTigerSizeStorer> _sizeStorer;
         std::string _sizeStorerUri;
         mutable ElapsedTracker _sizeStorerSyncTracker;
+
+        boost::scoped_ptr<WiredTigerJournalFlusher> _journalFlusher;
     };
 
 }
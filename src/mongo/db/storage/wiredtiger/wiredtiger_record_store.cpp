@@ -633,6 +633,53 @@ namespace {
         return insertRecord( txn, buf.get(), len, enforceQuota );
     }
 
+    Status WiredTigerRecordStore::insertRecords( OperationContext* txn,
+                                                 const std::vector<RecordData>& records,
+                                                 bool enforceQuota,
+                                                 std::vector<RecordId>* locsOut ) {
+        if ( _useOplogHack || _isCapped ) {
+            // These need their RecordIds tracked and the collection trimmed record by record.
+            return RecordStore::insertRecords( txn, records, enforceQuota, locsOut );
+        }
+
+        if ( records.empty() )
+            return Status::OK();
+
+        // Reserve the ids for the whole batch at once.
+        const int64_t firstId = _nextIdNum.fetchAndAdd( records.size() );
+        invariant( RecordId( firstId + records.size() - 1 ).isNormal() );
+
+        WiredTigerCursor curwrap( _uri, _instanceId, true, txn);
+        curwrap.assertInActiveTxn();
+        WT_CURSOR *c = curwrap.get();
+        invariant( c );
+
+        Status status = Status::OK();
+        int64_t numInserted = 0;
+        int totalLength = 0;
+        for ( size_t i = 0; i < records.size(); i++ ) {
+            const RecordId loc( firstId + i );
+            c->set_key(c, _makeKey(loc));
+            WiredTigerItem value(records[i].data(), records[i].size());
+            c->set_value(c, value.Get());
+            int ret = WT_OP_CHECK(c->insert(c));
+            if (ret) {
+                status = wtRCToStatus(ret, "WiredTigerRecordStore::insertRecords");
+                break;
+            }
+
+            locsOut->push_back( loc );
+            numInserted++;
+            totalLength += records[i].size();
+        }
+
+        // Count whatever got in, so that rolling back the caller's unit of work evens it out.
+        _changeNumRecords( txn, numInserted );
+        _increaseDataSize( txn, totalLength );
+
+        return status;
+    }
+
     StatusWith<RecordId> WiredTigerRecordStore::updateRecord( OperationContext* txn,
                                                               const RecordId& loc,
                                                               const char* data,
@@ -991,7 +1038,7 @@ namespace {
 
     private:
         WiredTigerRecordStore* _rs;
-        bool _amount;
+        int _amount;
     };
 
     void WiredTigerRecordStore::_increaseDataSize( OperationContext* txn, int amount ) {
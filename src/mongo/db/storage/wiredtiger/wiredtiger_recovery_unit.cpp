@@ -38,6 +38,8 @@
 #include "mongo/bson/bsonobjbuilder.h"
 #include "mongo/db/commands/server_status_metric.h"
 #include "mongo/db/server_parameters.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_journal_flusher.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_kv_engine.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_recovery_unit.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_session_cache.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_util.h"
@@ -77,6 +79,11 @@ namespace mongo {
             boost::condition condvar;
             long long lastSyncTime;
         } waitUntilDurableData;
+
+        WiredTigerJournalFlusher* getJournalFlusher(WiredTigerSessionCache* sessionCache) {
+            WiredTigerKVEngine* engine = sessionCache->getKVEngine();
+            return engine ? engine->getJournalFlusher() : NULL;
+        }
     }
 
     WiredTigerRecoveryUnit::WiredTigerRecoveryUnit(WiredTigerSessionCache* sc) :
@@ -86,6 +93,7 @@ namespace mongo {
         _active( false ),
         _myTransactionCount( 1 ),
         _everStartedWrite( false ),
+        _txnStartedWrite( false ),
         _currentlySquirreled( false ),
         _syncing( false ),
         _noTicketNeeded( false ) {
@@ -115,6 +123,8 @@ namespace mongo {
             if ( _session && _active ) {
                 _txnClose( true );
             }
+            // The unit of work may never have opened a transaction.
+            _txnStartedWrite = false;
 
             for (Changes::const_iterator it = _changes.begin(), end = _changes.end(); it != end;
                     ++it) {
@@ -134,6 +144,8 @@ namespace mongo {
             if ( _session && _active ) {
                 _txnClose( false );
             }
+            // The unit of work may never have opened a transaction.
+            _txnStartedWrite = false;
 
             for (Changes::const_reverse_iterator it = _changes.rbegin(), end = _changes.rend();
                     it != end; ++it) {
@@ -155,6 +167,7 @@ namespace mongo {
         invariant(!_currentlySquirreled);
         _inUnitOfWork = true;
         _everStartedWrite = true;
+        _txnStartedWrite = true;
         _getTicket(opCtx);
     }
 
@@ -184,6 +197,10 @@ namespace mongo {
             // we did a sync, so we're good
             return true;
         }
+        if ( WiredTigerJournalFlusher* flusher = getJournalFlusher( _sessionCache ) ) {
+            flusher->waitUntilDurable();
+            return true;
+        }
         waitUntilDurableData.waitUntilDurable();
         return true;
     }
@@ -306,14 +323,22 @@ namespace mongo {
         if ( commit ) {
             invariantWTOK( s->commit_transaction(s, NULL) );
             LOG(2) << "WT commit_transaction";
-            if ( _syncing )
+            if ( _syncing ) {
+                // With group commit the transaction didn't sync itself, see _txnOpen().  Only
+                // a transaction that may have written has anything to wait for; read-only
+                // snapshots are closed at every yield.
+                WiredTigerJournalFlusher* flusher = getJournalFlusher( _sessionCache );
+                if ( flusher && _txnStartedWrite )
+                    flusher->waitUntilDurable();
                 waitUntilDurableData.syncHappend();
+            }
         }
         else {
             invariantWTOK( s->rollback_transaction(s, NULL) );
             LOG(2) << "WT rollback_transaction";
         }
         _active = false;
+        _txnStartedWrite = false;
         _myTransactionCount++;
         _ticket.reset(NULL);
     }
@@ -360,8 +385,12 @@ namespace mongo {
         _getTicket(opCtx);
 
         WT_SESSION *s = _session->getSession();
-        _syncing = _syncing || waitUntilDurableData.numWaitingForSync.load() > 0;
-        invariantWTOK( s->begin_transaction(s, _syncing ? "sync=true" : NULL) );
+        // With group commit, a syncing transaction waits for the journal flusher once it has
+        // committed, rather than syncing on its own.
+        const bool groupCommit = getJournalFlusher( _sessionCache ) != NULL;
+        if ( !groupCommit )
+            _syncing = _syncing || waitUntilDurableData.numWaitingForSync.load() > 0;
+        invariantWTOK( s->begin_transaction(s, _syncing && !groupCommit ? "sync=true" : NULL) );
         LOG(2) << "WT begin_transaction";
         _timer.reset();
         _active = true;
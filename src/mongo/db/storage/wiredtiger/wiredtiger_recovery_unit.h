@@ -110,6 +110,7 @@ namespace mongo {
         bool _active;
         uint64_t _myTransactionCount;
         bool _everStartedWrite;
+        bool _txnStartedWrite; // a unit of work began in the current transaction
         Timer _timer;
         bool _currentlySquirreled;
         bool _syncing;
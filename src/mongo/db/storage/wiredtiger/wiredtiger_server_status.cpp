@@ -37,6 +37,7 @@
 
 #include "mongo/base/checked_cast.h"
 #include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_journal_flusher.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_kv_engine.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_record_store.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_recovery_unit.h"
@@ -79,6 +80,10 @@ namespace mongo {
         }
 
         WiredTigerRecoveryUnit::appendGlobalStats(bob);
+        WiredTigerRecoveryUnit::get(txn)->getSessionCache()->appendStats(bob);
+        if (WiredTigerJournalFlusher* flusher = _engine->getJournalFlusher()) {
+            flusher->appendStats(bob);
+        }
 
         return bob.obj();
     }
@@ -35,9 +35,11 @@
 
 #include "mongo/db/storage/wiredtiger/wiredtiger_session_cache.h"
 
+#include "mongo/bson/bsonobjbuilder.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_kv_engine.h"
 #include "mongo/db/storage/wiredtiger/wiredtiger_util.h"
 #include "mongo/util/log.h"
+#include "mongo/util/time_support.h"
 
 namespace mongo {
 
@@ -45,7 +47,9 @@ namespace mongo {
         : _cachePartition(cachePartition),
           _epoch(epoch),
           _session(NULL),
-          _cursorsOut(0) {
+          _cursorsOut(0),
+          _cursorCacheHits(0),
+          _cursorCacheMisses(0) {
 
         int ret = conn->open_session(conn, NULL, "isolation=snapshot", &_session);
         invariantWTOK(ret);
@@ -67,6 +71,7 @@ namespace mongo {
                 WT_CURSOR* save = cursors.back();
                 cursors.pop_back();
                 _cursorsOut++;
+                _cursorCacheHits++;
                 return save;
             }
         }
@@ -79,6 +84,7 @@ namespace mongo {
         if (ret != ENOENT)
             invariantWTOK(ret);
         if ( c ) _cursorsOut++;
+        _cursorCacheMisses++;
         return c;
     }
 
@@ -114,7 +120,25 @@ namespace mongo {
 
     namespace {
         AtomicUInt64 nextCursorId(1);
-        AtomicUInt64 cachePartitionGen(0);
+        AtomicUInt64 nextCacheId(1);
+        AtomicUInt32 nextThreadPartition(0);
+
+        /**
+         * Counts the calling thread in a partition's active count for as long as it is in scope.
+         */
+        class ActiveScope {
+        public:
+            explicit ActiveScope(AtomicUInt32* active) : _active(active) {
+                _active->fetchAndAdd(1);
+            }
+
+            ~ActiveScope() {
+                _active->fetchAndSubtract(1);
+            }
+
+        private:
+            AtomicUInt32* const _active;
+        };
     }
     // static
     uint64_t WiredTigerSession::genCursorId() {
@@ -123,13 +147,46 @@ namespace mongo {
 
     // -----------------------
 
+    /**
+     * Holds the session a thread last returned to a cache, so that its next getSession() can take
+     * it back without any locking. Only the owning thread puts sessions in, but closeAll() can
+     * take them out from any thread, so the session is always exchanged atomically.
+     */
+    struct WiredTigerSessionCache::ThreadSlot {
+        ThreadSlot() : session(NULL) { }
+
+        AtomicWord<WiredTigerSession*> session;
+    };
+
+    /**
+     * What a thread keeps for all session caches. The slots are shared with the caches which
+     * registered them, so that whichever of the thread and the cache goes away first leaves the
+     * slot valid for the other.
+     */
+    struct WiredTigerSessionCache::ThreadState {
+        ThreadState()
+            : partition(nextThreadPartition.fetchAndAdd(1) % NumSessionCachePartitions) { }
+
+        const int partition;
+        std::vector<std::pair<uint64_t, boost::shared_ptr<ThreadSlot> > > slots;
+    };
+
+    boost::thread_specific_ptr<WiredTigerSessionCache::ThreadState>
+        WiredTigerSessionCache::_threadState;
+
+    const unsigned WiredTigerSessionCache::kMaxParkedSessions;
+
     WiredTigerSessionCache::WiredTigerSessionCache( WiredTigerKVEngine* engine )
-        : _engine( engine ), _conn( engine->getConnection() ), _shuttingDown(0) {
+        : _engine( engine ), _conn( engine->getConnection() ),
+          _cacheId( nextCacheId.fetchAndAdd(1) ), _epoch(0), _parkedSessions(0),
+          _shuttingDown(0) {
 
     }
 
     WiredTigerSessionCache::WiredTigerSessionCache( WT_CONNECTION* conn )
-        : _engine( NULL ), _conn( conn ), _shuttingDown(0) {
+        : _engine( NULL ), _conn( conn ),
+          _cacheId( nextCacheId.fetchAndAdd(1) ), _epoch(0), _parkedSessions(0),
+          _shuttingDown(0) {
 
     }
 
@@ -141,69 +198,166 @@ namespace mongo {
         if (_shuttingDown.load()) return;
         _shuttingDown.store(1);
 
-        {
-            // This ensures that any calls, which are currently inside of getSession/releaseSession
-            // will be able to complete before we start cleaning up the pool. Any others, which are
-            // about to enter will return immediately because of _shuttingDown == true.
-            boost::lock_guard<boost::shared_mutex> lk(_shutdownLock);
+        // Wait for the calls which are currently inside of getSession/releaseSession to complete
+        // before cleaning up the pools. Any others, which are about to enter, will see
+        // _shuttingDown == true, because they bump the active count before checking it.
+        for (int i = 0; i < NumSessionCachePartitions; i++) {
+            while (_cache[i].active.load() != 0) {
+                sleepmillis(1);
+            }
         }
 
         closeAll();
     }
 
     void WiredTigerSessionCache::closeAll() {
+        // The epoch goes first, so that a session being returned while the slots and pools are
+        // emptied either ends up in one of them before it is emptied or sees the new epoch.
+        _epoch.fetchAndAdd(1);
+
+        SessionPool swapPool;
+
+        {
+            boost::lock_guard<boost::mutex> lk(_threadSlotsMutex);
+            _takeParkedSessions(false, &swapPool);
+        }
+
         for (int i = 0; i < NumSessionCachePartitions; i++) {
-            SessionPool swapPool;
+            boost::unique_lock<SpinLock> scopedLock(_cache[i].lock);
+            swapPool.insert(swapPool.end(), _cache[i].pool.begin(), _cache[i].pool.end());
+            _cache[i].pool.clear();
+        }
+
+        // New sessions will be created if need be outside of the locks
+        for (size_t i = 0; i < swapPool.size(); i++) {
+            delete swapPool[i];
+        }
+    }
 
-            {
-                boost::unique_lock<SpinLock> scopedLock(_cache[i].lock);
-                _cache[i].pool.swap(swapPool);
-                _cache[i].epoch++;
+    void WiredTigerSessionCache::_takeParkedSessions(bool onlyOrphaned, SessionPool* out) {
+        size_t live = 0;
+        for (size_t i = 0; i < _threadSlots.size(); i++) {
+            const bool orphaned = _threadSlots[i].unique();
+            if (orphaned || !onlyOrphaned) {
+                WiredTigerSession* parked = _threadSlots[i]->session.swap(NULL);
+                if (parked) {
+                    _parkedSessions.subtractAndFetch(1);
+                    out->push_back(parked);
+                }
             }
+            if (!orphaned) {
+                _threadSlots[live++].swap(_threadSlots[i]);
+            }
+        }
+        _threadSlots.resize(live);
+    }
 
-            // New sessions will be created if need be outside of the lock
-            for (size_t i = 0; i < swapPool.size(); i++) {
-                delete swapPool[i];
+    void WiredTigerSessionCache::appendStats(BSONObjBuilder& b) const {
+        long long hits = 0;
+        long long misses = 0;
+        for (int i = 0; i < NumSessionCachePartitions; i++) {
+            hits += _cache[i].cursorCacheHits.loadRelaxed();
+            misses += _cache[i].cursorCacheMisses.loadRelaxed();
+        }
+
+        BSONObjBuilder bb(b.subobjStart("cursorCache"));
+        bb.append("hits", hits);
+        bb.append("misses", misses);
+        bb.done();
+
+        b.append("parkedSessions", static_cast<long long>(_parkedSessions.load()));
+    }
+
+    // static
+    WiredTigerSessionCache::ThreadState* WiredTigerSessionCache::_getThreadState() {
+        ThreadState* state = _threadState.get();
+        if (!state) {
+            state = new ThreadState();
+            _threadState.reset(state);
+        }
+        return state;
+    }
+
+    WiredTigerSessionCache::ThreadSlot* WiredTigerSessionCache::_getThreadSlot(
+                                                                        ThreadState* state) {
+        for (size_t i = 0; i < state->slots.size(); i++) {
+            if (state->slots[i].first == _cacheId) {
+                return state->slots[i].second.get();
             }
+        }
 
-            swapPool.clear();
+        // First call from this thread into this cache. Forget the slots of caches which have
+        // been destroyed; their sessions were closed on shutdown.
+        size_t live = 0;
+        for (size_t i = 0; i < state->slots.size(); i++) {
+            if (!state->slots[i].second.unique()) {
+                state->slots[live++].swap(state->slots[i]);
+            }
+        }
+        state->slots.resize(live);
+
+        boost::shared_ptr<ThreadSlot> slot(new ThreadSlot());
+        state->slots.push_back(std::make_pair(_cacheId, slot));
+
+        SessionPool orphaned;
+        {
+            boost::lock_guard<boost::mutex> lk(_threadSlotsMutex);
+            _takeParkedSessions(true, &orphaned);
+            _threadSlots.push_back(slot);
         }
+
+        for (size_t i = 0; i < orphaned.size(); i++) {
+            delete orphaned[i];
+        }
+
+        return slot.get();
     }
 
     WiredTigerSession* WiredTigerSessionCache::getSession() {
-        boost::shared_lock<boost::shared_mutex> shutdownLock(_shutdownLock);
+        ThreadState* state = _getThreadState();
+        SessionCachePartition& partition = _cache[state->partition];
+        ActiveScope activeScope(&partition.active);
 
         // We should never be able to get here after _shuttingDown is set, because no new
         // operations should be allowed to start.
-        invariant(!_shuttingDown.loadRelaxed());
+        invariant(!_shuttingDown.load());
 
-        // Spread sessions uniformly across the cache partitions
-        const int cachePartition = cachePartitionGen.addAndFetch(1) % NumSessionCachePartitions;
+        const int epoch = _currentEpoch();
 
-        int epoch;
+        // The session this thread returned last, if closeAll() hasn't taken it since.
+        WiredTigerSession* parked = _getThreadSlot(state)->session.swap(NULL);
+        if (parked) {
+            _parkedSessions.subtractAndFetch(1);
+            if (parked->_getEpoch() == epoch) {
+                return parked;
+            }
+            delete parked;
+        }
 
         {
-            boost::unique_lock<SpinLock> cachePartitionLock(_cache[cachePartition].lock);
-            epoch = _cache[cachePartition].epoch;
+            boost::unique_lock<SpinLock> cachePartitionLock(partition.lock);
 
-            if (!_cache[cachePartition].pool.empty()) {
-                WiredTigerSession* cachedSession = _cache[cachePartition].pool.back();
-                _cache[cachePartition].pool.pop_back();
+            if (!partition.pool.empty()) {
+                WiredTigerSession* cachedSession = partition.pool.back();
+                partition.pool.pop_back();
 
                 return cachedSession;
             }
         }
 
         // Outside of the cache partition lock, but on release will be put back on the cache
-        return new WiredTigerSession(_conn, cachePartition, epoch);
+        return new WiredTigerSession(_conn, state->partition, epoch);
     }
 
     void WiredTigerSessionCache::releaseSession( WiredTigerSession* session ) {
         invariant( session );
         invariant(session->cursorsOut() == 0);
 
-        boost::shared_lock<boost::shared_mutex> shutdownLock(_shutdownLock);
-        if (_shuttingDown.loadRelaxed()) {
+        ThreadState* state = _getThreadState();
+        SessionCachePartition& partition = _cache[state->partition];
+        ActiveScope activeScope(&partition.active);
+
+        if (_shuttingDown.load()) {
             // Leak the session in order to avoid race condition with clean shutdown, where the
             // storage engine is ripped from underneath transactions, which are not "active"
             // (i.e., do not have any locks), but are just about to delete the recovery unit.
@@ -220,24 +374,50 @@ namespace mongo {
             invariant(range == 0);
         }
 
-        const int cachePartition = session->_getCachePartition();
-        bool returnedToCache = false;
-
-        if (cachePartition >= 0) {
-            boost::unique_lock<SpinLock> cachePartitionLock(_cache[cachePartition].lock);
-
-            invariant(session->_getEpoch() <= _cache[cachePartition].epoch);
+        if (session->_cursorCacheHits) {
+            partition.cursorCacheHits.fetchAndAdd(session->_cursorCacheHits);
+            session->_cursorCacheHits = 0;
+        }
+        if (session->_cursorCacheMisses) {
+            partition.cursorCacheMisses.fetchAndAdd(session->_cursorCacheMisses);
+            session->_cursorCacheMisses = 0;
+        }
 
-            if (session->_getEpoch() == _cache[cachePartition].epoch) {
-                _cache[cachePartition].pool.push_back(session);
-                returnedToCache = true;
+        if (session->_getCachePartition() >= 0) {
+            const int epoch = session->_getEpoch();
+            invariant(epoch <= _currentEpoch());
+
+            if (epoch == _currentEpoch()) {
+                ThreadSlot* slot = _getThreadSlot(state);
+                // Counted before it goes in, so that racing threads can't overshoot the limit.
+                const bool mayPark = _parkedSessions.addAndFetch(1) <= kMaxParkedSessions;
+                if (mayPark && slot->session.compareAndSwap(NULL, session) == NULL) {
+                    // Parked. If closeAll() started in the meantime it might have emptied the
+                    // slot before the session went in, so take it back out and close it, unless
+                    // closeAll() already did.
+                    session = NULL;
+                    if (epoch != _currentEpoch()) {
+                        session = slot->session.swap(NULL);
+                        if (session) {
+                            _parkedSessions.subtractAndFetch(1);
+                        }
+                    }
+                }
+                else {
+                    // Too many sessions are parked, or the thread has one parked already, so it
+                    // is using several at once.
+                    _parkedSessions.subtractAndFetch(1);
+                    boost::unique_lock<SpinLock> cachePartitionLock(partition.lock);
+                    if (epoch == _currentEpoch()) {
+                        partition.pool.push_back(session);
+                        session = NULL;
+                    }
+                }
             }
         }
 
         // Do all cleanup outside of the cache partition spinlock.
-        if (!returnedToCache) {
-            delete session;
-        }
+        delete session;
 
         if (_engine && _engine->haveDropsQueued()) {
             _engine->dropAllQueued();
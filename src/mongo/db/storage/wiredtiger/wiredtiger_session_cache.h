@@ -35,16 +35,19 @@
 #include <string>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
-#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/tss.hpp>
 
 #include <wiredtiger.h>
 
 #include "mongo/platform/atomic_word.h"
+#include "mongo/platform/platform_specific.h"
 #include "mongo/util/concurrency/spin_lock.h"
 
 namespace mongo {
 
+    class BSONObjBuilder;
     class WiredTigerKVEngine;
 
     /**
@@ -104,6 +107,11 @@ namespace mongo {
         WT_SESSION* _session; // owned
         CursorMap _curmap; // owned
         int _cursorsOut;
+
+        // getCursor() calls which reused a cached cursor, and ones which had to open a new one.
+        // The session cache collects and resets these when the session is returned to it.
+        long long _cursorCacheHits;
+        long long _cursorCacheMisses;
     };
 
     class WiredTigerSessionCache {
@@ -120,38 +128,96 @@ namespace mongo {
 
         void shuttingDown();
 
+        /**
+         * Appends the cursor cache hits and misses of the sessions returned to this cache, and
+         * the number of sessions parked by threads.
+         */
+        void appendStats(BSONObjBuilder& b) const;
+
         WT_CONNECTION* conn() const { return _conn; }
 
+        WiredTigerKVEngine* getKVEngine() const { return _engine; }
+
+        // At most this many sessions are parked by threads at once, any others go back to the
+        // pools. Every thread which ever ran an operation could otherwise hold a WT session and
+        // its cursors while idle, and WT refuses to open more than session_max sessions.
+        static const unsigned kMaxParkedSessions = 256;
+
     private:
+        struct ThreadSlot;
+        struct ThreadState;
+
         typedef std::vector<WiredTigerSession*> SessionPool;
+        typedef std::vector<boost::shared_ptr<ThreadSlot> > ThreadSlots;
 
         enum { NumSessionCachePartitions = 64 };
 
-        struct SessionCachePartition {
-            SessionCachePartition() : epoch(0) { }
+        struct MONGO_ALIGN_TO_CACHE SessionCachePartition {
+            SessionCachePartition() : active(0), cursorCacheHits(0), cursorCacheMisses(0) { }
             ~SessionCachePartition() {
                 invariant(pool.empty());
             }
 
             SpinLock lock;
-            int epoch;
             SessionPool pool;
+
+            // Number of threads inside getSession() or releaseSession() on this partition.
+            AtomicUInt32 active;
+
+            AtomicUInt64 cursorCacheHits;
+            AtomicUInt64 cursorCacheMisses;
         };
 
+        /**
+         * Returns the calling thread's state, creating it on the thread's first call into any
+         * session cache.
+         */
+        static ThreadState* _getThreadState();
+
+        /**
+         * Returns the slot in which the calling thread parks its session for this cache,
+         * registering one on the thread's first call into this cache.
+         */
+        ThreadSlot* _getThreadSlot(ThreadState* state);
+
+        /**
+         * Takes the sessions out of the registered thread slots, or only out of those whose
+         * thread has exited if 'onlyOrphaned' is true, and drops the slots of exited threads.
+         * Must be called with _threadSlotsMutex held.
+         */
+        void _takeParkedSessions(bool onlyOrphaned, SessionPool* out);
+
+        int _currentEpoch() const { return static_cast<int>(_epoch.load()); }
+
 
         WiredTigerKVEngine* _engine; // not owned, might be NULL
         WT_CONNECTION* _conn; // not owned
 
-        // Partitioned cache of WT sessions. The partition key is not important, but it is
-        // important that sessions be returned to the same partition they were taken from in order
-        // to have some form of balance between the partitions.
+        // Distinguishes this cache in the per-thread state, which outlives it.
+        const uint64_t _cacheId;
+
+        // Each thread is assigned one partition the first time it calls into a session cache and
+        // always uses it, so the partitions are shared by as few threads as possible. A session
+        // goes back to the partition of the thread that returns it.
         SessionCachePartition _cache[NumSessionCachePartitions];
 
-        // Regular operations take it in shared mode. Shutdown sets the _shuttingDown flag and
-        // then takes it in exclusive mode. This ensures that all threads, which would return
-        // sessions to the cache would leak them.
-        boost::shared_mutex _shutdownLock;
+        // Bumped by closeAll(). Sessions from an earlier epoch are closed when they come back.
+        AtomicUInt32 _epoch;
+
+        // Sessions in thread slots, plus those about to be parked. Bounded by kMaxParkedSessions.
+        AtomicUInt32 _parkedSessions;
+
+        // The slots of all threads which have used this cache, so that closeAll() can take
+        // their sessions. Slots whose thread has exited are pruned when new ones are registered.
+        boost::mutex _threadSlotsMutex;
+        ThreadSlots _threadSlots;
+
+        // Shutdown sets _shuttingDown and then waits for every partition's active count to drop
+        // to zero. Regular operations bump the count before checking the flag, so once the wait
+        // is over, no thread can return a session to the cache any more and they leak instead.
         AtomicUInt32 _shuttingDown; // Used as boolean - 0 = false, 1 = true
+
+        static boost::thread_specific_ptr<ThreadState> _threadState;
     };
 
 }
@@ -0,0 +1,178 @@
+// wiredtiger_session_cache_test.cpp
+
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_session_cache.h"
+#include "mongo/db/storage/wiredtiger/wiredtiger_util.h"
+#include "mongo/unittest/temp_dir.h"
+#include "mongo/unittest/unittest.h"
+
+namespace mongo {
+namespace {
+
+    class WiredTigerSessionCacheTest : public mongo::unittest::Test {
+    public:
+        WiredTigerSessionCacheTest() : _dbpath("wt_test"), _conn(NULL) {
+            int ret = wiredtiger_open(_dbpath.path().c_str(), NULL,
+                                      "create,session_max=1000,", &_conn);
+            ASSERT_OK(wtRCToStatus(ret));
+            _sessionCache.reset(new WiredTigerSessionCache(_conn));
+        }
+
+        ~WiredTigerSessionCacheTest() {
+            _sessionCache.reset();
+            _conn->close(_conn, NULL);
+        }
+
+    protected:
+        // Opens and releases a metadata cursor on 'session', to tell by the cursor cache counts
+        // whether it is a session which has been used before.
+        void useCursor(WiredTigerSession* session) {
+            WT_CURSOR* cursor = session->getCursor("metadata:",
+                                                   WiredTigerSession::kMetadataCursorId,
+                                                   false);
+            ASSERT(cursor);
+            session->releaseCursor(WiredTigerSession::kMetadataCursorId, cursor);
+        }
+
+        BSONObj cursorCacheStats() {
+            BSONObjBuilder bob;
+            _sessionCache->appendStats(bob);
+            return bob.obj()["cursorCache"].Obj().getOwned();
+        }
+
+        long long parkedSessions() {
+            BSONObjBuilder bob;
+            _sessionCache->appendStats(bob);
+            return bob.obj()["parkedSessions"].numberLong();
+        }
+
+        // Gets and releases a session, then waits until all threads have done so and the test
+        // has looked at the cache, so that no thread exits while its session is parked.
+        void useSessionAndWait(boost::barrier* released, boost::barrier* checked) {
+            WiredTigerSession* session = _sessionCache->getSession();
+            useCursor(session);
+            _sessionCache->releaseSession(session);
+            released->wait();
+            checked->wait();
+        }
+
+        unittest::TempDir _dbpath;
+        WT_CONNECTION* _conn;
+        boost::scoped_ptr<WiredTigerSessionCache> _sessionCache;
+    };
+
+    TEST_F(WiredTigerSessionCacheTest, ReusesReleasedSession) {
+        WiredTigerSession* session = _sessionCache->getSession();
+        useCursor(session);
+        _sessionCache->releaseSession(session);
+        ASSERT_EQUALS(BSON("hits" << 0LL << "misses" << 1LL), cursorCacheStats());
+
+        ASSERT_EQUALS(session, _sessionCache->getSession());
+        useCursor(session);
+        _sessionCache->releaseSession(session);
+        ASSERT_EQUALS(BSON("hits" << 1LL << "misses" << 1LL), cursorCacheStats());
+    }
+
+    TEST_F(WiredTigerSessionCacheTest, SeveralSessionsOnOneThread) {
+        WiredTigerSession* first = _sessionCache->getSession();
+        WiredTigerSession* second = _sessionCache->getSession();
+        ASSERT_NOT_EQUALS(first, second);
+        useCursor(first);
+        useCursor(second);
+        _sessionCache->releaseSession(first);
+        _sessionCache->releaseSession(second);
+
+        // Both are cached, one parked for this thread and the other in the pool.
+        first = _sessionCache->getSession();
+        second = _sessionCache->getSession();
+        ASSERT_NOT_EQUALS(first, second);
+        useCursor(first);
+        useCursor(second);
+        _sessionCache->releaseSession(first);
+        _sessionCache->releaseSession(second);
+        ASSERT_EQUALS(BSON("hits" << 2LL << "misses" << 2LL), cursorCacheStats());
+    }
+
+    TEST_F(WiredTigerSessionCacheTest, ParkedSessionsAreBounded) {
+        WiredTigerSession* session = _sessionCache->getSession();
+        _sessionCache->releaseSession(session);
+        ASSERT_EQUALS(1LL, parkedSessions());
+        ASSERT_EQUALS(session, _sessionCache->getSession());
+        ASSERT_EQUALS(0LL, parkedSessions());
+        _sessionCache->releaseSession(session);
+
+        const size_t numThreads = WiredTigerSessionCache::kMaxParkedSessions + 8;
+        boost::barrier released(numThreads + 1);
+        boost::barrier checked(numThreads + 1);
+        std::vector<boost::shared_ptr<boost::thread> > threads;
+        for (size_t i = 0; i < numThreads; i++) {
+            threads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(
+                [this, &released, &checked] { useSessionAndWait(&released, &checked); })));
+        }
+
+        released.wait();
+        const long long parked = parkedSessions();
+        checked.wait();
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i]->join();
+        }
+
+        // This thread's session is parked too, and counts against the limit.
+        ASSERT_EQUALS(static_cast<long long>(WiredTigerSessionCache::kMaxParkedSessions), parked);
+    }
+
+    TEST_F(WiredTigerSessionCacheTest, CloseAllDropsCachedSessions) {
+        WiredTigerSession* first = _sessionCache->getSession();
+        WiredTigerSession* second = _sessionCache->getSession();
+        useCursor(first);
+        useCursor(second);
+        _sessionCache->releaseSession(first);
+        _sessionCache->closeAll();
+
+        // Sessions which were out during closeAll() are closed when they come back.
+        _sessionCache->releaseSession(second);
+
+        WiredTigerSession* session = _sessionCache->getSession();
+        useCursor(session);
+        _sessionCache->releaseSession(session);
+        ASSERT_EQUALS(BSON("hits" << 0LL << "misses" << 3LL), cursorCacheStats());
+    }
+
+}  // namespace
+}  // namespace mongo
@@ -33,6 +33,7 @@
 #include "mongo/db/json.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/s/chunk_manager.h"
+#include "mongo/util/timer.h"
 
 namespace mongo {
 
@@ -69,7 +70,10 @@ namespace mongo {
             }
             
             _chunkRanges.reloadAll(_chunkMap);
+            _routingIndex.build(_chunkMap);
         }
+
+        const ChunkRoutingIndex& getRoutingIndex() const { return _routingIndex; }
     };
     
 } // namespace mongo
@@ -249,6 +253,91 @@ namespace ChunkTests {
         };
 
     } // namespace ChunkManagerTests
+
+    namespace ChunkRoutingIndexTests {
+
+        /**
+         * Splits the key space of { a : 1, b : 1 } at numChunks - 1 points, with mixed types in
+         * the second field so the KeyString order has to match BSONObjCmp across types.
+         */
+        vector<BSONObj> compoundSplitPoints(int numChunks) {
+            vector<BSONObj> splitPoints;
+            for (int i = 1; i < numChunks; ++i) {
+                if (i % 3 == 0) {
+                    splitPoints.push_back(BSON("a" << i / 3 << "b" << ("s" + std::to_string(i))));
+                }
+                else {
+                    splitPoints.push_back(BSON("a" << i / 3 << "b" << (i % 3) * 10.5));
+                }
+            }
+            return splitPoints;
+        }
+
+        void assertSameChunk(const ChunkMap& chunkMap,
+                             const ChunkRoutingIndex& index,
+                             const BSONObj& key) {
+            ChunkMap::const_iterator it = chunkMap.upper_bound(key);
+            ChunkPtr expected;
+            if (it != chunkMap.end()) {
+                expected = it->second;
+            }
+            ASSERT_EQUALS(expected.get(), index.upperBound(key).get());
+        }
+
+        class MatchesChunkMap {
+        public:
+            void run() {
+                for (int numChunks = 1; numChunks <= 70; ++numChunks) {
+                    TestableChunkManager manager("", ShardKeyPattern(BSON("a" << 1 << "b" << 1)),
+                                                 false);
+                    vector<BSONObj> splitPoints = compoundSplitPoints(numChunks);
+                    manager.setSingleChunkForShards(splitPoints);
+                    const ChunkRoutingIndex& index = manager.getRoutingIndex();
+                    ASSERT_EQUALS(static_cast<size_t>(numChunks), index.size());
+
+                    const ChunkMap& chunkMap = manager.getChunkMap();
+                    assertSameChunk(chunkMap, index, BSON("a" << MINKEY << "b" << MINKEY));
+                    assertSameChunk(chunkMap, index, BSON("a" << MAXKEY << "b" << MAXKEY));
+                    for (int a = -1; a <= numChunks / 3 + 1; ++a) {
+                        assertSameChunk(chunkMap, index, BSON("a" << a << "b" << MINKEY));
+                        assertSameChunk(chunkMap, index, BSON("a" << a << "b" << 0));
+                        assertSameChunk(chunkMap, index, BSON("a" << a << "b" << 10.5));
+                        assertSameChunk(chunkMap, index, BSON("a" << a << "b" << 15LL));
+                        assertSameChunk(chunkMap, index, BSON("a" << a << "b" << "s"));
+                        assertSameChunk(chunkMap, index, BSON("a" << a + 0.5 << "b" << 1));
+                    }
+                    for (const BSONObj& splitPoint : splitPoints) {
+                        assertSameChunk(chunkMap, index, splitPoint);
+                    }
+                }
+            }
+        };
+
+        /**
+         * Routes keys spread over a collection with many chunks, so the lookups go deeper than
+         * the small cases above.
+         */
+        class ManyChunks {
+        public:
+            void run() {
+                const int numChunks = 3000;
+
+                TestableChunkManager manager("", ShardKeyPattern(BSON("a" << 1 << "b" << 1)),
+                                             false);
+                manager.setSingleChunkForShards(compoundSplitPoints(numChunks));
+                const ChunkMap& chunkMap = manager.getChunkMap();
+                const ChunkRoutingIndex& index = manager.getRoutingIndex();
+                ASSERT_EQUALS(static_cast<size_t>(numChunks), index.size());
+
+                for (int i = 0; i < 1000; ++i) {
+                    assertSameChunk(chunkMap,
+                                    index,
+                                    BSON("a" << (i * 7919) % (numChunks / 3) << "b" << i % 31));
+                }
+            }
+        };
+
+    } // namespace ChunkRoutingIndexTests
     
     class All : public Suite {
     public:
@@ -275,6 +364,8 @@ namespace ChunkTests {
             add<ChunkManagerTests::InequalityThenUnsatisfiable>();
             add<ChunkManagerTests::OrEqualityUnsatisfiableInequality>();
             add<ChunkManagerTests::InMultiShard>();
+            add<ChunkRoutingIndexTests::MatchesChunkMap>();
+            add<ChunkRoutingIndexTests::ManyChunks>();
         }
     };
 
@@ -462,6 +462,91 @@ namespace IndexUpdateTests {
         }
     };
 
+    /** Foreground index creation generates the keys on several threads when asked to. */
+    class InsertBuildParallel : public IndexBuildBase {
+    public:
+        InsertBuildParallel() : _oldIndexBuildThreads(indexBuildThreads) {
+            indexBuildThreads = 4;
+        }
+        ~InsertBuildParallel() {
+            indexBuildThreads = _oldIndexBuildThreads;
+        }
+
+        void run() {
+            // Create a new collection.
+            Database* db = _ctx.db();
+            Collection* coll;
+            RecordId dupLoc1;
+            RecordId dupLoc2;
+            const int nDocs = 5000;
+            {
+                WriteUnitOfWork wunit(&_txn);
+                db->dropCollection( &_txn, _ns );
+                coll = db->createCollection( &_txn, _ns );
+                for (int i = 0; i < nDocs; ++i) {
+                    // The same 'c' in the first and last document, which land in different
+                    // batches.
+                    const int c = (i == nDocs - 1) ? 0 : i;
+                    StatusWith<RecordId> swLoc = coll->insertDocument(
+                        &_txn,
+                        BSON("_id" << i << "a" << i % 100 << "b" << BSON_ARRAY(i << i + 1)
+                                   << "c" << c),
+                        true);
+                    ASSERT_OK(swLoc.getStatus());
+                    if (i == 0) {
+                        dupLoc1 = swLoc.getValue();
+                    }
+                    if (i == nDocs - 1) {
+                        dupLoc2 = swLoc.getValue();
+                    }
+                }
+                wunit.commit();
+            }
+
+            MultiIndexBlock indexer(&_txn, coll);
+            indexer.allowInterruption();
+
+            std::vector<BSONObj> specs;
+            specs.push_back(BSON("name" << "a_1" << "ns" << coll->ns().ns()
+                                 << "key" << BSON("a" << 1)));
+            specs.push_back(BSON("name" << "b_1" << "ns" << coll->ns().ns()
+                                 << "key" << BSON("b" << 1)));
+            specs.push_back(BSON("name" << "c_1" << "ns" << coll->ns().ns()
+                                 << "key" << BSON("c" << 1) << "unique" << true));
+            ASSERT_OK(indexer.init(specs));
+
+            std::set<RecordId> dups;
+            ASSERT_OK(indexer.insertAllDocumentsInCollection(&dups));
+
+            // The duplicate is found after merging the runs of the threads.
+            ASSERT_EQUALS(dups.size(), 1U);
+            ASSERT(dups.count(dupLoc1) || dups.count(dupLoc2));
+
+            {
+                WriteUnitOfWork wunit(&_txn);
+                indexer.commit();
+                wunit.commit();
+            }
+
+            IndexCatalog* catalog = coll->getIndexCatalog();
+            const IndexDescriptor* a = catalog->findIndexByName(&_txn, "a_1");
+            const IndexDescriptor* b = catalog->findIndexByName(&_txn, "b_1");
+            ASSERT(a);
+            ASSERT(b);
+            ASSERT(!a->isMultikey(&_txn));
+            ASSERT(b->isMultikey(&_txn));
+
+            int64_t numKeys;
+            ASSERT_OK(catalog->getIndex(a)->validate(&_txn, false, &numKeys, NULL));
+            ASSERT_EQUALS(nDocs, numKeys);
+            ASSERT_OK(catalog->getIndex(b)->validate(&_txn, false, &numKeys, NULL));
+            ASSERT_EQUALS(2 * nDocs, numKeys);
+        }
+
+    private:
+        const int _oldIndexBuildThreads;
+    };
+
     /** Index creation is killed if mayInterrupt is true. */
     class InsertBuildIndexInterrupt : public IndexBuildBase {
     public:
@@ -919,6 +1004,7 @@ namespace IndexUpdateTests {
             add<InsertBuildEnforceUnique<false> >();
             add<InsertBuildFillDups<true> >();
             add<InsertBuildFillDups<false> >();
+            add<InsertBuildParallel>();
             add<InsertBuildIndexInterrupt>();
             add<InsertBuildIndexInterruptDisallowed>();
             add<InsertBuildIdIndexInterrupt>();
@@ -33,6 +33,7 @@
 #include <boost/scoped_ptr.hpp>
 #include <iostream>
 
+#include "mongo/base/owned_pointer_vector.h"
 #include "mongo/client/dbclientcursor.h"
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/catalog/database.h"
@@ -139,6 +140,19 @@ namespace PlanRankingTests {
             return _mps->bestSolution();
         }
 
+        /**
+         * How many times were the losing plans worked during the ranking process?
+         */
+        size_t losingPlansWorks() {
+            ASSERT(NULL != _mps.get());
+            OwnedPointerVector<PlanStageStats> stats(_mps->generateCandidateStats());
+            size_t works = 0;
+            for (size_t i = 0; i < stats.size(); ++i) {
+                works += stats[i]->common.works;
+            }
+            return works;
+        }
+
         /**
          * Was a backup plan picked during the ranking process?
          */
@@ -822,6 +836,55 @@ namespace PlanRankingTests {
         }
     };
 
+    /**
+     * A plan whose index scan is estimated to examine many times more keys than another plan's
+     * is not worked at all.
+     */
+    class PlanRankingPruneByEstimatedCost : public PlanRankingTestBase {
+    public:
+        PlanRankingPruneByEstimatedCost()
+            : _estimateMaxKeys(internalQueryPlanEvaluationEstimateMaxKeys) { }
+
+        virtual ~PlanRankingPruneByEstimatedCost() {
+            internalQueryPlanEvaluationEstimateMaxKeys = _estimateMaxKeys;
+        }
+
+        void run() {
+            // 'a' is very selective, 'b' is not.
+            for (int i = 0; i < N; ++i) {
+                insert(BSON("a" << i << "b" << 1));
+            }
+
+            addIndex(BSON("a" << 1));
+            addIndex(BSON("b" << 1));
+
+            BSONObj query = BSON("a" << 100 << "b" << 1);
+            const char* expectedSolution =
+                "{fetch: {filter: {b:1}, node: {ixscan: {pattern: {a: 1}}}}}";
+
+            CanonicalQuery* cq;
+            ASSERT_OK(CanonicalQuery::canonicalize(ns, query, &cq));
+            boost::scoped_ptr<CanonicalQuery> killCq(cq);
+
+            QuerySolution* soln = pickBestPlan(cq);
+            ASSERT(QueryPlannerTestLib::solutionMatches(expectedSolution, soln->root.get()));
+            ASSERT_EQUALS(losingPlansWorks(), 0U);
+
+            // Without estimates the scan over 'b' gets its trial, and still loses.
+            internalQueryPlanEvaluationEstimateMaxKeys = 0;
+
+            ASSERT_OK(CanonicalQuery::canonicalize(ns, query, &cq));
+            killCq.reset(cq);
+
+            soln = pickBestPlan(cq);
+            ASSERT(QueryPlannerTestLib::solutionMatches(expectedSolution, soln->root.get()));
+            ASSERT_GREATER_THAN(losingPlansWorks(), 0U);
+        }
+
+    private:
+        int _estimateMaxKeys;
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "query_plan_ranking" ) {}
@@ -845,6 +908,7 @@ namespace PlanRankingTests {
             add<PlanRankingAvoidBlockingSort>();
             add<PlanRankingWorkPlansLongEnough>();
             add<PlanRankingAccountForKeySkips>();
+            add<PlanRankingPruneByEstimatedCost>();
         }
     };
 
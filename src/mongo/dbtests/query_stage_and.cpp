@@ -44,6 +44,7 @@
 #include "mongo/db/exec/fetch.h"
 #include "mongo/db/exec/index_scan.h"
 #include "mongo/db/exec/plan_stage.h"
+#include "mongo/db/exec/working_set_common.h"
 #include "mongo/db/json.h"
 #include "mongo/db/matcher/expression_parser.h"
 #include "mongo/db/operation_context_impl.h"
@@ -225,8 +226,8 @@ namespace QueryStageAnd {
             size_t memUsageAfter = ah->getMemUsage();
             ah->restoreState(&_txn);
 
-            // Invalidating a read object should decrease memory usage.
-            ASSERT_LESS_THAN(memUsageAfter, memUsageBefore);
+            // Only the RecordId was held, and its slot isn't given back.
+            ASSERT_EQUALS(memUsageAfter, memUsageBefore);
 
             // And expect to find foo==15 it flagged for review.
             const unordered_set<WorkingSetID>& flagged = ws.getFlagged();
@@ -251,9 +252,11 @@ namespace QueryStageAnd {
                 ++count;
                 member = ws.get(id);
 
-                ASSERT_TRUE(member->getFieldDotted("foo", &elt));
-                ASSERT_LESS_THAN_OR_EQUALS(elt.numberInt(), 20);
-                ASSERT_NOT_EQUALS(15, elt.numberInt());
+                // Only the last child's index keys are in the result.
+                ASSERT_FALSE(member->getFieldDotted("foo", &elt));
+                BSONObj obj = coll->docFor(&_txn, member->loc).value();
+                ASSERT_LESS_THAN_OR_EQUALS(obj["foo"].numberInt(), 20);
+                ASSERT_NOT_EQUALS(15, obj["foo"].numberInt());
                 ASSERT_TRUE(member->getFieldDotted("bar", &elt));
                 ASSERT_GREATER_THAN_OR_EQUALS(elt.numberInt(), 10);
             }
@@ -262,6 +265,172 @@ namespace QueryStageAnd {
         }
     };
 
+    /**
+     * Invalidate a RecordId held by a hashed AND which has spilled to disk.  The AND can't tell
+     * whether it holds the RecordId until it reads it back, and only flags it then.
+     */
+    class QueryStageAndHashInvalidationSpilled : public QueryStageAndBase {
+    public:
+        void run() {
+            OldClientWriteContext ctx(&_txn, ns());
+            Database* db = ctx.db();
+            Collection* coll = ctx.getCollection();
+            if (!coll) {
+                WriteUnitOfWork wuow(&_txn);
+                coll = db->createCollection(&_txn, ns());
+                wuow.commit();
+            }
+
+            for (int i = 0; i < 50; ++i) {
+                insert(BSON("foo" << i << "bar" << i));
+            }
+
+            addIndex(BSON("foo" << 1));
+            addIndex(BSON("bar" << 1));
+
+            // The smallest table is bigger than this, so the first RecordId spills.
+            WorkingSet ws;
+            scoped_ptr<AndHashStage> ah(new AndHashStage(&ws, NULL, coll, 64));
+
+            // Foo <= 20
+            IndexScanParams params;
+            params.descriptor = getIndex(BSON("foo" << 1), coll);
+            params.bounds.isSimpleRange = true;
+            params.bounds.startKey = BSON("" << 20);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = -1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+            // Bar >= 10
+            params.descriptor = getIndex(BSON("bar" << 1), coll);
+            params.bounds.startKey = BSON("" << 10);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = 1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+            // Read half of the first child, then invalidate foo == 15 and foo == 5.
+            for (int i = 0; i < 10; ++i) {
+                WorkingSetID out;
+                PlanStage::StageState status = ah->work(&out);
+                ASSERT_EQUALS(PlanStage::NEED_TIME, status);
+            }
+
+            ah->saveState();
+            set<RecordId> data;
+            getLocs(&data, coll);
+            for (set<RecordId>::const_iterator it = data.begin(); it != data.end(); ++it) {
+                int foo = coll->docFor(&_txn, *it).value()["foo"].numberInt();
+                if (15 == foo || 5 == foo) {
+                    ah->invalidate(&_txn, *it, INVALIDATION_DELETION);
+                    remove(coll->docFor(&_txn, *it).value());
+                }
+            }
+            ah->restoreState(&_txn);
+
+            const unordered_set<WorkingSetID>& flagged = ws.getFlagged();
+            ASSERT_EQUALS(size_t(0), flagged.size());
+
+            int count = 0;
+            while (!ah->isEOF()) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                PlanStage::StageState status = ah->work(&id);
+                ASSERT_NOT_EQUALS(PlanStage::FAILURE, status);
+                if (PlanStage::ADVANCED != status) { continue; }
+
+                ++count;
+                WorkingSetMember* member = ws.get(id);
+                BSONElement elt;
+                ASSERT_TRUE(member->getFieldDotted("bar", &elt));
+                ASSERT_GREATER_THAN_OR_EQUALS(elt.numberInt(), 10);
+                ASSERT_LESS_THAN_OR_EQUALS(elt.numberInt(), 20);
+                ASSERT_NOT_EQUALS(15, elt.numberInt());
+            }
+
+            // foo == 5 was never in the intersection, so only foo == 15 is flagged.
+            ASSERT_EQUALS(10, count);
+            ASSERT_EQUALS(size_t(1), flagged.size());
+            WorkingSetMember* member = ws.get(*flagged.begin());
+            ASSERT_EQUALS(WorkingSetMember::OWNED_OBJ, member->state);
+            BSONElement elt;
+            ASSERT_TRUE(member->getFieldDotted("foo", &elt));
+            ASSERT_EQUALS(15, elt.numberInt());
+
+            const AndHashStats* stats =
+                static_cast<const AndHashStats*>(ah->getSpecificStats());
+            ASSERT_EQUALS(size_t(1), stats->spills);
+            ASSERT_EQUALS(size_t(1), stats->flaggedButPassed);
+        }
+    };
+
+    /**
+     * Invalidate more documents than a spilled hashed AND will keep copies of.  It can't drop
+     * them without maybe returning a stale result, so it fails.
+     */
+    class QueryStageAndHashInvalidationSpilledLimit : public QueryStageAndBase {
+    public:
+        void run() {
+            OldClientWriteContext ctx(&_txn, ns());
+            Database* db = ctx.db();
+            Collection* coll = ctx.getCollection();
+            if (!coll) {
+                WriteUnitOfWork wuow(&_txn);
+                coll = db->createCollection(&_txn, ns());
+                wuow.commit();
+            }
+
+            // 40 MB of documents, more than the 32 MB the AND keeps copies of.
+            const std::string big(1024 * 1024, 'x');
+            for (int i = 0; i < 40; ++i) {
+                insert(BSON("foo" << i << "bar" << i << "big" << big));
+            }
+
+            addIndex(BSON("foo" << 1));
+            addIndex(BSON("bar" << 1));
+
+            WorkingSet ws;
+            scoped_ptr<AndHashStage> ah(new AndHashStage(&ws, NULL, coll, 64));
+
+            // Foo >= 0
+            IndexScanParams params;
+            params.descriptor = getIndex(BSON("foo" << 1), coll);
+            params.bounds.isSimpleRange = true;
+            params.bounds.startKey = BSON("" << 0);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = 1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+            // Bar >= 0
+            params.descriptor = getIndex(BSON("bar" << 1), coll);
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+            // Spill part of the first child, then invalidate every document.
+            for (int i = 0; i < 10; ++i) {
+                WorkingSetID out;
+                PlanStage::StageState status = ah->work(&out);
+                ASSERT_EQUALS(PlanStage::NEED_TIME, status);
+            }
+
+            ah->saveState();
+            set<RecordId> data;
+            getLocs(&data, coll);
+            for (set<RecordId>::const_iterator it = data.begin(); it != data.end(); ++it) {
+                ah->invalidate(&_txn, *it, INVALIDATION_MUTATION);
+            }
+            ah->restoreState(&_txn);
+
+            WorkingSetID id = WorkingSet::INVALID_ID;
+            ASSERT_EQUALS(PlanStage::FAILURE, ah->work(&id));
+            BSONObj errorObj;
+            WorkingSetCommon::getStatusMemberObject(ws, id, &errorObj);
+            ASSERT_FALSE(errorObj.isEmpty());
+            ASSERT_EQUALS(ErrorCodes::OperationFailed,
+                          WorkingSetCommon::getMemberObjectStatus(errorObj).code());
+        }
+    };
+
     // Invalidate one of the "are we EOF?" lookahead results.
     class QueryStageAndHashInvalidateLookahead : public QueryStageAndBase {
     public:
@@ -398,9 +567,8 @@ namespace QueryStageAnd {
     };
 
     // An AND with two children.
-    // Add large keys (512 bytes) to index of first child to cause
-    // internal buffer within hashed AND to exceed threshold (32MB)
-    // before gathering all requested results.
+    // Lower the memory limit so that the first child's RecordIds
+    // spill to disk, and with them the last child's results.
     class QueryStageAndHashTwoLeafFirstChildLargeKeys : public QueryStageAndBase {
     public:
         void run() {
@@ -422,11 +590,12 @@ namespace QueryStageAnd {
             addIndex(BSON("foo" << 1 << "big" << 1));
             addIndex(BSON("bar" << 1));
 
-            // Lower buffer limit to 20 * sizeof(big) to force memory error
-            // before hashed AND is done reading the first child (stage has to
-            // hold 21 keys in buffer for Foo <= 20).
+            // Lower buffer limit below the size of the smallest table to
+            // spill before hashed AND is done reading the first child (stage
+            // has to hold 21 RecordIds for Foo <= 20).  Only RecordIds are
+            // held, so the size of the keys doesn't matter.
             WorkingSet ws;
-            scoped_ptr<AndHashStage> ah(new AndHashStage(&ws, NULL, coll, 20 * big.size()));
+            scoped_ptr<AndHashStage> ah(new AndHashStage(&ws, NULL, coll, 64));
 
             // Foo <= 20
             IndexScanParams params;
@@ -446,8 +615,14 @@ namespace QueryStageAnd {
             params.direction = 1;
             ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
 
-            // Stage execution should fail.
-            ASSERT_EQUALS(-1, countResults(ah.get()));
+            // foo == bar, and foo<=20, bar>=10, so our values are:
+            // foo == 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20.
+            ASSERT_EQUALS(11, countResults(ah.get()));
+
+            const AndHashStats* stats =
+                static_cast<const AndHashStats*>(ah->getSpecificStats());
+            ASSERT_EQUALS(size_t(1), stats->spills);
+            ASSERT_GREATER_THAN(stats->spilledBytes, size_t(0));
         }
     };
 
@@ -562,9 +737,8 @@ namespace QueryStageAnd {
     };
 
     // An AND with three children.
-    // Add large keys (512 bytes) to index of second child to cause
-    // internal buffer within hashed AND to exceed threshold (32MB)
-    // before gathering all requested results.
+    // Lower the memory limit so that the intersection spills to disk
+    // while reading the second child, and comes back once it is smaller.
     // We need 3 children because the hashed AND stage buffered data for
     // N-1 of its children. If the second child is the last child, it will not
     // be buffered.
@@ -590,11 +764,12 @@ namespace QueryStageAnd {
             addIndex(BSON("bar" << 1 << "big" << 1));
             addIndex(BSON("baz" << 1));
 
-            // Lower buffer limit to 10 * sizeof(big) to force memory error
-            // before hashed AND is done reading the second child (stage has to
-            // hold 11 keys in buffer for Foo <= 20 and Bar >= 10).
+            // The 21 RecordIds for Foo <= 20 take a table of 32 slots, or 256
+            // bytes.  The first hit of Bar >= 10 takes another 16 slots, which
+            // goes over the limit.  The 11 RecordIds left after the second
+            // child fit in 16 slots again.
             WorkingSet ws;
-            scoped_ptr<AndHashStage> ah(new AndHashStage(&ws, NULL, coll, 10 * big.size()));
+            scoped_ptr<AndHashStage> ah(new AndHashStage(&ws, NULL, coll, 300));
 
             // Foo <= 20
             IndexScanParams params;
@@ -622,8 +797,16 @@ namespace QueryStageAnd {
             params.direction = 1;
             ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
 
-            // Stage execution should fail.
-            ASSERT_EQUALS(-1, countResults(ah.get()));
+            // foo == bar == baz, and foo<=20, bar>=10, 5<=baz<=15, so our values are:
+            // foo == 10, 11, 12, 13, 14, 15.
+            ASSERT_EQUALS(6, countResults(ah.get()));
+
+            const AndHashStats* stats =
+                static_cast<const AndHashStats*>(ah->getSpecificStats());
+            ASSERT_EQUALS(size_t(1), stats->spills);
+            ASSERT_EQUALS(size_t(2), stats->mapAfterChild.size());
+            ASSERT_EQUALS(size_t(21), stats->mapAfterChild[0]);
+            ASSERT_EQUALS(size_t(11), stats->mapAfterChild[1]);
         }
     };
 
@@ -810,7 +993,7 @@ namespace QueryStageAnd {
             addIndex(BSON("bar" << 1));
 
             WorkingSet ws;
-            scoped_ptr<AndHashStage> ah(new AndHashStage(&ws, NULL, coll));
+            AndHashStage* ah = new AndHashStage(&ws, NULL, coll);
 
             // Foo <= 20
             IndexScanParams params;
@@ -835,10 +1018,14 @@ namespace QueryStageAnd {
             params.direction = 1;
             ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
 
+            // The AndHash stage only returns what the last child has, which
+            // is index keys, so fetch its results again.
+            scoped_ptr<FetchStage> fetchOut(new FetchStage(&_txn, &ws, ah, NULL, coll));
+
             // Check that the AndHash stage returns docs {foo: 10, bar: 10}
             // through {foo: 20, bar: 20}.
             for (int i = 10; i <= 20; i++) {
-                BSONObj obj = getNext(ah.get(), &ws);
+                BSONObj obj = getNext(fetchOut.get(), &ws);
                 ASSERT_EQUALS(i, obj["foo"].numberInt());
                 ASSERT_EQUALS(i, obj["bar"].numberInt());
             }
@@ -904,6 +1091,65 @@ namespace QueryStageAnd {
         }
     };
 
+    /**
+     * Check that a hash-based intersection which spilled to disk returns the
+     * last child's fetched docs in the last child's order.
+     */
+    class QueryStageAndHashSpilledLastChildOrder : public QueryStageAndBase {
+    public:
+        void run() {
+            OldClientWriteContext ctx(&_txn, ns());
+            Database* db = ctx.db();
+            Collection* coll = ctx.getCollection();
+            if (!coll) {
+                WriteUnitOfWork wuow(&_txn);
+                coll = db->createCollection(&_txn, ns());
+                wuow.commit();
+            }
+
+            for (int i = 0; i < 50; ++i) {
+                insert(BSON("foo" << i << "bar" << (49 - i)));
+            }
+
+            addIndex(BSON("foo" << 1));
+            addIndex(BSON("bar" << 1));
+
+            // The smallest table is bigger than this, so everything spills.
+            WorkingSet ws;
+            scoped_ptr<AndHashStage> ah(new AndHashStage(&ws, NULL, coll, 64));
+
+            // Foo <= 20
+            IndexScanParams params;
+            params.descriptor = getIndex(BSON("foo" << 1), coll);
+            params.bounds.isSimpleRange = true;
+            params.bounds.startKey = BSON("" << 20);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = -1;
+            ah->addChild(new IndexScan(&_txn, params, &ws, NULL));
+
+            // Bar >= 29, fetched.
+            params.descriptor = getIndex(BSON("bar" << 1), coll);
+            params.bounds.startKey = BSON("" << 29);
+            params.bounds.endKey = BSONObj();
+            params.bounds.endKeyInclusive = true;
+            params.direction = 1;
+            IndexScan* secondScan = new IndexScan(&_txn, params, &ws, NULL);
+            ah->addChild(new FetchStage(&_txn, &ws, secondScan, NULL, coll));
+
+            // Results come back in order of bar, so foo goes down from 20 to 0.
+            for (int i = 29; i <= 49; i++) {
+                BSONObj obj = getNext(ah.get(), &ws);
+                ASSERT_EQUALS(i, obj["bar"].numberInt());
+                ASSERT_EQUALS(49 - i, obj["foo"].numberInt());
+            }
+            ASSERT_EQUALS(0, countResults(ah.get()));
+
+            const AndHashStats* stats =
+                static_cast<const AndHashStats*>(ah->getSpecificStats());
+            ASSERT_EQUALS(size_t(1), stats->spills);
+        }
+    };
 
     //
     // Sorted AND tests
@@ -1399,6 +1645,8 @@ namespace QueryStageAnd {
 
         void setupTests() {
             add<QueryStageAndHashInvalidation>();
+            add<QueryStageAndHashInvalidationSpilled>();
+            add<QueryStageAndHashInvalidationSpilledLimit>();
             add<QueryStageAndHashTwoLeaf>();
             add<QueryStageAndHashTwoLeafFirstChildLargeKeys>();
             add<QueryStageAndHashTwoLeafLastChildLargeKeys>();
@@ -1410,6 +1658,7 @@ namespace QueryStageAnd {
             add<QueryStageAndHashInvalidateLookahead>();
             add<QueryStageAndHashFirstChildFetched>();
             add<QueryStageAndHashSecondChildFetched>();
+            add<QueryStageAndHashSpilledLastChildOrder>();
             add<QueryStageAndSortedInvalidation>();
             add<QueryStageAndSortedThreeLeaf>();
             add<QueryStageAndSortedWithNothing>();
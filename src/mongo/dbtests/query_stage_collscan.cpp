@@ -38,11 +38,14 @@
 #include "mongo/db/db_raii.h"
 #include "mongo/db/dbdirectclient.h"
 #include "mongo/db/exec/collection_scan.h"
+#include "mongo/db/exec/parallel_collection_scan.h"
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/json.h"
+#include "mongo/db/exec/plan_stats.h"
 #include "mongo/db/matcher/expression_parser.h"
 #include "mongo/db/operation_context_impl.h"
 #include "mongo/db/query/plan_executor.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/storage/record_store.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/util/fail_point_service.h"
@@ -74,10 +77,18 @@ namespace QueryStageCollectionScan {
             _client.dropCollection(ns());
         }
 
+        void insert(const BSONObj& obj) {
+            _client.insert(ns(), obj);
+        }
+
         void remove(const BSONObj& obj) {
             _client.remove(ns(), obj);
         }
 
+        void update(const BSONObj& query, const BSONObj& updateObj) {
+            _client.update(ns(), query, updateObj);
+        }
+
         int countResults(CollectionScanParams::Direction direction, const BSONObj& filterObj) {
             AutoGetCollectionForRead ctx(&_txn, ns());
 
@@ -223,6 +234,60 @@ namespace QueryStageCollectionScan {
         }
     };
 
+    //
+    // With the executor working the plan in batches we get the same results, in the same order.
+    //
+
+    class QueryStageCollscanBatched : public QueryStageCollectionScanBase {
+    public:
+        QueryStageCollscanBatched() : _oldBatchSize(internalQueryExecWorkBatchSize) {
+            // Doesn't divide the number of documents evenly.
+            internalQueryExecWorkBatchSize = 7;
+        }
+
+        virtual ~QueryStageCollscanBatched() {
+            internalQueryExecWorkBatchSize = _oldBatchSize;
+        }
+
+        void run() {
+            ASSERT_EQUALS(numObj(), countResults(CollectionScanParams::FORWARD, BSONObj()));
+            BSONObj filter = BSON("foo" << BSON("$lt" << 25));
+            ASSERT_EQUALS(25, countResults(CollectionScanParams::BACKWARD, filter));
+
+            AutoGetCollectionForRead ctx(&_txn, ns());
+
+            CollectionScanParams params;
+            params.collection = ctx.getCollection();
+            params.direction = CollectionScanParams::FORWARD;
+            params.tailable = false;
+
+            WorkingSet* ws = new WorkingSet();
+            CollectionScan* scan = new CollectionScan(&_txn, params, ws, NULL);
+
+            PlanExecutor* rawExec;
+            Status status = PlanExecutor::make(&_txn, ws, scan, params.collection,
+                                               PlanExecutor::YIELD_MANUAL, &rawExec);
+            ASSERT_OK(status);
+            boost::scoped_ptr<PlanExecutor> exec(rawExec);
+
+            int count = 0;
+            for (BSONObj obj; PlanExecutor::ADVANCED == exec->getNext(&obj, NULL); ) {
+                ASSERT_EQUALS(count, obj["foo"].numberInt());
+                ++count;
+            }
+            ASSERT_EQUALS(numObj(), count);
+            ASSERT(exec->isEOF());
+
+            // Works are still counted one per document.
+            ASSERT_EQUALS(static_cast<size_t>(numObj()), scan->getCommonStats()->advanced);
+            ASSERT_GREATER_THAN_OR_EQUALS(scan->getCommonStats()->works,
+                                          static_cast<size_t>(numObj()));
+        }
+
+    private:
+        const int _oldBatchSize;
+    };
+
     //
     // Get objects in the reverse order we inserted them when we go backwards.
     //
@@ -379,6 +444,248 @@ namespace QueryStageCollectionScan {
         }
     };
 
+    //
+    // A parallel scan returns the same documents, in the same order, as a CollectionScan.
+    //
+
+    class QueryStageParallelCollscanMatchesCollscan : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            // Enough documents for several batches, the last one partly filled.
+            const int numDocs = 5 * ParallelCollectionScan::kBatchSize + 17;
+            {
+                OldClientWriteContext ctx(&_txn, ns());
+                for (int i = numObj(); i < numDocs; ++i) {
+                    insert(BSON("foo" << i << "bar" << BSON("baz" << i % 7)));
+                }
+            }
+
+            BSONObj filterObj = fromjson("{foo: {$mod: [3, 0]}, 'bar.baz': {$ne: 2}}");
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(filterObj);
+            ASSERT_OK(swme.getStatus());
+            auto_ptr<MatchExpression> filterExpr(swme.getValue());
+
+            AutoGetCollectionForRead ctx(&_txn, ns());
+            Collection* coll = ctx.getCollection();
+
+            for (int direction = -1; direction <= 1; direction += 2) {
+                CollectionScanParams params;
+                params.collection = coll;
+                params.direction = (direction > 0) ? CollectionScanParams::FORWARD
+                                                   : CollectionScanParams::BACKWARD;
+                params.tailable = false;
+
+                vector<BSONObj> expected;
+                {
+                    WorkingSet ws;
+                    CollectionScan scan(&_txn, params, &ws, filterExpr.get());
+                    getResults(&scan, &ws, &expected);
+                }
+
+                WorkingSet ws;
+                ParallelCollectionScan scan(&_txn, params, &ws, filterExpr.get(), 4);
+                vector<BSONObj> results;
+                getResults(&scan, &ws, &results);
+
+                ASSERT_EQUALS(expected.size(), results.size());
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUALS(expected[i], results[i]);
+                }
+
+                const ParallelCollectionScanStats* stats =
+                    static_cast<const ParallelCollectionScanStats*>(scan.getSpecificStats());
+                ASSERT_EQUALS(static_cast<size_t>(numDocs), stats->docsTested);
+                ASSERT_EQUALS(6U, stats->batches);
+                ASSERT_EQUALS(0U, stats->batchesFilteredInline);
+            }
+        }
+
+    private:
+        void getResults(PlanStage* scan, WorkingSet* ws, vector<BSONObj>* out) {
+            while (!scan->isEOF()) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                PlanStage::StageState state = scan->work(&id);
+                ASSERT_NOT_EQUALS(PlanStage::FAILURE, state);
+                if (PlanStage::ADVANCED == state) {
+                    WorkingSetMember* member = ws->get(id);
+                    ASSERT(member->hasLoc());
+                    out->push_back(member->obj.value().getOwned());
+                    ws->free(id);
+                }
+            }
+        }
+    };
+
+    //
+    // A small scan is filtered without starting any threads.
+    //
+
+    class QueryStageParallelCollscanSingleBatch : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            AutoGetCollectionForRead ctx(&_txn, ns());
+
+            BSONObj filterObj = BSON("foo" << BSON("$gte" << 10));
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(filterObj);
+            ASSERT_OK(swme.getStatus());
+            auto_ptr<MatchExpression> filterExpr(swme.getValue());
+
+            CollectionScanParams params;
+            params.collection = ctx.getCollection();
+            params.direction = CollectionScanParams::FORWARD;
+            params.tailable = false;
+
+            WorkingSet ws;
+            ParallelCollectionScan scan(&_txn, params, &ws, filterExpr.get(), 4);
+
+            int count = 10;
+            while (!scan.isEOF()) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                if (PlanStage::ADVANCED == scan.work(&id)) {
+                    ASSERT_EQUALS(count, ws.get(id)->obj.value()["foo"].numberInt());
+                    ++count;
+                }
+            }
+            ASSERT_EQUALS(numObj(), count);
+
+            const ParallelCollectionScanStats* stats =
+                static_cast<const ParallelCollectionScanStats*>(scan.getSpecificStats());
+            ASSERT_EQUALS(1U, stats->batches);
+            ASSERT_EQUALS(1U, stats->batchesFilteredInline);
+
+            // $where can't be run by the workers.
+            swme = MatchExpressionParser::parse(fromjson("{$or: [{a: 1}, {$where: 'true'}]}"));
+            ASSERT_OK(swme.getStatus());
+            auto_ptr<MatchExpression> whereExpr(swme.getValue());
+            ASSERT(!ParallelCollectionScan::canParallelize(whereExpr.get()));
+            ASSERT(ParallelCollectionScan::canParallelize(filterExpr.get()));
+        }
+    };
+
+    //
+    // Deleting a document which was read but not yet returned still returns it, without a loc.
+    //
+
+    class QueryStageParallelCollscanInvalidateBuffered : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            OldClientWriteContext ctx(&_txn, ns());
+            Collection* coll = ctx.getCollection();
+
+            const int numDocs = 3 * ParallelCollectionScan::kBatchSize;
+            for (int i = numObj(); i < numDocs; ++i) {
+                insert(BSON("foo" << i));
+            }
+
+            vector<RecordId> locs;
+            getLocs(coll, CollectionScanParams::FORWARD, &locs);
+            ASSERT_EQUALS(static_cast<size_t>(numDocs), locs.size());
+
+            BSONObj filterObj = BSON("foo" << BSON("$gte" << 0));
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(filterObj);
+            ASSERT_OK(swme.getStatus());
+            auto_ptr<MatchExpression> filterExpr(swme.getValue());
+
+            CollectionScanParams params;
+            params.collection = coll;
+            params.direction = CollectionScanParams::FORWARD;
+            params.tailable = false;
+
+            WorkingSet ws;
+            ParallelCollectionScan scan(&_txn, params, &ws, filterExpr.get(), 2);
+
+            int count = 0;
+            while (count < 10) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                if (PlanStage::ADVANCED == scan.work(&id)) {
+                    ASSERT_EQUALS(count, ws.get(id)->obj.value()["foo"].numberInt());
+                    ++count;
+                }
+            }
+
+            // The first batch has been read, remove a document in it we haven't seen.
+            const int removed = count + 5;
+            scan.saveState();
+            scan.invalidate(&_txn, locs[removed], INVALIDATION_DELETION);
+            remove(coll->docFor(&_txn, locs[removed]).value());
+            scan.restoreState(&_txn);
+
+            while (!scan.isEOF()) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                if (PlanStage::ADVANCED == scan.work(&id)) {
+                    WorkingSetMember* member = ws.get(id);
+                    ASSERT_EQUALS(count, member->obj.value()["foo"].numberInt());
+                    ASSERT_EQUALS(removed != count, member->hasLoc());
+                    ++count;
+                }
+            }
+            ASSERT_EQUALS(numDocs, count);
+        }
+    };
+
+    //
+    // Updating a document which was read but not yet returned returns it without a loc, so an
+    // update or delete won't act on it.
+    //
+
+    class QueryStageParallelCollscanInvalidateMutation : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            OldClientWriteContext ctx(&_txn, ns());
+            Collection* coll = ctx.getCollection();
+
+            const int numDocs = 3 * ParallelCollectionScan::kBatchSize;
+            for (int i = numObj(); i < numDocs; ++i) {
+                insert(BSON("foo" << i));
+            }
+
+            vector<RecordId> locs;
+            getLocs(coll, CollectionScanParams::FORWARD, &locs);
+            ASSERT_EQUALS(static_cast<size_t>(numDocs), locs.size());
+
+            BSONObj filterObj = BSON("foo" << BSON("$gte" << 0));
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(filterObj);
+            ASSERT_OK(swme.getStatus());
+            auto_ptr<MatchExpression> filterExpr(swme.getValue());
+
+            CollectionScanParams params;
+            params.collection = coll;
+            params.direction = CollectionScanParams::FORWARD;
+            params.tailable = false;
+
+            WorkingSet ws;
+            ParallelCollectionScan scan(&_txn, params, &ws, filterExpr.get(), 2);
+
+            int count = 0;
+            while (count < 10) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                if (PlanStage::ADVANCED == scan.work(&id)) {
+                    ASSERT_EQUALS(count, ws.get(id)->obj.value()["foo"].numberInt());
+                    ++count;
+                }
+            }
+
+            // The first batch has been read, update a document in it we haven't seen.  The
+            // invalidation comes before the write, as it does from the Collection.
+            const int updated = count + 5;
+            scan.saveState();
+            scan.invalidate(&_txn, locs[updated], INVALIDATION_MUTATION);
+            update(BSON("foo" << updated), BSON("$set" << BSON("bar" << 1)));
+            scan.restoreState(&_txn);
+
+            while (!scan.isEOF()) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                if (PlanStage::ADVANCED == scan.work(&id)) {
+                    WorkingSetMember* member = ws.get(id);
+                    ASSERT_EQUALS(count, member->obj.value()["foo"].numberInt());
+                    ASSERT_EQUALS(updated != count, member->hasLoc());
+                    ++count;
+                }
+            }
+            ASSERT_EQUALS(numDocs, count);
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "QueryStageCollectionScan" ) {}
@@ -391,8 +698,13 @@ namespace QueryStageCollectionScan {
             add<QueryStageCollscanBasicBackwardWithMatch>();
             add<QueryStageCollscanObjectsInOrderForward>();
             add<QueryStageCollscanObjectsInOrderBackward>();
+            add<QueryStageCollscanBatched>();
             add<QueryStageCollscanInvalidateUpcomingObject>();
             add<QueryStageCollscanInvalidateUpcomingObjectBackward>();
+            add<QueryStageParallelCollscanMatchesCollscan>();
+            add<QueryStageParallelCollscanSingleBatch>();
+            add<QueryStageParallelCollscanInvalidateBuffered>();
+            add<QueryStageParallelCollscanInvalidateMutation>();
         }
     };
 
@@ -80,6 +80,22 @@ namespace {
         return count;
     }
 
+    int countResultsBatched(PlanStage* stage, WorkingSet* ws, size_t batchSize) {
+        int count = 0;
+        while (!stage->isEOF()) {
+            std::vector<WorkingSetID> results;
+            WorkingSetID stateId = WorkingSet::INVALID_ID;
+            PlanStage::StageState status = stage->workBatch(batchSize, &results, &stateId);
+            ASSERT_LESS_THAN_OR_EQUALS(results.size(), batchSize);
+            for (size_t i = 0; i < results.size(); ++i) {
+                ws->free(results[i]);
+            }
+            count += results.size();
+            if (PlanStage::IS_EOF == status) { break; }
+        }
+        return count;
+    }
+
     //
     // Insert 50 objects.  Filter/skip 0, 1, 2, ..., 100 objects and expect the right # of results.
     //
@@ -98,12 +114,42 @@ namespace {
         }
     };
 
+    //
+    // The same through workBatch(), with batches which do and don't line up with the results.
+    //
+    class QueryStageLimitSkipBatchedTest {
+    public:
+        void run() {
+            const size_t batchSizes[] = {1, 3, 64};
+            for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); ++b) {
+                for (int i = 0; i < 2 * N; ++i) {
+                    WorkingSet ws;
+
+                    scoped_ptr<PlanStage> skip(new SkipStage(i, &ws, getMS(&ws)));
+                    ASSERT_EQUALS(max(0, N - i),
+                                  countResultsBatched(skip.get(), &ws, batchSizes[b]));
+
+                    scoped_ptr<PlanStage> limit(new LimitStage(i, &ws, getMS(&ws)));
+                    ASSERT_EQUALS(min(N, i),
+                                  countResultsBatched(limit.get(), &ws, batchSizes[b]));
+
+                    // A limit over a skip: the second page of results.
+                    scoped_ptr<PlanStage> page(
+                            new LimitStage(i, &ws, new SkipStage(i, &ws, getMS(&ws))));
+                    ASSERT_EQUALS(min(max(0, N - i), i),
+                                  countResultsBatched(page.get(), &ws, batchSizes[b]));
+                }
+            }
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "query_stage_limit_skip" ) { }
 
         void setupTests() {
             add<QueryStageLimitSkipBasicTest>();
+            add<QueryStageLimitSkipBatchedTest>();
         }
     };
 
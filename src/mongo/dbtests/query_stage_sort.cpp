@@ -38,6 +38,7 @@
 #include "mongo/db/json.h"
 #include "mongo/db/operation_context_impl.h"
 #include "mongo/db/query/plan_executor.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/dbtests/dbtests.h"
 
 /**
@@ -542,6 +543,73 @@ namespace QueryStageSortTests {
         }
     };
 
+    // With disk use allowed, a sort which outgrows the memory limit spills sorted runs and
+    // merges them instead of failing.
+    template <int LIMIT>
+    class QueryStageSortSpill : public QueryStageSortTestBase {
+    public:
+        QueryStageSortSpill()
+            : _oldMaxBytes(internalQueryExecMaxBlockingSortBytes),
+              _oldAllowDiskUse(internalQueryExecBlockingSortAllowDiskUse) {
+            internalQueryExecMaxBlockingSortBytes = 16 * 1024;
+            internalQueryExecBlockingSortAllowDiskUse = true;
+        }
+
+        virtual ~QueryStageSortSpill() {
+            internalQueryExecMaxBlockingSortBytes = _oldMaxBytes;
+            internalQueryExecBlockingSortAllowDiskUse = _oldAllowDiskUse;
+        }
+
+        virtual int numObj() { return 10000; }
+
+        virtual int limit() const { return LIMIT; }
+
+        void run() {
+            OldClientWriteContext ctx(&_txn, ns());
+            Database* db = ctx.db();
+            Collection* coll = db->getCollection(ns());
+            if (!coll) {
+                WriteUnitOfWork wuow(&_txn);
+                coll = db->createCollection(&_txn, ns());
+                wuow.commit();
+            }
+
+            fillData();
+
+            WorkingSet* ws = new WorkingSet();
+            QueuedDataStage* ms = new QueuedDataStage(ws);
+            insertVarietyOfObjects(ms, coll);
+
+            SortStageParams params;
+            params.collection = coll;
+            params.pattern = BSON("foo" << -1);
+            params.limit = limit();
+            SortStage* sort = new SortStage(params, ws, ms);
+
+            PlanExecutor* rawExec;
+            Status status = PlanExecutor::make(&_txn, ws, sort, coll,
+                                               PlanExecutor::YIELD_MANUAL, &rawExec);
+            ASSERT_OK(status);
+            boost::scoped_ptr<PlanExecutor> exec(rawExec);
+
+            int count = 0;
+            BSONObj obj;
+            while (PlanExecutor::ADVANCED == exec->getNext(&obj, NULL)) {
+                ASSERT_EQUALS(numObj() - 1 - count, obj["foo"].numberInt());
+                ++count;
+            }
+            checkCount(count);
+
+            const SortStats* stats = static_cast<const SortStats*>(sort->getSpecificStats());
+            ASSERT_GREATER_THAN(stats->spills, 1U);
+            ASSERT_GREATER_THAN(stats->spilledBytes, 0U);
+        }
+
+    private:
+        const int _oldMaxBytes;
+        const bool _oldAllowDiskUse;
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "query_stage_sort_test" ) { }
@@ -559,6 +627,8 @@ namespace QueryStageSortTests {
             add<QueryStageSortDeletionInvalidationWithLimit<10> >();
             add<QueryStageSortDeletionInvalidationWithLimit<1> >();
             add<QueryStageSortParallelArrays>();
+            add<QueryStageSortSpill<0> >();
+            add<QueryStageSortSpill<2000> >();
         }
     };
 
@@ -0,0 +1,897 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kExecutor
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/executor/network_interface_asio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include "mongo/db/auth/internal_user_auth.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/dbmessage.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/concurrency/thread_name.h"
+#include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
+#include "mongo/util/net/ssl_options.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+namespace executor {
+
+namespace {
+
+    const size_t kHeaderSize = sizeof(MSGHEADER::Value);
+
+    // Idle connections beyond this many per host are closed when their command completes.
+    const size_t kMaxIdleConnectionsPerHost = 64;
+
+    // Idle connections are not reused after this long, the remote end has likely dropped them.
+    const Seconds kMaxIdleConnectionAge(60);
+
+    // Cursor affinity is best effort, mongod doesn't tie cursors to connections, so the least
+    // recently used entries are dropped rather than letting abandoned cursors grow the map.
+    const size_t kMaxTrackedCursorsPerHost = 10000;
+
+    bool isStaleConnectionError(const std::error_code& ec) {
+        return ec == asio::error::eof ||
+               ec == asio::error::connection_reset ||
+               ec == asio::error::broken_pipe;
+    }
+
+    Status networkErrorStatus(const std::error_code& ec,
+                              const char* context,
+                              const HostAndPort& target) {
+        return Status(ErrorCodes::HostUnreachable,
+                      str::stream() << "network error " << context << " " << target.toString()
+                                    << ": " << ec.message());
+    }
+
+    Status validateReplyLength(int msgSize, const HostAndPort& target) {
+        if (msgSize < static_cast<int>(sizeof(QueryResult::Value)) ||
+                static_cast<size_t>(msgSize) > MaxMessageSizeBytes) {
+            return Status(ErrorCodes::ProtocolError,
+                          str::stream() << "invalid reply length " << msgSize << " from "
+                                        << target.toString());
+        }
+        return Status::OK();
+    }
+
+    /**
+     * Converts the OP_REPLY to a command into the command's response, or the error the server
+     * reported with $err.
+     */
+    repl::ResponseStatus parseCommandReply(const Message& reply,
+                                           const HostAndPort& target,
+                                           Milliseconds elapsed) {
+        QueryResult::View qr = reply.singleData().view2ptr();
+        const int dataLen = reply.size() - sizeof(QueryResult::Value);
+        if (reply.operation() != opReply || qr.getNReturned() != 1 ||
+                dataLen < BSONObj::kMinBSONLength ||
+                ConstDataView(qr.data()).read<LittleEndian<int>>() > dataLen) {
+            return Status(ErrorCodes::ProtocolError,
+                          str::stream() << "malformed command reply from " << target.toString());
+        }
+
+        const BSONObj data(qr.data());
+        if (qr.getResultFlags() & ResultFlag_ErrSet) {
+            const BSONElement code = data["code"];
+            return Status(code.isNumber() ? ErrorCodes::fromInt(code.numberInt()) :
+                                            ErrorCodes::UnknownError,
+                          data["$err"].valuestrsafe());
+        }
+        return RemoteCommandResponse(data.getOwned(), elapsed);
+    }
+
+    /**
+     * Returns the cursor a getMore command continues, or 0 for any other command.
+     */
+    long long cursorIdForCommand(const BSONObj& cmdObj) {
+        const BSONElement first = cmdObj.firstElement();
+        if (first.fieldNameStringData() != "getMore" || first.type() != NumberLong) {
+            return 0;
+        }
+        return first.numberLong();
+    }
+
+}  // namespace
+
+    NetworkInterfaceASIO::AsyncConnection::AsyncConnection(asio::io_service& service,
+                                                           const HostAndPort& theHost) :
+        socket(service),
+        host(theHost) {
+
+    }
+
+    NetworkInterfaceASIO::AsyncOp::AsyncOp(
+            asio::io_service& service,
+            const repl::ReplicationExecutor::CallbackHandle& theCbHandle,
+            const RemoteCommandRequest& theRequest,
+            const RemoteCommandCompletionFn& theOnFinish,
+            Date_t theStart) :
+        cbHandle(theCbHandle),
+        request(theRequest),
+        onFinish(theOnFinish),
+        start(theStart),
+        reusedConnection(false),
+        retried(false),
+        written(false),
+        finished(false),
+        timeout(service),
+        requestId(0) {
+
+    }
+
+    NetworkInterfaceASIO::MultiplexedConnection::MultiplexedConnection(
+            asio::io_service& service,
+            const HostAndPort& theHost) :
+        socket(service),
+        host(theHost),
+        connected(false),
+        failed(false),
+        writing(false),
+        reading(false) {
+
+    }
+
+    void NetworkInterfaceASIO::HostConnections::forgetCursor(
+            std::map<long long, TrackedCursor>::iterator it) {
+        cursorsByAge.erase(it->second.age);
+        cursors.erase(it);
+    }
+
+    NetworkInterfaceASIO::NetworkInterfaceASIO(size_t connectionsPerHost) :
+        NetworkInterface(),
+        _connectionsPerHost(connectionsPerHost),
+        _resolver(_io_service),
+        _isExecutorRunnable(false),
+        _inShutdown(false),
+        _started(false) {
+
+    }
+
+    NetworkInterfaceASIO::~NetworkInterfaceASIO() { }
+
+    bool NetworkInterfaceASIO::isUsable() {
+        if (isInternalAuthSet()) {
+            return false;
+        }
+        const int sslMode = sslGlobalParams.sslMode.load();
+        return sslMode == SSLParams::SSLMode_disabled || sslMode == SSLParams::SSLMode_allowSSL;
+    }
+
+    std::string NetworkInterfaceASIO::getDiagnosticString() {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        str::stream output;
+        output << "NetworkInterfaceASIO";
+        output << " inShutdown:" << _inShutdown;
+        output << " inProgress:" << _inProgress.size();
+        output << " commands:" << _numCommands.load();
+        output << " connects:" << _numConnects.load();
+        output << " reused:" << _numReusedConnections.load();
+        output << " retries:" << _numRetries.load();
+        output << " failures:" << _numFailures.load();
+        output << " multiplexedConnections:" << _numMultiplexedConnections.load();
+        output << " execRunable:" << _isExecutorRunnable;
+        return output;
+    }
+
+    void NetworkInterfaceASIO::appendStats(BSONObjBuilder* builder) {
+        size_t inProgress;
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            inProgress = _inProgress.size();
+        }
+        builder->appendNumber("inProgress", static_cast<long long>(inProgress));
+        builder->appendNumber("commands", static_cast<long long>(_numCommands.load()));
+        builder->appendNumber("connects", static_cast<long long>(_numConnects.load()));
+        builder->appendNumber("reusedConnections",
+                              static_cast<long long>(_numReusedConnections.load()));
+        builder->appendNumber("retries", static_cast<long long>(_numRetries.load()));
+        builder->appendNumber("failures", static_cast<long long>(_numFailures.load()));
+        builder->appendNumber("connectionsPerHost", static_cast<long long>(_connectionsPerHost));
+        builder->appendNumber("multiplexedConnections", _numMultiplexedConnections.load());
+    }
+
+    void NetworkInterfaceASIO::startup() {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        invariant(!_inShutdown);
+        if (_started) {
+            return;
+        }
+        _started = true;
+        _work.reset(new asio::io_service::work(_io_service));
+        _serviceRunner = stdx::thread([this] {
+            setThreadName("NetworkInterfaceASIO");
+            LOG(1) << "thread starting";
+            _io_service.run();
+            LOG(1) << "thread shutting down";
+        });
+    }
+
+    void NetworkInterfaceASIO::shutdown() {
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _inShutdown = true;
+            if (!_started) {
+                return;
+            }
+        }
+        // Fail everything still outstanding on the network thread so no handler runs after the
+        // join, then let run() return once the aborted handlers have drained.
+        _io_service.post([this] {
+            stdx::list<AsyncOpPtr> outstanding;
+            {
+                stdx::lock_guard<stdx::mutex> lk(_mutex);
+                outstanding = _inProgress;
+            }
+            for (const AsyncOpPtr& op : outstanding) {
+                _completeOp(op, Status(ErrorCodes::ShutdownInProgress,
+                                       "network interface shutting down"));
+            }
+            _closeAllConnections();
+            _resolver.cancel();
+        });
+        _work.reset();
+        _serviceRunner.join();
+    }
+
+    void NetworkInterfaceASIO::signalWorkAvailable() {
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _signalWorkAvailable_inlock();
+    }
+
+    void NetworkInterfaceASIO::_signalWorkAvailable_inlock() {
+        if (!_isExecutorRunnable) {
+            _isExecutorRunnable = true;
+            _isExecutorRunnableCondition.notify_one();
+        }
+    }
+
+    void NetworkInterfaceASIO::waitForWork() {
+        stdx::unique_lock<stdx::mutex> lk(_mutex);
+        while (!_isExecutorRunnable) {
+            _isExecutorRunnableCondition.wait(lk);
+        }
+        _isExecutorRunnable = false;
+    }
+
+    void NetworkInterfaceASIO::waitForWorkUntil(Date_t when) {
+        stdx::unique_lock<stdx::mutex> lk(_mutex);
+        while (!_isExecutorRunnable) {
+            const Milliseconds waitTime(when - now());
+            if (waitTime <= Milliseconds(0)) {
+                break;
+            }
+            _isExecutorRunnableCondition.wait_for(lk, waitTime);
+        }
+        _isExecutorRunnable = false;
+    }
+
+    Date_t NetworkInterfaceASIO::now() {
+        return Date_t::now();
+    }
+
+    void NetworkInterfaceASIO::startCommand(
+            const repl::ReplicationExecutor::CallbackHandle& cbHandle,
+            const RemoteCommandRequest& request,
+            const RemoteCommandCompletionFn& onFinish) {
+        LOG(2) << "Scheduling " << request.cmdObj.firstElementFieldName() << " to " <<
+            request.target;
+        AsyncOpPtr op = std::make_shared<AsyncOp>(_io_service, cbHandle, request, onFinish, now());
+        {
+            stdx::unique_lock<stdx::mutex> lk(_mutex);
+            if (_inShutdown) {
+                lk.unlock();
+                onFinish(repl::ResponseStatus(ErrorCodes::ShutdownInProgress,
+                                              "network interface shutting down"));
+                return;
+            }
+            _inProgress.push_back(op);
+        }
+        _numCommands.fetchAndAdd(1);
+        _io_service.post([this, op] { _startOp(op); });
+    }
+
+    void NetworkInterfaceASIO::cancelCommand(
+            const repl::ReplicationExecutor::CallbackHandle& cbHandle) {
+        // Callers which do not go through an executor pass an invalid handle, they abandon
+        // commands by timing them out instead.
+        if (!cbHandle.isValid()) {
+            return;
+        }
+        AsyncOpPtr op;
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            for (const AsyncOpPtr& candidate : _inProgress) {
+                if (candidate->cbHandle == cbHandle) {
+                    op = candidate;
+                    break;
+                }
+            }
+        }
+        if (!op) {
+            return;
+        }
+        _io_service.post([this, op] {
+            _completeOp(op, Status(ErrorCodes::CallbackCanceled, "Callback canceled"));
+        });
+    }
+
+    void NetworkInterfaceASIO::_startOp(const AsyncOpPtr& op) {
+        if (op->finished) {
+            return;
+        }
+
+        Milliseconds timeout = op->request.timeout;
+        if (op->request.expirationDate != RemoteCommandRequest::kNoExpirationDate) {
+            const Milliseconds untilExpiration = op->request.expirationDate - now();
+            if (untilExpiration <= Milliseconds(0)) {
+                _completeOp(op, Status(ErrorCodes::ExceededTimeLimit,
+                                       str::stream() << "Went to run command, but it was too "
+                                       "late. Expiration was set to "
+                                       << dateToISOStringUTC(op->request.expirationDate)));
+                return;
+            }
+            if (timeout == RemoteCommandRequest::kNoTimeout || untilExpiration < timeout) {
+                timeout = untilExpiration;
+            }
+        }
+        if (timeout != RemoteCommandRequest::kNoTimeout) {
+            op->timeout.expires_from_now(std::chrono::milliseconds(timeout.count()));
+            op->timeout.async_wait([this, op](std::error_code ec) {
+                if (ec || op->finished) {
+                    return;
+                }
+                _completeOp(op, Status(ErrorCodes::ExceededTimeLimit,
+                                       str::stream() << "Operation timed out waiting for "
+                                                     << op->request.target.toString()));
+            });
+        }
+
+        // see query.h for the protocol we are using here.
+        BufBuilder b;
+        b.appendNum(0); // command/query options
+        b.appendStr(op->request.dbname + ".$cmd");
+        b.appendNum(0); // ntoskip
+        b.appendNum(-1); // ntoreturn, -1 so the server closes the cursor
+        op->request.cmdObj.appendSelfToBufBuilder(b);
+        op->toSend.setData(dbQuery, b.buf(), b.len());
+        op->requestId = nextMessageId();
+        op->toSend.header().setId(op->requestId);
+        op->toSend.header().setResponseTo(0);
+
+        if (_connectionsPerHost) {
+            _startMultiplexedOp(op);
+            return;
+        }
+
+        op->connection = _getIdleConnection(op->request.target);
+        if (op->connection) {
+            op->reusedConnection = true;
+            _numReusedConnections.fetchAndAdd(1);
+            _send(op);
+            return;
+        }
+        _connect(op);
+    }
+
+    void NetworkInterfaceASIO::_connect(const AsyncOpPtr& op) {
+        op->reusedConnection = false;
+        op->connection.reset(new AsyncConnection(_io_service, op->request.target));
+        _numConnects.fetchAndAdd(1);
+
+        asio::ip::tcp::resolver::query query(op->request.target.host(),
+                                             std::to_string(op->request.target.port()));
+        _resolver.async_resolve(query, [this, op](std::error_code ec,
+                                                  asio::ip::tcp::resolver::iterator endpoints) {
+            if (op->finished) {
+                return;
+            }
+            if (ec) {
+                _networkError(op, ec, "resolving");
+                return;
+            }
+            asio::async_connect(op->connection->socket, endpoints,
+                                [this, op](std::error_code ec, asio::ip::tcp::resolver::iterator) {
+                if (op->finished) {
+                    return;
+                }
+                if (ec) {
+                    _networkError(op, ec, "connecting to");
+                    return;
+                }
+                std::error_code ignored;
+                op->connection->socket.set_option(asio::ip::tcp::no_delay(true), ignored);
+                _send(op);
+            });
+        });
+    }
+
+    void NetworkInterfaceASIO::_send(const AsyncOpPtr& op) {
+        asio::async_write(op->connection->socket,
+                          asio::buffer(op->toSend.singleData().view2ptr(), op->toSend.size()),
+                          [this, op](std::error_code ec, size_t) {
+            if (op->finished) {
+                return;
+            }
+            if (ec) {
+                _networkError(op, ec, "sending command to");
+                return;
+            }
+            op->written = true;
+            _recvHeader(op);
+        });
+    }
+
+    void NetworkInterfaceASIO::_recvHeader(const AsyncOpPtr& op) {
+        asio::async_read(op->connection->socket,
+                         asio::buffer(op->responseHeader.view().view2ptr(), kHeaderSize),
+                         [this, op](std::error_code ec, size_t) {
+            if (op->finished) {
+                return;
+            }
+            if (ec) {
+                _networkError(op, ec, "receiving reply header from");
+                return;
+            }
+            MSGHEADER::ConstView header = op->responseHeader.constView();
+            Status status = validateReplyLength(header.getMessageLength(), op->request.target);
+            if (!status.isOK()) {
+                _completeOp(op, status);
+                return;
+            }
+            if (header.getResponseTo() != op->requestId) {
+                _completeOp(op, Status(ErrorCodes::ProtocolError,
+                                       str::stream() << "reply from "
+                                                     << op->request.target.toString()
+                                                     << " is for request "
+                                                     << header.getResponseTo()
+                                                     << ", expected " << op->requestId));
+                return;
+            }
+            _recvBody(op);
+        });
+    }
+
+    void NetworkInterfaceASIO::_recvBody(const AsyncOpPtr& op) {
+        const int msgSize = op->responseHeader.constView().getMessageLength();
+        char* buf = static_cast<char*>(mongoMalloc(msgSize));
+        memcpy(buf, op->responseHeader.view().view2ptr(), kHeaderSize);
+        op->toRecv.reset();
+        op->toRecv.setData(buf, true);
+
+        asio::async_read(op->connection->socket,
+                         asio::buffer(buf + kHeaderSize, msgSize - kHeaderSize),
+                         [this, op](std::error_code ec, size_t) {
+            if (op->finished) {
+                return;
+            }
+            if (ec) {
+                _networkError(op, ec, "receiving reply from");
+                return;
+            }
+
+            // The whole reply is in, the socket can serve the next command.
+            _returnConnection(std::move(op->connection));
+
+            _completeOp(op, parseCommandReply(op->toRecv,
+                                              op->request.target,
+                                              Milliseconds(now() - op->start)));
+        });
+    }
+
+    void NetworkInterfaceASIO::_networkError(const AsyncOpPtr& op,
+                                             const std::error_code& ec,
+                                             const char* context) {
+        // A pooled connection may have been closed by the remote end while it sat idle, which
+        // shows up as soon as it is used.  Try once more on a fresh connection, but only if the
+        // request wasn't written: after that the command may have run, and it need not be
+        // idempotent.
+        if (op->reusedConnection && !op->written && !op->retried &&
+                isStaleConnectionError(ec)) {
+            LOG(2) << "Pooled connection to " << op->request.target << " failed " << context
+                   << " it: " << ec.message() << ", retrying on a new connection";
+            op->retried = true;
+            _numRetries.fetchAndAdd(1);
+            _connect(op);
+            return;
+        }
+        _completeOp(op, networkErrorStatus(ec, context, op->request.target));
+    }
+
+    void NetworkInterfaceASIO::_completeOp(const AsyncOpPtr& op,
+                                           const repl::ResponseStatus& status) {
+        if (op->finished) {
+            return;
+        }
+        op->finished = true;
+
+        std::error_code ignored;
+        op->timeout.cancel(ignored);
+        // Any connection still owned by the op is mid-command and can't be reused, closing it
+        // also aborts outstanding handlers, which see op->finished and return.
+        if (op->connection) {
+            op->connection->socket.close(ignored);
+            op->connection.reset();
+        }
+        if (!status.isOK()) {
+            _numFailures.fetchAndAdd(1);
+        }
+        {
+            stdx::lock_guard<stdx::mutex> lk(_mutex);
+            _inProgress.remove(op);
+        }
+
+        LOG(2) << "Network status of sending " << op->request.cmdObj.firstElementFieldName() <<
+            " to " << op->request.target << " was " << status.getStatus();
+        op->onFinish(status);
+
+        stdx::lock_guard<stdx::mutex> lk(_mutex);
+        _signalWorkAvailable_inlock();
+    }
+
+    std::unique_ptr<NetworkInterfaceASIO::AsyncConnection>
+    NetworkInterfaceASIO::_getIdleConnection(const HostAndPort& host) {
+        auto it = _idleConnections.find(host);
+        if (it == _idleConnections.end()) {
+            return {};
+        }
+        // Most recently used last, so once the back is too old all of them are
+        auto& idle = it->second;
+        const Date_t oldestUsable = now() - kMaxIdleConnectionAge;
+        while (!idle.empty()) {
+            std::unique_ptr<AsyncConnection> connection = std::move(idle.back());
+            idle.pop_back();
+            if (connection->lastUsed >= oldestUsable) {
+                return connection;
+            }
+        }
+        return {};
+    }
+
+    void NetworkInterfaceASIO::_returnConnection(std::unique_ptr<AsyncConnection> connection) {
+        connection->lastUsed = now();
+        auto& idle = _idleConnections[connection->host];
+        if (idle.size() >= kMaxIdleConnectionsPerHost) {
+            return;
+        }
+        idle.push_back(std::move(connection));
+    }
+
+    void NetworkInterfaceASIO::_closeAllConnections() {
+        _idleConnections.clear();
+        std::error_code ignored;
+        for (auto& host : _multiplexed) {
+            for (const MultiplexedConnectionPtr& connection : host.second.connections) {
+                // Outstanding handlers see failed and return
+                connection->failed = true;
+                connection->socket.close(ignored);
+                _numMultiplexedConnections.subtractAndFetch(1);
+            }
+        }
+        _multiplexed.clear();
+    }
+
+    void NetworkInterfaceASIO::_startMultiplexedOp(const AsyncOpPtr& op) {
+        HostConnections& host = _multiplexed[op->request.target];
+
+        MultiplexedConnectionPtr connection;
+        const long long cursorId = cursorIdForCommand(op->request.cmdObj);
+        if (cursorId) {
+            auto it = host.cursors.find(cursorId);
+            if (it != host.cursors.end()) {
+                connection = it->second.connection.lock();
+                if (connection) {
+                    host.cursorsByAge.splice(host.cursorsByAge.end(),
+                                             host.cursorsByAge,
+                                             it->second.age);
+                }
+                else {
+                    host.forgetCursor(it);
+                }
+            }
+        }
+
+        if (connection) {
+            _numReusedConnections.fetchAndAdd(1);
+        }
+        else if (host.connections.size() < _connectionsPerHost) {
+            connection = std::make_shared<MultiplexedConnection>(_io_service, op->request.target);
+            host.connections.push_back(connection);
+            _numMultiplexedConnections.addAndFetch(1);
+            _connectMultiplexed(connection);
+        }
+        else {
+            // All connections are open, share the one with the least queued behind it
+            connection = *std::min_element(
+                    host.connections.begin(),
+                    host.connections.end(),
+                    [](const MultiplexedConnectionPtr& a, const MultiplexedConnectionPtr& b) {
+                        return a->outstanding.size() + a->toSend.size() <
+                               b->outstanding.size() + b->toSend.size();
+                    });
+            _numReusedConnections.fetchAndAdd(1);
+        }
+
+        connection->toSend.push_back(op);
+        _flushMultiplexed(connection);
+    }
+
+    void NetworkInterfaceASIO::_connectMultiplexed(const MultiplexedConnectionPtr& connection) {
+        _numConnects.fetchAndAdd(1);
+
+        asio::ip::tcp::resolver::query query(connection->host.host(),
+                                             std::to_string(connection->host.port()));
+        _resolver.async_resolve(query, [this, connection](
+                std::error_code ec,
+                asio::ip::tcp::resolver::iterator endpoints) {
+            if (connection->failed) {
+                return;
+            }
+            if (ec) {
+                _failMultiplexed(connection,
+                                 networkErrorStatus(ec, "resolving", connection->host),
+                                 false);
+                return;
+            }
+            asio::async_connect(connection->socket, endpoints, [this, connection](
+                    std::error_code ec,
+                    asio::ip::tcp::resolver::iterator) {
+                if (connection->failed) {
+                    return;
+                }
+                if (ec) {
+                    _failMultiplexed(connection,
+                                     networkErrorStatus(ec, "connecting to", connection->host),
+                                     false);
+                    return;
+                }
+                std::error_code ignored;
+                connection->socket.set_option(asio::ip::tcp::no_delay(true), ignored);
+                connection->connected = true;
+                _flushMultiplexed(connection);
+            });
+        });
+    }
+
+    void NetworkInterfaceASIO::_flushMultiplexed(const MultiplexedConnectionPtr& connection) {
+        if (!connection->connected || connection->writing) {
+            return;
+        }
+
+        // Everything queued goes out in one gathered write
+        connection->sending.clear();
+        connection->sendBuffers.clear();
+        while (!connection->toSend.empty()) {
+            AsyncOpPtr op = std::move(connection->toSend.front());
+            connection->toSend.pop_front();
+            if (op->finished) {
+                continue;
+            }
+            // Registered before the write, the reply handler may run before the write handler
+            connection->outstanding[op->requestId] = op;
+            connection->sendBuffers.push_back(asio::buffer(op->toSend.singleData().view2ptr(),
+                                                           op->toSend.size()));
+            connection->sending.push_back(std::move(op));
+        }
+        if (connection->sending.empty()) {
+            return;
+        }
+
+        connection->writing = true;
+        asio::async_write(connection->socket, connection->sendBuffers,
+                          [this, connection](std::error_code ec, size_t bytesWritten) {
+            // A request written in full may have run, the remote end ignores one it didn't
+            // receive in full.
+            for (const AsyncOpPtr& op : connection->sending) {
+                if (bytesWritten < static_cast<size_t>(op->toSend.size())) {
+                    break;
+                }
+                bytesWritten -= op->toSend.size();
+                op->written = true;
+            }
+            connection->writing = false;
+            connection->sending.clear();
+            if (connection->failed) {
+                return;
+            }
+            if (ec) {
+                _failMultiplexed(connection,
+                                 networkErrorStatus(ec, "sending command to", connection->host),
+                                 isStaleConnectionError(ec));
+                return;
+            }
+            _flushMultiplexed(connection);
+        });
+        _readMultiplexed(connection);
+    }
+
+    void NetworkInterfaceASIO::_readMultiplexed(const MultiplexedConnectionPtr& connection) {
+        if (connection->reading || connection->outstanding.empty()) {
+            return;
+        }
+        connection->reading = true;
+        asio::async_read(connection->socket,
+                         asio::buffer(connection->responseHeader.view().view2ptr(), kHeaderSize),
+                         [this, connection](std::error_code ec, size_t) {
+            if (connection->failed) {
+                return;
+            }
+            if (ec) {
+                _failMultiplexed(connection,
+                                 networkErrorStatus(ec,
+                                                    "receiving reply header from",
+                                                    connection->host),
+                                 isStaleConnectionError(ec));
+                return;
+            }
+            Status status = validateReplyLength(
+                    connection->responseHeader.constView().getMessageLength(),
+                    connection->host);
+            if (!status.isOK()) {
+                _failMultiplexed(connection, status, false);
+                return;
+            }
+            _readMultiplexedBody(connection);
+        });
+    }
+
+    void NetworkInterfaceASIO::_readMultiplexedBody(const MultiplexedConnectionPtr& connection) {
+        const int msgSize = connection->responseHeader.constView().getMessageLength();
+        char* buf = static_cast<char*>(mongoMalloc(msgSize));
+        memcpy(buf, connection->responseHeader.view().view2ptr(), kHeaderSize);
+        connection->toRecv.reset();
+        connection->toRecv.setData(buf, true);
+
+        asio::async_read(connection->socket,
+                         asio::buffer(buf + kHeaderSize, msgSize - kHeaderSize),
+                         [this, connection](std::error_code ec, size_t) {
+            if (connection->failed) {
+                return;
+            }
+            if (ec) {
+                _failMultiplexed(connection,
+                                 networkErrorStatus(ec, "receiving reply from", connection->host),
+                                 isStaleConnectionError(ec));
+                return;
+            }
+            connection->reading = false;
+
+            const MSGID responseTo = connection->toRecv.header().getResponseTo();
+            auto it = connection->outstanding.find(responseTo);
+            if (it == connection->outstanding.end()) {
+                _failMultiplexed(connection,
+                                 Status(ErrorCodes::ProtocolError,
+                                        str::stream() << "reply from "
+                                                      << connection->host.toString()
+                                                      << " is for unknown request "
+                                                      << responseTo),
+                                 false);
+                return;
+            }
+            AsyncOpPtr op = std::move(it->second);
+            connection->outstanding.erase(it);
+
+            // A timed out or canceled op still gets its reply read, to keep the stream in step
+            if (!op->finished) {
+                repl::ResponseStatus result = parseCommandReply(connection->toRecv,
+                                                                connection->host,
+                                                                Milliseconds(now() - op->start));
+                if (result.isOK()) {
+                    _trackCursor(connection, op, result.getValue().data);
+                }
+                _completeOp(op, result);
+            }
+            connection->toRecv.reset();
+            _readMultiplexed(connection);
+        });
+    }
+
+    void NetworkInterfaceASIO::_trackCursor(const MultiplexedConnectionPtr& connection,
+                                            const AsyncOpPtr& op,
+                                            const BSONObj& reply) {
+        HostConnections& host = _multiplexed[connection->host];
+        const BSONElement cursor = reply["cursor"];
+        const long long cursorId = cursor.isABSONObj() ? cursor.Obj()["id"].numberLong() : 0;
+
+        const long long continued = cursorIdForCommand(op->request.cmdObj);
+        if (continued && continued != cursorId) {
+            auto it = host.cursors.find(continued);
+            if (it != host.cursors.end()) {
+                host.forgetCursor(it);
+            }
+        }
+        if (!cursorId) {
+            return;
+        }
+
+        auto it = host.cursors.find(cursorId);
+        if (it != host.cursors.end()) {
+            it->second.connection = connection;
+            host.cursorsByAge.splice(host.cursorsByAge.end(), host.cursorsByAge, it->second.age);
+            return;
+        }
+        if (host.cursors.size() >= kMaxTrackedCursorsPerHost) {
+            host.forgetCursor(host.cursors.find(host.cursorsByAge.front()));
+        }
+        TrackedCursor& tracked = host.cursors[cursorId];
+        tracked.connection = connection;
+        tracked.age = host.cursorsByAge.insert(host.cursorsByAge.end(), cursorId);
+    }
+
+    void NetworkInterfaceASIO::_failMultiplexed(const MultiplexedConnectionPtr& connection,
+                                                const Status& status,
+                                                bool staleConnection) {
+        if (connection->failed) {
+            return;
+        }
+        connection->failed = true;
+        std::error_code ignored;
+        connection->socket.close(ignored);
+
+        auto& connections = _multiplexed[connection->host].connections;
+        connections.erase(std::remove(connections.begin(), connections.end(), connection),
+                          connections.end());
+        _numMultiplexedConnections.subtractAndFetch(1);
+
+        std::vector<AsyncOpPtr> ops;
+        for (auto& outstanding : connection->outstanding) {
+            ops.push_back(std::move(outstanding.second));
+        }
+        connection->outstanding.clear();
+        ops.insert(ops.end(), connection->toSend.begin(), connection->toSend.end());
+        connection->toSend.clear();
+
+        // Commands which were never written can't have run, if the remote end dropped the
+        // connection they get one more try on another one.  Anything written may have run and
+        // fails, it need not be idempotent.
+        LOG(2) << "Multiplexed connection to " << connection->host << " failed with "
+               << ops.size() << " commands outstanding: " << status;
+        for (const AsyncOpPtr& op : ops) {
+            if (op->finished) {
+                continue;
+            }
+            if (staleConnection && !op->written && !op->retried) {
+                op->retried = true;
+                _numRetries.fetchAndAdd(1);
+                _startMultiplexedOp(op);
+                continue;
+            }
+            _completeOp(op, status);
+        }
+    }
+
+} // namespace executor
+} // namespace mongo
@@ -0,0 +1,256 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <asio/include/asio.hpp>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "mongo/executor/network_interface.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/list.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/stdx/thread.h"
+#include "mongo/util/net/hostandport.h"
+#include "mongo/util/net/message.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+namespace executor {
+
+    /**
+     * Implementation of the network interface which runs every command as a chain of asio
+     * completion handlers on a single network thread, rather than blocking a worker thread per
+     * request as NetworkInterfaceImpl does.  Any number of commands may be in flight at once; the
+     * cost of an outstanding command is its buffers and a socket.
+     *
+     * Commands are sent as OP_QUERY on <dbname>.$cmd.  Sockets are kept in a per host pool of
+     * idle connections once a reply has been read.  A command which finds that a pooled
+     * connection was closed by the remote end before its request was written is retried once on
+     * a fresh connection; once the request is written it may have run, so it is never resent.
+     *
+     * With a connectionsPerHost limit the interface instead multiplexes commands: every command
+     * to a host goes over one of at most that many connections, each with any number of requests
+     * outstanding, and a reply is matched to its request by responseTo.  A getMore is sent on the
+     * connection that returned its cursor.  This bounds the number of sockets each remote host
+     * sees no matter how many commands are in flight, at the cost of the remote host running
+     * the commands on a connection one after the other: a slow command delays everything queued
+     * behind it.  As without multiplexing, only commands not yet written are retried when a
+     * connection fails.
+     *
+     * The network thread never blocks, so authentication and SSL are not supported.  Callers must
+     * check isUsable() and fall back to a blocking client when it returns false.
+     */
+    class NetworkInterfaceASIO final : public NetworkInterface {
+    public:
+        /**
+         * A connectionsPerHost of 0 gives each in-flight command a connection of its own.
+         */
+        explicit NetworkInterfaceASIO(size_t connectionsPerHost = 0);
+        virtual ~NetworkInterfaceASIO();
+        virtual std::string getDiagnosticString();
+        virtual void startup();
+        virtual void shutdown();
+        virtual void waitForWork();
+        virtual void waitForWorkUntil(Date_t when);
+        virtual void signalWorkAvailable();
+        virtual Date_t now();
+        virtual void startCommand(
+                const repl::ReplicationExecutor::CallbackHandle& cbHandle,
+                const RemoteCommandRequest& request,
+                const RemoteCommandCompletionFn& onFinish);
+        virtual void cancelCommand(const repl::ReplicationExecutor::CallbackHandle& cbHandle);
+
+        /**
+         * Returns false if this process is configured in a way which requires connections to do
+         * more than plain TCP, currently internal authentication or SSL.
+         */
+        static bool isUsable();
+
+        /**
+         * Appends counters for serverStatus.
+         */
+        void appendStats(BSONObjBuilder* builder);
+
+    private:
+
+        /**
+         * A connected socket to a remote host, owned either by an operation or by the idle pool.
+         */
+        struct AsyncConnection {
+            AsyncConnection(asio::io_service& service, const HostAndPort& host);
+
+            asio::ip::tcp::socket socket;
+            const HostAndPort host;
+            Date_t lastUsed;
+        };
+
+        /**
+         * All state of one command, from resolving the target until the completion function runs.
+         */
+        struct AsyncOp {
+            AsyncOp(asio::io_service& service,
+                    const repl::ReplicationExecutor::CallbackHandle& cbHandle,
+                    const RemoteCommandRequest& request,
+                    const RemoteCommandCompletionFn& onFinish,
+                    Date_t start);
+
+            const repl::ReplicationExecutor::CallbackHandle cbHandle;
+            const RemoteCommandRequest request;
+            const RemoteCommandCompletionFn onFinish;
+            const Date_t start;
+
+            std::unique_ptr<AsyncConnection> connection;
+            // True if the connection came from the idle pool, so a failure may be a stale socket
+            bool reusedConnection;
+            bool retried;
+            // Set once the request has been written, after which it is never sent again
+            bool written;
+            // Set once onFinish has been scheduled, all later handlers for this op are no-ops
+            bool finished;
+            asio::steady_timer timeout;
+
+            Message toSend;
+            MSGID requestId;
+            MSGHEADER::Value responseHeader;
+            Message toRecv;
+        };
+        typedef std::shared_ptr<AsyncOp> AsyncOpPtr;
+
+        /**
+         * A connection shared by every command sent over it in multiplexed mode.  Commands queue
+         * in toSend until the connection is up and the previous write is done, then wait in
+         * outstanding for their reply.  One read is always pending while anything is outstanding.
+         */
+        struct MultiplexedConnection {
+            MultiplexedConnection(asio::io_service& service, const HostAndPort& host);
+
+            asio::ip::tcp::socket socket;
+            const HostAndPort host;
+            bool connected;
+            bool failed;
+            bool writing;
+            bool reading;
+
+            std::deque<AsyncOpPtr> toSend;
+            // The ops in the current write, kept alive until it completes since it uses their
+            // buffers
+            std::vector<AsyncOpPtr> sending;
+            std::vector<asio::const_buffer> sendBuffers;
+            std::unordered_map<MSGID, AsyncOpPtr> outstanding;
+
+            MSGHEADER::Value responseHeader;
+            Message toRecv;
+        };
+        typedef std::shared_ptr<MultiplexedConnection> MultiplexedConnectionPtr;
+
+        struct TrackedCursor {
+            std::weak_ptr<MultiplexedConnection> connection;
+            // This cursor's entry in HostConnections::cursorsByAge
+            std::list<long long>::iterator age;
+        };
+
+        struct HostConnections {
+            void forgetCursor(std::map<long long, TrackedCursor>::iterator it);
+
+            std::vector<MultiplexedConnectionPtr> connections;
+            // getMore is sent on the connection which returned the cursor
+            std::map<long long, TrackedCursor> cursors;
+            // The ids in cursors, least recently used first
+            std::list<long long> cursorsByAge;
+        };
+
+        // All of these run on the network thread
+        void _startOp(const AsyncOpPtr& op);
+        void _connect(const AsyncOpPtr& op);
+        void _send(const AsyncOpPtr& op);
+        void _recvHeader(const AsyncOpPtr& op);
+        void _recvBody(const AsyncOpPtr& op);
+        void _completeOp(const AsyncOpPtr& op, const repl::ResponseStatus& status);
+        void _networkError(const AsyncOpPtr& op, const std::error_code& ec, const char* context);
+        std::unique_ptr<AsyncConnection> _getIdleConnection(const HostAndPort& host);
+        void _returnConnection(std::unique_ptr<AsyncConnection> connection);
+
+        // Multiplexed mode, also on the network thread
+        void _startMultiplexedOp(const AsyncOpPtr& op);
+        void _connectMultiplexed(const MultiplexedConnectionPtr& connection);
+        void _flushMultiplexed(const MultiplexedConnectionPtr& connection);
+        void _readMultiplexed(const MultiplexedConnectionPtr& connection);
+        void _readMultiplexedBody(const MultiplexedConnectionPtr& connection);
+        void _failMultiplexed(const MultiplexedConnectionPtr& connection,
+                              const Status& status,
+                              bool staleConnection);
+        void _trackCursor(const MultiplexedConnectionPtr& connection,
+                          const AsyncOpPtr& op,
+                          const BSONObj& reply);
+        void _closeAllConnections();
+
+        void _signalWorkAvailable_inlock();
+
+        const size_t _connectionsPerHost;
+
+        asio::io_service _io_service;
+        std::unique_ptr<asio::io_service::work> _work;
+        stdx::thread _serviceRunner;
+        asio::ip::tcp::resolver _resolver;
+
+        // Idle connections by host, only touched on the network thread
+        std::map<HostAndPort, std::vector<std::unique_ptr<AsyncConnection>>> _idleConnections;
+
+        // Multiplexed connections by host, only touched on the network thread
+        std::map<HostAndPort, HostConnections> _multiplexed;
+
+        // Guards everything below
+        stdx::mutex _mutex;
+
+        // Operations which have been started and not completed, searched by cancelCommand()
+        stdx::list<AsyncOpPtr> _inProgress;
+
+        stdx::condition_variable _isExecutorRunnableCondition;
+        bool _isExecutorRunnable;
+        bool _inShutdown;
+        bool _started;
+
+        AtomicUInt64 _numCommands;
+        AtomicUInt64 _numConnects;
+        AtomicUInt64 _numReusedConnections;
+        AtomicUInt64 _numRetries;
+        AtomicUInt64 _numFailures;
+        AtomicInt64 _numMultiplexedConnections;
+    };
+
+} // namespace executor
+} // namespace mongo
@@ -33,6 +33,7 @@
 #include "mongo/s/chunk_manager.h"
 
 #include <boost/next_prior.hpp>
+#include <cstring>
 #include <map>
 #include <set>
 
@@ -40,6 +41,7 @@
 #include "mongo/db/query/index_bounds_builder.h"
 #include "mongo/db/query/query_planner.h"
 #include "mongo/db/query/query_planner_common.h"
+#include "mongo/db/storage/key_string.h"
 #include "mongo/s/catalog/catalog_cache.h"
 #include "mongo/s/catalog/catalog_manager.h"
 #include "mongo/s/catalog/type_chunk.h"
@@ -139,6 +141,34 @@ namespace {
 #undef ENSURE
     }
 
+    // Chunk bounds compare with BSONObjCmp, which is ascending on every field
+    const Ordering kRoutingOrdering = Ordering::make(BSONObj());
+
+    /**
+     * The first 8 bytes of a key, big endian and zero padded, so comparing prefixes as integers
+     * agrees with memcmp on the keys.
+     */
+    uint64_t keyPrefix(const char* data, size_t size) {
+        uint64_t prefix = 0;
+        const size_t prefixSize = std::min(size, sizeof(prefix));
+        for (size_t i = 0; i < prefixSize; ++i) {
+            prefix |= uint64_t(static_cast<unsigned char>(data[i])) << (56 - 8 * i);
+        }
+        return prefix;
+    }
+
+    /**
+     * Assigns each sorted position its Eytzinger slot by an in order walk of the implicit tree.
+     */
+    void assignSlots(size_t slot, size_t numSlots, size_t* next, std::vector<size_t>* slotOf) {
+        if (slot > numSlots) {
+            return;
+        }
+        assignSlots(2 * slot, numSlots, next, slotOf);
+        (*slotOf)[(*next)++] = slot;
+        assignSlots(2 * slot + 1, numSlots, next, slotOf);
+    }
+
 } // namespace
 
     AtomicUInt32 ChunkManager::NextSequenceNumber(1U);
@@ -187,6 +217,7 @@ namespace {
                     _shards.swap(shards);
                     _shardVersions.swap(shardVersions);
                     _chunkRanges.reloadAll(_chunkMap);
+                    _routingIndex.build(_chunkMap);
 
                     return;
                 }
@@ -429,22 +460,14 @@ namespace {
 
     ChunkPtr ChunkManager::findIntersectingChunk( const BSONObj& shardKey ) const {
         {
-            BSONObj chunkMin;
-            ChunkPtr chunk;
-            {
-                ChunkMap::const_iterator it = _chunkMap.upper_bound( shardKey );
-                if (it != _chunkMap.end()) {
-                    chunkMin = it->first;
-                    chunk = it->second;
-                }
-            }
+            ChunkPtr chunk = _routingIndex.upperBound( shardKey );
 
             if ( chunk ) {
                 if ( chunk->containsKey( shardKey ) ){
                     return chunk;
                 }
 
-                log() << chunkMin;
+                log() << chunk->getMax();
                 log() << *chunk;
                 log() << shardKey;
 
@@ -773,6 +796,75 @@ namespace {
         }
     }
 
+    void ChunkRoutingIndex::clear() {
+        _slots.clear();
+        _chunks.clear();
+        _keyData.clear();
+    }
+
+    void ChunkRoutingIndex::build(const ChunkMap& chunks) {
+        clear();
+        const size_t numChunks = chunks.size();
+        if (!numChunks) {
+            return;
+        }
+
+        std::vector<size_t> slotOf(numChunks);
+        size_t next = 0;
+        assignSlots(1, numChunks, &next, &slotOf);
+
+        std::vector<ChunkMap::const_iterator> bySlot(numChunks + 1);
+        size_t position = 0;
+        for (ChunkMap::const_iterator it = chunks.begin(); it != chunks.end(); ++it) {
+            bySlot[slotOf[position++]] = it;
+        }
+
+        // Key data is appended in slot order too, so the levels near the root are contiguous
+        _slots.resize(numChunks + 1);
+        _chunks.resize(numChunks + 1);
+        for (size_t slot = 1; slot <= numChunks; ++slot) {
+            const KeyString key(bySlot[slot]->first, kRoutingOrdering);
+            Slot& entry = _slots[slot];
+            entry.prefix = keyPrefix(key.getBuffer(), key.getSize());
+            entry.offset = _keyData.size();
+            entry.size = key.getSize();
+            _keyData.insert(_keyData.end(), key.getBuffer(), key.getBuffer() + key.getSize());
+            _chunks[slot] = bySlot[slot]->second;
+        }
+    }
+
+    ChunkPtr ChunkRoutingIndex::upperBound(const BSONObj& shardKey) const {
+        const size_t numSlots = size();
+        const KeyString key(shardKey, kRoutingOrdering);
+        const char* keyData = key.getBuffer();
+        const size_t keySize = key.getSize();
+        const uint64_t prefix = keyPrefix(keyData, keySize);
+
+        // Descend right past every slot <= shardKey, left at every slot > shardKey
+        size_t slot = 1;
+        while (slot <= numSlots) {
+            const Slot& entry = _slots[slot];
+            bool lessOrEqual;
+            if (entry.prefix != prefix) {
+                lessOrEqual = entry.prefix < prefix;
+            }
+            else {
+                const int cmp = memcmp(&_keyData[entry.offset], keyData,
+                                       std::min<size_t>(entry.size, keySize));
+                lessOrEqual = cmp < 0 || (cmp == 0 && entry.size <= keySize);
+            }
+            slot = 2 * slot + (lessOrEqual ? 1 : 0);
+        }
+
+        // The answer is where the walk last went left, drop the right turns after it and that
+        // left turn itself.  Nothing left means every max is <= shardKey.
+        while (slot & 1) {
+            slot >>= 1;
+        }
+        slot >>= 1;
+        return slot ? _chunks[slot] : ChunkPtr();
+    }
+
     int ChunkManager::getCurrentDesiredChunkSize() const {
         // split faster in early chunks helps spread out an initial load better
         const int minChunkSize = 1 << 20;  // 1 MBytes
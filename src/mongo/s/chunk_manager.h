@@ -103,6 +103,44 @@ namespace mongo {
     };
 
 
+    /**
+     * Immutable lookup table from a shard key to the chunk which contains it, built from the
+     * ChunkMap when it is loaded.  Routing a write would otherwise walk the map's tree comparing
+     * whole BSON keys at every node.
+     *
+     * Each chunk's max is encoded as a KeyString, which orders keys of one shard key pattern the
+     * same way BSONObjCmp does, so comparisons are memcmp.  The keys are laid out in Eytzinger
+     * (breadth first) order, so the top levels of every search share a few cache lines, and each
+     * slot carries the first 8 bytes of its key so most comparisons never touch the key data.
+     */
+    class ChunkRoutingIndex {
+    public:
+        void build(const ChunkMap& chunks);
+
+        void clear();
+
+        /**
+         * Returns the first chunk whose max is greater than shardKey, the same chunk as
+         * ChunkMap::upper_bound(), or NULL if there is none.
+         */
+        ChunkPtr upperBound(const BSONObj& shardKey) const;
+
+        size_t size() const { return _chunks.empty() ? 0 : _chunks.size() - 1; }
+
+    private:
+        struct Slot {
+            uint64_t prefix;
+            uint32_t offset;
+            uint32_t size;
+        };
+
+        // Slots and chunks are indexed 1..n, the children of slot k are 2k and 2k + 1
+        std::vector<Slot> _slots;
+        std::vector<ChunkPtr> _chunks;
+        std::vector<char> _keyData;
+    };
+
+
     /* config.sharding
          { ns: 'alleyinsider.fs.chunks' ,
            key: { ts : 1 } ,
@@ -226,6 +264,7 @@ namespace mongo {
 
         ChunkMap _chunkMap;
         ChunkRangeManager _chunkRanges;
+        ChunkRoutingIndex _routingIndex;
 
         std::set<Shard> _shards;
 
@@ -0,0 +1,224 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/s/client/async_multi_command.h"
+
+#include <algorithm>
+#include <deque>
+
+#include "mongo/client/remote_command_runner.h"
+#include "mongo/client/replica_set_monitor.h"
+#include "mongo/db/audit.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/executor/network_interface_asio.h"
+#include "mongo/stdx/condition_variable.h"
+#include "mongo/stdx/mutex.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    // Scatter commands which don't need the shard version through NetworkInterfaceASIO rather than
+    // a blocking connection per shard.
+    MONGO_EXPORT_SERVER_PARAMETER(asyncShardDispatch, bool, false);
+
+    // If set, asynchronous commands from every client share at most this many connections to each
+    // shard host, with requests multiplexed over them.
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(asyncShardConnectionsPerHost, int, 0);
+
+namespace {
+
+    stdx::mutex shardNetworkInterfaceMutex;
+    executor::NetworkInterfaceASIO* shardNetworkInterface = NULL;
+
+    /**
+     * Picks the host to send to, the primary for a replica set shard.
+     */
+    StatusWith<HostAndPort> targetHost(const ConnectionString& endpoint) {
+        if (endpoint.type() != ConnectionString::SET) {
+            return endpoint.getServers().front();
+        }
+        try {
+            boost::shared_ptr<ReplicaSetMonitor> monitor =
+                ReplicaSetMonitor::get(endpoint.getSetName());
+            if (!monitor) {
+                return Status(ErrorCodes::ReplicaSetNotFound,
+                              str::stream() << "unknown replica set " << endpoint.getSetName());
+            }
+            return monitor->getMasterOrUassert();
+        }
+        catch (const DBException& ex) {
+            return ex.toStatus();
+        }
+    }
+
+}  // namespace
+
+    executor::NetworkInterfaceASIO* getShardNetworkInterface() {
+        stdx::lock_guard<stdx::mutex> lk(shardNetworkInterfaceMutex);
+        if (!shardNetworkInterface) {
+            // Lives for the rest of the process, like the shard connection pool
+            shardNetworkInterface = new executor::NetworkInterfaceASIO(
+                    std::max(0, asyncShardConnectionsPerHost));
+            shardNetworkInterface->startup();
+        }
+        return shardNetworkInterface;
+    }
+
+    class AsyncShardDispatchStatus : public ServerStatusSection {
+    public:
+        AsyncShardDispatchStatus() : ServerStatusSection("asyncShardDispatch") {}
+
+        // Only once something has used it, this is linked into mongod too
+        virtual bool includeByDefault() const {
+            stdx::lock_guard<stdx::mutex> lk(shardNetworkInterfaceMutex);
+            return shardNetworkInterface != NULL;
+        }
+
+        virtual BSONObj generateSection(OperationContext* txn,
+                                        const BSONElement& configElement) const {
+            BSONObjBuilder builder;
+            builder.appendBool("enabled", AsyncMultiCommand::isEnabled());
+            executor::NetworkInterfaceASIO* net = NULL;
+            {
+                stdx::lock_guard<stdx::mutex> lk(shardNetworkInterfaceMutex);
+                net = shardNetworkInterface;
+            }
+            if (net) {
+                net->appendStats(&builder);
+            }
+            return builder.obj();
+        }
+    } asyncShardDispatchStatus;
+
+    struct AsyncMultiCommand::Responses {
+        struct Response {
+            ConnectionString endpoint;
+            repl::ResponseStatus result;
+        };
+
+        void add(const ConnectionString& endpoint, const repl::ResponseStatus& result) {
+            stdx::lock_guard<stdx::mutex> lk(mutex);
+            responses.push_back(Response{endpoint, result});
+            available.notify_one();
+        }
+
+        stdx::mutex mutex;
+        stdx::condition_variable available;
+        std::deque<Response> responses;
+    };
+
+    AsyncMultiCommand::AsyncMultiCommand() :
+        _responses(std::make_shared<Responses>()),
+        _numPending(0),
+        _timeoutMillis(0) {
+
+    }
+
+    AsyncMultiCommand::~AsyncMultiCommand() {
+        // Anything still in flight completes into _responses, which the callbacks keep alive.
+    }
+
+    bool AsyncMultiCommand::isEnabled() {
+        return asyncShardDispatch && executor::NetworkInterfaceASIO::isUsable();
+    }
+
+    void AsyncMultiCommand::setTimeoutMillis(int milliSecs) {
+        _timeoutMillis = milliSecs;
+    }
+
+    void AsyncMultiCommand::addCommand(const ConnectionString& endpoint,
+                                       StringData dbName,
+                                       const BSONSerializable& request) {
+        BSONObjBuilder cmdBuilder;
+        cmdBuilder.appendElements(request.toBSON());
+        audit::appendImpersonatedUsers(&cmdBuilder);
+        _toSend.push_back(PendingCommand{endpoint, dbName.toString(), cmdBuilder.obj()});
+    }
+
+    void AsyncMultiCommand::sendAll() {
+        executor::NetworkInterfaceASIO* net = getShardNetworkInterface();
+        const Milliseconds timeout = _timeoutMillis > 0 ? Milliseconds(_timeoutMillis) :
+                                                          RemoteCommandRequest::kNoTimeout;
+
+        for (const PendingCommand& command : _toSend) {
+            ++_numPending;
+
+            StatusWith<HostAndPort> target = targetHost(command.endpoint);
+            if (!target.isOK()) {
+                _responses->add(command.endpoint, target.getStatus());
+                continue;
+            }
+
+            std::shared_ptr<Responses> responses = _responses;
+            const ConnectionString endpoint = command.endpoint;
+            net->startCommand(repl::ReplicationExecutor::CallbackHandle(),
+                              RemoteCommandRequest(target.getValue(),
+                                                   command.dbName,
+                                                   command.cmdObj,
+                                                   timeout),
+                              [responses, endpoint](const repl::ResponseStatus& result) {
+                responses->add(endpoint, result);
+            });
+        }
+        _toSend.clear();
+    }
+
+    int AsyncMultiCommand::numPending() const {
+        return _numPending + static_cast<int>(_toSend.size());
+    }
+
+    Status AsyncMultiCommand::recvAny(ConnectionString* endpoint, BSONSerializable* response) {
+        invariant(_numPending > 0);
+
+        stdx::unique_lock<stdx::mutex> lk(_responses->mutex);
+        while (_responses->responses.empty()) {
+            _responses->available.wait(lk);
+        }
+        Responses::Response next = std::move(_responses->responses.front());
+        _responses->responses.pop_front();
+        lk.unlock();
+        --_numPending;
+
+        *endpoint = next.endpoint;
+        if (!next.result.isOK()) {
+            return next.result.getStatus();
+        }
+
+        std::string errMsg;
+        if (!response->parseBSON(next.result.getValue().data, &errMsg) ||
+                !response->isValid(&errMsg)) {
+            return Status(ErrorCodes::FailedToParse, errMsg);
+        }
+        return Status::OK();
+    }
+
+}  // namespace mongo
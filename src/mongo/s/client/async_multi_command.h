@@ -0,0 +1,107 @@
+/**
+ *    Copyright (C) 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/client/connection_string.h"
+#include "mongo/s/client/multi_command_dispatch.h"
+
+namespace mongo {
+
+namespace executor {
+    class NetworkInterfaceASIO;
+}  // namespace executor
+
+    /**
+     * An AsyncMultiCommand sends commands to different hosts through the process-wide
+     * NetworkInterfaceASIO, so every command is in flight at once without a connection or a
+     * thread being held per host, and the caller only blocks in recvAny().  Responses are returned
+     * in the order they arrive.
+     *
+     * With the asyncShardConnectionsPerHost server parameter set, the commands of all clients
+     * share a bounded number of connections to each shard host, see NetworkInterfaceASIO.
+     *
+     * Connections are not versioned, so this is only for commands which do not depend on the
+     * shard version, and which do not need to run on the client's ShardConnection.
+     *
+     * See MultiCommandDispatch for more details.
+     */
+    class AsyncMultiCommand : public MultiCommandDispatch {
+    public:
+
+        AsyncMultiCommand();
+
+        ~AsyncMultiCommand();
+
+        /**
+         * Returns true if the asyncShardDispatch server parameter is on and the network interface
+         * can talk to the cluster, callers use DBClientMultiCommand or Future otherwise.
+         */
+        static bool isEnabled();
+
+        void addCommand(const ConnectionString& endpoint,
+                        StringData dbName,
+                        const BSONSerializable& request) override;
+
+        void sendAll() override;
+
+        int numPending() const override;
+
+        Status recvAny(ConnectionString* endpoint, BSONSerializable* response) override;
+
+        void setTimeoutMillis(int milliSecs);
+
+    private:
+
+        struct PendingCommand {
+            ConnectionString endpoint;
+            std::string dbName;
+            BSONObj cmdObj;
+        };
+
+        // Completed commands, shared with the completion callbacks which run on the network
+        // thread and may outlive this dispatcher.
+        struct Responses;
+
+        std::vector<PendingCommand> _toSend;
+        std::shared_ptr<Responses> _responses;
+        int _numPending;
+        int _timeoutMillis;
+    };
+
+    /**
+     * Returns the network interface used for asynchronous shard dispatch, starting it on first use.
+     */
+    executor::NetworkInterfaceASIO* getShardNetworkInterface();
+
+}  // namespace mongo
@@ -33,12 +33,17 @@
 #include "mongo/s/commands/run_on_all_shards_cmd.h"
 
 #include <list>
+#include <map>
 #include <set>
+#include <string>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 
 #include "mongo/db/jsobj.h"
 #include "mongo/client/parallel.h"
+#include "mongo/s/bson_serializable.h"
+#include "mongo/s/client/async_multi_command.h"
 #include "mongo/s/client/shard.h"
 #include "mongo/s/client/shard_registry.h"
 #include "mongo/s/grid.h"
@@ -46,6 +51,83 @@
 
 namespace mongo {
 
+namespace {
+
+    struct ShardResponse {
+        std::string server;
+        bool ok;
+        BSONObj result;
+    };
+
+    /**
+     * Runs the command on each shard with a Future, which holds a connection per shard until it
+     * is joined.  Responses are in shard order.
+     */
+    std::vector<ShardResponse> runWithFutures(const std::string& dbName,
+                                              const BSONObj& cmdObj,
+                                              const std::set<Shard>& shards,
+                                              bool useShardConn) {
+        // TODO: Future is deprecated, replace with commandOp()
+        std::list< boost::shared_ptr<Future::CommandResult> > futures;
+        for (std::set<Shard>::const_iterator i=shards.begin(), end=shards.end() ; i != end ; i++) {
+            futures.push_back( Future::spawnCommand( i->getConnString().toString(),
+                                                     dbName,
+                                                     cmdObj,
+                                                     0,
+                                                     NULL,
+                                                     useShardConn ));
+        }
+
+        std::vector<ShardResponse> responses;
+        for (const auto& res : futures) {
+            const bool ok = res->join();
+            responses.push_back(ShardResponse{res->getServer(), ok, res->result()});
+        }
+        return responses;
+    }
+
+    /**
+     * Sends the command to every shard at once through AsyncMultiCommand, the client thread only
+     * waits for the slowest shard.  Responses are in shard order.
+     */
+    std::vector<ShardResponse> runAsync(const std::string& dbName,
+                                        const BSONObj& cmdObj,
+                                        const std::set<Shard>& shards) {
+        AsyncMultiCommand dispatcher;
+        for (const Shard& shard : shards) {
+            dispatcher.addCommand(shard.getConnString(), dbName, RawBSONSerializable(cmdObj));
+        }
+        dispatcher.sendAll();
+
+        std::map<std::string, ShardResponse> byServer;
+        while (dispatcher.numPending() > 0) {
+            ConnectionString endpoint;
+            RawBSONSerializable response;
+            Status status = dispatcher.recvAny(&endpoint, &response);
+
+            ShardResponse& shardResponse = byServer[endpoint.toString()];
+            shardResponse.server = endpoint.toString();
+            if (status.isOK()) {
+                shardResponse.result = response.toBSON();
+                shardResponse.ok = shardResponse.result["ok"].trueValue();
+            }
+            else {
+                BSONObjBuilder errorBuilder;
+                Command::appendCommandStatus(errorBuilder, status);
+                shardResponse.result = errorBuilder.obj();
+                shardResponse.ok = false;
+            }
+        }
+
+        std::vector<ShardResponse> responses;
+        for (const Shard& shard : shards) {
+            responses.push_back(byServer[shard.getConnString().toString()]);
+        }
+        return responses;
+    }
+
+}  // namespace
+
     RunOnAllShardsCommand::RunOnAllShardsCommand(const char* name,
                                                  const char* oldName,
                                                  bool useShardConn)
@@ -88,15 +170,12 @@ namespace mongo {
         std::set<Shard> shards;
         getShards(dbName, cmdObj, shards);
 
-        // TODO: Future is deprecated, replace with commandOp()
-        std::list< boost::shared_ptr<Future::CommandResult> > futures;
-        for (std::set<Shard>::const_iterator i=shards.begin(), end=shards.end() ; i != end ; i++) {
-            futures.push_back( Future::spawnCommand( i->getConnString().toString(),
-                                                     dbName,
-                                                     cmdObj,
-                                                     0,
-                                                     NULL,
-                                                     _useShardConn ));
+        std::vector<ShardResponse> responses;
+        if (!_useShardConn && AsyncMultiCommand::isEnabled()) {
+            responses = runAsync(dbName, cmdObj, shards);
+        }
+        else {
+            responses = runWithFutures(dbName, cmdObj, shards, _useShardConn);
         }
 
         std::vector<ShardAndReply> results;
@@ -104,46 +183,46 @@ namespace mongo {
         BSONObjBuilder errors;
         int commonErrCode = -1;
 
-        std::list< boost::shared_ptr<Future::CommandResult> >::iterator futuresit;
+        std::vector<ShardResponse>::const_iterator responsesit;
         std::set<Shard>::const_iterator shardsit;
-        // We iterate over the set of shards and their corresponding futures in parallel.
+        // We iterate over the set of shards and their corresponding responses in parallel.
         // TODO: replace with zip iterator if we ever decide to use one from Boost or elsewhere
-        for (futuresit = futures.begin(), shardsit = shards.cbegin();
-              futuresit != futures.end() && shardsit != shards.end();
-              ++futuresit, ++shardsit ) {
+        for (responsesit = responses.begin(), shardsit = shards.cbegin();
+              responsesit != responses.end() && shardsit != shards.end();
+              ++responsesit, ++shardsit ) {
 
-            boost::shared_ptr<Future::CommandResult> res = *futuresit;
+            const std::string& server = responsesit->server;
 
-            if ( res->join() ) {
+            if ( responsesit->ok ) {
                 // success :)
-                BSONObj result = res->result();
+                BSONObj result = responsesit->result;
                 results.emplace_back( shardsit->getName(), result );
-                subobj.append( res->getServer(), result );
+                subobj.append( server, result );
                 continue;
             }
 
-            BSONObj result = res->result();
+            BSONObj result = responsesit->result;
 
             if ( result["errmsg"].type() ||
                  result["code"].numberInt() != 0 ) {
-                result = specialErrorHandler( res->getServer(), dbName, cmdObj, result );
+                result = specialErrorHandler( server, dbName, cmdObj, result );
 
                 BSONElement errmsg = result["errmsg"];
                 if ( errmsg.eoo() || errmsg.String().empty() ) {
                     // it was fixed!
                     results.emplace_back( shardsit->getName(), result );
-                    subobj.append( res->getServer(), result );
+                    subobj.append( server, result );
                     continue;
                 }
             }
 
             // Handle "errmsg".
             if( ! result["errmsg"].eoo() ){
-                errors.appendAs(result["errmsg"], res->getServer());
+                errors.appendAs(result["errmsg"], server);
             }
             else {
                 // Can happen if message is empty, for some reason
-                errors.append( res->getServer(), str::stream() <<
+                errors.append( server, str::stream() <<
                                "result without error message returned : " << result );
             }
 
@@ -156,7 +235,7 @@ namespace mongo {
                 commonErrCode = 0;
             }
             results.emplace_back( shardsit->getName(), result );
-            subobj.append( res->getServer(), result );
+            subobj.append( server, result );
         }
 
         subobj.done();
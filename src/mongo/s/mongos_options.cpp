@@ -109,6 +109,48 @@ namespace mongo {
                 "disable scripting engine")
                                          .setSources(moe::SourceAllLegacy);
 
+        moe::OptionSection async_network_options("Async network options");
+
+        async_network_options.addOptionChaining("net.async.enabled", "asyncNetwork", moe::Switch,
+                "serve clients from a fixed pool of asio threads instead of a thread per "
+                "connection (experimental, no SSL or unix domain sockets)");
+
+        async_network_options.addOptionChaining("net.async.threads", "asyncNetworkThreads",
+                moe::Int, "number of asio network threads (default 2 per core, minimum 4)");
+
+        async_network_options.addOptionChaining("net.async.workerThreads",
+                "asyncNetworkWorkerThreads", moe::Int,
+                "number of threads running requests for asio connections, off the network "
+                "threads, split over the reactors (default 8 per core, minimum 32)");
+
+        async_network_options.addOptionChaining("net.async.idleTimeoutSecs",
+                "asyncNetworkIdleTimeoutSecs", moe::Int,
+                "close asio connections idle for this many seconds (default 0, disabled)");
+
+        async_network_options.addOptionChaining("net.async.reactors", "asyncNetworkReactors",
+                moe::Int, "number of io_services asio connections are spread over, each with "
+                "its own threads (default 1, 0 is one per core)");
+
+        async_network_options.addOptionChaining("net.async.pinReactors",
+                "asyncNetworkPinReactors", moe::Switch, "pin each reactor's threads to a cpu");
+
+        async_network_options.addOptionChaining("net.async.reactorBalancing",
+                "asyncNetworkReactorBalancing", moe::String,
+                "how new connections are assigned to reactors: roundRobin (default) or "
+                "leastConnections")
+                                         .format("(:?roundRobin)|(:?leastConnections)",
+                                                 "(roundRobin/leastConnections)");
+
+        async_network_options.addOptionChaining("net.async.pipelineDepth",
+                "asyncNetworkPipelineDepth", moe::Int,
+                "number of requests per connection read ahead of their replies being written, "
+                "replies are coalesced into one write (default 1, disabled)");
+
+        async_network_options.addOptionChaining("net.async.rebalanceIntervalSecs",
+                "asyncNetworkRebalanceIntervalSecs", moe::Int,
+                "how often to move busy long lived connections from the busiest reactor to the "
+                "idlest (default 0, disabled)");
+
 
         options->addSection(general_options);
 
@@ -118,6 +160,8 @@ namespace mongo {
 
         options->addSection(sharding_options);
 
+        options->addSection(async_network_options);
+
 #ifdef MONGO_CONFIG_SSL
         options->addSection(ssl_options);
 #endif
@@ -252,6 +296,77 @@ namespace mongo {
             }
         }
 
+        if (params.count("net.async.enabled")) {
+            mongosGlobalParams.asyncNetwork = params["net.async.enabled"].as<bool>();
+        }
+
+        if (params.count("net.async.threads")) {
+            int threads = params["net.async.threads"].as<int>();
+            if (threads < 0) {
+                return Status(ErrorCodes::BadValue,
+                              "error: asyncNetworkThreads must be greater than or equal to 0");
+            }
+            mongosGlobalParams.asyncNetworkThreads = threads;
+        }
+
+        if (params.count("net.async.workerThreads")) {
+            int workerThreads = params["net.async.workerThreads"].as<int>();
+            if (workerThreads < 0) {
+                return Status(ErrorCodes::BadValue,
+                              "error: asyncNetworkWorkerThreads must be greater than or equal "
+                              "to 0");
+            }
+            mongosGlobalParams.asyncNetworkWorkerThreads = workerThreads;
+        }
+
+        if (params.count("net.async.idleTimeoutSecs")) {
+            int idleTimeoutSecs = params["net.async.idleTimeoutSecs"].as<int>();
+            if (idleTimeoutSecs < 0) {
+                return Status(ErrorCodes::BadValue,
+                              "error: asyncNetworkIdleTimeoutSecs must be greater than or equal "
+                              "to 0");
+            }
+            mongosGlobalParams.asyncNetworkIdleTimeoutSecs = idleTimeoutSecs;
+        }
+
+        if (params.count("net.async.reactors")) {
+            int reactors = params["net.async.reactors"].as<int>();
+            if (reactors < 0) {
+                return Status(ErrorCodes::BadValue,
+                              "error: asyncNetworkReactors must be greater than or equal to 0");
+            }
+            mongosGlobalParams.asyncNetworkReactors = reactors;
+        }
+
+        if (params.count("net.async.pinReactors")) {
+            mongosGlobalParams.asyncNetworkPinReactors = params["net.async.pinReactors"].as<bool>();
+        }
+
+        if (params.count("net.async.reactorBalancing")) {
+            mongosGlobalParams.asyncNetworkLeastConnections =
+                params["net.async.reactorBalancing"].as<std::string>() == "leastConnections";
+        }
+
+        if (params.count("net.async.pipelineDepth")) {
+            int pipelineDepth = params["net.async.pipelineDepth"].as<int>();
+            if (pipelineDepth < 1) {
+                return Status(ErrorCodes::BadValue,
+                              "error: asyncNetworkPipelineDepth must be greater than or equal "
+                              "to 1");
+            }
+            mongosGlobalParams.asyncNetworkPipelineDepth = pipelineDepth;
+        }
+
+        if (params.count("net.async.rebalanceIntervalSecs")) {
+            int rebalanceIntervalSecs = params["net.async.rebalanceIntervalSecs"].as<int>();
+            if (rebalanceIntervalSecs < 0) {
+                return Status(ErrorCodes::BadValue,
+                              "error: asyncNetworkRebalanceIntervalSecs must be greater than or "
+                              "equal to 0");
+            }
+            mongosGlobalParams.asyncNetworkRebalanceIntervalSecs = rebalanceIntervalSecs;
+        }
+
         if ( ! params.count( "sharding.configDB" ) ) {
             return Status(ErrorCodes::BadValue, "error: no args for --configdb");
         }
@@ -47,8 +47,39 @@ namespace mongo {
         ConnectionString configdbs;
         bool upgrade;
 
+        // Serve client connections from the asio based network::NetworkServer instead of the
+        // thread per connection PortMessageServer
+        bool asyncNetwork;
+        // Number of io_service threads for the asio server, 0 picks based on the core count
+        int asyncNetworkThreads;
+        // Number of threads running message handlers for the asio server, 0 picks based on the
+        // core count
+        int asyncNetworkWorkerThreads;
+        // Close asio server connections idle for this many seconds, 0 disables
+        int asyncNetworkIdleTimeoutSecs;
+        // Number of io_services ("reactors") the asio server shards sockets over, 0 is one per core
+        int asyncNetworkReactors;
+        // Pin each reactor's threads to a cpu
+        bool asyncNetworkPinReactors;
+        // Assign new connections to the reactor with the fewest connections instead of round robin
+        bool asyncNetworkLeastConnections;
+        // Requests per asio connection read ahead of their replies being written, 1 disables
+        int asyncNetworkPipelineDepth;
+        // Seconds between checks for one asio reactor doing much more work than another, 0
+        // disables moving connections between reactors
+        int asyncNetworkRebalanceIntervalSecs;
+
         MongosGlobalParams() :
-            upgrade(false)
+            upgrade(false),
+            asyncNetwork(false),
+            asyncNetworkThreads(0),
+            asyncNetworkWorkerThreads(0),
+            asyncNetworkIdleTimeoutSecs(0),
+            asyncNetworkReactors(1),
+            asyncNetworkPinReactors(false),
+            asyncNetworkLeastConnections(false),
+            asyncNetworkPipelineDepth(1),
+            asyncNetworkRebalanceIntervalSecs(0)
         { }
     };
 
@@ -76,7 +76,9 @@
 #include "mongo/util/log.h"
 #include "mongo/util/net/message.h"
 #include "mongo/util/net/message_server.h"
+#include "mongo/util/net/network_server.h"
 #include "mongo/util/net/ssl_manager.h"
+#include "mongo/util/net/ssl_options.h"
 #include "mongo/util/ntservice.h"
 #include "mongo/util/options_parser/startup_options.h"
 #include "mongo/util/processinfo.h"
@@ -182,7 +184,40 @@ namespace mongo {
         PeriodicTask::startRunningPeriodicTasks();
 
         ShardedMessageHandler handler;
-        MessageServer * server = createServer( opts , &handler );
+        MessageServer * server = nullptr;
+        if (mongosGlobalParams.asyncNetwork) {
+#ifdef MONGO_CONFIG_SSL
+            if (sslGlobalParams.sslMode.load() != SSLParams::SSLMode_disabled) {
+                error() << "asyncNetwork does not support SSL, use the default network server";
+                dbexit(EXIT_BADOPTIONS);
+            }
+#endif
+#ifndef _WIN32
+            if (!serverGlobalParams.noUnixSocket) {
+                warning() << "asyncNetwork does not listen on a unix domain socket, only on TCP, "
+                          << "use --nounixsocket to silence this warning";
+            }
+#endif
+            network::NetworkOptions networkOptions;
+            networkOptions.ipList = opts.ipList;
+            networkOptions.port = opts.port;
+            networkOptions.threads = mongosGlobalParams.asyncNetworkThreads;
+            networkOptions.workerThreads = mongosGlobalParams.asyncNetworkWorkerThreads;
+            networkOptions.idleTimeoutSecs = mongosGlobalParams.asyncNetworkIdleTimeoutSecs;
+            networkOptions.reactors = mongosGlobalParams.asyncNetworkReactors;
+            networkOptions.pinReactors = mongosGlobalParams.asyncNetworkPinReactors;
+            networkOptions.balancing = mongosGlobalParams.asyncNetworkLeastConnections ?
+                network::NetworkOptions::Balancing::leastConnections :
+                network::NetworkOptions::Balancing::roundRobin;
+            networkOptions.pipelineDepth = mongosGlobalParams.asyncNetworkPipelineDepth;
+            networkOptions.rebalanceIntervalSecs =
+                mongosGlobalParams.asyncNetworkRebalanceIntervalSecs;
+            log() << "using the asio network server";
+            server = network::createAsyncServer(networkOptions, &handler);
+        }
+        else {
+            server = createServer( opts , &handler );
+        }
         server->setAsTimeTracker();
         server->setupSockets();
         server->run();
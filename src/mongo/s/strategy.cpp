@@ -232,7 +232,7 @@ namespace mongo {
                 cursorCache.store( cc, cursorLeftoverMillis );
             }
 
-            replyToQuery( 0, r.p(), r.m(), buffer.buf(), buffer.len(), docCount,
+            replyToQuery( 0, r.p(), r.m(), buffer, docCount,
                     startFrom, hasMore ? cc->getId() : 0 );
         }
         else{
@@ -638,7 +638,7 @@ namespace mongo {
                 cursorCache.remove( id );
             }
 
-            replyToQuery( 0, r.p(), r.m(), buffer.buf(), buffer.len(), docCount,
+            replyToQuery( 0, r.p(), r.m(), buffer, docCount,
                     startFrom, hasMore ? cursor->getId() : 0 );
             return;
         }
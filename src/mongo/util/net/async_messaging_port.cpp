@@ -5,29 +5,35 @@
  *      Author: charlie
  */
 
-#include "async_messaging_port.h"
+#include "mongo/platform/basic.h"
+
+#include "mongo/util/net/async_messaging_port.h"
+
+#include "mongo/util/net/network_server.h"
 
 namespace mongo {
 namespace network {
 
-AsyncMessagingPort::AsyncMessagingPort(ConnectionInfo* const connInfo) : _connInfo(connInfo) {
+AsyncMessagingPort::AsyncMessagingPort(ConnectionInfo* const connInfo, long long connectionId)
+        : _connInfo(connInfo) {
+    setConnectionId(connectionId);
 }
 
-void AsyncMessagingPort::asyncSend(Message& toSend, int responseTo) {
+void AsyncMessagingPort::asyncSend(Message& toSend, MSGID responseTo) {
+    verify(!toSend.empty());
     //TODO: get rid of nextMessageId
     toSend.header().setId(nextMessageId());
     toSend.header().setResponseTo(responseTo);
-    //TODO: Piggyback data is added here
-    toSend.isSingleData() ? asyncSendSingle(toSend) : asyncSendMulti(toSend);
+    _connInfo->asyncSendMessage(toSend);
 }
 
-void AsyncMessagingPort::asyncSendSingle(const Message& toSend)  {
-    _connInfo->asyncSendMessage(toSend.singleData(), toSend.size());
+HostAndPort AsyncMessagingPort::remote() const {
+    return _connInfo->remote();
 }
 
-void AsyncMessagingPort::asyncSendMulti(const Message& toSend) {
-
+std::string AsyncMessagingPort::localAddrString() const {
+    return _connInfo->localAddrString();
 }
 
-} //namespace mongo
 } //namespace network
+} //namespace mongo
@@ -9,35 +9,36 @@
 
 #include "mongo/platform/basic.h"
 
-#include <algorithm>
-#include <boost/thread/thread.hpp>
-#include <errno.h>
-#include <utility>
-
-#include "mongo/util/assert_util.h"
-#include "mongo/util/exit.h"
-#include "mongo/util/log.h"
+#include <string>
+
+#include "mongo/util/net/hostandport.h"
 #include "mongo/util/net/message.h"
 #include "mongo/util/net/message_port.h"
-#include "mongo/util/net/network_server.h"
 
 namespace mongo {
 namespace network {
 
+class ConnectionInfo;
+
 /*
  * Piggybacking isn't supported for lazy kill cursor, not sure if that is really needed?
  * Also, if it is, it's not part of AbstractMessagingPort....
+ *
+ * Owned by the ConnectionInfo, this is what the Client and the MessageHandler see as the port.
+ * Replies are queued on the connection and return before they hit the wire
+ * A response that owns its buffers is taken by reply and left empty, so the buffers go to the
+ * socket without another copy
  */
 class AsyncMessagingPort: public AbstractMessagingPort {
 public:
-    AsyncMessagingPort(ConnectionInfo* const connInfo);
+    AsyncMessagingPort(ConnectionInfo* const connInfo, long long connectionId);
     virtual ~AsyncMessagingPort() {};
 
     void reply(Message& received, Message& response, MSGID responseTo) final {
-        asyncSend(received, responseTo);
+        asyncSend(response, responseTo);
     }
     void reply(Message& received, Message& response) final {
-        asyncSend(received, response.header().getId());
+        asyncSend(response, received.header().getId());
     }
 
     /*
@@ -45,7 +46,7 @@ public:
      * Consider returning std::string for error logging, etc.
      */
     //Only used for mongoD and MessagingPort... and that is pretty iffy...
-    HostAndPort remote() const final { fassert(-2, false); return SockAddr(); }
+    HostAndPort remote() const final;
     //Only used for an error string for sasl logging
     //TODO: fix sasl logging to use a string
     std::string localAddrString() const final;
@@ -53,11 +54,8 @@ public:
 private:
     ConnectionInfo* const _connInfo;
 
-    void asyncSend(Message& toSend, int responseTo = 0);
-    void asyncSendSingle(const Message& toSend);
-    void asyncSendMulti(const Message& toSend);
+    void asyncSend(Message& toSend, MSGID responseTo = 0);
 };
 
-} //namespace mongo
 } //namespace network
-
+} //namespace mongo
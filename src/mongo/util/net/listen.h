@@ -106,6 +106,13 @@ namespace mongo {
          */
         void waitUntilListening() const;
 
+    protected:
+        /**
+         * For listeners that do not run the select() loop in initAndListen, e.g. the asio
+         * server, to keep the rough elapsed time moving.
+         */
+        void addElapsedTimeMillis(long long millis) { _elapsedTime += millis; }
+
     private:
         std::vector<SockAddr> _mine;
         std::vector<SOCKET> _socks;
@@ -96,6 +96,22 @@ namespace mongo {
             _cur += m.header().getLen();
         }
 
+        /**
+         * Sends the pending data followed by m in a single vectored send, without copying m
+         */
+        void flushWith( Message& m ) {
+            std::vector< std::pair< char *, int > > data;
+            data.push_back( std::make_pair( _buf, len() ) );
+            if ( m.isSingleData() ) {
+                data.push_back( std::make_pair( m.singleData().view2ptr(), m.header().getLen() ) );
+            }
+            else {
+                data.insert( data.end(), m.multiData().begin(), m.multiData().end() );
+            }
+            _port->send( data, "flush" );
+            _cur = _buf;
+        }
+
         void flush() {
             if ( _buf == _cur )
                 return;
@@ -305,15 +321,9 @@ again:
 
         if ( piggyBackData && piggyBackData->len() ) {
             mmm( log() << "*     have piggy back" << endl; )
-            if ( ( piggyBackData->len() + toSend.header().getLen() ) > 1300 ) {
-                // won't fit in a packet - so just send it off
-                piggyBackData->flush();
-            }
-            else {
-                piggyBackData->append( toSend );
-                piggyBackData->flush();
-                return;
-            }
+            // the socket gathers both, so neither is copied regardless of size
+            piggyBackData->flushWith( toSend );
+            return;
         }
 
         toSend.send( *this, "say" );
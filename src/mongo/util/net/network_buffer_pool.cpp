@@ -0,0 +1,137 @@
+/*
+ * network_buffer_pool.cpp
+ *
+ *  Created on: Jun 20, 2015
+ *      Author: charlie
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/util/net/network_buffer_pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/util/allocator.h"
+#include "mongo/util/assert_util.h"
+
+namespace mongo {
+namespace network {
+
+MessageBuffer::MessageBuffer(MessageBuffer&& other) :
+        _pool(other._pool), _data(other._data), _capacity(other._capacity),
+        _sizeClass(other._sizeClass) {
+    other._data = nullptr;
+    other._capacity = 0;
+}
+
+MessageBuffer& MessageBuffer::operator=(MessageBuffer&& other) {
+    if (this == &other)
+        return *this;
+    release();
+    _pool = other._pool;
+    _data = other._data;
+    _capacity = other._capacity;
+    _sizeClass = other._sizeClass;
+    other._data = nullptr;
+    other._capacity = 0;
+    return *this;
+}
+
+void MessageBuffer::release() {
+    if (!_data)
+        return;
+    if (_sizeClass < 0)
+        free(_data);
+    else
+        _pool->put(_data, _sizeClass);
+    _data = nullptr;
+    _capacity = 0;
+}
+
+MessageBufferPool::MessageBufferPool(size_t maxCachedBytesPerClass) {
+    for (int i = 0; i < kSizeClasses; ++i) {
+        auto& sizeClass = _classes[i];
+        sizeClass.maxFree = std::max(size_t(1), maxCachedBytesPerClass / sizeOfClass(i));
+        sizeClass.free.reserve(sizeClass.maxFree);
+    }
+}
+
+MessageBufferPool::~MessageBufferPool() {
+    for (auto& sizeClass : _classes) {
+        for (auto data : sizeClass.free)
+            free(data);
+    }
+}
+
+int MessageBufferPool::sizeClassFor(size_t size) {
+    if (size > kMaxPooledSize)
+        return -1;
+    int sizeClass = 0;
+    while (sizeOfClass(sizeClass) < size)
+        ++sizeClass;
+    return sizeClass;
+}
+
+MessageBuffer MessageBufferPool::get(size_t size) {
+    const int sizeClassIndex = sizeClassFor(size);
+    if (sizeClassIndex < 0) {
+        ++_unpooled;
+        //Same rounding as the legacy MessagingPort::recv
+        const size_t capacity = (size + NETWORK_MIN_MESSAGE_SIZE - 1) & ~(NETWORK_MIN_MESSAGE_SIZE - 1);
+        return MessageBuffer(this, static_cast<char*>(mongoMalloc(capacity)), capacity, -1);
+    }
+
+    auto& sizeClass = _classes[sizeClassIndex];
+    const size_t capacity = sizeOfClass(sizeClassIndex);
+    char* data = nullptr;
+    {
+        scoped_spinlock lk(sizeClass.lock);
+        if (!sizeClass.free.empty()) {
+            data = sizeClass.free.back();
+            sizeClass.free.pop_back();
+        }
+    }
+    if (data) {
+        ++sizeClass.hits;
+    }
+    else {
+        ++sizeClass.misses;
+        data = static_cast<char*>(mongoMalloc(capacity));
+    }
+    return MessageBuffer(this, data, capacity, sizeClassIndex);
+}
+
+void MessageBufferPool::put(char* data, int sizeClassIndex) {
+    auto& sizeClass = _classes[sizeClassIndex];
+    {
+        scoped_spinlock lk(sizeClass.lock);
+        if (sizeClass.free.size() < sizeClass.maxFree) {
+            sizeClass.free.push_back(data);
+            return;
+        }
+    }
+    free(data);
+}
+
+void MessageBufferPool::appendStats(BSONObjBuilder* builder) const {
+    BSONObjBuilder pool(builder->subobjStart("bufferPool"));
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    long long cachedBytes = 0;
+    for (int i = 0; i < kSizeClasses; ++i) {
+        auto& sizeClass = _classes[i];
+        hits += sizeClass.hits;
+        misses += sizeClass.misses;
+        //Racy read of the size is fine for stats
+        cachedBytes += sizeClass.free.size() * sizeOfClass(i);
+    }
+    pool.appendNumber("hits", static_cast<long long>(hits));
+    pool.appendNumber("misses", static_cast<long long>(misses));
+    pool.appendNumber("unpooled", static_cast<long long>(_unpooled.load()));
+    pool.appendNumber("cachedBytes", cachedBytes);
+}
+
+} /* namespace network */
+} /* namespace mongo */
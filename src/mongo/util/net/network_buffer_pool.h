@@ -0,0 +1,103 @@
+/*
+ * network_buffer_pool.h
+ *
+ *  Created on: Jun 20, 2015
+ *      Author: charlie
+ */
+
+#pragma once
+
+#include "mongo/platform/platform_specific.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/util/concurrency/spin_lock.h"
+
+namespace mongo {
+
+class BSONObjBuilder;
+
+namespace network {
+
+//If this changes the mask for allocation needs to change too
+const size_t NETWORK_MIN_MESSAGE_SIZE = 1024;
+
+class MessageBufferPool;
+
+/*
+ * A buffer checked out of a MessageBufferPool, goes back to the pool when released or destroyed
+ * Movable only.  Message can be backed by data() with freeIt = false, no copy needed
+ */
+class MessageBuffer {
+    MONGO_DISALLOW_COPYING(MessageBuffer);
+public:
+    MessageBuffer() = default;
+    MessageBuffer(MessageBuffer&& other);
+    MessageBuffer& operator=(MessageBuffer&& other);
+    ~MessageBuffer() { release(); }
+
+    char* data() const { return _data; }
+    size_t capacity() const { return _capacity; }
+    explicit operator bool() const { return _data != nullptr; }
+
+    void release();
+
+private:
+    friend class MessageBufferPool;
+    MessageBuffer(MessageBufferPool* pool, char* data, size_t capacity, int sizeClass) :
+        _pool(pool), _data(data), _capacity(capacity), _sizeClass(sizeClass) { }
+
+    MessageBufferPool* _pool{};
+    char* _data{};
+    size_t _capacity{};
+    //-1 for buffers too large to pool, they are malloc'd and freed directly
+    int _sizeClass{-1};
+};
+
+/*
+ * Power of two size classes from NETWORK_MIN_MESSAGE_SIZE to 64KB, so the typical < 16KB message
+ * is served from a free list without touching the heap
+ * One pool per reactor, buffers may be returned from any thread so each class has a spin lock,
+ * it is only held to push or pop a pointer
+ * The free lists are reserved up front so returning a buffer never allocates
+ */
+class MessageBufferPool {
+    MONGO_DISALLOW_COPYING(MessageBufferPool);
+public:
+    static const int kSizeClasses = 7;
+    static const size_t kMaxPooledSize = NETWORK_MIN_MESSAGE_SIZE << (kSizeClasses - 1);
+
+    explicit MessageBufferPool(size_t maxCachedBytesPerClass = 4 * 1024 * 1024);
+    ~MessageBufferPool();
+
+    /*
+     * Returns a buffer of at least size bytes
+     */
+    MessageBuffer get(size_t size);
+
+    void appendStats(BSONObjBuilder* builder) const;
+
+    static int sizeClassFor(size_t size);
+    static size_t sizeOfClass(int sizeClass) { return NETWORK_MIN_MESSAGE_SIZE << sizeClass; }
+
+private:
+    friend class MessageBuffer;
+    void put(char* data, int sizeClass);
+
+    struct MONGO_ALIGN_TO_CACHE SizeClass {
+        SpinLock lock;
+        std::vector<char*> free;
+        size_t maxFree{};
+        std::atomic<uint64_t> hits{};
+        std::atomic<uint64_t> misses{};
+    };
+    std::array<SizeClass, kSizeClasses> _classes;
+    std::atomic<uint64_t> _unpooled{};
+};
+
+} /* namespace network */
+} /* namespace mongo */
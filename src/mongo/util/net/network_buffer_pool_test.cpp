@@ -0,0 +1,114 @@
+/*    Copyright 2015 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/platform/basic.h"
+
+#include "mongo/unittest/unittest.h"
+#include "mongo/util/net/network_buffer_pool.h"
+
+namespace mongo {
+namespace {
+
+    using network::MessageBuffer;
+    using network::MessageBufferPool;
+    using network::NETWORK_MIN_MESSAGE_SIZE;
+
+    TEST(MessageBufferPool, SizeClasses) {
+        ASSERT_EQUALS(0, MessageBufferPool::sizeClassFor(1));
+        ASSERT_EQUALS(0, MessageBufferPool::sizeClassFor(NETWORK_MIN_MESSAGE_SIZE));
+        ASSERT_EQUALS(1, MessageBufferPool::sizeClassFor(NETWORK_MIN_MESSAGE_SIZE + 1));
+        ASSERT_EQUALS(4, MessageBufferPool::sizeClassFor(16 * 1024));
+        ASSERT_EQUALS(MessageBufferPool::kSizeClasses - 1,
+                      MessageBufferPool::sizeClassFor(MessageBufferPool::kMaxPooledSize));
+        ASSERT_EQUALS(-1, MessageBufferPool::sizeClassFor(MessageBufferPool::kMaxPooledSize + 1));
+    }
+
+    TEST(MessageBufferPool, ReleasedBufferIsReused) {
+        MessageBufferPool pool;
+        char* first;
+        {
+            MessageBuffer buf = pool.get(100);
+            ASSERT(buf);
+            ASSERT_EQUALS(NETWORK_MIN_MESSAGE_SIZE, buf.capacity());
+            first = buf.data();
+        }
+        MessageBuffer buf = pool.get(NETWORK_MIN_MESSAGE_SIZE);
+        ASSERT_EQUALS(first, buf.data());
+
+        // A different size class doesn't share the free list.
+        MessageBuffer bigger = pool.get(NETWORK_MIN_MESSAGE_SIZE * 2);
+        ASSERT_NOT_EQUALS(first, bigger.data());
+        ASSERT_EQUALS(NETWORK_MIN_MESSAGE_SIZE * 2, bigger.capacity());
+    }
+
+    TEST(MessageBufferPool, MoveTransfersOwnership) {
+        MessageBufferPool pool;
+        MessageBuffer a = pool.get(10);
+        char* data = a.data();
+        MessageBuffer b(std::move(a));
+        ASSERT_FALSE(a);
+        ASSERT_EQUALS(data, b.data());
+
+        MessageBuffer c;
+        c = std::move(b);
+        ASSERT_FALSE(b);
+        ASSERT_EQUALS(data, c.data());
+        c.release();
+        ASSERT_FALSE(c);
+        ASSERT_EQUALS(data, pool.get(10).data());
+    }
+
+    TEST(MessageBufferPool, LargeBuffersAreNotPooled) {
+        MessageBufferPool pool;
+        const size_t size = MessageBufferPool::kMaxPooledSize + 1;
+        MessageBuffer buf = pool.get(size);
+        ASSERT(buf);
+        ASSERT_GREATER_THAN_OR_EQUALS(buf.capacity(), size);
+        ASSERT_EQUALS(0U, buf.capacity() % NETWORK_MIN_MESSAGE_SIZE);
+    }
+
+    TEST(MessageBufferPool, FreeListIsBounded) {
+        // Room for two of the smallest buffers.
+        MessageBufferPool pool(2 * NETWORK_MIN_MESSAGE_SIZE);
+        MessageBuffer a = pool.get(1);
+        MessageBuffer b = pool.get(1);
+        MessageBuffer c = pool.get(1);
+        char* aData = a.data();
+        char* bData = b.data();
+        a.release();
+        b.release();
+        // Doesn't fit, freed.
+        c.release();
+
+        MessageBuffer x = pool.get(1);
+        MessageBuffer y = pool.get(1);
+        ASSERT_EQUALS(bData, x.data());
+        ASSERT_EQUALS(aData, y.data());
+    }
+
+}  // namespace
+}  // namespace mongo
@@ -7,9 +7,9 @@
 
 /*
  * TODO: define ASIO_HAS_MOVE for vendored asio library
- * TODO: -C- handle listen.cpp const Listener* Listener::_timeTracker;
  * TODO: -C- Support IPv6 - requires removing option handling from socks.cpp.  Global opts or net file
- * TODO: -C- Do we care about globalTicketHolder any more?
+ * SSL and unix domain sockets are only available through the legacy PortMessageServer, mongos
+ * refuses to start the asio server with SSL and warns that it opens no unix domain socket
  */
 
 
@@ -17,252 +17,1225 @@
 
 #include "mongo/platform/basic.h"
 
+#include "mongo/util/net/network_server.h"
+
 #include <algorithm>
 #include <boost/thread/thread.hpp>
+#include <chrono>
 #include <errno.h>
 #include <utility>
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "mongo/db/auth/action_set.h"
+#include "mongo/db/auth/action_type.h"
+#include "mongo/db/auth/privilege.h"
+#include "mongo/db/commands.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/server_options.h"
+#include "mongo/db/stats/counters.h"
 #include "mongo/util/assert_util.h"
+#include "mongo/util/concurrency/thread_name.h"
 #include "mongo/util/exit.h"
 #include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
 #include "mongo/util/net/message.h"
-#include "mongo/util/net/network_server.h"
+#include "mongo/util/scopeguard.h"
+#include "mongo/util/stringutils.h"
+#include "mongo/util/timer.h"
 
 namespace mongo {
 namespace network {
 
 const std::string NETWORK_PREFIX = "conn";
 
+NetworkServerStats networkServerStats;
+
+void NetworkServerStats::append(BSONObjBuilder* builder) const {
+    builder->appendNumber("current", static_cast<long long>(connectionsCurrent.load()));
+    builder->appendNumber("totalCreated", static_cast<long long>(connectionsCreated.load()));
+    builder->appendNumber("rejected", static_cast<long long>(connectionsRejected.load()));
+    builder->appendNumber("idleTimeouts", static_cast<long long>(idleTimeouts.load()));
+    builder->appendNumber("messagesIn", static_cast<long long>(messagesIn.load()));
+    builder->appendNumber("messagesOut", static_cast<long long>(messagesOut.load()));
+    builder->appendNumber("processingErrors", static_cast<long long>(processingErrors.load()));
+    builder->appendNumber("socketErrors", static_cast<long long>(socketErrors.load()));
+    builder->appendNumber("coalescedReplies", static_cast<long long>(coalescedReplies.load()));
+    builder->appendNumber("pipelinePauses", static_cast<long long>(pipelinePauses.load()));
+    builder->appendNumber("connectionsMoved", static_cast<long long>(connectionsMoved.load()));
+}
+
+const char* const ConnectionCounters::kNames[kNumCounters] = {
+    "bytesIn",
+    "bytesOut",
+    "queries",
+    "getMores",
+    "inserts",
+    "updates",
+    "deletes",
+    "commands",
+};
+
+void ConnectionCounters::add(const ConnectionCounters& other) {
+    for (int i = 0; i < kNumCounters; ++i)
+        _counts[i].fetch_add(other._counts[i].load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+}
+
+void ConnectionCounters::countRequest(const Message& m) {
+    switch (m.operation()) {
+    case dbQuery: {
+        //Past the header is the int32 query flags, then the namespace
+        const MsgData::ConstView data = m.singleData().view2ptr();
+        const int nsOffset = sizeof(int32_t);
+        const int maxNsLen = data.dataLen() - nsOffset;
+        if (maxNsLen > 0) {
+            const char* ns = data.data() + nsOffset;
+            if (StringData(ns, strnlen(ns, maxNsLen)).endsWith(".$cmd")) {
+                increment(kCommands);
+                break;
+            }
+        }
+        increment(kQueries);
+        break;
+    }
+    case dbGetMore:
+        increment(kGetMores);
+        break;
+    case dbInsert:
+        increment(kInserts);
+        break;
+    case dbUpdate:
+        increment(kUpdates);
+        break;
+    case dbDelete:
+        increment(kDeletes);
+        break;
+    default:
+        break;
+    }
+}
+
+void ConnectionCounters::append(BSONObjBuilder* builder) const {
+    for (int i = 0; i < kNumCounters; ++i)
+        builder->appendNumber(kNames[i], static_cast<long long>(get(static_cast<Counter>(i))));
+}
+
+ConnectionCounters::Counter ConnectionCounters::fromName(StringData name) {
+    for (int i = 0; i < kNumCounters; ++i) {
+        if (name == kNames[i])
+            return static_cast<Counter>(i);
+    }
+    return kNumCounters;
+}
+
+namespace {
+    //Set when the async server is started so serverStatus can tell which listener is running
+    std::atomic<NetworkServer*> runningServer{};
+
+    class AsyncNetworkServerStatusSection : public ServerStatusSection {
+    public:
+        AsyncNetworkServerStatusSection() : ServerStatusSection("asyncNetwork") {}
+        virtual bool includeByDefault() const { return true; }
+
+        virtual BSONObj generateSection(OperationContext* txn,
+                                        const BSONElement& configElement) const {
+            BSONObjBuilder b;
+            NetworkServer* server = runningServer.load();
+            b.appendBool("enabled", server != nullptr);
+            networkServerStats.append(&b);
+            if (server)
+                server->appendReactorStats(&b);
+            return b.obj();
+        }
+    } asyncNetworkServerStatusSection;
+
+    /*
+     * Lists the open asio connections with their counters, heaviest first when sortBy is given
+     * { currentConn : 1, sortBy : "bytesIn", limit : 10 }
+     */
+    class CmdCurrentConn : public Command {
+    public:
+        CmdCurrentConn() : Command("currentConn") {}
+        virtual bool slaveOk() const { return true; }
+        virtual bool adminOnly() const { return true; }
+        virtual bool isWriteCommandForConfigServer() const { return false; }
+        virtual void help(std::stringstream& help) const {
+            help << "lists asio network server connections and their request and byte counts\n"
+                    "{ currentConn : 1, sortBy : <counter>, limit : <n> }";
+        }
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {
+            ActionSet actions;
+            actions.addAction(ActionType::inprog);
+            out->push_back(Privilege(ResourcePattern::forClusterResource(), actions));
+        }
+        bool run(OperationContext* txn,
+                 const std::string& dbname,
+                 BSONObj& cmdObj,
+                 int,
+                 std::string& errmsg,
+                 BSONObjBuilder& result) {
+            NetworkServer* server = runningServer.load();
+            if (!server) {
+                errmsg = "the asio network server is not running";
+                return false;
+            }
+
+            ConnectionCounters::Counter sortBy = ConnectionCounters::kNumCounters;
+            BSONElement sortByElement = cmdObj["sortBy"];
+            if (!sortByElement.eoo()) {
+                sortBy = ConnectionCounters::fromName(sortByElement.valuestrsafe());
+                if (sortBy == ConnectionCounters::kNumCounters) {
+                    errmsg = str::stream() << "unknown counter to sort by: " << sortByElement;
+                    return false;
+                }
+            }
+            long long limit = cmdObj["limit"].numberLong();
+            if (limit < 0) {
+                errmsg = "limit must be greater than or equal to 0";
+                return false;
+            }
+
+            auto conns = server->connections()->snapshot();
+            //Sampled once up front, the counters keep moving while sorting
+            std::vector<std::pair<uint64_t, ConnectionInfo*>> sampled;
+            sampled.reserve(conns.size());
+            for (auto& conn : conns) {
+                sampled.emplace_back(sortBy == ConnectionCounters::kNumCounters ? 0 :
+                                         conn->counters().get(sortBy),
+                                     conn.get());
+            }
+            if (sortBy != ConnectionCounters::kNumCounters) {
+                std::stable_sort(sampled.begin(), sampled.end(),
+                                 [](const std::pair<uint64_t, ConnectionInfo*>& lhs,
+                                    const std::pair<uint64_t, ConnectionInfo*>& rhs) {
+                                     return lhs.first > rhs.first;
+                                 });
+            }
+
+            BSONArrayBuilder array(result.subarrayStart("connections"));
+            long long count = 0;
+            for (auto& i : sampled) {
+                if (limit && count++ == limit)
+                    break;
+                ConnectionInfo* conn = i.second;
+                BSONObjBuilder c(array.subobjStart());
+                c.appendNumber("connectionId", conn->connectionId());
+                c.append("client", conn->remote().toString());
+                c.append("reactor", conn->reactor()->id());
+                conn->counters().append(&c);
+            }
+            return true;
+        }
+    } cmdCurrentConn;
+} // namespace
+
+Reactor::Reactor(int id, int threads, int cpu, int workerThreads, std::string threadName) :
+        _id(id), _threads(threads), _cpu(cpu), _threadName(std::move(threadName)),
+        _work(new asio::io_service::work(_service)) {
+    if (workerThreads)
+        _workers.reset(new Reactor(id, workerThreads, -1, 0, "networkWorker"));
+}
+
+void Reactor::connectionRemoved(const ConnectionCounters& counters) {
+    _closedTotals.add(counters);
+    --_connections;
+}
+
+void Reactor::start() {
+    if (_workers)
+        _workers->start();
+    //Using boost thread as it allows for cross platform stack size reduction
+    boost::thread::attributes attrs;
+    attrs.set_stack_size(NETWORK_DEFAULT_STACK_SIZE);
+    try {
+        for(int i = 0; i < _threads; ++i)
+            _threadPool.emplace_back(attrs, [this]{ serviceRun(); });
+    }
+    catch (boost::thread_resource_error&) {
+        log() << "can't create new thread for listening, shutting down" << std::endl;
+        fassertFailed(28701);
+    }
+}
+
+void Reactor::join() {
+    for (auto& t: _threadPool)
+        t.join();
+    _threadPool.clear();
+    if (_workers)
+        _workers->join();
+}
+
+void Reactor::stop() {
+    _work.reset();
+    _service.stop();
+    if (_workers)
+        _workers->stop();
+}
+
+void Reactor::serviceRun() {
+    setThreadName(std::string(str::stream() << _threadName << _id));
+#ifdef __linux__
+    if (_cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(_cpu, &cpus);
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (ret)
+            warning() << "failed to pin network reactor " << _id << " to cpu " << _cpu << ": "
+                      << errnoWithDescription(ret);
+    }
+#endif
+    try {
+        asio::error_code ec;
+        _service.run(ec);
+        if (ec) {
+            log() << "Error running service: " << ec.message() << std::endl;
+            fassertFailed(28700);
+        }
+    } catch (std::exception &e) {
+        log() << "Exception running io_service: " << e.what() << std::endl;
+        dbexit( EXIT_UNCAUGHT );
+    } catch (...) {
+        log() << "unknown error running io_service" << std::endl;
+        dbexit( EXIT_UNCAUGHT );
+    }
+}
+
+namespace {
+    //Handlers block on locks and shard i/o, so there are many more of these than io threads
+    int pickWorkerThreads(int workerThreads) {
+        if (workerThreads)
+            return workerThreads;
+        const int cores = std::max(1u, boost::thread::hardware_concurrency());
+        return std::max(32, cores * 8);
+    }
+} // namespace
+
 NetworkServer::NetworkServer(NetworkOptions options, Connections* connections) :
         _options(std::move(options)),
         _connections(connections) {
-    invariant(OnConnectEvent != nullptr);
+    const int cores = std::max(1u, boost::thread::hardware_concurrency());
+    const int reactors = _options.reactors ? _options.reactors : cores;
+    //Handlers run on the workers, these only move bytes, but keep a handful of threads
+    const int threads = _options.threads ? _options.threads : std::max(4, cores * 2);
+    const int threadsPerReactor = std::max(1, threads / reactors);
+    //Each reactor posts requests to its own workers, rounded up so none is left short
+    const int workerThreads = pickWorkerThreads(_options.workerThreads);
+    const int workersPerReactor = (workerThreads + reactors - 1) / reactors;
+    for (int i = 0; i < reactors; ++i)
+        _reactors.emplace_back(new Reactor(i, threadsPerReactor,
+                                           _options.pinReactors ? i % cores : -1,
+                                           workersPerReactor));
+}
+
+NetworkServer::Initiator::Initiator(
+        asio::io_service& service,
+        const asio::ip::tcp::endpoint& endPoint)
+        : _acceptor(service, endPoint) {
+}
+
+bool NetworkServer::setupSockets() {
+    std::vector<asio::ip::tcp::endpoint> endPoints;
     //If ipList is specified bind on those ips, otherwise bind to all ips for that port
     if (_options.ipList.size()) {
-        for (auto &i : _options.ipList) {
+        std::vector<std::string> ips;
+        splitStringDelim(_options.ipList, &ips, ',');
+        for (auto& ip : ips) {
+            asio::error_code ec;
+            auto address = asio::ip::address::from_string(ip, ec);
+            if (ec) {
+                error() << "invalid bind ip " << ip << ": " << ec.message();
+                return false;
+            }
             //create an end point with address and port number for each ip
-            _endPoints.emplace_back(&_service, asio::ip::tcp::endpoint(i, _options.port));
+            endPoints.emplace_back(address, _options.port);
         }
     }
     else
-        _endPoints.emplace_back(&_service, asio::ip::tcp::endpoint(asio::ip::tcp::v4(),
-                _options.port));
-}
+        endPoints.emplace_back(asio::ip::tcp::v4(), _options.port);
 
-NetworkServer::Initiator::Initiator(
-        asio::io_service& service,
-        const asio::ip::tcp::endpoint& endPoint)
-        : _acceptor(service, endPoint), _socket(service) {
+    for (auto& endPoint : endPoints) {
+        try {
+            _endPoints.emplace_back(new Initiator(service(), endPoint));
+        }
+        catch (const std::system_error& e) {
+            error() << "listen(): bind() failed for " << endPoint.address().to_string() << ':'
+                    << endPoint.port() << ": " << e.what();
+            return false;
+        }
+        log() << "waiting for connections on port " << _options.port << " (asio)";
+    }
+    return true;
 }
 
 void NetworkServer::startAllWaits() {
     for (auto& i : _endPoints)
-        startWait(&i);
+        startWait(i.get());
+}
+
+Reactor* NetworkServer::pickReactor() {
+    if (_reactors.size() == 1)
+        return _reactors.front().get();
+    if (_options.balancing == NetworkOptions::Balancing::leastConnections) {
+        //Few reactors, a scan is cheaper than keeping them ordered
+        Reactor* least = _reactors.front().get();
+        for (auto& reactor : _reactors) {
+            if (reactor->connections() < least->connections())
+                least = reactor.get();
+        }
+        return least;
+    }
+    return _reactors[_nextReactor++ % _reactors.size()].get();
 }
 
 void NetworkServer::startWait(Initiator* const initiator) {
-    initiator->_acceptor.async_accept(initiator->_socket, [this, initiator] (std::error_code ec) {
+    //Accepting straight onto the target reactor's io_service, a socket can't move afterwards
+    initiator->_target = pickReactor();
+    initiator->_socket.reset(new asio::ip::tcp::socket(initiator->_target->service()));
+    initiator->_acceptor.async_accept(*initiator->_socket, [this, initiator] (std::error_code ec) {
+        if (ec == asio::error::operation_aborted)
+            return;
         if (!ec)
             //TOOO: Ensure that move is enabled: ASIO_HAS_MOVE
-            _connections->newConnHandler(std::move(initiator->_socket));
+            _connections->newConnHandler(std::move(*initiator->_socket), initiator->_target);
         else {
             //Clear the socket just in case
-            asio::ip::tcp::socket sock(std::move(initiator->_socket));
-            sock.shutdown(asio::socket_base::shutdown_type::shutdown_both);
-            sock.close();
-            switch (ec) {
-            default:
-                log() << "Error code: " << ec << " on port " << initiator->_acceptor.local_endpoint()
-                        << std::endl;
-            }
+            asio::error_code ignored;
+            initiator->_socket->close(ignored);
+            log() << "Error accepting new connection on port "
+                  << initiator->_acceptor.local_endpoint(ignored).port() << ": " << ec.message();
         }
         //requeue
         startWait(initiator);
     });
 }
 
-void NetworkServer::serviceRun() {
-    try {
-        asio::error_code ec;
-        _service.run(ec);
-        if (ec) {
-            log() << "Error running service: " << ec << std::endl;
-            fassert(-1, !ec);
+void NetworkServer::asyncRebalance() {
+    _rebalanceTimer->expires_from_now(std::chrono::seconds(_options.rebalanceIntervalSecs));
+    _rebalanceTimer->async_wait([this](std::error_code ec) {
+        if (ec)
+            return;
+        rebalance();
+        asyncRebalance();
+    });
+}
+
+void NetworkServer::rebalance() {
+    std::vector<uint64_t> reactorBusy;
+    reactorBusy.reserve(_reactors.size());
+    for (auto& reactor : _reactors)
+        reactorBusy.push_back(reactor->busyMicros());
+    auto conns = _connections->snapshot();
+    std::unordered_map<ConnectionId, uint64_t> connectionBusy;
+    connectionBusy.reserve(conns.size());
+    for (auto& conn : conns)
+        connectionBusy[conn->connectionId()] = conn->busyMicros();
+
+    //The first check only takes the samples
+    const bool haveSamples = !_lastReactorBusy.empty();
+    std::vector<uint64_t> lastReactorBusy;
+    lastReactorBusy.swap(_lastReactorBusy);
+    _lastReactorBusy = reactorBusy;
+    std::unordered_map<ConnectionId, uint64_t> lastConnectionBusy;
+    lastConnectionBusy.swap(_lastConnectionBusy);
+    _lastConnectionBusy = connectionBusy;
+    if (!haveSamples)
+        return;
+
+    size_t busiest = 0;
+    size_t idlest = 0;
+    for (size_t i = 0; i < _reactors.size(); ++i) {
+        reactorBusy[i] -= lastReactorBusy[i];
+        if (reactorBusy[i] > reactorBusy[busiest])
+            busiest = i;
+        if (reactorBusy[i] < reactorBusy[idlest])
+            idlest = i;
+    }
+    const uint64_t intervalMicros = _options.rebalanceIntervalSecs * 1000 * 1000ULL;
+    //Not worth moving anything unless a reactor has at least a tenth of a thread's worth of work
+    if (reactorBusy[busiest] < intervalMicros / 10 ||
+            reactorBusy[busiest] < 2 * reactorBusy[idlest])
+        return;
+
+    //Only long lived connections, the work of short lived ones ends before a move pays off
+    const auto oldEnough = std::chrono::steady_clock::now() -
+                           std::chrono::seconds(_options.rebalanceIntervalSecs);
+    const uint64_t gap = reactorBusy[busiest] - reactorBusy[idlest];
+    Reactor* const from = _reactors[busiest].get();
+    ConnectionInfo* heaviest = nullptr;
+    uint64_t heaviestBusy = 0;
+    for (auto& conn : conns) {
+        if (conn->reactor() != from || conn->created() > oldEnough)
+            continue;
+        auto last = lastConnectionBusy.find(conn->connectionId());
+        if (last == lastConnectionBusy.end())
+            continue;
+        const uint64_t busy = connectionBusy[conn->connectionId()] - last->second;
+        //Moving more than the gap would only swap which reactor is overloaded
+        if (busy > heaviestBusy && busy < gap) {
+            heaviest = conn.get();
+            heaviestBusy = busy;
         }
-    } catch (std::exception &e) {
-        log() << "Exception running io_service: " << e.what() << std::endl;
-        dbexit( EXIT_UNCAUGHT );
-    } catch (...) {
-        log() << "unknown error running io_service" << std::endl;
-        dbexit( EXIT_UNCAUGHT );
     }
+    if (!heaviest)
+        return;
+    LOG(1) << "rebalancing connection " << heaviest->remote() << " #"
+           << heaviest->connectionId() << " from reactor " << busiest << " ("
+           << reactorBusy[busiest] << "us busy) to reactor " << idlest << " ("
+           << reactorBusy[idlest] << "us busy)";
+    heaviest->requestMove(_reactors[idlest].get());
 }
 
 void NetworkServer::run() {
     //Init waiting on the port
     startAllWaits();
+    if (_options.rebalanceIntervalSecs && _reactors.size() > 1) {
+#ifdef _WIN32
+        warning() << "moving connections between reactors is not supported on Windows";
+#else
+        _rebalanceTimer.reset(new asio::steady_timer(service()));
+        asyncRebalance();
+#endif
+    }
 
-    //Init processing of new connections
-    int threads = _options.threads ? _options.threads : boost::thread::hardware_concurrency() / 4;
+    log() << "asio network server running " << _reactors.size() << " reactor(s)"
+          << (_options.pinReactors ? " pinned to cpus" : "");
+    for (auto& reactor : _reactors)
+        reactor->start();
+    for (auto& reactor : _reactors)
+        reactor->join();
+}
 
-    //Using boost thread as it allows for cross platform stack size reduction
-    boost::thread::attributes attrs;
-    attrs.set_stack_size(NETWORK_DEFAULT_STACK_SIZE);
-    try {
-        for(; threads > 0; --threads)
-            _threads.emplace_back(attrs, [this]{ serviceRun(); });
+void NetworkServer::appendReactorStats(BSONObjBuilder* builder) const {
+    //A connection closing during the sample may be counted twice or not at all, fine for stats
+    std::vector<std::unique_ptr<ConnectionCounters>> reactorTotals;
+    for (auto& reactor : _reactors) {
+        reactorTotals.emplace_back(new ConnectionCounters());
+        reactorTotals.back()->add(reactor->closedTotals());
     }
-    catch (boost::thread_resource_error&) {
-        log() << "can't create new thread for listening, shutting down" << std::endl;
-        fassert(-1, false);
+    for (auto& conn : _connections->snapshot())
+        reactorTotals[conn->reactor()->id()]->add(conn->counters());
+
+    ConnectionCounters totals;
+    {
+        BSONArrayBuilder reactors(builder->subarrayStart("reactors"));
+        for (auto& reactor : _reactors) {
+            BSONObjBuilder r(reactors.subobjStart());
+            r.append("id", reactor->id());
+            r.appendNumber("connections", static_cast<long long>(reactor->connections()));
+            r.appendNumber("busyMicros", static_cast<long long>(reactor->busyMicros()));
+            reactor->bufferPool().appendStats(&r);
+            ConnectionCounters& reactorTotal = *reactorTotals[reactor->id()];
+            BSONObjBuilder t(r.subobjStart("totals"));
+            reactorTotal.append(&t);
+            totals.add(reactorTotal);
+        }
     }
-    catch (...) {
-        log() << "unknown error accepting new socket" << std::endl;
-        dbexit( EXIT_UNCAUGHT );
+    BSONObjBuilder t(builder->subobjStart("totals"));
+    totals.append(&t);
+}
+
+void NetworkServer::stop() {
+    for (auto& i : _endPoints) {
+        asio::error_code ignored;
+        i->_acceptor.close(ignored);
     }
+    _connections->closeAll();
+    for (auto& reactor : _reactors)
+        reactor->stop();
 }
 
 NetworkServer::~NetworkServer() {
-    _service.stop();
-    for (auto& t: _threads)
-        t.join();
+    for (auto& reactor : _reactors)
+        reactor->stop();
+    for (auto& reactor : _reactors)
+        reactor->join();
+}
+
+Connections::Connections(MessageHandler* handler,
+                         int idleTimeoutSecs,
+                         int pipelineDepth) :
+        _handler(handler), _idleTimeoutSecs(idleTimeoutSecs), _pipelineDepth(pipelineDepth) {
 }
 
+void Connections::newConnHandler(asio::ip::tcp::socket&& socket, Reactor* reactor) {
+    if (!Listener::globalTicketHolder.tryAcquire()) {
+        ++networkServerStats.connectionsRejected;
+        log() << "connection refused because too many open connections: "
+              << Listener::globalTicketHolder.used() << std::endl;
+        asio::error_code ignored;
+        socket.close(ignored);
+        return;
+    }
+
+    asio::error_code ignored;
+    socket.set_option(asio::ip::tcp::no_delay(true), ignored);
+    socket.set_option(asio::socket_base::keep_alive(true), ignored);
+
+    const ConnectionId connectionId = Listener::globalConnectionNumber.addAndFetch(1);
+    auto conn = std::make_shared<ConnectionInfo>(this, reactor, std::move(socket), connectionId);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto pos = _conns.emplace(conn.get(), conn);
+        verify(pos.second);
+        (void)pos;
+    }
+    ++networkServerStats.connectionsCreated;
+    ++networkServerStats.connectionsCurrent;
+    if (!serverGlobalParams.quiet) {
+        const int conns = Listener::globalTicketHolder.used();
+        log() << "connection accepted from " << conn->remote() << " #" << connectionId
+              << " (" << conns << (conns == 1 ? " connection" : " connections") << " now open)"
+              << std::endl;
+    }
+    conn->start();
+}
+
+std::vector<std::shared_ptr<ConnectionInfo>> Connections::snapshot() {
+    std::vector<std::shared_ptr<ConnectionInfo>> conns;
+    std::lock_guard<std::mutex> lock(_mutex);
+    conns.reserve(_conns.size());
+    for (auto& i : _conns)
+        conns.push_back(i.second);
+    return conns;
+}
 
-void Connections::newConnHandler(asio::ip::tcp::socket&& socket) {
-    std::unique_ptr<ConnectionInfo> ci(std::move(socket), ++_connectionCount);
-    ConnectionInfo* conn = ci.get();
-    std::unique_lock lock(_mutex);
-    auto pos = _conns.emplace(ci.get(), ci);
-    verify(pos.second);
-    (void)pos;
-    lock.release();
-    conn->asyncReceiveMessage();
+void Connections::remove(ConnectionInfo* conn) {
+    std::shared_ptr<ConnectionInfo> removed;
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _conns.find(conn);
+    verify(it != _conns.end());
+    //Free outside of the lock, if this was the last reference destruction may be non-trivial
+    removed = std::move(it->second);
+    _conns.erase(it);
+}
+
+void Connections::closeAll() {
+    for (auto& conn : snapshot())
+        conn->asyncClose();
+}
+
+namespace {
+    HostAndPort remoteOf(const asio::ip::tcp::socket& socket) {
+        asio::error_code ec;
+        auto endPoint = socket.remote_endpoint(ec);
+        if (ec)
+            return HostAndPort();
+        return HostAndPort(endPoint.address().to_string(), endPoint.port());
+    }
+
+    std::string localAddrOf(const asio::ip::tcp::socket& socket) {
+        asio::error_code ec;
+        auto endPoint = socket.local_endpoint(ec);
+        if (ec)
+            return "";
+        return endPoint.address().to_string();
+    }
+} // namespace
+
+ConnectionInfo::ConnectionInfo(Connections* const owner,
+        Reactor* const reactor,
+        asio::ip::tcp::socket socket,
+        ConnectionId connectionId) :
+    _owner(owner),
+    _reactor(reactor),
+    _socket(std::move(socket)),
+    _strand(new asio::io_service::strand(_socket.get_io_service())),
+    _idleTimer(new asio::steady_timer(_socket.get_io_service())),
+    _connectionId(connectionId),
+    _created(std::chrono::steady_clock::now()),
+    _pipelineDepth(std::max(1, owner->pipelineDepth())),
+    _port(this, connectionId),
+    _remote(remoteOf(_socket)),
+    _localAddr(localAddrOf(_socket)) {
+    reactor->connectionAdded();
+}
+
+ConnectionInfo::~ConnectionInfo() {
+    //The Client may refer to the port, so it goes first
+    _client.reset();
+    reactor()->connectionRemoved(_counters);
+    Listener::globalTicketHolder.release();
+    --networkServerStats.connectionsCurrent;
+    if (!serverGlobalParams.quiet) {
+        const int conns = Listener::globalTicketHolder.used();
+        log() << "end connection " << _remote << " (" << conns
+              << (conns == 1 ? " connection" : " connections") << " now open)" << std::endl;
+    }
+}
+
+HostAndPort ConnectionInfo::remote() const {
+    return _remote;
+}
+
+std::string ConnectionInfo::localAddrString() const {
+    return _localAddr;
+}
+
+void ConnectionInfo::start() {
+    auto self(shared_from_this());
+    _strand->dispatch([this, self] {
+        try {
+            //Creates the Client on this thread, then detach it so any thread can run it
+            _owner->handler()->connected(&_port);
+            _client = Client::releaseCurrent();
+        }
+        catch (const DBException& e) {
+            log() << "DBException setting up connection, closing: " << e << std::endl;
+            if (haveClient())
+                _client = Client::releaseCurrent();
+            asyncSocketShutdownRemove();
+            return;
+        }
+        asyncReceiveMessage();
+    });
+}
+
+void ConnectionInfo::asyncClose() {
+    auto self(shared_from_this());
+    std::unique_ptr<asio::io_service::strand> strand;
+    {
+        //The connection may be moving to another reactor
+        std::lock_guard<std::mutex> lock(_strandMutex);
+        strand.reset(new asio::io_service::strand(*_strand));
+    }
+    strand->dispatch([this, self] {
+        asyncSocketShutdownRemove();
+    });
+}
+
+void ConnectionInfo::requestMove(Reactor* target) {
+    _moveTo = target;
+}
+
+bool ConnectionInfo::moveIfRequested() {
+    //Handlers charge the reactor they were posted from, so none may be running
+    invariant(!_processing);
+    Reactor* const from = reactor();
+    Reactor* const target = _moveTo.exchange(nullptr);
+    if (!target || target == from)
+        return false;
+#ifdef _WIN32
+    //Needs WSADuplicateSocket, the rebalancer isn't started on Windows
+    return false;
+#else
+    //A socket can't change io_service, so the descriptor is duplicated onto a new socket
+    asio::error_code ec;
+    const auto protocol = _socket.local_endpoint(ec).protocol();
+    if (ec)
+        return false;
+    const int fd = ::dup(_socket.native_handle());
+    if (fd < 0) {
+        const int err = errno;
+        LOG(1) << "failed to dup socket to move connection " << _remote << ": "
+               << errnoWithDescription(err);
+        return false;
+    }
+    asio::ip::tcp::socket moved(target->service());
+    moved.assign(protocol, fd, ec);
+    if (ec) {
+        ::close(fd);
+        LOG(1) << "failed to move connection " << _remote << ": " << ec.message();
+        return false;
+    }
+    //Removes the descriptor from the old reactor, the dup keeps the connection open
+    _socket.close(ec);
+    {
+        std::lock_guard<std::mutex> lock(_strandMutex);
+        _socket = std::move(moved);
+        _strand.reset(new asio::io_service::strand(target->service()));
+    }
+    //Nothing is waiting on the timer between requests, a cancelled wait may still be queued
+    _idleTimer.reset(new asio::steady_timer(target->service()));
+    _reactor = target;
+    from->connectionMovedOut();
+    target->connectionAdded();
+    ++networkServerStats.connectionsMoved;
+    LOG(1) << "moved connection " << _remote << " #" << _connectionId << " from reactor "
+           << from->id() << " to reactor " << target->id();
+    return true;
+#endif
 }
 
 void ConnectionInfo::asyncReceiveMessage() {
+    if (_closed)
+        return;
+    //Between requests, with no write in progress, is the only time a connection can move
+    if (!_writing && moveIfRequested()) {
+        auto self(shared_from_this());
+        _strand->post([this, self] {
+            asyncReceiveMessage();
+        });
+        return;
+    }
+    if (pipelined()) {
+        asyncReadAhead();
+        return;
+    }
+    asyncStartIdleTimer();
     asyncGetHeader();
 }
 
+void ConnectionInfo::asyncStartIdleTimer() {
+    _waitingForHeader = true;
+    const int idleTimeoutSecs = _owner->idleTimeoutSecs();
+    if (!idleTimeoutSecs)
+        return;
+    auto self(shared_from_this());
+    _idleTimer->expires_from_now(std::chrono::seconds(idleTimeoutSecs));
+    _idleTimer->async_wait(_strand->wrap([this, self](std::error_code ec) {
+        //The header may have been queued on the strand ahead of us
+        if (ec || !_waitingForHeader || _closed)
+            return;
+        ++networkServerStats.idleTimeouts;
+        LOG(1) << "closing idle connection " << _remote << " #" << _connectionId;
+        asyncSocketShutdownRemove();
+    }));
+}
+
 void ConnectionInfo::asyncGetHeader() {
     static_assert(NETWORK_MIN_MESSAGE_SIZE > HEADERSIZE, "Min alloc must be > message header size");
-    //TODO: capture average message size and use that if > min
-    _buf.clear();
-    _buf.resize(NETWORK_MIN_MESSAGE_SIZE);
-    _socket.async_receive(asio::buffer(_buf.data(), HEADERSIZE),
-            [this](std::error_code ec, size_t len) {
-        _bytesIn += len;
-        if (ec) {
-            asyncSocketError(ec);
+    //Only the length is read first, like MessagingPort::recv, the endian probe is nothing but a
+    //length.  A buffer is only checked out once the size is known
+    auto self(shared_from_this());
+    asio::async_read(_socket, asio::buffer(_header.view().view2ptr(), sizeof(int32_t)),
+            _strand->wrap([this, self](std::error_code ec, size_t len) {
+        _waitingForHeader = false;
+        _counters.increment(ConnectionCounters::kBytesIn, len);
+        if (_closed)
             return;
-        }
-        if (len != HEADERSIZE) {
-            log() << "Error, invalid header size received: " << len << std::endl;
-            asyncSocketShutdownRemove(conn);
+        if (ec) {
+            asyncSocketError("header", ec);
             return;
         }
-        asyncGetMessage(conn);
-    });
+        asio::error_code ignored;
+        _idleTimer->cancel(ignored);
+        asyncGetMessage();
+    }));
 }
 
-void ConnectionInfo::asyncGetMessage() {
-    const auto msgSize = getMsgData().getLen();
-    //Forcing into the nearest 1024 size block.  Assuming this was to always hit a tcmalloc size?
-    _buf.resize((msgSize + NETWORK_MIN_MESSAGE_SIZE - 1) & 0xfffffc00);
-    //Message size may be -1 to check endian?  Not sure if that is current spec
-    fassert(-1, msgSize >= 0);
-    if ( static_cast<size_t>(msgSize) < HEADERSIZE ||
+bool ConnectionInfo::replyToProbe(int msgSize) {
+    if (msgSize == 542393671) {
+        // an http GET
+        std::string msg = "It looks like you are trying to access MongoDB over HTTP on the "
+                "native driver port.\n";
+        LOG(1) << msg;
+        std::stringstream ss;
+        ss << "HTTP/1.0 200 OK\r\nConnection: close\r\nContent-Type: text/plain\r\n"
+                "Content-Length: " << msg.size() << "\r\n\r\n" << msg;
+        std::string s = ss.str();
+        queueCopy(s.c_str(), s.size());
+        closeOnComplete();
+        return true;
+    }
+    if (msgSize == -1) {
+        // Endian check from the client, after connecting, to see what mode server is running in.
+        unsigned foo = 0x10203040;
+        queueCopy(reinterpret_cast<const char*>(&foo), sizeof(foo));
+        return true;
+    }
+    return false;
+}
+
+bool ConnectionInfo::validMessageSize(int msgSize) {
+    if ( msgSize < static_cast<int>(HEADERSIZE) ||
          static_cast<size_t>(msgSize) > MaxMessageSizeBytes ) {
-        LOG(0) << "recv(): message len " << len << " is invalid. "
+        LOG(0) << "recv(): message len " << msgSize << " is invalid. "
                << "Min " << HEADERSIZE << " Max: " << MaxMessageSizeBytes;
+        return false;
+    }
+    return true;
+}
+
+void ConnectionInfo::asyncGetMessage() {
+    const int msgSize = _header.constView().getMessageLength();
+    if (replyToProbe(msgSize)) {
+        takeHandlerReplies();
+        asyncFlushReplies();
+        return;
+    }
+    if (!validMessageSize(msgSize)) {
         //TODO: can we return an error on the socket to the client?
-        asyncSocketShutdownRemove(conn);
+        asyncSocketShutdownRemove();
+        return;
     }
-    _socket.async_receive(asio::buffer(_buf.data() + HEADERSIZE, msgSize - HEADERSIZE),
-            [this](std::error_code ec, size_t len) {
-        _bytesIn += len;
+    //Size classed, so steady state traffic recycles the same few buffers
+    _buf = reactor()->bufferPool().get(msgSize);
+    memcpy(_buf.data(), _header.view().view2ptr(), sizeof(int32_t));
+    //The rest of the header comes with the body
+    auto self(shared_from_this());
+    asio::async_read(_socket,
+            asio::buffer(_buf.data() + sizeof(int32_t), msgSize - sizeof(int32_t)),
+            _strand->wrap([this, self](std::error_code ec, size_t len) {
+        _counters.increment(ConnectionCounters::kBytesIn, len);
+        if (_closed)
+            return;
         if (ec) {
-            asyncSocketError(ec);
+            asyncSocketError("message body", ec);
             return;
         }
-        if (len != HEADERSIZE) {
-            log() << "Error, invalid header size received: " << len << std::endl;
-            asyncSocketShutdownRemove(conn);
-            return;
+        asyncProcessMessage();
+    }));
+}
+
+void ConnectionInfo::asyncProcessMessage() {
+    _processing = true;
+    //Read on the strand, the connection can't move until the handler is done
+    Reactor* const reactor = this->reactor();
+    auto self(shared_from_this());
+    reactor->workers().service().post([this, self, reactor] {
+        {
+            //Message doesn't own _buf, it goes back to the pool once processing is done
+            Message m(_buf.data(), false);
+            Client::setCurrent(std::move(_client));
+            ScopeGuard releaseClient = MakeGuard([this] {
+                _client = Client::releaseCurrent();
+            });
+            setThreadName(cc().desc().c_str());
+            processMessage(m, reactor);
         }
-        asyncQueueMessage(conn);
+        _strand->post([this, self] {
+            asyncProcessMessageComplete();
+        });
     });
 }
 
-void ConnectionInfo::asyncQueueMessage() {
+void ConnectionInfo::asyncProcessMessageComplete() {
+    _processing = false;
+    _buf.release();
+    takeHandlerReplies();
+    if (_closed)
+        return;
 
+    //If a reply was queued, the send completion continues the loop
+    if (!_pendingReplies.empty()) {
+        asyncFlushReplies();
+        return;
+    }
+    doClose() ? asyncSocketShutdownRemove() : asyncReceiveMessage();
 }
 
-void ConnectionInfo::asyncSocketError(std::error_code ec) {
-    fassert(-1, ec != 0);
-    log() << "Error waiting for header " << ec << std::endl;
-    asyncSocketShutdownRemove(conn);
+void ConnectionInfo::takeHandlerReplies() {
+    for (auto& reply : _handlerReplies)
+        _pendingReplies.push_back(std::move(reply));
+    _handlerReplies.clear();
 }
 
-void ConnectionInfo::asyncSocketShutdownRemove() {
-    _socket.shutdown(asio::socket_base::shutdown_type::shutdown_both);
-    _socket.close();
-    //Now that the socket's work is done, post to the async work queue to remove it
-    _socket.get_io_service().post([this]{
-        std::unique_lock lock(_owner->_mutex);
-        verify(_owner->_conns.erase(this));
-        lock.release();
+void ConnectionInfo::processMessage(Message& m, Reactor* reactor) {
+    ++networkServerStats.messagesIn;
+    networkCounter.hit(m.header().getLen(), 0);
+    _counters.countRequest(m);
+    //Time spent on a reactor's workers is what the rebalancer evens out between reactors, a
+    //connection that moves takes its handlers to the workers of its new reactor
+    Timer busy;
+    ON_BLOCK_EXIT([this, reactor, &busy] {
+        const long long micros = busy.micros();
+        _busyMicros += micros;
+        reactor->addBusyMicros(micros);
     });
+    try {
+        _owner->handler()->process(m, &_port);
+    }
+    catch (const AssertionException& e) {
+        ++networkServerStats.processingErrors;
+        log() << "AssertionException handling request, closing client connection: " << e
+              << std::endl;
+        closeOnComplete();
+    }
+    catch (const DBException& e) {
+        ++networkServerStats.processingErrors;
+        log() << "DBException handling request, closing client connection: " << e
+              << std::endl;
+        closeOnComplete();
+    }
+    catch (std::exception &e) {
+        error() << "Uncaught std::exception: " << e.what() << ", terminating" << std::endl;
+        dbexit( EXIT_UNCAUGHT );
+    }
 }
 
-/*
- *
-//Ensure allocation is a multiple of 1024 and large enough
-//Taken from the other networking code in case there are any hidden assumpitons
-//Not sure I see the propose given that there are other non-aligned allocs so
-int z = (len+1023)&0xfffffc00;
+void ConnectionInfo::asyncReadAhead() {
+    if (!_readAhead)
+        _readAhead = reactor()->bufferPool().get(NETWORK_READ_AHEAD_SIZE);
+    asyncStartIdleTimer();
+    auto self(shared_from_this());
+    _socket.async_read_some(asio::buffer(_readAhead.data() + _readEnd,
+                                         _readAhead.capacity() - _readEnd),
+            _strand->wrap([this, self](std::error_code ec, size_t len) {
+        _waitingForHeader = false;
+        _counters.increment(ConnectionCounters::kBytesIn, len);
+        if (_closed)
+            return;
+        if (ec) {
+            asyncSocketError("read ahead", ec);
+            return;
+        }
+        asio::error_code ignored;
+        _idleTimer->cancel(ignored);
+        _readEnd += len;
+        asyncProcessReadAhead();
+    }));
+}
 
-MONGO_ALIGN_TO_CACHE struct ConnStats {
+void ConnectionInfo::asyncProcessReadAhead() {
+    _processing = true;
+    //Writes only ever complete while the worker runs, so this can only overcount
+    const size_t repliesInFlight = _pendingReplies.size() + _writingReplies.size();
+    //Read on the strand, the connection can't move until the handlers are done
+    Reactor* const reactor = this->reactor();
+    auto self(shared_from_this());
+    reactor->workers().service().post([this, self, repliesInFlight, reactor] {
+        const bool valid = processReadAhead(repliesInFlight, reactor);
+        _strand->post([this, self, valid] {
+            asyncProcessReadAheadComplete(valid);
+        });
+    });
+}
 
-};
+bool ConnectionInfo::processReadAhead(size_t repliesInFlight, Reactor* reactor) {
+    //Requests run in the order they arrived and one at a time, same as on a serial connection,
+    //so writes and getLastError see the same ordering.  Only the reading and replying overlap
+    Client::setCurrent(std::move(_client));
+    ScopeGuard releaseClient = MakeGuard([this] {
+        _client = Client::releaseCurrent();
+    });
+    setThreadName(cc().desc().c_str());
+    while (!doClose()) {
+        if (repliesInFlight + _handlerReplies.size() >= _pipelineDepth) {
+            //The client isn't draining replies, stop reading until a write completes
+            ++networkServerStats.pipelinePauses;
+            _readPaused = true;
+            break;
+        }
+        const size_t available = _readEnd - _readStart;
+        if (available < sizeof(int32_t))
+            break;
+        char* data = _readAhead.data() + _readStart;
+        const int msgSize = MSGHEADER::ConstView(data).getMessageLength();
+        if (replyToProbe(msgSize)) {
+            _readStart += sizeof(int32_t);
+            continue;
+        }
+        if (!validMessageSize(msgSize))
+            return false;
+        if (available < static_cast<size_t>(msgSize))
+            break;
+        _readStart += msgSize;
+        //The message is backed by the read ahead buffer, nothing is copied out of it
+        Message m(data, false);
+        processMessage(m, reactor);
+    }
+    return true;
+}
 
-    try {
+void ConnectionInfo::asyncProcessReadAheadComplete(bool valid) {
+    _processing = false;
+    takeHandlerReplies();
+    if (_closed)
+        return;
+    if (!valid) {
+        asyncSocketShutdownRemove();
+        return;
+    }
+    //Everything answered from this read goes out in one gathered write
+    asyncFlushReplies();
+    if (doClose()) {
+        if (!_writing)
+            asyncSocketShutdownRemove();
+        return;
+    }
+    if (_readPaused) {
+        //Any write that would have resumed us completed while the worker ran
+        if (_writing)
+            return;
+        _readPaused = false;
+        asyncProcessReadAhead();
+        return;
+    }
+    prepareReadAhead();
+    asyncReceiveMessage();
+}
 
+void ConnectionInfo::prepareReadAhead() {
+    const size_t available = _readEnd - _readStart;
+    size_t needed = NETWORK_READ_AHEAD_SIZE;
+    //asyncProcessReadAhead has validated the length of a partial message
+    if (available >= sizeof(int32_t)) {
+        const int msgSize = MSGHEADER::ConstView(_readAhead.data() + _readStart).getMessageLength();
+        needed = std::max(needed, static_cast<size_t>(msgSize));
     }
-    catch ( AssertionException& e ) {
-        log() << "AssertionException handling request, closing client connection: " << e << std::endl;
-        portWithHandler->shutdown();
+    if (needed > _readAhead.capacity() ||
+            (!available && _readAhead.capacity() > NETWORK_READ_AHEAD_SIZE)) {
+        //Grow to fit a large message, or go back to the usual size once it's been handled
+        MessageBuffer next = reactor()->bufferPool().get(needed);
+        memcpy(next.data(), _readAhead.data() + _readStart, available);
+        _readAhead = std::move(next);
     }
-    catch ( SocketException& e ) {
-        log() << "SocketException handling request, closing client connection: " << e << std::endl;
-        portWithHandler->shutdown();
+    else if (_readStart) {
+        //Only ever the tail of one message
+        memmove(_readAhead.data(), _readAhead.data() + _readStart, available);
     }
-    catch ( const DBException& e ) { // must be right above std::exception to avoid catching subclasses
-        log() << "DBException handling request, closing client connection: " << e << std::endl;
-        portWithHandler->shutdown();
+    _readStart = 0;
+    _readEnd = available;
+}
+
+void ConnectionInfo::asyncSendMessage(Message& toSend) {
+    //Without pipelining a request is answered before the next one is read
+    verify(pipelined() || (!_writing && _pendingReplies.empty() && _handlerReplies.empty()));
+    ++networkServerStats.messagesOut;
+    if (toSend.doIFreeIt()) {
+        //Take the buffers, they are gathered straight onto the socket and freed on completion
+        PendingReply reply;
+        reply.message = std::move(toSend);
+        _handlerReplies.push_back(std::move(reply));
+        return;
     }
-    catch ( std::exception &e ) {
-        error() << "Uncaught std::exception: " << e.what() << ", terminating" << std::endl;
-        dbexit( EXIT_UNCAUGHT );
+    //Nothing guarantees buffers we don't own outlive the send, so these are copied
+    if (toSend.isSingleData()) {
+        queueCopy(toSend.singleData().view2ptr(), toSend.header().getLen());
+        return;
     }
-    if ( len == 542393671 ) {
-        // an http GET
-        string msg = "It looks like you are trying to access MongoDB over HTTP on the native driver port.\n";
-        LOG( psock->getLogLevel() ) << msg;
-        std::stringstream ss;
-        ss << "HTTP/1.0 200 OK\r\nConnection: close\r\nContent-Type: text/plain\r\nContent-Length: " << msg.size() << "\r\n\r\n" << msg;
-        string s = ss.str();
-        send( s.c_str(), s.size(), "http" );
-        return false;
+    PendingReply reply;
+    reply.copyLen = toSend.size();
+    reply.copy = reactor()->bufferPool().get(reply.copyLen);
+    char* pos = reply.copy.data();
+    for (auto& i : toSend.multiData()) {
+        memcpy(pos, i.first, i.second);
+        pos += i.second;
     }
-    else if ( len == -1 ) {
-        // Endian check from the client, after connecting, to see what mode server is running in.
-        unsigned foo = 0x10203040;
-        send( (char *) &foo, 4, "endian" );
-        psock->setHandshakeReceived();
-        goto again;
+    _handlerReplies.push_back(std::move(reply));
+}
+
+void ConnectionInfo::queueCopy(const char* data, size_t len) {
+    PendingReply reply;
+    reply.copyLen = len;
+    reply.copy = reactor()->bufferPool().get(len);
+    memcpy(reply.copy.data(), data, len);
+    _handlerReplies.push_back(std::move(reply));
+}
+
+void ConnectionInfo::asyncFlushReplies() {
+    //One write at a time, whatever is queued meanwhile goes out when it completes
+    if (_writing || _pendingReplies.empty())
+        return;
+    _writing = true;
+    _writingReplies.swap(_pendingReplies);
+    //These keep their capacity between writes, so building the sequence doesn't allocate
+    _sendBuffers.clear();
+    for (auto& reply : _writingReplies) {
+        if (reply.copy)
+            _sendBuffers.emplace_back(reply.copy.data(), reply.copyLen);
+        else if (reply.message.isSingleData())
+            _sendBuffers.emplace_back(reply.message.singleData().view2ptr(),
+                                      reply.message.header().getLen());
+        else {
+            for (auto& i : reply.message.multiData())
+                _sendBuffers.emplace_back(i.first, i.second);
+        }
     }
- */
+    if (_writingReplies.size() > 1)
+        networkServerStats.coalescedReplies += _writingReplies.size();
+    auto self(shared_from_this());
+    asio::async_write(_socket, _sendBuffers,
+            _strand->wrap([this, self](std::error_code ec, size_t len) {
+        _writing = false;
+        _writingReplies.clear();
+        _counters.increment(ConnectionCounters::kBytesOut, len);
+        networkCounter.hit(0, len);
+        if (_closed)
+            return;
+        if (ec) {
+            asyncSocketError("send", ec);
+            return;
+        }
+        asyncWriteComplete();
+    }));
+}
+
+void ConnectionInfo::asyncWriteComplete() {
+    if (!pipelined()) {
+        doClose() ? asyncSocketShutdownRemove() : asyncReceiveMessage();
+        return;
+    }
+    //A read is outstanding unless processing was paused for this write, or a worker is running
+    //requests and picks up from here once it's done
+    asyncFlushReplies();
+    if (_processing)
+        return;
+    if (_readPaused) {
+        _readPaused = false;
+        asyncProcessReadAhead();
+    }
+    else if (doClose() && !_writing) {
+        asyncSocketShutdownRemove();
+    }
+}
+
+void ConnectionInfo::asyncSocketError(const char* context, std::error_code ec) {
+    invariant(ec);
+    //A closed connection is the normal way for a client to go away
+    if (ec != asio::error::eof && ec != asio::error::connection_reset) {
+        ++networkServerStats.socketErrors;
+        LOG(1) << "Socket error during " << context << " for " << _remote << ": " << ec.message();
+    }
+    asyncSocketShutdownRemove();
+}
+
+void ConnectionInfo::asyncSocketShutdownRemove() {
+    if (_closed)
+        return;
+    _closed = true;
+    asio::error_code ignored;
+    _idleTimer->cancel(ignored);
+    _socket.shutdown(asio::socket_base::shutdown_type::shutdown_both, ignored);
+    _socket.close(ignored);
+    //Outstanding handlers hold a reference, the connection is freed once they drain
+    _owner->remove(this);
+}
+
+AsyncMessageServer::AsyncMessageServer(const NetworkOptions& options, MessageHandler* handler) :
+        Listener("", options.ipList, options.port),
+        _connections(handler, options.idleTimeoutSecs, options.pipelineDepth),
+        _server(options, &_connections),
+        _timeTracker(_server.service()) {
+}
+
+void AsyncMessageServer::setupSockets() {
+    _setupSocketsSuccessful = _server.setupSockets();
+}
+
+void AsyncMessageServer::asyncTrackTime() {
+    //Listener::initAndListen keeps this moving from its select loop, do the same off a timer
+    _timeTracker.expires_from_now(std::chrono::milliseconds(10));
+    _timeTracker.async_wait([this](std::error_code ec) {
+        if (ec)
+            return;
+        addElapsedTimeMillis(10);
+        asyncTrackTime();
+    });
+}
+
+void AsyncMessageServer::run() {
+    if (!_setupSocketsSuccessful)
+        return;
+    runningServer = &_server;
+    asyncTrackTime();
+    _server.run();
+}
+
+MessageServer* createAsyncServer(const NetworkOptions& options, MessageHandler* handler) {
+    return new AsyncMessageServer(options, handler);
+}
 
 } /* namespace network */
 } /* namespace mongo */
@@ -12,12 +12,30 @@
 #include <array>
 #include <asio/include/asio.hpp>
 #include <atomic>
-#include <tuple>
-#include <vector>
+#include <boost/thread/thread.hpp>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/string_data.h"
+#include "mongo/db/client.h"
+#include "mongo/db/service_context.h"
+#include "mongo/util/net/async_messaging_port.h"
+#include "mongo/util/net/hostandport.h"
+#include "mongo/util/net/listen.h"
+#include "mongo/util/net/message.h"
+#include "mongo/util/net/message_server.h"
+#include "mongo/util/net/network_buffer_pool.h"
 
 
 namespace mongo {
+
+class BSONObjBuilder;
+
 namespace network {
 
 /*
@@ -28,9 +46,8 @@ namespace network {
  * We really need a _simple_ buffer type (that other buffers can then derive from)
  *
  * afaict asio leaves state info behind, so it has problems scaling
- * to move socket's io_servce have to get the native socket handle,
- * duplicate the native socket handle, assign the handle to a new socket and io_servicet
- * unistd.h int dup(int old fd); WSADuplicateSocket();
+ * Moving a connection between reactors dups the native handle onto a socket on the new
+ * io_service, see ConnectionInfo::moveIfRequested.  Windows would need WSADuplicateSocket()
  *
  * jemalloc arenas
  *
@@ -41,134 +58,250 @@ namespace network {
 using BufferSet = std::vector< std::pair<char*, int>>;
 const auto HEADERSIZE = size_t(sizeof(MSGHEADER::Value));
 class Connections;
+class Reactor;
+
+const size_t NETWORK_DEFAULT_STACK_SIZE = 1024 * 1024;
+//Pipelined connections read into a buffer this size, larger messages grow it temporarily
+const size_t NETWORK_READ_AHEAD_SIZE = 16 * 1024;
+
+/*
+ * Server wide counters for the async network server, reported in serverStatus.asyncNetwork
+ * Connection counts are also kept in Listener::globalTicketHolder so serverStatus.connections
+ * is comparable between the legacy and the async server
+ */
+struct MONGO_ALIGN_TO_CACHE NetworkServerStats {
+    std::atomic<uint64_t> connectionsCurrent{};
+    std::atomic<uint64_t> connectionsCreated{};
+    std::atomic<uint64_t> connectionsRejected{};
+    std::atomic<uint64_t> idleTimeouts{};
+    std::atomic<uint64_t> messagesIn{};
+    std::atomic<uint64_t> messagesOut{};
+    std::atomic<uint64_t> processingErrors{};
+    std::atomic<uint64_t> socketErrors{};
+    //Replies that shared a write with at least one other reply
+    std::atomic<uint64_t> coalescedReplies{};
+    //Times a pipelined connection stopped reading because its replies weren't being drained
+    std::atomic<uint64_t> pipelinePauses{};
+    //Connections the rebalancer moved to another reactor
+    std::atomic<uint64_t> connectionsMoved{};
+
+    void append(BSONObjBuilder* builder) const;
+};
+extern NetworkServerStats networkServerStats;
+
+/*
+ * Request and byte counts for a connection, exactly one cache line
+ * Only the connection's strand writes them, so relaxed increments are enough, readers sample
+ * them while the connection runs.  The same type holds the per reactor totals of closed
+ * connections and the sums built when sampling
+ */
+class MONGO_ALIGN_TO_CACHE ConnectionCounters {
+    MONGO_DISALLOW_COPYING(ConnectionCounters);
+public:
+    enum Counter {
+        kBytesIn,
+        kBytesOut,
+        kQueries,
+        kGetMores,
+        kInserts,
+        kUpdates,
+        kDeletes,
+        kCommands,
+        kNumCounters
+    };
+    static const char* const kNames[kNumCounters];
+
+    ConnectionCounters() = default;
+
+    void increment(Counter counter, uint64_t n = 1) {
+        _counts[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t get(Counter counter) const {
+        return _counts[counter].load(std::memory_order_relaxed);
+    }
+    void add(const ConnectionCounters& other);
+
+    /*
+     * Counts the request by its opcode, queries on a $cmd namespace are commands
+     */
+    void countRequest(const Message& m);
+
+    void append(BSONObjBuilder* builder) const;
+
+    //Returns kNumCounters if name isn't a counter
+    static Counter fromName(StringData name);
+
+private:
+    std::array<std::atomic<uint64_t>, kNumCounters> _counts{};
+};
+
 /*
  * Functions starting with async return immediately after queueing work
- * _socket is *not* cleaned up properly for the OS, the holder does this
+ * All async handlers for a connection run on _strand, so they never execute concurrently
+ * Message handlers may block, on locks or on shard i/o, so they run on the reactor's workers
+ * rather than on an io_service thread, and post back to the strand once done.  Nothing reads or
+ * writes the socket while they run, and the replies they queue are only handed to the strand
+ * afterwards
+ * Handlers hold a shared_ptr to the connection, so removing it from Connections only frees it
+ * once the last outstanding handler is done
+ *
+ * By default a connection reads one message, runs it and writes the reply before reading again
+ * With a pipeline depth > 1 it reads ahead into a buffer while replies are written, runs every
+ * complete message in it in order, and gathers all of their replies into a single write
+ * Requests are still run one at a time in the order received, so ordering of writes and
+ * getLastError is the same as without pipelining
  *
  * Do not make virtual, counting cache lines for counters
  */
-MONGO_ALIGN_TO_CACHE class ConnectionInfo {
+class MONGO_ALIGN_TO_CACHE ConnectionInfo : public std::enable_shared_from_this<ConnectionInfo> {
     MONGO_DISALLOW_COPYING(ConnectionInfo);
 public:
     ConnectionInfo(Connections* const owner,
+            Reactor* const reactor,
             asio::ip::tcp::socket socket,
-            ConnectionId connectionId) :
-        _owner(owner),
-        _socket(std::move(socket)),
-        _connectionId(std::move(connectionId)),
-        _buf(0)
-    { }
-
-    MsgData::View& getMsgData() {
-        verify(_buf.data());
-        return reinterpret_cast<MsgData::View&>(*_buf.data());
-    }
+            ConnectionId connectionId);
+    ~ConnectionInfo();
 
-    void closeOnComplete() { _closeOnComplete = true; }
-    void asyncReceiveMessage();
-    void setLastError();
-    //TODO: type checking of handler function
-    //Data should be small, i.e. a pointer or number
-    template <typename Buffer, typename Callback, typename Data>
-    void asyncSendMessage(Buffer&& buffer,
-            Data data = nullptr,
-            Callback callback = [] (ConnectionInfo, size_t, std::error_code, Data) {}) {
-        //We have no guarantee the sender persists
-        //TODO: revisit this and see what assumptions are possible about existence
-        _socket.async_send(std::forward<Buffer>(buffer),
-                [this, data, callback](std::error_code ec, size_t len) {
-            _bytesOut += len;
-            callback(this, len, ec, data);
-            if (ec) {
-                asyncSocketError(ec);
-                return;
-            }
-            if (len != HEADERSIZE) {
-                log() << "Error, invalid header size received: " << len << std::endl;
-                asyncSocketShutdownRemove(conn);
-                return;
-            }
-            doClose() ? asyncSocketShutdownRemove() : asyncReceiveMessage();
-        });
-    }
+    ConnectionId connectionId() const { return _connectionId; }
+    Reactor* reactor() const { return _reactor.load(); }
+    std::chrono::steady_clock::time_point created() const { return _created; }
+    //Time spent running this connection's requests
+    uint64_t busyMicros() const { return _busyMicros; }
+    uint64_t bytesIn() const { return _counters.get(ConnectionCounters::kBytesIn); }
+    uint64_t bytesOut() const { return _counters.get(ConnectionCounters::kBytesOut); }
+    const ConnectionCounters& counters() const { return _counters; }
 
-    //For single data Message
-    template <typename Callback, typename Data>
-    void asyncSendMessage(const char* const buf, const size_t size,
-            Data data = nullptr,
-            Callback callback = [] (ConnectionInfo, size_t, std::error_code, Data) {}) {
-        //We have no guarantee the sender persists
-        //TODO: revisit this and see what assumptions are possible about existence, need to copy header regardless
-        _buf.clear();
-        _buf.resize(size);
-        memcpy(_buf.data(), buf, size);
-        asyncSendMessage(asio::const_buffer(_buf.data(), size), data, callback);
-    }
+    /*
+     * Runs MessageHandler::connected to create the Client then starts the receive loop
+     */
+    void start();
+    void closeOnComplete() { _closeOnComplete = true; }
+    /*
+     * Queues a reply, only valid from inside MessageHandler::process for this connection
+     * If toSend owns its buffers they are moved out of it and written with a gathered send,
+     * leaving toSend empty.  Otherwise the data is copied so the caller may free it on return
+     * The reply is written once processing of the current batch of requests is done
+     */
+    void asyncSendMessage(Message& toSend);
+    /*
+     * Thread safe, shuts the socket down from the connection's strand
+     */
+    void asyncClose();
+    /*
+     * Thread safe, the connection moves to target the next time it is between requests
+     */
+    void requestMove(Reactor* target);
 
-    //For multi data Message
-    template <typename Callback, typename Data>
-    void asyncSendMessage(const char* const buf, const size_t size,
-            BufferSet* buffers,
-            Data data = nullptr,
-            Callback callback = [] (ConnectionInfo, size_t, std::error_code, Data) {}) {
-        //We have no guarantee the sender persists
-        //TODO: revisit this and see what assumptions are possible about existence
-        //Copy the header into _buf, need to do this regardless so we have the info
-        _buf.clear();
-        _buf.resize(HEADERSIZE);
-        memcpy(_buf.data(), buf, HEADERSIZE);
-        _buffers = std::move(*buffers);
-        std::vector<asio::const_buffer> ioBuf;
-        ioBuf.emplace_back(_buf.data(), HEADERSIZE);
-        for (auto& i: _buffers) {
-            ioBuf.emplace_back(i.first, i.second);
-        }
-        asyncSendMessage(ioBuf, data, callback);
-    }
+    HostAndPort remote() const;
+    std::string localAddrString() const;
 
 private:
+    void asyncReceiveMessage();
     void asyncGetHeader();
     void asyncGetMessage();
-    void asyncQueueMessage();
-    void asyncSocketError(std::error_code ec);
+    void asyncProcessMessage();
+    void asyncProcessMessageComplete();
+    //Runs on a worker of reactor, which is charged for the time taken
+    void processMessage(Message& m, Reactor* reactor);
+    //Replies to the http and endian probes, returns false if msgSize is a regular length
+    bool replyToProbe(int msgSize);
+    bool validMessageSize(int msgSize);
+    void asyncReadAhead();
+    void asyncProcessReadAhead();
+    //Runs the complete messages in the read ahead buffer, on a worker of reactor.  Returns false
+    //if one had an invalid length
+    bool processReadAhead(size_t repliesInFlight, Reactor* reactor);
+    void asyncProcessReadAheadComplete(bool valid);
+    //Moves the replies queued by the message handlers to those waiting for a write
+    void takeHandlerReplies();
+    //Moves a partial message to the front of the read ahead buffer, making room for all of it
+    void prepareReadAhead();
+    void queueCopy(const char* data, size_t len);
+    void asyncFlushReplies();
+    void asyncWriteComplete();
+    //Moves the socket, strand and timer to the requested reactor, only between requests
+    bool moveIfRequested();
+    void asyncStartIdleTimer();
+    void asyncSocketError(const char* context, std::error_code ec);
     void asyncSocketShutdownRemove();
     bool doClose() { return _closeOnComplete; }
+    bool pipelined() const { return _pipelineDepth > 1; }
+
+    //Either a Message whose buffers were taken, or a copy in a pooled buffer
+    struct PendingReply {
+        Message message;
+        MessageBuffer copy;
+        size_t copyLen{};
+    };
 
     //A cache line is 64 bytes, or 8x8 byte numbers
-    std::atomic<uint64_t> _bytesIn{};
-    std::atomic<uint64_t> _bytesOut{};
-    std::atomic<uint64_t> _queries{};
-    std::atomic<uint64_t> _inserts{};
-    std::atomic<uint64_t> _updates{};
-    std::atomic<uint64_t> _deletes{};
-    std::atomic<uint64_t> _commands{};
-    std::atomic<uint64_t> _dummy{}; //one cache line left for counters
-    //pos 8, place for one more counter
-    asio::ip::tcp::socket _socket;
-    ConnectionId _connectionId;
+    ConnectionCounters _counters;
     Connections* const _owner;
-    //TODO: Might have to turn this into a char*, currently trying to back Message with _freeIt = false
-    std::vector _buf;
-    BufferSet _buffers;
-    //TODO: Add last error saving
+    //All of these change when the connection moves to another reactor
+    std::atomic<Reactor*> _reactor;
+    asio::ip::tcp::socket _socket;
+    std::unique_ptr<asio::io_service::strand> _strand;
+    std::unique_ptr<asio::steady_timer> _idleTimer;
+    //Held to replace _strand, and by other threads to read it
+    std::mutex _strandMutex;
+    std::atomic<Reactor*> _moveTo{};
+    const ConnectionId _connectionId;
+    const std::chrono::steady_clock::time_point _created;
+    std::atomic<uint64_t> _busyMicros{};
+    const size_t _pipelineDepth;
+    AsyncMessagingPort _port;
+    //Declared after _port, the Client holds a pointer to it
+    ServiceContext::UniqueClient _client;
+    MSGHEADER::Value _header;
+    //Checked out of the reactor's pool, backs the Message with _freeIt = false
+    MessageBuffer _buf;
+    //Pipelined connections only, [_readStart, _readEnd) has been read but not processed
+    MessageBuffer _readAhead;
+    size_t _readStart{};
+    size_t _readEnd{};
+    //Replies queued while messages are processed, only touched by whoever runs the handlers
+    std::vector<PendingReply> _handlerReplies;
+    //Replies waiting for the write in progress, and the replies in it
+    std::vector<PendingReply> _pendingReplies;
+    std::vector<PendingReply> _writingReplies;
+    std::vector<asio::const_buffer> _sendBuffers;
+    const HostAndPort _remote;
+    //Taken once, handlers ask for it while the socket may be moving to another reactor
+    const std::string _localAddr;
     //TODO: Turn this into state and verify it's correct at all stages
+    bool _writing{};
+    //A worker is running this connection's requests
+    bool _processing{};
+    bool _readPaused{};
+    bool _waitingForHeader{};
+    bool _closed{};
     std::atomic<bool> _closeOnComplete{};
 };
 
-class ListenerPool {
-    uint64_t connectionCount;
-};
-
-//If this changes the mask for allocation needs to change too
-const size_t NETWORK_MIN_MESSAGE_SIZE = 1024;
-const size_t NETWORK_DEFAULT_STACK_SIZE = 1024 * 1024;
 /*
  * Options for a network server
  */
 struct NetworkOptions {
+    enum class Balancing { roundRobin, leastConnections };
+
     std::string ipList;
-    int port;
+    int port{};
+    //io_service threads over all reactors, 0 is pick based on the number of cores
     int threads{};
+    //Number of io_services, each with its own threads, 0 is one per core
+    int reactors{1};
+    //Threads running message handlers over all reactors, 0 is pick based on the number of cores
+    int workerThreads{};
+    //Pin each reactor's threads to one cpu, reactor n goes on cpu n % cores
+    bool pinReactors{};
+    //How accepted sockets are spread over the reactors
+    Balancing balancing{Balancing::roundRobin};
+    //Close connections that haven't sent a message in this long, 0 disables
+    int idleTimeoutSecs{};
+    //Requests per connection that may be read ahead of their replies being written, 1 disables
+    int pipelineDepth{1};
+    //How often to check for reactors doing much more work than others, 0 disables
+    int rebalanceIntervalSecs{};
 };
 
 class Server {
@@ -178,19 +311,93 @@ public:
     virtual void run() = 0;
 };
 
+/*
+ * An io_service and the threads running it
+ * A socket is tied to the io_service it was created on, so all of a connection's handlers run
+ * on the reactor it was accepted to.  Each reactor has its own io_service lock, rather than
+ * every handler in the process going through one
+ * The message handlers of its connections run on its workers, a second io_service with its own
+ * threads, so that dispatching requests is also split over the reactors
+ */
+class Reactor {
+    MONGO_DISALLOW_COPYING(Reactor);
+public:
+    //cpu < 0 means don't pin, workerThreads 0 means no workers
+    Reactor(int id, int threads, int cpu, int workerThreads = 0,
+            std::string threadName = "network");
+
+    void start();
+    void join();
+    void stop();
+
+    int id() const { return _id; }
+    asio::io_service& service() { return _service; }
+    //Runs the message handlers of this reactor's connections
+    Reactor& workers() { return *_workers; }
+    MessageBufferPool& bufferPool() { return _bufferPool; }
+
+    uint64_t connections() const { return _connections; }
+    void connectionAdded() { ++_connections; }
+    void connectionMovedOut() { --_connections; }
+    //Folds the connection's counts into the reactor's totals
+    void connectionRemoved(const ConnectionCounters& counters);
+    const ConnectionCounters& closedTotals() const { return _closedTotals; }
+
+    void addBusyMicros(uint64_t micros) { _busyMicros += micros; }
+    //Time spent in message handlers on this reactor's workers
+    uint64_t busyMicros() const { return _busyMicros; }
+
+private:
+    const int _id;
+    const int _threads;
+    const int _cpu;
+    const std::string _threadName;
+    asio::io_service _service;
+    MessageBufferPool _bufferPool;
+    //Keeps run() from returning while the reactor has no sockets
+    std::unique_ptr<asio::io_service::work> _work;
+    std::vector<boost::thread> _threadPool;
+    std::unique_ptr<Reactor> _workers;
+    std::atomic<uint64_t> _connections{};
+    ConnectionCounters _closedTotals;
+    std::atomic<uint64_t> _busyMicros{};
+
+    void serviceRun();
+};
+
 /*
  * TODO: NUMA aware handling will be added one day, so NONE of this is static
  * All funcions starting with async are calling from async functions, should not
  * take locks if at all possible
  */
 class Connections {
+    MONGO_DISALLOW_COPYING(Connections);
 public:
-    void newConnHandler(asio::ip::tcp::socket&& socket);
+    Connections(MessageHandler* handler,
+                int idleTimeoutSecs,
+                int pipelineDepth);
+
+    /*
+     * Takes ownership of a newly accepted socket, rejects it if over the connection limit
+     */
+    void newConnHandler(asio::ip::tcp::socket&& socket, Reactor* reactor);
+    void remove(ConnectionInfo* conn);
+    void closeAll();
+    /*
+     * The open connections, the lock is only held to copy the pointers
+     */
+    std::vector<std::shared_ptr<ConnectionInfo>> snapshot();
+
+    MessageHandler* handler() const { return _handler; }
+    int idleTimeoutSecs() const { return _idleTimeoutSecs; }
+    int pipelineDepth() const { return _pipelineDepth; }
 
 private:
-    std::unordered_map<ConnectionInfo*, std::unique_ptr<ConnectionInfo>> _conns;
-    uint64_t _connectionCount{};
-    std::mutex _mutex; //Protects access to _conns and _connectionCount
+    MessageHandler* const _handler;
+    const int _idleTimeoutSecs;
+    const int _pipelineDepth;
+    std::unordered_map<ConnectionInfo*, std::shared_ptr<ConnectionInfo>> _conns;
+    std::mutex _mutex; //Protects access to _conns
 };
 
 /*
@@ -200,32 +407,83 @@ class NetworkServer : public Server {
 public:
     NetworkServer(const NetworkOptions options, Connections* connections);
     ~NetworkServer() final;
+
+    /*
+     * Binds all the end points, returns false if any failed
+     */
+    bool setupSockets();
+    /*
+     * Starts the reactors and blocks until they are stopped
+     */
     void run() final;
+    void stop();
+
+    //The acceptors run on the first reactor
+    asio::io_service& service() { return _reactors.front()->service(); }
+    Connections* connections() const { return _connections; }
+
+    /*
+     * Appends the reactors, each with its connection counts summed over closed connections and
+     * a sample of the open ones, and the sum of those over all reactors
+     */
+    void appendReactorStats(BSONObjBuilder* builder) const;
 
 private:
     struct Initiator {
         Initiator(asio::io_service& service, const asio::ip::tcp::endpoint& endPoint);
         asio::ip::tcp::acceptor _acceptor;
-        asio::ip::tcp::socket _socket;
+        //The next socket is created on the reactor picked for it
+        std::unique_ptr<asio::ip::tcp::socket> _socket;
+        Reactor* _target{};
     };
     const NetworkOptions _options;
     Connections* _connections;
-    asio::io_service _service;
-    //Holds the end points and currently waiting socket
-    std::vector<Initiator> _endPoints;
-    std::vector<boost::thread> _threads;
+    std::vector<std::unique_ptr<Reactor>> _reactors;
+    std::atomic<uint64_t> _nextReactor{};
+    //Holds the end points and currently waiting socket, handlers keep pointers to them
+    std::vector<std::unique_ptr<Initiator>> _endPoints;
+    //The rebalancer runs on the first reactor, these are only touched from its timer
+    std::unique_ptr<asio::steady_timer> _rebalanceTimer;
+    std::vector<uint64_t> _lastReactorBusy;
+    std::unordered_map<ConnectionId, uint64_t> _lastConnectionBusy;
 
-    void serviceRun();
-    void startAllWaits();
-    void startWait(Initiator* const initiator);
+    Reactor* pickReactor();
+    void asyncRebalance();
     /*
-     * New conn handler
-     * Only used to hand off the data
+     * Compares the time each reactor's workers spent in handlers since the last check, if the
+     * busiest did more than twice the work of the idlest, moves one long lived connection
+     * between them.  Its handlers then run on the workers of the idlest
      */
-    void newConnHandler(asio::ip::tcp::socket&& socket);
+    void rebalance();
+    void startAllWaits();
+    void startWait(Initiator* const initiator);
 };
 
+/*
+ * Adapts NetworkServer to MessageServer so mongos can pick it at startup instead of the
+ * thread per connection PortMessageServer
+ * It is also a Listener only so it can be the time tracker, it never calls initAndListen
+ */
+class AsyncMessageServer final : public MessageServer, public Listener {
+public:
+    AsyncMessageServer(const NetworkOptions& options, MessageHandler* handler);
+
+    void run() final;
+    void setAsTimeTracker() final {
+        Listener::setAsTimeTracker();
+    }
+    void setupSockets() final;
+
+private:
+    Connections _connections;
+    NetworkServer _server;
+    asio::steady_timer _timeTracker;
+    bool _setupSocketsSuccessful{};
+
+    void asyncTrackTime();
+};
+
+MessageServer* createAsyncServer(const NetworkOptions& options, MessageHandler* handler);
+
 } /* namespace network */
 } /* namespace mongo */
-
-#endif /* SRC_MONGO_UTIL_NET_NETWORK_SERVER_H_ */